@@ -57,16 +57,14 @@ namespace cupuacu
             [[nodiscard]] bool isDirty(const int64_t channel,
                                        const int64_t frame) const
             {
-                return segment->dirty[static_cast<std::size_t>(channel)]
-                                     [static_cast<std::size_t>(frame)] != 0;
+                return segment->isDirty(channel, frame);
             }
 
             [[nodiscard]] audio::SampleProvenance
             getSampleProvenance(const int64_t channel,
                                 const int64_t frame) const
             {
-                return segment->provenance[static_cast<std::size_t>(channel)]
-                                          [static_cast<std::size_t>(frame)];
+                return segment->getProvenance(channel, frame);
             }
         };
 
@@ -101,10 +99,6 @@ namespace cupuacu
             {
                 initialized.samples[channel].assign(
                     static_cast<std::size_t>(initialized.frameCount), 0.0f);
-                initialized.dirty[channel].assign(
-                    static_cast<std::size_t>(initialized.frameCount), 0u);
-                initialized.provenance[channel].assign(
-                    static_cast<std::size_t>(initialized.frameCount), {});
             }
 
             return initialized;
@@ -158,8 +152,7 @@ namespace cupuacu
         [[nodiscard]] audio::SampleProvenance
         getSampleProvenance(const int64_t channel, const int64_t frame) const
         {
-            return segment->provenance[static_cast<std::size_t>(channel)]
-                                      [static_cast<std::size_t>(frame)];
+            return segment->getProvenance(channel, frame);
         }
 
         [[nodiscard]] ReadLease acquireReadLease() const
@@ -201,9 +194,17 @@ namespace cupuacu
 
             segment->samples[static_cast<std::size_t>(channel)]
                             [static_cast<std::size_t>(frame)] = value;
-            segment->dirty[static_cast<std::size_t>(channel)]
-                          [static_cast<std::size_t>(frame)] =
-                shouldMarkDirty ? 1u : 0u;
+            segment->dirty.resize(std::max<std::size_t>(
+                segment->dirty.size(), static_cast<std::size_t>(channel) + 1));
+            auto &channelDirty = segment->dirty[static_cast<std::size_t>(channel)];
+            if (shouldMarkDirty)
+            {
+                channelDirty.add(frame, frame + 1);
+            }
+            else
+            {
+                channelDirty.remove(frame, frame + 1);
+            }
             touch();
         }
 
@@ -252,36 +253,48 @@ namespace cupuacu
                 boundedCount * std::max<int64_t>(1, result.channelCount);
             for (int64_t channel = 0; channel < result.channelCount; ++channel)
             {
-                auto &channelSamples =
-                    result.samples[static_cast<std::size_t>(channel)];
-                auto &channelDirty =
-                    result.dirty[static_cast<std::size_t>(channel)];
-                auto &channelProvenance =
-                    result.provenance[static_cast<std::size_t>(channel)];
+                const auto channelIndex = static_cast<std::size_t>(channel);
+                const auto &sourceSamples = segment->samples[channelIndex];
+                auto &channelSamples = result.samples[channelIndex];
                 channelSamples.resize(static_cast<std::size_t>(boundedCount));
-                channelDirty.resize(static_cast<std::size_t>(boundedCount));
-                channelProvenance.resize(static_cast<std::size_t>(boundedCount));
-                for (int64_t frame = 0; frame < boundedCount; ++frame)
+                for (int64_t frame = 0; frame < boundedCount;
+                     frame += kProgressStrideFrames)
                 {
-                    const auto sourceIndex =
-                        static_cast<std::size_t>(boundedStart + frame);
-                    channelSamples[static_cast<std::size_t>(frame)] =
-                        segment->samples[static_cast<std::size_t>(channel)]
-                                        [sourceIndex];
-                    channelDirty[static_cast<std::size_t>(frame)] =
-                        segment->dirty[static_cast<std::size_t>(channel)]
-                                      [sourceIndex];
-                    channelProvenance[static_cast<std::size_t>(frame)] =
-                        segment->provenance[static_cast<std::size_t>(channel)]
-                                           [sourceIndex];
-                    if (progress &&
-                        (((frame + 1) % kProgressStrideFrames) == 0 ||
-                         frame + 1 == boundedCount))
+                    const auto chunkFrames =
+                        std::min(kProgressStrideFrames, boundedCount - frame);
+                    std::copy_n(sourceSamples.begin() + boundedStart + frame,
+                                chunkFrames, channelSamples.begin() + frame);
+                    if (progress)
                     {
-                        progress(channel * boundedCount + frame + 1,
+                        progress(channel * boundedCount + frame + chunkFrames,
                                  totalProgressUnits);
                     }
                 }
+
+                if (channelIndex < segment->dirty.size())
+                {
+                    for (const auto &range :
+                         segment->dirty[channelIndex].rangesWithin(
+                             boundedStart, boundedStart + boundedCount))
+                    {
+                        result.dirty[channelIndex].add(
+                            range.startFrame - boundedStart,
+                            range.endFrameExclusive - boundedStart);
+                    }
+                }
+
+                if (channelIndex < segment->provenance.size())
+                {
+                    auto &channelProvenance = result.provenance[channelIndex];
+                    channelProvenance = audio::provenanceRangesWithin(
+                        segment->provenance[channelIndex], boundedStart,
+                        boundedStart + boundedCount);
+                    for (auto &range : channelProvenance)
+                    {
+                        range.startFrame -= boundedStart;
+                        range.endFrameExclusive -= boundedStart;
+                    }
+                }
             }
 
             return result;
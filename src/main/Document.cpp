@@ -1,11 +1,14 @@
 #include "Document.hpp"
 
+#include "Logger.hpp"
 #include "audio/PreservationTrackingAudioBuffer.hpp"
 
 #include <algorithm>
 #include <cstddef>
+#include <exception>
 #include <mutex>
 #include <shared_mutex>
+#include <span>
 #include <utility>
 
 namespace cupuacu
@@ -17,6 +20,25 @@ namespace cupuacu
             static uint64_t nextId = 1;
             return nextId++;
         }
+
+        int64_t readBufferFrames(const cupuacu::audio::AudioBuffer &buffer,
+                                 const int64_t channel, const int64_t startFrame,
+                                 float *destination, const int64_t frameCount)
+        {
+            if (!destination || channel < 0 ||
+                channel >= buffer.getChannelCount() || startFrame < 0 ||
+                frameCount <= 0)
+            {
+                return 0;
+            }
+
+            const auto readableFrames = std::min<int64_t>(
+                frameCount,
+                std::max<int64_t>(0, buffer.getFrameCount() - startFrame));
+            buffer.readChannelFrames(channel, startFrame, destination,
+                                     readableFrames);
+            return readableFrames;
+        }
     } // namespace
 
     Document::~Document() = default;
@@ -30,7 +52,11 @@ namespace cupuacu
         preservationSourceId = other.preservationSourceId;
         waveformDataVersion = other.waveformDataVersion;
         markerDataVersion = other.markerDataVersion;
+        frameVersions = other.frameVersions;
         nextMarkerId = other.nextMarkerId;
+        sampleScratchFile = other.sampleScratchFile;
+        residentSampleBudgetBytes = other.residentSampleBudgetBytes;
+        residentBytesAddedSinceCheck = other.residentBytesAddedSinceCheck;
         markers = other.markers;
     }
 
@@ -50,7 +76,11 @@ namespace cupuacu
         preservationSourceId = other.preservationSourceId;
         waveformDataVersion = other.waveformDataVersion;
         markerDataVersion = other.markerDataVersion;
+        frameVersions = other.frameVersions;
         nextMarkerId = other.nextMarkerId;
+        sampleScratchFile = other.sampleScratchFile;
+        residentSampleBudgetBytes = other.residentSampleBudgetBytes;
+        residentBytesAddedSinceCheck = other.residentBytesAddedSinceCheck;
         markers = other.markers;
         return *this;
     }
@@ -64,7 +94,11 @@ namespace cupuacu
         preservationSourceId = other.preservationSourceId;
         waveformDataVersion = other.waveformDataVersion;
         markerDataVersion = other.markerDataVersion;
+        frameVersions = std::move(other.frameVersions);
         nextMarkerId = other.nextMarkerId;
+        sampleScratchFile = std::move(other.sampleScratchFile);
+        residentSampleBudgetBytes = other.residentSampleBudgetBytes;
+        residentBytesAddedSinceCheck = other.residentBytesAddedSinceCheck;
         markers = std::move(other.markers);
     }
 
@@ -84,7 +118,11 @@ namespace cupuacu
         preservationSourceId = other.preservationSourceId;
         waveformDataVersion = other.waveformDataVersion;
         markerDataVersion = other.markerDataVersion;
+        frameVersions = std::move(other.frameVersions);
         nextMarkerId = other.nextMarkerId;
+        sampleScratchFile = std::move(other.sampleScratchFile);
+        residentSampleBudgetBytes = other.residentSampleBudgetBytes;
+        residentBytesAddedSinceCheck = other.residentBytesAddedSinceCheck;
         markers = std::move(other.markers);
         return *this;
     }
@@ -111,6 +149,18 @@ namespace cupuacu
         return buffer->getSample(channel, frame);
     }
 
+    int64_t Document::readFramesUnlocked(const int64_t channel,
+                                         const int64_t startFrame,
+                                         float *destination,
+                                         const int64_t frameCount) const
+    {
+        return readBufferFrames(*buffer, channel, startFrame, destination,
+                                frameCount);
+    }
+
+    // Cloning copies only the block tables; sample blocks stay shared with
+    // the other holders (document copies and live read leases) and are
+    // duplicated one at a time as they are written.
     void Document::ensureUniqueBufferUnlocked()
     {
         if (buffer.use_count() != 1)
@@ -119,6 +169,71 @@ namespace cupuacu
         }
     }
 
+    // The buffer's blocks count the RAM they take as they are detached,
+    // sliced, packed or grown, whichever write did it. Scanning the block
+    // tables is linear in the document length, so the budget is only
+    // checked again after a quarter of it has been taken. The change that
+    // brought the blocks in is already made, so a scratch file that cannot
+    // take them, such as on a full disk, leaves them in RAM.
+    void Document::enforceResidentSampleBudgetUnlocked()
+    {
+        const auto bytesAdded = buffer->takeResidentBytesAdded();
+        if (!sampleScratchFile || residentSampleBudgetBytes <= 0)
+        {
+            return;
+        }
+
+        residentBytesAddedSinceCheck += bytesAdded;
+        if (residentBytesAddedSinceCheck < residentSampleBudgetBytes / 4)
+        {
+            return;
+        }
+        residentBytesAddedSinceCheck = 0;
+        try
+        {
+            buffer->pageOutResidentBlocks(*sampleScratchFile,
+                                          residentSampleBudgetBytes / 2);
+        }
+        catch (const std::exception &e)
+        {
+            cupuacu::logging::warn(
+                std::string("Keeping samples in RAM: ") + e.what());
+        }
+    }
+
+    // Every change to the samples goes through here, so that whatever
+    // blocks it brought into RAM are held to the budget before the lock
+    // is released.
+    template <typename Mutate> void Document::mutateSamples(Mutate &&mutate)
+    {
+        std::unique_lock lock(dataMutex);
+        ensureUniqueBufferUnlocked();
+        mutate();
+        enforceResidentSampleBudgetUnlocked();
+    }
+
+    void Document::resetFrameVersionsUnlocked()
+    {
+        frameVersions.resize(
+            static_cast<std::size_t>(getChannelCountUnlocked()));
+        for (auto &versions : frameVersions)
+        {
+            versions.reset();
+        }
+    }
+
+    void Document::markFramesChangedUnlocked(const int64_t channel,
+                                             const int64_t startFrame,
+                                             const int64_t endFrameExclusive)
+    {
+        if (channel >= 0 &&
+            channel < static_cast<int64_t>(frameVersions.size()))
+        {
+            frameVersions[static_cast<std::size_t>(channel)].markChanged(
+                startFrame, endFrameExclusive);
+        }
+    }
+
     int64_t Document::clampMarkerFrameUnlocked(const int64_t frame) const
     {
         return std::clamp(frame, int64_t{0}, getFrameCountUnlocked());
@@ -166,64 +281,101 @@ namespace cupuacu
                      : std::make_shared<cupuacu::audio::AudioBuffer>();
         buffer->resize(channelCount, frameCount);
         ++waveformDataVersion;
+        resetFrameVersionsUnlocked();
         ++markerDataVersion;
         markers.clear();
         nextMarkerId = 1;
     }
 
     Document::ReadLease::ReadLease(const Document &documentToRead)
-        : document(&documentToRead),
-          lock(documentToRead.dataMutex)
     {
+        // Only copying the snapshot needs the lock. Holding a reference to
+        // the buffer makes the next write clone its block table, so the
+        // samples seen here stay unchanged for the lifetime of the lease.
+        std::shared_lock lock(documentToRead.dataMutex);
+        buffer = documentToRead.buffer;
+        format = documentToRead.format;
+        sampleRate = documentToRead.sampleRate;
+        preservationSourceId = documentToRead.preservationSourceId;
+        waveformDataVersion = documentToRead.waveformDataVersion;
+        markerDataVersion = documentToRead.markerDataVersion;
+        markers = documentToRead.markers;
     }
 
     SampleFormat Document::ReadLease::getSampleFormat() const
     {
-        return document->format;
+        return format;
     }
 
     int Document::ReadLease::getSampleRate() const
     {
-        return document->sampleRate;
+        return sampleRate;
     }
 
     int64_t Document::ReadLease::getFrameCount() const
     {
-        return document->getFrameCountUnlocked();
+        return buffer->getFrameCount();
     }
 
     int64_t Document::ReadLease::getChannelCount() const
     {
-        return document->getChannelCountUnlocked();
+        return buffer->getChannelCount();
+    }
+
+    uint64_t Document::ReadLease::getWaveformDataVersion() const
+    {
+        return waveformDataVersion;
+    }
+
+    uint64_t Document::ReadLease::getMarkerDataVersion() const
+    {
+        return markerDataVersion;
     }
 
     float Document::ReadLease::getSample(const int64_t channel,
                                          const int64_t frame) const
     {
-        return document->getSampleUnlocked(channel, frame);
+        return buffer->getSample(channel, frame);
+    }
+
+    int64_t Document::ReadLease::readFrames(const int64_t channel,
+                                            const int64_t startFrame,
+                                            float *destination,
+                                            const int64_t frameCount) const
+    {
+        return readBufferFrames(*buffer, channel, startFrame, destination,
+                                frameCount);
     }
 
     bool Document::ReadLease::isDirty(const int64_t channel,
                                       const int64_t frame) const
     {
-        return document->buffer->isDirty(channel, frame);
+        return buffer->isDirty(channel, frame);
+    }
+
+    std::vector<audio::FrameRange>
+    Document::ReadLease::getDirtyRanges(const int64_t channel,
+                                        const int64_t startFrame,
+                                        const int64_t endFrameExclusive) const
+    {
+        return buffer->getDirtyRanges(channel, startFrame, endFrameExclusive);
     }
 
     cupuacu::audio::SampleProvenance
     Document::ReadLease::getSampleProvenance(const int64_t channel,
                                              const int64_t frame) const
     {
-        return document->buffer->getProvenance(channel, frame);
+        return buffer->getProvenance(channel, frame);
     }
 
     uint64_t Document::ReadLease::getPreservationSourceId() const
     {
-        return document->preservationSourceId;
+        return preservationSourceId;
     }
 
     const std::vector<DocumentMarker> &Document::ReadLease::getMarkers() const
     {
-        return document->markers;
+        return markers;
     }
 
     Document::ReadLease Document::acquireReadLease() const
@@ -249,6 +401,20 @@ namespace cupuacu
         return waveformDataVersion;
     }
 
+    uint64_t Document::getFrameRangeVersion(const int64_t channel,
+                                            const int64_t startFrame,
+                                            const int64_t endFrameExclusive) const
+    {
+        std::shared_lock lock(dataMutex);
+        if (channel < 0 ||
+            channel >= static_cast<int64_t>(frameVersions.size()))
+        {
+            return 0;
+        }
+        return frameVersions[static_cast<std::size_t>(channel)].versionOf(
+            startFrame, endFrameExclusive);
+    }
+
     uint64_t Document::getMarkerDataVersion() const
     {
         std::shared_lock lock(dataMutex);
@@ -273,13 +439,24 @@ namespace cupuacu
         return getSampleUnlocked(channel, frame);
     }
 
+    int64_t Document::readFrames(const int64_t channel, const int64_t startFrame,
+                                 float *destination,
+                                 const int64_t frameCount) const
+    {
+        std::shared_lock lock(dataMutex);
+        return readFramesUnlocked(channel, startFrame, destination, frameCount);
+    }
+
     void Document::setSample(int64_t channel, int64_t frame, float value,
                              const bool shouldMarkDirty)
     {
-        std::unique_lock lock(dataMutex);
-        ensureUniqueBufferUnlocked();
-        buffer->setSample(channel, frame, value, shouldMarkDirty);
-        ++waveformDataVersion;
+        mutateSamples(
+            [&]
+            {
+                buffer->setSample(channel, frame, value, shouldMarkDirty);
+                ++waveformDataVersion;
+                markFramesChangedUnlocked(channel, frame, frame + 1);
+            });
     }
 
     void Document::writeInterleavedFloatBlock(const int64_t startFrame,
@@ -288,59 +465,92 @@ namespace cupuacu
                                               const int64_t channelCount,
                                               const bool shouldMarkDirty)
     {
-        std::unique_lock lock(dataMutex);
         if (!interleaved || startFrame < 0 || frameCount <= 0 ||
             channelCount <= 0)
         {
             return;
         }
-        ensureUniqueBufferUnlocked();
-
-        const auto writableFrames = std::min<int64_t>(
-            frameCount,
-            std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
-        const auto writableChannels =
-            std::min<int64_t>(channelCount, getChannelCountUnlocked());
-        if (writableFrames <= 0 || writableChannels <= 0)
-        {
-            return;
-        }
 
-        if (shouldMarkDirty)
-        {
-            for (int64_t frame = 0; frame < writableFrames; ++frame)
+        mutateSamples(
+            [&]
             {
+                const auto writableFrames = std::min<int64_t>(
+                    frameCount,
+                    std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
+                const auto writableChannels =
+                    std::min<int64_t>(channelCount, getChannelCountUnlocked());
+                if (writableFrames <= 0 || writableChannels <= 0)
+                {
+                    return;
+                }
+
+                const auto stride = static_cast<std::size_t>(channelCount);
                 for (int64_t channel = 0; channel < writableChannels; ++channel)
                 {
-                    buffer->setSample(
-                        channel, startFrame + frame,
-                        interleaved[static_cast<std::size_t>(frame) *
-                                        static_cast<std::size_t>(
-                                            channelCount) +
-                                    static_cast<std::size_t>(channel)],
-                        true);
+                    markFramesChangedUnlocked(channel, startFrame,
+                                              startFrame + writableFrames);
+                    if (shouldMarkDirty)
+                    {
+                        buffer->markDirty(channel, startFrame,
+                                          startFrame + writableFrames);
+                    }
+                    buffer->forEachMutableChannelSpan(
+                        channel, startFrame, writableFrames,
+                        [&](const std::span<float> span,
+                            const int64_t spanStartFrame)
+                        {
+                            const auto *source =
+                                interleaved +
+                                static_cast<std::size_t>(spanStartFrame -
+                                                         startFrame) *
+                                    stride +
+                                static_cast<std::size_t>(channel);
+                            for (std::size_t i = 0; i < span.size(); ++i)
+                            {
+                                span[i] = source[i * stride];
+                            }
+                        });
                 }
-            }
-            ++waveformDataVersion;
+                ++waveformDataVersion;
+            });
+    }
+
+    void Document::writeInterleavedPcmBlock(const int64_t startFrame,
+                                            const std::int32_t *interleaved,
+                                            const int64_t frameCount,
+                                            const int64_t channelCount,
+                                            const int bitDepth)
+    {
+        if (!interleaved || startFrame < 0 || frameCount <= 0 ||
+            channelCount <= 0 || (bitDepth != 16 && bitDepth != 24))
+        {
             return;
         }
 
-        for (int64_t channel = 0; channel < writableChannels; ++channel)
-        {
-            auto channelData = buffer->getMutableChannelData(channel);
-            if (channelData.empty())
-            {
-                continue;
-            }
-            for (int64_t frame = 0; frame < writableFrames; ++frame)
+        mutateSamples(
+            [&]
             {
-                channelData[static_cast<std::size_t>(startFrame + frame)] =
-                    interleaved[static_cast<std::size_t>(frame) *
-                                    static_cast<std::size_t>(channelCount) +
-                                static_cast<std::size_t>(channel)];
-            }
-        }
-        ++waveformDataVersion;
+                const auto writableFrames = std::min<int64_t>(
+                    frameCount,
+                    std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
+                const auto writableChannels =
+                    std::min<int64_t>(channelCount, getChannelCountUnlocked());
+                if (writableFrames <= 0 || writableChannels <= 0)
+                {
+                    return;
+                }
+
+                for (int64_t channel = 0; channel < writableChannels; ++channel)
+                {
+                    buffer->writeChannelPcmFrames(
+                        channel, startFrame, interleaved + channel,
+                        writableFrames, static_cast<std::size_t>(channelCount),
+                        bitDepth);
+                    markFramesChangedUnlocked(channel, startFrame,
+                                              startFrame + writableFrames);
+                }
+                ++waveformDataVersion;
+            });
     }
 
     void Document::writeChannelFloatBlock(const int64_t channel,
@@ -349,103 +559,157 @@ namespace cupuacu
                                           const int64_t frameCount,
                                           const bool shouldMarkDirty)
     {
-        std::unique_lock lock(dataMutex);
-        if (!samples || channel < 0 || channel >= getChannelCountUnlocked() ||
-            startFrame < 0 || frameCount <= 0)
-        {
-            return;
-        }
-
-        const auto writableFrames = std::min<int64_t>(
-            frameCount,
-            std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
-        if (writableFrames <= 0)
+        if (!samples || channel < 0 || startFrame < 0 || frameCount <= 0)
         {
             return;
         }
 
-        ensureUniqueBufferUnlocked();
-        if (shouldMarkDirty)
-        {
-            for (int64_t frame = 0; frame < writableFrames; ++frame)
+        mutateSamples(
+            [&]
             {
-                buffer->setSample(channel, startFrame + frame,
-                                  samples[static_cast<std::size_t>(frame)], true);
-            }
-        }
-        else
-        {
-            auto channelData = buffer->getMutableChannelData(channel);
-            std::copy_n(samples, static_cast<std::size_t>(writableFrames),
-                        channelData.data() + startFrame);
-        }
-        ++waveformDataVersion;
+                const auto writableFrames = std::min<int64_t>(
+                    frameCount,
+                    std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
+                if (channel >= getChannelCountUnlocked() || writableFrames <= 0)
+                {
+                    return;
+                }
+
+                buffer->writeChannelFrames(channel, startFrame, samples,
+                                           writableFrames);
+                markFramesChangedUnlocked(channel, startFrame,
+                                          startFrame + writableFrames);
+                if (shouldMarkDirty)
+                {
+                    buffer->markDirty(channel, startFrame,
+                                      startFrame + writableFrames);
+                }
+                ++waveformDataVersion;
+            });
     }
 
     void Document::resizeBuffer(int64_t channels, int64_t frames)
     {
-        std::unique_lock lock(dataMutex);
-        ensureUniqueBufferUnlocked();
-        buffer->resize(channels, frames);
-        ++waveformDataVersion;
+        mutateSamples(
+            [&]
+            {
+                const int64_t oldFrameCount = getFrameCountUnlocked();
+                buffer->resize(channels, frames);
+                ++waveformDataVersion;
+
+                // Channels that were there keep the versions of the frames
+                // they kept. Added channels get new ones.
+                const auto keptChannelCount = std::min<std::size_t>(
+                    frameVersions.size(),
+                    static_cast<std::size_t>(getChannelCountUnlocked()));
+                frameVersions.resize(keptChannelCount);
+                frameVersions.resize(
+                    static_cast<std::size_t>(getChannelCountUnlocked()));
+                for (std::size_t channel = 0; channel < keptChannelCount;
+                     ++channel)
+                {
+                    frameVersions[channel].markChanged(
+                        std::min(oldFrameCount, getFrameCountUnlocked()),
+                        audio::FrameRangeVersions::END);
+                }
+            });
     }
 
     void Document::insertFrames(
         int64_t frameIndex, int64_t numFrames,
         const SampleOperationProgressCallback &progress)
     {
-        std::unique_lock lock(dataMutex);
-        ensureUniqueBufferUnlocked();
-        buffer->insertFrames(frameIndex, numFrames, progress);
-        ++waveformDataVersion;
+        mutateSamples(
+            [&]
+            {
+                buffer->insertFrames(frameIndex, numFrames, progress);
+                ++waveformDataVersion;
 
-        if (numFrames <= 0)
-        {
-            return;
-        }
+                if (numFrames <= 0)
+                {
+                    return;
+                }
 
-        for (auto &marker : markers)
-        {
-            if (marker.frame >= frameIndex)
-            {
-                marker.frame += numFrames;
-            }
-        }
-        ++markerDataVersion;
+                for (auto &versions : frameVersions)
+                {
+                    versions.markChanged(frameIndex,
+                                         audio::FrameRangeVersions::END);
+                }
+
+                for (auto &marker : markers)
+                {
+                    if (marker.frame >= frameIndex)
+                    {
+                        marker.frame += numFrames;
+                    }
+                }
+                ++markerDataVersion;
+            });
     }
 
     void Document::removeFrames(
         int64_t frameIndex, int64_t numFrames,
         const SampleOperationProgressCallback &progress)
     {
-        std::unique_lock lock(dataMutex);
-        ensureUniqueBufferUnlocked();
-        buffer->removeFrames(frameIndex, numFrames, progress);
-        ++waveformDataVersion;
+        mutateSamples(
+            [&]
+            {
+                buffer->removeFrames(frameIndex, numFrames, progress);
+                ++waveformDataVersion;
 
-        if (numFrames <= 0)
-        {
-            normalizeMarkersUnlocked();
-            return;
-        }
+                if (numFrames <= 0)
+                {
+                    normalizeMarkersUnlocked();
+                    return;
+                }
 
-        const int64_t removedEnd = frameIndex + numFrames;
-        for (auto &marker : markers)
-        {
-            if (marker.frame >= removedEnd)
-            {
-                marker.frame -= numFrames;
-                continue;
-            }
+                for (auto &versions : frameVersions)
+                {
+                    versions.markChanged(frameIndex,
+                                         audio::FrameRangeVersions::END);
+                }
 
-            if (marker.frame >= frameIndex)
-            {
-                marker.frame = frameIndex;
-            }
-        }
+                const int64_t removedEnd = frameIndex + numFrames;
+                for (auto &marker : markers)
+                {
+                    if (marker.frame >= removedEnd)
+                    {
+                        marker.frame -= numFrames;
+                        continue;
+                    }
+
+                    if (marker.frame >= frameIndex)
+                    {
+                        marker.frame = frameIndex;
+                    }
+                }
 
-        normalizeMarkersUnlocked();
-        ++markerDataVersion;
+                normalizeMarkersUnlocked();
+                ++markerDataVersion;
+            });
+    }
+
+    void Document::setResidentSampleBudget(
+        std::shared_ptr<cupuacu::audio::SampleScratchFile> scratchFile,
+        const int64_t maxResidentBytes)
+    {
+        std::unique_lock lock(dataMutex);
+        sampleScratchFile = std::move(scratchFile);
+        residentSampleBudgetBytes = std::max<int64_t>(0, maxResidentBytes);
+        residentBytesAddedSinceCheck = 0;
+    }
+
+    int64_t Document::getResidentSampleBytes() const
+    {
+        std::shared_lock lock(dataMutex);
+        return buffer->getResidentBytes();
+    }
+
+    int64_t Document::getUnsharedResidentSampleBytes() const
+    {
+        std::shared_lock lock(dataMutex);
+        return buffer.use_count() == 1 ? buffer->getUnsharedResidentBytes()
+                                       : 0;
     }
 
     std::shared_ptr<cupuacu::audio::AudioBuffer> Document::getAudioBuffer() const
@@ -502,28 +766,39 @@ namespace cupuacu
         for (int64_t channel = 0; channel < result.channelCount; ++channel)
         {
             auto &channelSamples = result.samples[static_cast<std::size_t>(channel)];
-            auto &channelDirty = result.dirty[static_cast<std::size_t>(channel)];
-            auto &channelProvenance =
-                result.provenance[static_cast<std::size_t>(channel)];
             channelSamples.resize(static_cast<std::size_t>(boundedCount));
-            channelDirty.resize(static_cast<std::size_t>(boundedCount));
-            channelProvenance.resize(static_cast<std::size_t>(boundedCount));
-            for (int64_t frame = 0; frame < boundedCount; ++frame)
+            for (int64_t frame = 0; frame < boundedCount;
+                 frame += kProgressStrideFrames)
             {
-                channelSamples[static_cast<std::size_t>(frame)] =
-                    getSampleUnlocked(channel, boundedStart + frame);
-                channelDirty[static_cast<std::size_t>(frame)] =
-                    buffer->isDirty(channel, boundedStart + frame) ? 1u : 0u;
-                channelProvenance[static_cast<std::size_t>(frame)] =
-                    buffer->getProvenance(channel, boundedStart + frame);
-                if (progress &&
-                    (((frame + 1) % kProgressStrideFrames) == 0 ||
-                     frame + 1 == boundedCount))
+                const auto chunkFrames =
+                    std::min(kProgressStrideFrames, boundedCount - frame);
+                buffer->readChannelFrames(channel, boundedStart + frame,
+                                          channelSamples.data() + frame,
+                                          chunkFrames);
+                if (progress)
                 {
-                    progress(channel * boundedCount + frame + 1,
+                    progress(channel * boundedCount + frame + chunkFrames,
                              totalProgressUnits);
                 }
             }
+
+            auto &channelDirty = result.dirty[static_cast<std::size_t>(channel)];
+            for (const auto &range : buffer->getDirtyRanges(
+                     channel, boundedStart, boundedStart + boundedCount))
+            {
+                channelDirty.add(range.startFrame - boundedStart,
+                                 range.endFrameExclusive - boundedStart);
+            }
+
+            auto &channelProvenance =
+                result.provenance[static_cast<std::size_t>(channel)];
+            channelProvenance = buffer->getProvenanceRanges(
+                channel, boundedStart, boundedStart + boundedCount);
+            for (auto &range : channelProvenance)
+            {
+                range.startFrame -= boundedStart;
+                range.endFrameExclusive -= boundedStart;
+            }
         }
 
         return result;
@@ -543,8 +818,19 @@ namespace cupuacu
         const bool shouldMarkDirty,
         const SampleOperationProgressCallback &progress)
     {
-        std::unique_lock lock(dataMutex);
-        ensureUniqueBufferUnlocked();
+        mutateSamples(
+            [&]
+            {
+                writeSegmentUnlocked(startFrame, segment, shouldMarkDirty,
+                                     progress);
+            });
+    }
+
+    void Document::writeSegmentUnlocked(
+        const int64_t startFrame, const AudioSegment &segment,
+        const bool shouldMarkDirty,
+        const SampleOperationProgressCallback &progress)
+    {
         const auto writableFrames = std::min<int64_t>(
             segment.frameCount,
             std::max<int64_t>(0, getFrameCountUnlocked() - startFrame));
@@ -556,40 +842,50 @@ namespace cupuacu
 
         for (int64_t channel = 0; channel < writableChannels; ++channel)
         {
-            const bool hasDirtyForChannel =
-                channel < static_cast<int64_t>(segment.dirty.size());
-            for (int64_t frame = 0; frame < writableFrames; ++frame)
+            const auto &channelSamples =
+                segment.samples[static_cast<std::size_t>(channel)];
+            for (int64_t frame = 0; frame < writableFrames;
+                 frame += kProgressStrideFrames)
             {
-                const bool sampleShouldMarkDirty =
-                    shouldMarkDirty ||
-                    (hasDirtyForChannel &&
-                     frame < static_cast<int64_t>(
-                                 segment.dirty[static_cast<std::size_t>(channel)]
-                                     .size()) &&
-                     segment.dirty[static_cast<std::size_t>(channel)]
-                                 [static_cast<std::size_t>(frame)] != 0);
-                buffer->setSample(
-                    channel, startFrame + frame,
-                    segment.samples[static_cast<std::size_t>(channel)]
-                                   [static_cast<std::size_t>(frame)],
-                    sampleShouldMarkDirty);
-                if (channel < static_cast<int64_t>(segment.provenance.size()) &&
-                    frame < static_cast<int64_t>(
-                                segment.provenance[static_cast<std::size_t>(channel)]
-                                    .size()))
+                const auto chunkFrames =
+                    std::min(kProgressStrideFrames, writableFrames - frame);
+                buffer->writeChannelFrames(channel, startFrame + frame,
+                                           channelSamples.data() + frame,
+                                           chunkFrames);
+                if (progress)
                 {
-                    buffer->setProvenance(
-                        channel, startFrame + frame,
-                        segment.provenance[static_cast<std::size_t>(channel)]
-                                          [static_cast<std::size_t>(frame)]);
+                    progress(channel * writableFrames + frame + chunkFrames,
+                             totalProgressUnits);
                 }
-                if (progress &&
-                    (((frame + 1) % kProgressStrideFrames) == 0 ||
-                     frame + 1 == writableFrames))
+            }
+
+            markFramesChangedUnlocked(channel, startFrame,
+                                      startFrame + writableFrames);
+            if (shouldMarkDirty)
+            {
+                buffer->markDirty(channel, startFrame, startFrame + writableFrames);
+            }
+            else if (channel < static_cast<int64_t>(segment.dirty.size()))
+            {
+                for (const auto &range :
+                     segment.dirty[static_cast<std::size_t>(channel)].rangesWithin(
+                         0, writableFrames))
                 {
-                    progress(channel * writableFrames + frame + 1,
-                             totalProgressUnits);
+                    buffer->markDirty(channel, startFrame + range.startFrame,
+                                      startFrame + range.endFrameExclusive);
+                }
+            }
+
+            if (channel < static_cast<int64_t>(segment.provenance.size()))
+            {
+                auto ranges = segment.provenance[static_cast<std::size_t>(channel)];
+                for (auto &range : ranges)
+                {
+                    range.startFrame += startFrame;
+                    range.endFrameExclusive += startFrame;
                 }
+                buffer->setProvenanceRanges(channel, startFrame,
+                                            startFrame + writableFrames, ranges);
             }
         }
         ++waveformDataVersion;
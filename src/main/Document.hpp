@@ -1,13 +1,17 @@
 #pragma once
 
 #include "audio/AudioBuffer.hpp"
+#include "audio/FrameRangeSet.hpp"
+#include "audio/FrameRangeVersions.hpp"
 #include "audio/SampleProvenance.hpp"
+#include "audio/SampleScratchFile.hpp"
 #include "SampleFormat.hpp"
 
 #include <functional>
 #include <memory>
 #include <shared_mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace cupuacu
@@ -34,8 +38,29 @@ namespace cupuacu
             int64_t channelCount = 0;
             int64_t frameCount = 0;
             std::vector<std::vector<float>> samples;
-            std::vector<std::vector<std::uint8_t>> dirty;
-            std::vector<std::vector<audio::SampleProvenance>> provenance;
+            // Per channel, in frames relative to the start of the segment.
+            std::vector<audio::FrameRangeSet> dirty;
+            std::vector<std::vector<audio::ProvenanceRange>> provenance;
+
+            [[nodiscard]] bool isDirty(const int64_t channel,
+                                       const int64_t frame) const
+            {
+                return channel >= 0 &&
+                       channel < static_cast<int64_t>(dirty.size()) &&
+                       dirty[static_cast<std::size_t>(channel)].contains(frame);
+            }
+
+            [[nodiscard]] audio::SampleProvenance
+            getProvenance(const int64_t channel, const int64_t frame) const
+            {
+                if (channel < 0 ||
+                    channel >= static_cast<int64_t>(provenance.size()))
+                {
+                    return {};
+                }
+                return audio::findProvenance(
+                    provenance[static_cast<std::size_t>(channel)], frame);
+            }
         };
 
     private:
@@ -46,18 +71,35 @@ namespace cupuacu
         uint64_t preservationSourceId = 0;
         uint64_t waveformDataVersion = 0;
         uint64_t markerDataVersion = 0;
+        // One per channel.
+        std::vector<audio::FrameRangeVersions> frameVersions;
         uint64_t nextMarkerId = 1;
+        std::shared_ptr<audio::SampleScratchFile> sampleScratchFile;
+        int64_t residentSampleBudgetBytes = 0;
+        int64_t residentBytesAddedSinceCheck = 0;
         mutable std::shared_mutex dataMutex;
         std::vector<DocumentMarker> markers;
 
         int64_t getFrameCountUnlocked() const;
         int64_t getChannelCountUnlocked() const;
         float getSampleUnlocked(int64_t channel, int64_t frame) const;
+        int64_t readFramesUnlocked(int64_t channel, int64_t startFrame,
+                                   float *destination,
+                                   int64_t frameCount) const;
         int64_t clampMarkerFrame(int64_t frame) const;
         int64_t clampMarkerFrameUnlocked(int64_t frame) const;
         void normalizeMarkers();
         void normalizeMarkersUnlocked();
         void ensureUniqueBufferUnlocked();
+        void enforceResidentSampleBudgetUnlocked();
+        template <typename Mutate> void mutateSamples(Mutate &&mutate);
+        void resetFrameVersionsUnlocked();
+        void markFramesChangedUnlocked(int64_t channel, int64_t startFrame,
+                                       int64_t endFrameExclusive);
+        void writeSegmentUnlocked(
+            int64_t startFrame, const AudioSegment &segment,
+            bool shouldMarkDirty,
+            const SampleOperationProgressCallback &progress);
 
     public:
         Document() = default;
@@ -67,6 +109,10 @@ namespace cupuacu
         Document(Document &&other) noexcept;
         Document &operator=(Document &&other) noexcept;
 
+        // A pinned, immutable snapshot of the document taken when the lease
+        // is acquired. It holds no lock: writers that run while a lease is
+        // alive detach from the snapshot's block table instead of waiting,
+        // and the lease keeps reading the version it pinned.
         class ReadLease
         {
         public:
@@ -79,8 +125,30 @@ namespace cupuacu
             [[nodiscard]] int getSampleRate() const;
             [[nodiscard]] int64_t getFrameCount() const;
             [[nodiscard]] int64_t getChannelCount() const;
+            // getWaveformDataVersion() of the document when this snapshot
+            // was taken.
+            [[nodiscard]] uint64_t getWaveformDataVersion() const;
+            [[nodiscard]] uint64_t getMarkerDataVersion() const;
             [[nodiscard]] float getSample(int64_t channel, int64_t frame) const;
+            // Copies up to frameCount samples of channel starting at
+            // startFrame into destination and returns how many were copied;
+            // frames past the end of the document are not written.
+            int64_t readFrames(int64_t channel, int64_t startFrame,
+                               float *destination, int64_t frameCount) const;
+            // Calls fn(std::span<const float>, firstFrame) for each
+            // contiguous run of samples in the range, without copying.
+            template <typename Fn>
+            void forEachSpan(int64_t channel, int64_t startFrame,
+                             int64_t frameCount, Fn &&fn) const
+            {
+                buffer->forEachChannelSpan(channel, startFrame, frameCount,
+                                           std::forward<Fn>(fn));
+            }
             [[nodiscard]] bool isDirty(int64_t channel, int64_t frame) const;
+            // Dirty parts of [startFrame, endFrameExclusive), ascending.
+            [[nodiscard]] std::vector<audio::FrameRange>
+            getDirtyRanges(int64_t channel, int64_t startFrame,
+                           int64_t endFrameExclusive) const;
             [[nodiscard]] audio::SampleProvenance
             getSampleProvenance(int64_t channel, int64_t frame) const;
             [[nodiscard]] uint64_t getPreservationSourceId() const;
@@ -91,8 +159,13 @@ namespace cupuacu
 
             explicit ReadLease(const Document &documentToRead);
 
-            const Document *document = nullptr;
-            std::shared_lock<std::shared_mutex> lock;
+            std::shared_ptr<const cupuacu::audio::AudioBuffer> buffer;
+            SampleFormat format = SampleFormat::Unknown;
+            int sampleRate = 0;
+            uint64_t preservationSourceId = 0;
+            uint64_t waveformDataVersion = 0;
+            uint64_t markerDataVersion = 0;
+            std::vector<DocumentMarker> markers;
         };
 
         void initialize(SampleFormat sampleFormatToUse,
@@ -105,11 +178,20 @@ namespace cupuacu
 
         int getSampleRate() const;
         uint64_t getWaveformDataVersion() const;
+        // The version of the samples of channel in frames
+        // [startFrame, endFrameExclusive). Unlike getWaveformDataVersion(),
+        // it only changes when one of them is written, or when frames are
+        // inserted or removed before the end of the range. 0 for a channel
+        // the document does not have.
+        uint64_t getFrameRangeVersion(int64_t channel, int64_t startFrame,
+                                      int64_t endFrameExclusive) const;
         uint64_t getMarkerDataVersion() const;
         int64_t getFrameCount() const;
         int64_t getChannelCount() const;
 
         float getSample(int64_t channel, int64_t frame) const;
+        int64_t readFrames(int64_t channel, int64_t startFrame,
+                           float *destination, int64_t frameCount) const;
         void setSample(int64_t channel, int64_t frame, float value,
                        bool shouldMarkDirty = true);
         void writeInterleavedFloatBlock(int64_t startFrame,
@@ -117,6 +199,13 @@ namespace cupuacu
                                         int64_t frameCount,
                                         int64_t channelCount,
                                         bool shouldMarkDirty = false);
+        // Loads integer PCM samples (bitDepth 16 or 24, right-aligned in
+        // int32) without converting them; whole blocks stay in their compact
+        // form until edited. Samples are not marked dirty.
+        void writeInterleavedPcmBlock(int64_t startFrame,
+                                      const std::int32_t *interleaved,
+                                      int64_t frameCount, int64_t channelCount,
+                                      int bitDepth);
         void writeChannelFloatBlock(int64_t channel, int64_t startFrame,
                                     const float *samples, int64_t frameCount,
                                     bool shouldMarkDirty = true);
@@ -131,6 +220,17 @@ namespace cupuacu
             int64_t frameIndex, int64_t numFrames,
             const SampleOperationProgressCallback &progress = {});
 
+        // Caps the sample data kept in RAM. Once written blocks exceed
+        // maxResidentBytes they are moved into scratchFile and read back
+        // through its mapping. A null file or a budget of 0 disables paging.
+        void setResidentSampleBudget(
+            std::shared_ptr<audio::SampleScratchFile> scratchFile,
+            int64_t maxResidentBytes);
+        int64_t getResidentSampleBytes() const;
+        // Leaves out sample blocks shared with other copies of the document,
+        // which would stay in RAM without this one.
+        int64_t getUnsharedResidentSampleBytes() const;
+
         std::shared_ptr<cupuacu::audio::AudioBuffer> getAudioBuffer() const;
         uint64_t getPreservationSourceId() const;
         audio::SampleProvenance getSampleProvenance(int64_t channel,
@@ -5,6 +5,7 @@
 #include "file/AudioExport.hpp"
 #include "file/OverwritePreservationState.hpp"
 #include "gui/Selection.hpp"
+#include "undo/UndoManifestJournal.hpp"
 #include "undo/UndoStore.hpp"
 #include "waveform/WaveformCachePersistence.hpp"
 #include "waveform/DocumentWaveformCaches.hpp"
@@ -32,7 +33,9 @@ namespace cupuacu
         waveform::DocumentWaveformCaches waveformCaches;
         gui::Selection<double> selection = gui::Selection<double>(0.0);
         int64_t cursor = 0;
-        undo::UndoStore undoStore;
+        undo::UndoStore undoStore{undo::PayloadCodec::Lossless,
+                                  undo::PayloadWriteMode::WriteBehind};
+        mutable undo::UndoManifestJournal undoManifestJournal;
         mutable bool loggedRestartUndoPersistenceSizeWarning = false;
         std::filesystem::path autosaveSnapshotPath;
         uint64_t autosavedWaveformDataVersion = 0;
@@ -73,14 +76,17 @@ namespace cupuacu
             pendingPersistentWaveformCacheSave = false;
         }
 
-        [[nodiscard]] bool pumpWaveformCacheWork(const Paths *paths = nullptr)
+        [[nodiscard]] bool pumpWaveformCacheWork(
+            const Paths *paths = nullptr,
+            const waveform::PersistentCacheSettings &cacheSettings = {})
         {
             const bool stateChanged = waveformCaches.pumpWork(
                 document, document.getWaveformDataVersion());
             if (pendingPersistentWaveformCacheSave && paths &&
                 !getWaveformCacheBuildProgress().has_value())
             {
-                (void)waveform::savePersistentWaveformCache(*this, *paths);
+                (void)waveform::savePersistentWaveformCache(*this, *paths,
+                                                            cacheSettings);
                 pendingPersistentWaveformCacheSave = false;
             }
             return stateChanged;
@@ -94,15 +100,20 @@ namespace cupuacu
         }
 
         [[nodiscard]] std::optional<waveform::PersistentCacheKey>
-        getPersistentWaveformCacheKey() const
+        getPersistentWaveformCacheKey(
+            const waveform::PersistentCacheKeyMode keyMode =
+                waveform::PersistentCacheKeyMode::SourceFile) const
         {
-            return waveform::makePersistentCacheKey(currentFile, document);
+            return waveform::makePersistentCacheKey(currentFile, document,
+                                                    keyMode);
         }
 
-        [[nodiscard]] std::filesystem::path
-        getPersistentWaveformCachePath(const Paths &paths) const
+        [[nodiscard]] std::filesystem::path getPersistentWaveformCachePath(
+            const Paths &paths,
+            const waveform::PersistentCacheKeyMode keyMode =
+                waveform::PersistentCacheKeyMode::SourceFile) const
         {
-            const auto key = getPersistentWaveformCacheKey();
+            const auto key = getPersistentWaveformCacheKey(keyMode);
             if (!key.has_value())
             {
                 return {};
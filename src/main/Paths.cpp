@@ -71,6 +71,18 @@ std::filesystem::path Paths::displayPropertiesPath() const
     return path;
 }
 
+std::filesystem::path Paths::waveformCachePropertiesPath() const
+{
+    auto path = configPath() / "waveform_cache_properties.json";
+    return path;
+}
+
+std::filesystem::path Paths::undoHistoryPropertiesPath() const
+{
+    auto path = configPath() / "undo_history_properties.json";
+    return path;
+}
+
 std::filesystem::path Paths::recentlyOpenedFilesPath() const
 {
     auto path = configPath() / "recently_opened_files.json";
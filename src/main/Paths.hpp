@@ -38,6 +38,10 @@ namespace cupuacu
 
         std::filesystem::path displayPropertiesPath() const;
 
+        std::filesystem::path waveformCachePropertiesPath() const;
+
+        std::filesystem::path undoHistoryPropertiesPath() const;
+
         std::filesystem::path recentlyOpenedFilesPath() const;
 
         std::filesystem::path sessionStatePath() const;
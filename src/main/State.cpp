@@ -6,6 +6,7 @@
 #include "effects/RemoveSilenceEffect.hpp"
 
 #include "gui/Waveform.hpp"
+#include "gui/WaveformTileRenderPool.hpp"
 #include "gui/AboutWindow.hpp"
 #include "gui/ExportAudioDialogWindow.hpp"
 #include "gui/GenerateSilenceDialogWindow.hpp"
@@ -17,9 +18,52 @@
 #include "actions/io/BackgroundOpen.hpp"
 #include "actions/io/BackgroundSave.hpp"
 #include "actions/Undoable.hpp"
+#include "actions/DocumentIo.hpp"
 #include "actions/DocumentSessionPersistence.hpp"
 #include "file/OverwritePreservation.hpp"
 #include "file/OverwritePreservationMutation.hpp"
+#include "undo/UndoHistoryBudget.hpp"
+#include "Logger.hpp"
+
+namespace
+{
+    // An undo step that could not be brought back from the restart history
+    // takes the steps behind it in stack along, and the user is told.
+    void dropUnavailableHistory(
+        cupuacu::State *state,
+        std::deque<std::shared_ptr<cupuacu::actions::Undoable>> &stack,
+        const cupuacu::actions::Undoable &unavailable, const char *operation,
+        const char *followingSteps)
+    {
+        auto &tab = *state->getActiveTab();
+        const auto droppedCount =
+            cupuacu::undo::dropUnavailableUndoSteps(tab, stack, unavailable);
+
+        const std::string title = std::string(operation) + " unavailable";
+        std::string message = "An edit of \"" + tab.title +
+                              "\" could not be restored from the previous "
+                              "session, so it was removed from the history";
+        if (droppedCount > 1)
+        {
+            message += " along with the " + std::to_string(droppedCount - 1) +
+                       " " + followingSteps + " that depended on it";
+        }
+        message += ".";
+
+        cupuacu::logging::warn(title + ": " + message);
+        if (state->errorReporter)
+        {
+            state->errorReporter(title, message);
+            return;
+        }
+        if (SDL_WasInit(SDL_INIT_VIDEO) != 0)
+        {
+            SDL_ShowSimpleMessageBox(
+                SDL_MESSAGEBOX_WARNING, title.c_str(), message.c_str(),
+                cupuacu::actions::detail::getDocumentIoParentWindow(state));
+        }
+    }
+} // namespace
 
 int64_t getMaxSampleOffset(const cupuacu::State *state)
 {
@@ -116,6 +160,11 @@ void cupuacu::destroyBackgroundEffectJob(
     delete job;
 }
 
+void cupuacu::destroyWaveformTileRenderPool(gui::WaveformTileRenderPool *pool)
+{
+    delete pool;
+}
+
 cupuacu::State::~State() = default;
 
 void cupuacu::State::addUndoableToTab(
@@ -128,6 +177,13 @@ void cupuacu::State::addUndoableToTab(
 
     auto &tab = tabs[static_cast<std::size_t>(tabIndex)];
     tab.undoables.push_back(std::move(undoable));
+    for (const auto &redoable : tab.redoables)
+    {
+        if (redoable)
+        {
+            cupuacu::undo::releaseUndoPayloads(tab, *redoable);
+        }
+    }
     tab.redoables.clear();
 }
 
@@ -165,6 +221,7 @@ void cupuacu::State::addAndDoUndoableToTab(
         undoable->updateGui();
     }
 
+    cupuacu::undo::enforceUndoHistoryBudget(this);
     cupuacu::actions::autosaveDocumentAfterMutation(this, tabIndex);
 }
 
@@ -172,6 +229,7 @@ void cupuacu::State::addUndoable(
     std::shared_ptr<cupuacu::actions::Undoable> undoable)
 {
     addUndoableToTab(activeTabIndex, std::move(undoable));
+    cupuacu::undo::enforceUndoHistoryBudget(this);
 }
 
 void cupuacu::State::addAndDoUndoable(
@@ -198,6 +256,12 @@ void cupuacu::State::undo()
     undoables.pop_back();
     getActiveDocumentSession().stopWaveformCacheBuild();
     undoable->undo();
+    if (undoable->isUnavailable())
+    {
+        dropUnavailableHistory(this, undoables, *undoable, "Undo",
+                               "older undo step(s)");
+        return;
+    }
     if (!undoable->lastOperationCommitted())
     {
         undoables.push_back(undoable);
@@ -208,6 +272,7 @@ void cupuacu::State::undo()
     cupuacu::file::OverwritePreservation::refreshActiveSession(this);
     undoable->updateGui();
     redoables.push_back(undoable);
+    cupuacu::undo::enforceUndoHistoryBudget(this);
     cupuacu::actions::autosaveActiveDocumentAfterMutation(this);
 }
 
@@ -229,6 +294,12 @@ void cupuacu::State::redo()
     redoables.pop_back();
     getActiveDocumentSession().stopWaveformCacheBuild();
     redoable->redo();
+    if (redoable->isUnavailable())
+    {
+        dropUnavailableHistory(this, redoables, *redoable, "Redo",
+                               "later redo step(s)");
+        return;
+    }
     if (!redoable->lastOperationCommitted())
     {
         redoables.push_back(redoable);
@@ -239,6 +310,7 @@ void cupuacu::State::redo()
     cupuacu::file::OverwritePreservation::refreshActiveSession(this);
     redoable->updateGui();
     undoables.push_back(redoable);
+    cupuacu::undo::enforceUndoHistoryBudget(this);
     cupuacu::actions::autosaveActiveDocumentAfterMutation(this);
 }
 
@@ -13,6 +13,8 @@
 #include "gui/OptionsSection.hpp"
 #include "gui/VuMeterScale.hpp"
 #include "persistence/SessionStatePersistence.hpp"
+#include "undo/UndoHistoryBudget.hpp"
+#include "waveform/PersistentCacheSettings.hpp"
 
 #include <cstdint>
 #include <functional>
@@ -56,6 +58,7 @@ namespace cupuacu
         class MarkerEditorDialogWindow;
         class Component;
         class Waveform;
+        class WaveformTileRenderPool;
     } // namespace gui
 
     namespace effects
@@ -80,6 +83,7 @@ namespace cupuacu
     void destroyBackgroundSaveJob(actions::io::BackgroundSaveJob *);
     void destroyBackgroundAutosaveJob(actions::io::BackgroundAutosaveJob *);
     void destroyBackgroundEffectJob(actions::effects::BackgroundEffectJob *);
+    void destroyWaveformTileRenderPool(gui::WaveformTileRenderPool *);
 
     enum class PendingSaveAsMode
     {
@@ -168,9 +172,15 @@ namespace cupuacu
         int activeTabIndex = 0;
         ClipboardAudio clipboard;
         effects::EffectSettings effectSettings;
+        undo::UndoHistoryBudget undoHistoryBudget;
+        waveform::PersistentCacheSettings waveformCacheSettings;
         std::vector<std::string> recentFiles;
 
         std::vector<gui::Waveform *> waveforms;
+        // Shared by the waveforms, which create it when first needed.
+        std::unique_ptr<gui::WaveformTileRenderPool,
+                        void (*)(gui::WaveformTileRenderPool *)>
+            waveformTileRenderPool{nullptr, destroyWaveformTileRenderPool};
         std::vector<gui::Window *> windows;
         std::unique_ptr<gui::DocumentSessionWindow> mainDocumentSessionWindow;
         std::unique_ptr<gui::AboutWindow, void (*)(gui::AboutWindow *)>
@@ -3,10 +3,12 @@
 #include "../State.hpp"
 #include "../file/OverwritePreservationMutation.hpp"
 
+#include <cstdint>
 #include <functional>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace cupuacu::actions
 {
@@ -35,6 +37,13 @@ namespace cupuacu::actions
             return true;
         }
 
+        // Whether the undoable turned out to be impossible to undo or redo,
+        // such as a restart history entry whose payloads are gone.
+        [[nodiscard]] virtual bool isUnavailable() const
+        {
+            return false;
+        }
+
         [[nodiscard]] virtual bool canPersistForRestart() const
         {
             return false;
@@ -45,5 +54,26 @@ namespace cupuacu::actions
         {
             return std::nullopt;
         }
+
+        // Undo store payloads owned by this undoable. They are deleted once
+        // the undoable is dropped from the history.
+        [[nodiscard]] virtual std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const
+        {
+            return {};
+        }
+
+        // Sample data kept in memory until the undoable first needs it.
+        [[nodiscard]] virtual std::uint64_t pendingPayloadBytes() const
+        {
+            return 0;
+        }
+
+        // Moves the pending sample data into the undo store of session, the
+        // session this undoable belongs to.
+        virtual void spillPendingPayloads(cupuacu::DocumentSession &session)
+        {
+            (void)session;
+        }
     };
 } // namespace cupuacu::actions
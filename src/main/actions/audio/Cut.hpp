@@ -151,7 +151,8 @@ namespace cupuacu::actions::audio
                 updateCursorPos(state, startFrame);
                 session.selection.reset();
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, name + " complete");
+                    state, session, progressUi, name + " complete",
+                    {{.frameIndex = startFrame, .erasedFrames = numFrames}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -210,7 +211,8 @@ namespace cupuacu::actions::audio
                 }
                 updateCursorPos(state, oldCursorPos);
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, "Undo complete");
+                    state, session, progressUi, "Undo complete",
+                    {{.frameIndex = startFrame, .insertedFrames = numFrames}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -263,6 +265,12 @@ namespace cupuacu::actions::audio
             return numFrames;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {removedHandle};
+        }
+
         [[nodiscard]] const undo::UndoStore::SegmentHandle &getRemovedHandle() const
         {
             return removedHandle;
@@ -275,7 +275,7 @@ namespace cupuacu::actions::audio
                                     });
                             });
                         overwrittenHandle = detail::storeSegmentIfNeeded(
-                            session, overwrittenHandle, *overwritten,
+                            session, overwrittenHandle, std::move(*overwritten),
                             "paste-overwritten");
                     }
                 }
@@ -324,7 +324,10 @@ namespace cupuacu::actions::audio
                 session.selection.setValue2(startFrame + insertedFrameCount);
                 updateCursorPos(state, startFrame);
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, "Paste complete");
+                    state, session, progressUi, "Paste complete",
+                    {{.frameIndex = startFrame,
+                      .erasedFrames = overwrittenFrameCount,
+                      .insertedFrames = insertedFrameCount}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -414,7 +417,10 @@ namespace cupuacu::actions::audio
                 }
                 updateCursorPos(state, oldCursorPos);
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, "Undo complete");
+                    state, session, progressUi, "Undo complete",
+                    {{.frameIndex = startFrame,
+                      .erasedFrames = removeCount,
+                      .insertedFrames = overwrittenFrameCount}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -483,6 +489,12 @@ namespace cupuacu::actions::audio
             return overwrittenFrameCount;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {insertedHandle, overwrittenHandle};
+        }
+
         [[nodiscard]] const undo::UndoStore::SegmentHandle &getInsertedHandle() const
         {
             return insertedHandle;
@@ -98,8 +98,8 @@ namespace cupuacu::actions::audio
             }
 
             overwrittenOldSamplesHandle = detail::storeSampleMatrixIfNeeded(
-                session, overwrittenOldSamplesHandle, pendingOverwrittenOldSamples,
-                "record-edit-overwritten");
+                session, overwrittenOldSamplesHandle,
+                std::move(pendingOverwrittenOldSamples), "record-edit-overwritten");
             pendingOverwrittenOldSamples.reset();
             auto recordedSamples = detail::materializeSampleMatrix(
                 session, pendingRecordedSamples, recordedSamplesHandle,
@@ -112,10 +112,8 @@ namespace cupuacu::actions::audio
                 const auto &samples = recordedSamples[ch];
                 const int64_t framesToWrite = std::min<int64_t>(
                     recordedFrameCount, static_cast<int64_t>(samples.size()));
-                for (int64_t i = 0; i < framesToWrite; ++i)
-                {
-                    doc.setSample(ch, data.startFrame + i, samples[i], true);
-                }
+                doc.writeChannelFloatBlock(ch, data.startFrame, samples.data(),
+                                           framesToWrite, true);
                 if (framesToWrite > 0)
                 {
                     session.getWaveformCache(ch).invalidateSamples(
@@ -156,8 +154,8 @@ namespace cupuacu::actions::audio
                 std::max<int64_t>(0, overlapEnd - data.startFrame);
 
             recordedSamplesHandle = detail::storeSampleMatrixIfNeeded(
-                session, recordedSamplesHandle, pendingRecordedSamples,
-                "record-edit-recorded");
+                session, recordedSamplesHandle,
+                std::move(pendingRecordedSamples), "record-edit-recorded");
             pendingRecordedSamples.reset();
             auto overwrittenOldSamples = detail::materializeSampleMatrix(
                 session, pendingOverwrittenOldSamples,
@@ -170,10 +168,8 @@ namespace cupuacu::actions::audio
                 const auto &samples = overwrittenOldSamples[ch];
                 const int64_t framesToRestore = std::min<int64_t>(
                     overlapFrameCount, static_cast<int64_t>(samples.size()));
-                for (int64_t i = 0; i < framesToRestore; ++i)
-                {
-                    doc.setSample(ch, data.startFrame + i, samples[i], false);
-                }
+                doc.writeChannelFloatBlock(ch, data.startFrame, samples.data(),
+                                           framesToRestore, false);
                 if (framesToRestore > 0)
                 {
                     session.getWaveformCache(ch).invalidateSamples(
@@ -251,6 +247,31 @@ namespace cupuacu::actions::audio
             return data;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {overwrittenOldSamplesHandle, recordedSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return detail::pendingSampleMatrixBytes(
+                       pendingOverwrittenOldSamples) +
+                   detail::pendingSampleMatrixBytes(pendingRecordedSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            overwrittenOldSamplesHandle = detail::storeSampleMatrixIfNeeded(
+                session, overwrittenOldSamplesHandle,
+                std::move(pendingOverwrittenOldSamples), "record-edit-overwritten");
+            pendingOverwrittenOldSamples.reset();
+            recordedSamplesHandle = detail::storeSampleMatrixIfNeeded(
+                session, recordedSamplesHandle,
+                std::move(pendingRecordedSamples), "record-edit-recorded");
+            pendingRecordedSamples.reset();
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleMatrixHandle &
         getOverwrittenOldSamplesHandle() const
         {
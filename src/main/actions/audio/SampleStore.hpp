@@ -2,6 +2,8 @@
 
 #include "../../DocumentSession.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <vector>
 
@@ -22,6 +24,21 @@ namespace cupuacu::actions::audio::detail
         return handle;
     }
 
+    // As above, moving the samples into the store rather than copying them,
+    // for callers that drop them afterwards.
+    inline undo::UndoStore::SampleMatrixHandle storeSampleMatrixIfNeeded(
+        cupuacu::DocumentSession &session,
+        undo::UndoStore::SampleMatrixHandle handle,
+        std::optional<SampleMatrix> &&samples, const char *prefix)
+    {
+        if (handle.empty() && samples.has_value())
+        {
+            return session.undoStore.writeSampleMatrix(std::move(*samples),
+                                                       prefix);
+        }
+        return handle;
+    }
+
     inline undo::UndoStore::SampleCubeHandle storeSampleCubeIfNeeded(
         cupuacu::DocumentSession &session,
         undo::UndoStore::SampleCubeHandle handle,
@@ -34,6 +51,50 @@ namespace cupuacu::actions::audio::detail
         return handle;
     }
 
+    inline undo::UndoStore::SampleCubeHandle storeSampleCubeIfNeeded(
+        cupuacu::DocumentSession &session,
+        undo::UndoStore::SampleCubeHandle handle,
+        std::optional<SampleCube> &&samples, const char *prefix)
+    {
+        if (handle.empty() && samples.has_value())
+        {
+            return session.undoStore.writeSampleCube(std::move(*samples),
+                                                     prefix);
+        }
+        return handle;
+    }
+
+    inline std::uint64_t
+    pendingSampleMatrixBytes(const std::optional<SampleMatrix> &samples)
+    {
+        std::uint64_t bytes = 0;
+        if (samples.has_value())
+        {
+            for (const auto &channel : *samples)
+            {
+                bytes += channel.size() * sizeof(float);
+            }
+        }
+        return bytes;
+    }
+
+    inline std::uint64_t
+    pendingSampleCubeBytes(const std::optional<SampleCube> &samples)
+    {
+        std::uint64_t bytes = 0;
+        if (samples.has_value())
+        {
+            for (const auto &run : *samples)
+            {
+                for (const auto &channel : run)
+                {
+                    bytes += channel.size() * sizeof(float);
+                }
+            }
+        }
+        return bytes;
+    }
+
     inline SampleMatrix materializeSampleMatrix(
         cupuacu::DocumentSession &session,
         std::optional<SampleMatrix> &pendingSamples,
@@ -66,4 +127,55 @@ namespace cupuacu::actions::audio::detail
 
         return session.undoStore.readSampleCube(handle);
     }
+
+    // Redo samples of an effect that may be replayed: the new samples are a
+    // pure function of the old ones, so only the old samples are stored and
+    // the new ones are recomputed with render when needed. New samples that
+    // are already at hand are used as they are; if the effect cannot be
+    // replayed they are stored like the old ones.
+    inline SampleMatrix materializeReplayableSampleMatrix(
+        cupuacu::DocumentSession &session,
+        std::optional<SampleMatrix> &pendingOldSamples,
+        undo::UndoStore::SampleMatrixHandle &oldHandle, const char *oldPrefix,
+        std::optional<SampleMatrix> &pendingNewSamples,
+        undo::UndoStore::SampleMatrixHandle &newHandle, const char *newPrefix,
+        const bool replayable,
+        const std::function<void(SampleMatrix &)> &render)
+    {
+        if (replayable && !pendingNewSamples.has_value() && newHandle.empty())
+        {
+            auto samples = materializeSampleMatrix(session, pendingOldSamples,
+                                                   oldHandle, oldPrefix);
+            render(samples);
+            return samples;
+        }
+
+        oldHandle = storeSampleMatrixIfNeeded(
+            session, oldHandle, std::move(pendingOldSamples), oldPrefix);
+        pendingOldSamples.reset();
+        if (replayable && pendingNewSamples.has_value())
+        {
+            SampleMatrix materialized = std::move(*pendingNewSamples);
+            pendingNewSamples.reset();
+            return materialized;
+        }
+        return materializeSampleMatrix(session, pendingNewSamples, newHandle,
+                                       newPrefix);
+    }
+
+    // Drops new samples from memory, storing them first unless they can be
+    // recomputed from the old samples.
+    inline void retireReplayableSampleMatrix(
+        cupuacu::DocumentSession &session,
+        std::optional<SampleMatrix> &pendingNewSamples,
+        undo::UndoStore::SampleMatrixHandle &newHandle, const char *newPrefix,
+        const bool replayable)
+    {
+        if (!replayable)
+        {
+            newHandle = storeSampleMatrixIfNeeded(
+                session, newHandle, std::move(pendingNewSamples), newPrefix);
+        }
+        pendingNewSamples.reset();
+    }
 } // namespace cupuacu::actions::audio::detail
@@ -15,6 +15,18 @@ namespace cupuacu::actions::audio::detail
         return handle;
     }
 
+    // As above, moving the segment into the store rather than copying it.
+    inline undo::UndoStore::SegmentHandle storeSegmentIfNeeded(
+        cupuacu::DocumentSession &session, undo::UndoStore::SegmentHandle handle,
+        cupuacu::Document::AudioSegment &&segment, const char *prefix)
+    {
+        if (handle.empty())
+        {
+            return session.undoStore.writeSegment(std::move(segment), prefix);
+        }
+        return handle;
+    }
+
     template <typename CaptureFn>
     inline cupuacu::Document::AudioSegment captureOrLoadSegment(
         cupuacu::DocumentSession &session, undo::UndoStore::SegmentHandle handle,
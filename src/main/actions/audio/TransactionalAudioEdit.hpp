@@ -10,6 +10,7 @@
 #include <cstdint>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace cupuacu::actions::audio::detail
 {
@@ -98,12 +99,28 @@ namespace cupuacu::actions::audio::detail
             });
     }
 
+    // edits describe how the commit changed the document's frames, so that
+    // the waveform caches keep the peaks of the frames it moved. Without
+    // them, or if the caches do not match the document from before the
+    // commit, they are built again from scratch.
     inline void rebuildWaveformCacheAfterTransactionalCommit(
         State *state, cupuacu::DocumentSession &session,
-        OperationProgressUi &progressUi, const std::string &completedDetail)
+        OperationProgressUi &progressUi, const std::string &completedDetail,
+        const std::vector<waveform::DocumentWaveformCaches::FrameEdit> &edits =
+            {})
     {
-        session.waveformCaches.resetToChannelCount(
-            session.document.getChannelCount());
+        const int64_t channelCount = session.document.getChannelCount();
+        int64_t frameCountBefore = session.document.getFrameCount();
+        for (const auto &edit : edits)
+        {
+            frameCountBefore += edit.erasedFrames - edit.insertedFrames;
+        }
+        if (edits.empty() ||
+            !session.waveformCaches.applyEdits(channelCount, frameCountBefore,
+                                               edits))
+        {
+            session.waveformCaches.resetToChannelCount(channelCount);
+        }
         progressUi.publishProgress("Updating waveform", 0.95, true);
         session.updateWaveformCache();
         while (true)
@@ -357,7 +357,9 @@ namespace cupuacu::actions::audio
                 session.selection.setValue1(0);
                 session.selection.setValue2(middleCount);
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, "Trim complete");
+                    state, session, progressUi, "Trim complete",
+                    {{.frameIndex = endFrame, .erasedFrames = afterCount},
+                     {.frameIndex = 0, .erasedFrames = beforeCount}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -430,7 +432,10 @@ namespace cupuacu::actions::audio
                 session.selection.setValue1(beforeCount);
                 session.selection.setValue2(beforeCount + middleCount);
                 detail::rebuildWaveformCacheAfterTransactionalCommit(
-                    state, session, progressUi, "Undo complete");
+                    state, session, progressUi, "Undo complete",
+                    {{.frameIndex = 0, .insertedFrames = beforeCount},
+                     {.frameIndex = beforeCount + middleCount,
+                      .insertedFrames = afterCount}});
                 session.syncSelectionAndCursorToDocumentLength();
                 lastCommitted = true;
             }
@@ -513,6 +518,12 @@ namespace cupuacu::actions::audio
             return afterCount;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {beforeHandle, afterHandle};
+        }
+
         [[nodiscard]] const undo::UndoStore::SegmentHandle &getBeforeHandle() const
         {
             return beforeHandle;
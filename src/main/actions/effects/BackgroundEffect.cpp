@@ -109,12 +109,22 @@ namespace cupuacu::actions::effects
 
             void redo() override
             {
+                if (revisionsSpilled)
+                {
+                    delegate->redo();
+                    return;
+                }
                 swapRevision(redoRevision, undoRevision,
                              redoWaveformCaches, undoWaveformCaches, true);
             }
 
             void undo() override
             {
+                if (revisionsSpilled)
+                {
+                    delegate->undo();
+                    return;
+                }
                 swapRevision(undoRevision, redoRevision,
                              undoWaveformCaches, redoWaveformCaches, false);
             }
@@ -152,9 +162,45 @@ namespace cupuacu::actions::effects
                                 : std::nullopt;
             }
 
+            [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+            payloadHandles() const override
+            {
+                return delegate ? delegate->payloadHandles()
+                                : std::vector<undo::UndoStore::PayloadHandle>{};
+            }
+
+            [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+            {
+                return revisionBytes(redoRevision) +
+                       revisionBytes(undoRevision) +
+                       (delegate ? delegate->pendingPayloadBytes() : 0);
+            }
+
+            // The inactive revision is a whole document. Once the delegate's
+            // payloads are on disk it is dropped and the delegate, which only
+            // touches the affected frames, takes over.
+            void spillPendingPayloads(cupuacu::DocumentSession &session) override
+            {
+                if (!delegate)
+                {
+                    return;
+                }
+                delegate->spillPendingPayloads(session);
+                if (revisionsSpilled || !delegate->canPersistForRestart())
+                {
+                    return;
+                }
+                redoRevision.reset();
+                undoRevision.reset();
+                redoWaveformCaches.reset();
+                undoWaveformCaches.reset();
+                revisionsSpilled = true;
+            }
+
         private:
             int tabIndex = -1;
             std::shared_ptr<cupuacu::actions::Undoable> delegate;
+            bool revisionsSpilled = false;
             std::optional<cupuacu::Document> redoRevision;
             std::optional<cupuacu::Document> undoRevision;
             std::optional<cupuacu::waveform::DocumentWaveformCaches>
@@ -163,6 +209,19 @@ namespace cupuacu::actions::effects
                 undoWaveformCaches;
             std::function<void(bool)> afterSwap;
 
+            // Blocks the revision shares with the session's document cost
+            // nothing extra, so only the ones it holds alone are counted.
+            static std::uint64_t
+            revisionBytes(const std::optional<cupuacu::Document> &revision)
+            {
+                if (!revision.has_value())
+                {
+                    return 0;
+                }
+                return static_cast<std::uint64_t>(
+                    revision->getUnsharedResidentSampleBytes());
+            }
+
             void swapRevision(std::optional<cupuacu::Document> &source,
                               std::optional<cupuacu::Document> &destination,
                               std::optional<
@@ -256,11 +315,8 @@ namespace cupuacu::actions::effects
                 oldChannel.resize(static_cast<std::size_t>(request.frameCount));
                 newChannel.resize(static_cast<std::size_t>(request.frameCount));
 
-                for (int64_t frame = 0; frame < request.frameCount; ++frame)
-                {
-                    oldChannel[static_cast<std::size_t>(frame)] =
-                        document.getSample(channel, request.startFrame + frame);
-                }
+                document.readFrames(channel, request.startFrame,
+                                    oldChannel.data(), request.frameCount);
 
                 for (int64_t frame = 0; frame < request.frameCount; ++frame)
                 {
@@ -324,11 +380,12 @@ namespace cupuacu::actions::effects
                 oldChannel.resize(static_cast<std::size_t>(request.frameCount));
                 newChannel.resize(static_cast<std::size_t>(request.frameCount));
 
+                document.readFrames(channel, request.startFrame,
+                                    oldChannel.data(), request.frameCount);
                 for (int64_t frame = 0; frame < request.frameCount; ++frame)
                 {
                     const float oldValue =
-                        document.getSample(channel, request.startFrame + frame);
-                    oldChannel[static_cast<std::size_t>(frame)] = oldValue;
+                        oldChannel[static_cast<std::size_t>(frame)];
                     newChannel[static_cast<std::size_t>(frame)] =
                         static_cast<float>(
                             oldValue *
@@ -390,11 +447,12 @@ namespace cupuacu::actions::effects
                 oldChannel.resize(static_cast<std::size_t>(request.frameCount));
                 newChannel.resize(static_cast<std::size_t>(request.frameCount));
 
+                document.readFrames(channel, request.startFrame,
+                                    oldChannel.data(), request.frameCount);
                 for (int64_t frame = 0; frame < request.frameCount; ++frame)
                 {
                     const float oldValue =
-                        document.getSample(channel, request.startFrame + frame);
-                    oldChannel[static_cast<std::size_t>(frame)] = oldValue;
+                        oldChannel[static_cast<std::size_t>(frame)];
                     newChannel[static_cast<std::size_t>(frame)] =
                         cupuacu::effects::DynamicsUndoable::processSampleValue(
                             *request.dynamicsSettings, oldValue);
@@ -452,11 +510,12 @@ namespace cupuacu::actions::effects
                 oldChannel.resize(static_cast<std::size_t>(request.frameCount));
                 newChannel.resize(static_cast<std::size_t>(request.frameCount));
 
+                document.readFrames(channel, request.startFrame,
+                                    oldChannel.data(), request.frameCount);
                 for (int64_t frame = 0; frame < request.frameCount; ++frame)
                 {
                     const float oldValue =
-                        document.getSample(channel, request.startFrame + frame);
-                    oldChannel[static_cast<std::size_t>(frame)] = oldValue;
+                        oldChannel[static_cast<std::size_t>(frame)];
                     newChannel[static_cast<std::size_t>(frame)] =
                         static_cast<float>(
                             oldValue *
@@ -503,7 +562,6 @@ namespace cupuacu::actions::effects
                           settings.thresholdSampleValue);
             const auto mode =
                 cupuacu::effects::removeSilenceModeFromIndex(settings.modeIndex);
-            std::vector<cupuacu::effects::SilenceRange> runs;
             const int64_t endFrame = request.startFrame + request.frameCount;
             const int64_t minFrames = [&]
             {
@@ -520,45 +578,17 @@ namespace cupuacu::actions::effects
                 return std::max<int64_t>(
                     1, static_cast<int64_t>(std::ceil(frames)));
             }();
-            bool inRun = false;
-            int64_t runStart = request.startFrame;
-            for (int64_t frame = request.startFrame; frame < endFrame; ++frame)
+            std::vector<const gui::WaveformCache *> caches;
+            if (request.removeSilenceWaveformCaches)
             {
-                double magnitude = 0.0;
-                for (const int64_t channel : request.targetChannels)
+                for (const auto &cache : *request.removeSilenceWaveformCaches)
                 {
-                    magnitude = std::max(
-                        magnitude,
-                        static_cast<double>(std::fabs(
-                            document.getSample(channel, frame))));
-                }
-                const bool isSilent = magnitude <= thresholdAbsolute;
-                if (isSilent && !inRun)
-                {
-                    inRun = true;
-                    runStart = frame;
-                }
-                else if (!isSilent && inRun)
-                {
-                    const int64_t runLength = frame - runStart;
-                    if (runLength >= minFrames)
-                    {
-                        runs.push_back(
-                            {.startFrame = runStart, .frameCount = runLength});
-                    }
-                    inRun = false;
-                }
-            }
-
-            if (inRun)
-            {
-                const int64_t runLength = endFrame - runStart;
-                if (runLength >= minFrames)
-                {
-                    runs.push_back(
-                        {.startFrame = runStart, .frameCount = runLength});
+                    caches.push_back(&cache);
                 }
             }
+            auto runs = cupuacu::effects::findSilentRuns(
+                document, request.targetChannels, request.startFrame,
+                request.frameCount, thresholdAbsolute, minFrames, caches);
 
             if (mode == cupuacu::effects::RemoveSilenceMode::FromBeginningAndEnd &&
                 !runs.empty())
@@ -626,12 +656,9 @@ namespace cupuacu::actions::effects
                             result->removedSamples[runIndex][channel];
                         channelSamples.resize(
                             static_cast<std::size_t>(run.frameCount));
-                        for (int64_t frame = 0; frame < run.frameCount; ++frame)
-                        {
-                            channelSamples[static_cast<std::size_t>(frame)] =
-                                document.getSample(channel,
-                                                   run.startFrame + frame);
-                        }
+                        document.readFrames(channel, run.startFrame,
+                                            channelSamples.data(),
+                                            run.frameCount);
                     }
                 }
                 if (progress)
@@ -653,11 +680,8 @@ namespace cupuacu::actions::effects
                 oldChannel.resize(static_cast<std::size_t>(request.frameCount));
                 newChannel.assign(static_cast<std::size_t>(request.frameCount), 0.0f);
 
-                for (int64_t frame = 0; frame < request.frameCount; ++frame)
-                {
-                    oldChannel[static_cast<std::size_t>(frame)] =
-                        document.getSample(channel, request.startFrame + frame);
-                }
+                document.readFrames(channel, request.startFrame,
+                                    oldChannel.data(), request.frameCount);
 
                 int64_t writeFrame = 0;
                 std::size_t runIndex = 0;
@@ -1020,7 +1044,7 @@ namespace cupuacu::actions::effects
                 {
                     computedResult->removedSamplesHandle =
                         undoStore.writeSampleCube(
-                            computedResult->removedSamples,
+                            std::move(computedResult->removedSamples),
                             "remove-silence-removed");
                 }
             }
@@ -1042,11 +1066,20 @@ namespace cupuacu::actions::effects
                 if (undoStore.isAttached())
                 {
                     computedResult->oldSamplesHandle =
-                        undoStore.writeSampleMatrix(computedResult->oldSamples,
-                                                    "effect-old");
-                    computedResult->newSamplesHandle =
-                        undoStore.writeSampleMatrix(computedResult->newSamples,
-                                                    "effect-new");
+                        undoStore.writeSampleMatrix(
+                            std::move(computedResult->oldSamples), "effect-old");
+                    // Reverse, Amplify/Fade, Dynamics and Amplify Envelope
+                    // undoables recompute their new samples from the old
+                    // ones and the settings, so only compacted silence
+                    // removal needs them stored.
+                    if (computedResult->kind ==
+                        BackgroundEffectKind::RemoveSilence)
+                    {
+                        computedResult->newSamplesHandle =
+                            undoStore.writeSampleMatrix(
+                                std::move(computedResult->newSamples),
+                                "effect-new");
+                    }
                 }
             }
 
@@ -1315,6 +1348,17 @@ namespace cupuacu::actions::effects
             .hadSelection = session.selection.isActive(),
             .removeSilenceSettings = settings,
         };
+        const auto caches = cupuacu::effects::waveformCachesForChannels(
+            session.document, &session.waveformCaches, targetChannels);
+        if (!caches.empty())
+        {
+            auto cacheCopies = std::make_shared<std::vector<gui::WaveformCache>>();
+            for (const auto *cache : caches)
+            {
+                cacheCopies->push_back(*cache);
+            }
+            request.removeSilenceWaveformCaches = std::move(cacheCopies);
+        }
 
         startBackgroundEffect(state, std::move(request), &session.document);
         return true;
@@ -46,6 +46,11 @@ namespace cupuacu::actions::effects
             amplifyEnvelopeSettings;
         std::optional<::cupuacu::effects::RemoveSilenceSettings>
             removeSilenceSettings;
+        // Copies of the target channels' waveform caches, if they were laid
+        // out for the document, which stand in for the frames they cover
+        // while silence is looked for.
+        std::shared_ptr<const std::vector<gui::WaveformCache>>
+            removeSilenceWaveformCaches;
     };
 
     struct BackgroundEffectResult
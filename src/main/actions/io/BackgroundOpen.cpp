@@ -36,7 +36,8 @@ namespace cupuacu::actions::io
                 new BackgroundOpenJob(
                     id, std::move(request),
                     state->paths ? state->paths->waveformCachePath()
-                                 : std::filesystem::path{}));
+                                 : std::filesystem::path{},
+                    state->waveformCacheSettings));
             const auto detail = state->backgroundOpenJob->getPath();
             cupuacu::setLongTask(state, "Opening file", detail, 0.0,
                                  false, true);
@@ -176,9 +177,9 @@ namespace cupuacu::actions::io
             prepareForDocumentTransition(state);
             auto &session = state->getActiveDocumentSession();
             session.setCurrentFile(snapshot.path);
-            cupuacu::file::commitLoadedAudioFile(session, snapshot.path,
-                                                 std::move(*loaded),
-                                                 state->paths.get());
+            cupuacu::file::commitLoadedAudioFile(
+                session, snapshot.path, std::move(*loaded),
+                state->paths.get(), state->waveformCacheSettings);
             cupuacu::file::OverwritePreservation::refreshActiveSession(state);
             refreshDocumentUi(state);
             if (isStartupRestore &&
@@ -309,10 +310,13 @@ namespace cupuacu::actions::io
     BackgroundOpenJob::BackgroundOpenJob(std::uint64_t idToUse,
                                          PendingOpenRequest requestToOpen,
                                          std::filesystem::path
-                                             waveformCacheRootToUse)
+                                             waveformCacheRootToUse,
+                                         const waveform::PersistentCacheSettings
+                                             &waveformCacheSettingsToUse)
         : id(idToUse),
           request(std::move(requestToOpen)),
           waveformCacheRoot(std::move(waveformCacheRootToUse)),
+          waveformCacheSettings(waveformCacheSettingsToUse),
           detail(request.path)
     {
     }
@@ -406,7 +410,8 @@ namespace cupuacu::actions::io
                     cacheSession.document.getChannelCount());
                 loaded->persistentWaveformCacheLoaded =
                     cupuacu::waveform::loadPersistentWaveformCache(
-                        cacheSession, waveformCacheRoot);
+                        cacheSession, waveformCacheRoot,
+                        waveformCacheSettings);
                 loaded->persistentWaveformCacheChecked = true;
                 if (loaded->persistentWaveformCacheLoaded)
                 {
@@ -518,7 +523,8 @@ namespace cupuacu::actions::io
                 auto &session =
                     state->tabs[static_cast<std::size_t>(tabIndex)].session;
                 const bool cacheStateChanged =
-                    session.pumpWaveformCacheWork(state->paths.get());
+                    session.pumpWaveformCacheWork(
+                        state->paths.get(), state->waveformCacheSettings);
                 if (const auto progress =
                         normalizedWaveformCacheBuildProgress(session);
                     progress.has_value())
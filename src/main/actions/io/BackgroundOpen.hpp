@@ -31,7 +31,9 @@ namespace cupuacu::actions::io
 
         BackgroundOpenJob(std::uint64_t idToUse,
                           PendingOpenRequest requestToOpen,
-                          std::filesystem::path waveformCacheRootToUse = {});
+                          std::filesystem::path waveformCacheRootToUse = {},
+                          const waveform::PersistentCacheSettings
+                              &waveformCacheSettingsToUse = {});
         ~BackgroundOpenJob();
 
         BackgroundOpenJob(const BackgroundOpenJob &) = delete;
@@ -49,6 +51,7 @@ namespace cupuacu::actions::io
         std::uint64_t id = 0;
         PendingOpenRequest request;
         std::filesystem::path waveformCacheRoot;
+        waveform::PersistentCacheSettings waveformCacheSettings;
         mutable std::mutex mutex;
         bool completed = false;
         bool success = false;
@@ -70,7 +70,8 @@ namespace cupuacu::actions::io
                 new BackgroundSaveJob(
                     id, std::move(request), state, *document,
                     state->paths ? state->paths->waveformCachePath()
-                                 : std::filesystem::path{}));
+                                 : std::filesystem::path{},
+                    state->waveformCacheSettings));
             cupuacu::setLongTask(state, "Saving file", detail, 0.0, false,
                                  true);
             state->backgroundSaveJob->start();
@@ -219,12 +220,15 @@ namespace cupuacu::actions::io
                                          cupuacu::State *stateToUse,
                                          const cupuacu::Document &documentToWrite,
                                          std::filesystem::path
-                                             waveformCacheRootToUse)
+                                             waveformCacheRootToUse,
+                                         const waveform::PersistentCacheSettings
+                                             &waveformCacheSettingsToUse)
         : id(idToUse),
           request(std::move(requestToSave)),
           state(stateToUse),
           document(documentToWrite),
           waveformCacheRoot(std::move(waveformCacheRootToUse)),
+          waveformCacheSettings(waveformCacheSettingsToUse),
           detail(request.path.string())
     {
     }
@@ -414,7 +418,8 @@ namespace cupuacu::actions::io
                 cacheSession.rebuildWaveformCacheSynchronously();
                 const bool cacheSaved =
                     cupuacu::waveform::savePersistentWaveformCache(
-                        cacheSession, waveformCacheRoot);
+                        cacheSession, waveformCacheRoot,
+                        waveformCacheSettings);
                 std::lock_guard lock(mutex);
                 persistentWaveformCacheSaved = cacheSaved;
             }
@@ -51,7 +51,9 @@ namespace cupuacu::actions::io
                           BackgroundSaveRequest requestToSave,
                           cupuacu::State *stateToUse,
                           const cupuacu::Document &documentToWrite,
-                          std::filesystem::path waveformCacheRootToUse = {});
+                          std::filesystem::path waveformCacheRootToUse = {},
+                          const waveform::PersistentCacheSettings
+                              &waveformCacheSettingsToUse = {});
         ~BackgroundSaveJob();
 
         BackgroundSaveJob(const BackgroundSaveJob &) = delete;
@@ -68,6 +70,7 @@ namespace cupuacu::actions::io
         cupuacu::State *state = nullptr;
         cupuacu::Document document;
         std::filesystem::path waveformCacheRoot;
+        waveform::PersistentCacheSettings waveformCacheSettings;
         mutable std::mutex mutex;
         bool completed = false;
         bool success = false;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ChannelBlocks.hpp"
+#include "FrameRangeSet.hpp"
 #include "SampleProvenance.hpp"
 
 #include <algorithm>
@@ -8,6 +10,7 @@
 #include <functional>
 #include <memory>
 #include <span>
+#include <utility>
 #include <vector>
 
 namespace cupuacu::audio
@@ -15,7 +18,7 @@ namespace cupuacu::audio
     class AudioBuffer
     {
     protected:
-        std::vector<std::vector<float>> channels;
+        std::vector<ChannelBlocks> channels;
 
     public:
         using ProgressCallback =
@@ -23,6 +26,8 @@ namespace cupuacu::audio
 
         virtual ~AudioBuffer() = default;
 
+        // Shallow in the sample data: the clone shares every sample block
+        // with this buffer until one of them writes to it.
         [[nodiscard]] virtual std::shared_ptr<AudioBuffer> clone() const
         {
             return std::make_shared<AudioBuffer>(*this);
@@ -43,8 +48,9 @@ namespace cupuacu::audio
             int64_t totalFrames = 0;
             for (std::size_t channel = 0; channel < writableChannels; ++channel)
             {
-                totalFrames += std::min<std::size_t>(
-                    channels[channel].size(), samples[channel].size());
+                totalFrames += std::min<int64_t>(
+                    channels[channel].size(),
+                    static_cast<int64_t>(samples[channel].size()));
             }
 
             int64_t completedFrames = 0;
@@ -52,17 +58,15 @@ namespace cupuacu::audio
             {
                 auto &destination = channels[channel];
                 const auto &source = samples[channel];
-                const auto writableFrames = std::min<std::size_t>(
-                    destination.size(), source.size());
-                for (std::size_t frame = 0; frame < writableFrames;
-                     frame += static_cast<std::size_t>(kProgressStrideFrames))
+                const auto writableFrames = std::min<int64_t>(
+                    destination.size(), static_cast<int64_t>(source.size()));
+                for (int64_t frame = 0; frame < writableFrames;
+                     frame += kProgressStrideFrames)
                 {
-                    const auto chunkFrames = std::min<std::size_t>(
-                        writableFrames - frame,
-                        static_cast<std::size_t>(kProgressStrideFrames));
-                    std::copy_n(source.data() + frame, chunkFrames,
-                                destination.data() + frame);
-                    completedFrames += static_cast<int64_t>(chunkFrames);
+                    const auto chunkFrames = std::min<int64_t>(
+                        writableFrames - frame, kProgressStrideFrames);
+                    destination.write(frame, source.data() + frame, chunkFrames);
+                    completedFrames += chunkFrames;
                     if (progress)
                     {
                         progress(completedFrames, std::max<int64_t>(1, totalFrames));
@@ -83,6 +87,26 @@ namespace cupuacu::audio
             return true;
         }
 
+        // Dirty parts of [startFrame, endFrameExclusive) in ascending order.
+        // Without dirty tracking every frame counts as dirty.
+        virtual std::vector<FrameRange>
+        getDirtyRanges(int64_t channel, int64_t startFrame,
+                       int64_t endFrameExclusive) const
+        {
+            const auto first = std::max<int64_t>(0, startFrame);
+            const auto last = std::min(endFrameExclusive, getFrameCount());
+            if (channel < 0 || channel >= getChannelCount() || first >= last)
+            {
+                return {};
+            }
+            return {{first, last}};
+        }
+
+        virtual void markDirty(int64_t channel, int64_t startFrame,
+                               int64_t endFrameExclusive)
+        {
+        }
+
         virtual SampleProvenance getProvenance(int64_t channel,
                                                int64_t frame) const
         {
@@ -94,6 +118,23 @@ namespace cupuacu::audio
         {
         }
 
+        // Provenance of [startFrame, endFrameExclusive) as ranges in
+        // absolute frames; frames without provenance are left out.
+        virtual std::vector<ProvenanceRange>
+        getProvenanceRanges(int64_t channel, int64_t startFrame,
+                            int64_t endFrameExclusive) const
+        {
+            return {};
+        }
+
+        // Replaces the provenance of [startFrame, endFrameExclusive) with
+        // ranges, given in absolute frames.
+        virtual void setProvenanceRanges(int64_t channel, int64_t startFrame,
+                                         int64_t endFrameExclusive,
+                                         const std::vector<ProvenanceRange> &ranges)
+        {
+        }
+
         virtual void markAllClean()
         {
         }
@@ -114,7 +155,7 @@ namespace cupuacu::audio
         virtual void setSample(int64_t channel, int64_t frame, float value,
                                const bool shouldMarkDirty = true)
         {
-            channels[channel][frame] = value;
+            channels[channel].set(frame, value);
         }
 
         virtual void insertFrames(int64_t frameIndex, int64_t numFrames,
@@ -133,21 +174,7 @@ namespace cupuacu::audio
             int64_t completedChannels = 0;
             for (auto &ch : channels)
             {
-                if (frameIndex == static_cast<int64_t>(ch.size()))
-                {
-                    const int64_t newSize = static_cast<int64_t>(ch.size()) + numFrames;
-                    if (newSize > static_cast<int64_t>(ch.capacity()))
-                    {
-                        const int64_t grown =
-                            std::max<int64_t>(newSize, static_cast<int64_t>(ch.capacity()) * 2);
-                        ch.reserve(grown);
-                    }
-                    ch.insert(ch.end(), numFrames, 0.0f);
-                }
-                else
-                {
-                    ch.insert(ch.begin() + frameIndex, numFrames, 0.0f);
-                }
+                ch.insertZeros(frameIndex, numFrames);
                 ++completedChannels;
                 if (progress)
                 {
@@ -174,59 +201,42 @@ namespace cupuacu::audio
                 return;
             }
 
-            constexpr int64_t kProgressStrideFrames = 16384;
+            // Each channel reports against its own total, so progress is
+            // mapped onto a fixed number of units per channel to keep the
+            // reported total constant across the whole call.
+            constexpr int64_t kProgressUnitsPerChannel = 4096;
 
-            int64_t totalFramesToShift = 0;
-            for (const auto &ch : channels)
-            {
-                const int64_t oldSize = static_cast<int64_t>(ch.size());
-                const int64_t newSize = oldSize - numFrames;
-                totalFramesToShift += std::max<int64_t>(1, newSize - frameIndex);
-            }
-
-            int64_t completedFrames = 0;
+            const int64_t totalUnits = std::max<int64_t>(
+                1, static_cast<int64_t>(channels.size()) *
+                       kProgressUnitsPerChannel);
+            int64_t channelBaseUnits = 0;
+            int64_t lastReportedUnits = 0;
             for (auto &ch : channels)
             {
-                const int64_t oldSize = static_cast<int64_t>(ch.size());
-                const int64_t newSize = oldSize - numFrames;
-                const int64_t framesToShift = newSize - frameIndex;
-
-                if (framesToShift > 0)
+                ChannelBlocks::ProgressCallback channelProgress;
+                if (progress)
                 {
-                    for (int64_t movedFrames = 0; movedFrames < framesToShift;
-                         movedFrames += kProgressStrideFrames)
+                    channelProgress = [&](const int64_t completed,
+                                          const int64_t total)
                     {
-                        const int64_t chunkFrames = std::min<int64_t>(
-                            kProgressStrideFrames, framesToShift - movedFrames);
-                        std::memmove(ch.data() + frameIndex + movedFrames,
-                                     ch.data() + frameIndex + numFrames + movedFrames,
-                                     static_cast<std::size_t>(chunkFrames) *
-                                         sizeof(float));
-                        completedFrames += chunkFrames;
-                        if (progress)
+                        const auto units =
+                            channelBaseUnits +
+                            completed * kProgressUnitsPerChannel /
+                                std::max<int64_t>(1, total);
+                        if (units > lastReportedUnits)
                         {
-                            progress(completedFrames,
-                                     std::max<int64_t>(1, totalFramesToShift));
+                            lastReportedUnits = units;
+                            progress(units, totalUnits);
                         }
-                    }
+                    };
                 }
-                else
-                {
-                    completedFrames += 1;
-                    if (progress)
-                    {
-                        progress(completedFrames,
-                                 std::max<int64_t>(1, totalFramesToShift));
-                    }
-                }
-
-                ch.resize(static_cast<std::size_t>(newSize));
+                ch.erase(frameIndex, numFrames, channelProgress);
+                channelBaseUnits += kProgressUnitsPerChannel;
             }
 
-            if (progress)
+            if (progress && lastReportedUnits < totalUnits)
             {
-                progress(std::max<int64_t>(1, totalFramesToShift),
-                         std::max<int64_t>(1, totalFramesToShift));
+                progress(totalUnits, totalUnits);
             }
         }
 
@@ -246,25 +256,131 @@ namespace cupuacu::audio
 
         float getSample(int64_t channel, int64_t frame) const
         {
-            return channels[channel][frame];
+            return channels[channel].get(frame);
         }
 
-        std::span<const float> getImmutableChannelData(int64_t channel) const
+        // Allocation-free sequential reader over one channel. An out of range
+        // channel yields a reader that returns silence.
+        ChannelBlocks::Reader getChannelReader(int64_t channel) const
         {
             if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
             {
                 return {};
             }
-            return channels[channel];
+            return channels[channel].reader();
         }
 
-        std::span<float> getMutableChannelData(int64_t channel)
+        // Calls fn(std::span<const float>, firstFrame) for each contiguous
+        // run of samples in [startFrame, startFrame + numFrames).
+        template <typename Fn>
+        void forEachChannelSpan(int64_t channel, int64_t startFrame,
+                                int64_t numFrames, Fn &&fn) const
         {
             if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
             {
-                return {};
+                return;
+            }
+            channels[channel].forEachSpan(startFrame, numFrames,
+                                          std::forward<Fn>(fn));
+        }
+
+        // Writes bypass dirty and provenance tracking, like the mutable
+        // channel data access they replace.
+        template <typename Fn>
+        void forEachMutableChannelSpan(int64_t channel, int64_t startFrame,
+                                       int64_t numFrames, Fn &&fn)
+        {
+            if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
+            {
+                return;
+            }
+            channels[channel].forEachMutableSpan(startFrame, numFrames,
+                                                 std::forward<Fn>(fn));
+        }
+
+        // Stores integer PCM samples in their compact form where whole
+        // blocks are covered. Like writeChannelFrames this bypasses dirty and
+        // provenance tracking; it is meant for loading.
+        void writeChannelPcmFrames(int64_t channel, int64_t startFrame,
+                                   const std::int32_t *source,
+                                   int64_t numFrames, std::size_t stride,
+                                   int bitDepth)
+        {
+            if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
+            {
+                return;
+            }
+            channels[channel].writePcm(startFrame, source, numFrames, stride,
+                                       bitDepth);
+        }
+
+        // Bytes of sample data held in RAM by this buffer's blocks, counting
+        // blocks still shared with other copies.
+        int64_t getResidentBytes() const
+        {
+            int64_t total = 0;
+            for (const auto &ch : channels)
+            {
+                total += ch.residentBytes();
+            }
+            return total;
+        }
+
+        // What the blocks of every channel took in RAM since the last call;
+        // see ChannelBlocks::takeResidentBytesAdded().
+        int64_t takeResidentBytesAdded()
+        {
+            int64_t total = 0;
+            for (auto &ch : channels)
+            {
+                total += ch.takeResidentBytesAdded();
+            }
+            return total;
+        }
+
+        // Bytes of sample data held in RAM by blocks of this buffer only.
+        int64_t getUnsharedResidentBytes() const
+        {
+            int64_t total = 0;
+            for (const auto &ch : channels)
+            {
+                total += ch.unsharedResidentBytes();
+            }
+            return total;
+        }
+
+        void pageOutResidentBlocks(SampleScratchFile &scratch,
+                                   const int64_t maxResidentBytes)
+        {
+            auto excess = getResidentBytes() - maxResidentBytes;
+            for (auto &ch : channels)
+            {
+                if (excess <= 0)
+                {
+                    break;
+                }
+                excess -= ch.pageOut(scratch, excess);
+            }
+        }
+
+        void readChannelFrames(int64_t channel, int64_t startFrame,
+                               float *destination, int64_t numFrames) const
+        {
+            if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
+            {
+                return;
+            }
+            channels[channel].read(startFrame, destination, numFrames);
+        }
+
+        void writeChannelFrames(int64_t channel, int64_t startFrame,
+                                const float *source, int64_t numFrames)
+        {
+            if (channel < 0 || channel >= static_cast<int64_t>(channels.size()))
+            {
+                return;
             }
-            return channels[channel];
+            channels[channel].write(startFrame, source, numFrames);
         }
     };
 } // namespace cupuacu::audio
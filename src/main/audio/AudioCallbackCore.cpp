@@ -89,9 +89,8 @@ bool cupuacu::audio::callback_core::fillOutputBuffer(
         return false;
     }
 
-    const auto chBufL = buffer->getImmutableChannelData(0);
-    const auto chBufR =
-        buffer->getImmutableChannelData(channelCount == 2 ? 1 : 0);
+    auto chBufL = buffer->getChannelReader(0);
+    auto chBufR = buffer->getChannelReader(channelCount == 2 ? 1 : 0);
 
     const bool shouldPlayChannelL =
         !selectionIsActive ||
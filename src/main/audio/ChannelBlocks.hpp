@@ -0,0 +1,963 @@
+#pragma once
+
+#include "SampleScratchFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace cupuacu::audio
+{
+    // One channel of samples, stored as a table of bounded blocks instead of
+    // one contiguous vector. Inserting or removing frames only splits, trims
+    // or merges the blocks at the edit boundaries and shifts the block table,
+    // so a splice costs the edited range plus one block per boundary rather
+    // than the length of the channel tail.
+    //
+    // Blocks are shared between copies and duplicated only when one copy
+    // writes to them, so copying a channel costs one reference per block and
+    // an edit on a copy duplicates only the blocks it touches.
+    //
+    // A block either owns its samples in RAM or views storage it does not
+    // own: the shared block of silence that inserted frames start out as, or
+    // a slot in a SampleScratchFile the block was paged out to. Integer PCM
+    // loads may also keep blocks in their compact 16/24-bit form. Viewed and
+    // compact blocks are promoted to owned float the first time they are
+    // written.
+    //
+    // Invariant: no block is empty, no block exceeds kBlockFrames, and two
+    // neighbouring blocks never fit into one together, so the table stays at
+    // most twice as long as the densely packed minimum.
+    class ChannelBlocks
+    {
+    public:
+        static constexpr int64_t kBlockFrames = 65536;
+
+        static_assert(kBlockFrames <= SampleScratchFile::kSlotFrames);
+
+        // Storage of a block that is not plain float: integer PCM samples as
+        // they were loaded, converted to float whenever they are read.
+        enum class Encoding : std::uint8_t
+        {
+            Float32,
+            PcmS16,
+            PcmS24
+        };
+
+        class Block
+        {
+        public:
+            Block() = default;
+
+            explicit Block(std::vector<float> samplesToOwn)
+                : samples(std::move(samplesToOwn))
+            {
+            }
+
+            Block(std::shared_ptr<const float> samplesToView,
+                  const std::size_t count)
+                : view(std::move(samplesToView)), viewSize(count)
+            {
+            }
+
+            Block(const Encoding encodingToUse,
+                  std::vector<std::uint8_t> packedToOwn)
+                : encoding(encodingToUse), packed(std::move(packedToOwn))
+            {
+            }
+
+            // Float samples of the block. Only valid when isFloat().
+            [[nodiscard]] const float *data() const
+            {
+                return view ? view.get() : samples.data();
+            }
+
+            [[nodiscard]] std::size_t size() const
+            {
+                if (encoding != Encoding::Float32)
+                {
+                    return packed.size() / bytesPerSample(encoding);
+                }
+                return view ? viewSize : samples.size();
+            }
+
+            [[nodiscard]] bool isFloat() const
+            {
+                return encoding == Encoding::Float32;
+            }
+
+            [[nodiscard]] bool isResident() const
+            {
+                return !view;
+            }
+
+            [[nodiscard]] int64_t residentBytes() const
+            {
+                return static_cast<int64_t>(samples.capacity() * sizeof(float) +
+                                            packed.capacity());
+            }
+
+            [[nodiscard]] float sample(const std::size_t index) const
+            {
+                if (isFloat())
+                {
+                    return data()[index];
+                }
+                float result = 0.0f;
+                decode(index, 1, &result);
+                return result;
+            }
+
+            // Writes count float samples starting at offset to destination.
+            void copyTo(const std::size_t offset, const std::size_t count,
+                        float *destination) const
+            {
+                if (isFloat())
+                {
+                    std::memcpy(destination, data() + offset,
+                                count * sizeof(float));
+                    return;
+                }
+                decode(offset, count, destination);
+            }
+
+            // Views share the underlying storage; owned samples are copied.
+            [[nodiscard]] std::shared_ptr<Block>
+            slice(const std::size_t offset, const std::size_t count) const
+            {
+                if (!isFloat())
+                {
+                    const auto width = bytesPerSample(encoding);
+                    return std::make_shared<Block>(
+                        encoding,
+                        std::vector<std::uint8_t>(
+                            packed.begin() +
+                                static_cast<std::ptrdiff_t>(offset * width),
+                            packed.begin() + static_cast<std::ptrdiff_t>(
+                                                 (offset + count) * width)));
+                }
+                if (view)
+                {
+                    return std::make_shared<Block>(
+                        std::shared_ptr<const float>(view, view.get() + offset),
+                        count);
+                }
+                return std::make_shared<Block>(std::vector<float>(
+                    samples.begin() + static_cast<std::ptrdiff_t>(offset),
+                    samples.begin() +
+                        static_cast<std::ptrdiff_t>(offset + count)));
+            }
+
+            [[nodiscard]] static std::shared_ptr<Block>
+            silence(const std::size_t count)
+            {
+                static const auto zeroes = std::make_shared<const std::vector<float>>(
+                    static_cast<std::size_t>(kBlockFrames), 0.0f);
+                return std::make_shared<Block>(
+                    std::shared_ptr<const float>(zeroes, zeroes->data()), count);
+            }
+
+            // Packs count samples of bitDepth (16 or 24), read from source
+            // with the given element stride, into a compact block.
+            [[nodiscard]] static std::shared_ptr<Block>
+            packPcm(const std::int32_t *source, const std::size_t count,
+                    const std::size_t stride, const int bitDepth)
+            {
+                const auto encodingToUse =
+                    bitDepth == 16 ? Encoding::PcmS16 : Encoding::PcmS24;
+                const auto width = bytesPerSample(encodingToUse);
+                std::vector<std::uint8_t> bytes(count * width);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const auto value =
+                        static_cast<std::uint32_t>(source[i * stride]);
+                    for (std::size_t byte = 0; byte < width; ++byte)
+                    {
+                        bytes[i * width + byte] =
+                            static_cast<std::uint8_t>(value >> (8 * byte));
+                    }
+                }
+                return std::make_shared<Block>(encodingToUse, std::move(bytes));
+            }
+
+        private:
+            friend class ChannelBlocks;
+
+            Encoding encoding = Encoding::Float32;
+            std::vector<float> samples;
+            std::shared_ptr<const float> view;
+            std::size_t viewSize = 0;
+            std::vector<std::uint8_t> packed;
+
+            static std::size_t bytesPerSample(const Encoding encodingToUse)
+            {
+                return encodingToUse == Encoding::PcmS16 ? 2 : 3;
+            }
+
+            // Straight loops over little-endian bytes so the compiler can
+            // vectorize them; the scale matches libsndfile's int to float
+            // conversion, so decoded samples equal a float load of the file.
+            void decode(const std::size_t offset, const std::size_t count,
+                        float *destination) const
+            {
+                const auto *bytes = packed.data();
+                if (encoding == Encoding::PcmS16)
+                {
+                    constexpr float kScale = 1.0f / 32768.0f;
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        const auto *p = bytes + (offset + i) * 2;
+                        const auto value = static_cast<std::int16_t>(
+                            static_cast<std::uint16_t>(p[0]) |
+                            static_cast<std::uint16_t>(p[1] << 8));
+                        destination[i] = static_cast<float>(value) * kScale;
+                    }
+                    return;
+                }
+
+                constexpr float kScale = 1.0f / 8388608.0f;
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const auto *p = bytes + (offset + i) * 3;
+                    const auto value = static_cast<std::int32_t>(
+                                           static_cast<std::uint32_t>(p[0]) << 8 |
+                                           static_cast<std::uint32_t>(p[1]) << 16 |
+                                           static_cast<std::uint32_t>(p[2]) << 24) >>
+                                       8;
+                    destination[i] = static_cast<float>(value) * kScale;
+                }
+            }
+        };
+
+        using ProgressCallback =
+            std::function<void(int64_t completed, int64_t total)>;
+
+        // Sequential random-access view that remembers the block of the last
+        // lookup. Reading neighbouring frames stays O(1); jumping elsewhere
+        // costs one binary search over the block table. Compact blocks are
+        // converted a short chunk at a time into a buffer inside the reader.
+        // Readers never allocate, so they are safe to use on the audio
+        // callback.
+        class Reader
+        {
+        public:
+            static constexpr int64_t kDecodeChunkFrames = 256;
+
+            Reader() = default;
+
+            explicit Reader(const ChannelBlocks &channelToRead)
+                : channel(&channelToRead)
+            {
+            }
+
+            // Copies start with an empty cache: the cached pointer may point
+            // into the source reader's own decode buffer.
+            Reader(const Reader &other) : channel(other.channel)
+            {
+            }
+
+            Reader &operator=(const Reader &other)
+            {
+                channel = other.channel;
+                current = nullptr;
+                currentIndex = 0;
+                currentStart = 0;
+                currentEnd = 0;
+                return *this;
+            }
+
+            float operator[](const int64_t frame)
+            {
+                if (frame < currentStart || frame >= currentEnd)
+                {
+                    if (!seek(frame))
+                    {
+                        return 0.0f;
+                    }
+                }
+                return current[frame - currentStart];
+            }
+
+        private:
+            const ChannelBlocks *channel = nullptr;
+            const float *current = nullptr;
+            std::size_t currentIndex = 0;
+            int64_t currentStart = 0;
+            int64_t currentEnd = 0;
+            float decoded[kDecodeChunkFrames]{};
+
+            bool seek(const int64_t frame)
+            {
+                if (!channel || frame < 0 || frame >= channel->frameCount)
+                {
+                    return false;
+                }
+
+                const auto &blocks = channel->blocks;
+                const auto &blockStarts = channel->blockStarts;
+                std::size_t index = currentIndex;
+                const bool inCurrentBlock =
+                    current && index < blocks.size() &&
+                    frame >= blockStarts[index] &&
+                    frame < blockStarts[index] +
+                                static_cast<int64_t>(blocks[index]->size());
+                if (!inCurrentBlock)
+                {
+                    index = current && index + 1 < blocks.size() &&
+                                    frame == blockStarts[index + 1]
+                                ? index + 1
+                                : channel->blockIndexForFrame(frame);
+                }
+                currentIndex = index;
+
+                const auto &block = *blocks[index];
+                const auto blockStart = blockStarts[index];
+                const auto blockSize = static_cast<int64_t>(block.size());
+                if (block.isFloat())
+                {
+                    currentStart = blockStart;
+                    currentEnd = blockStart + blockSize;
+                    current = block.data();
+                    return true;
+                }
+
+                const auto local = frame - blockStart;
+                const auto chunkStart = local - local % kDecodeChunkFrames;
+                const auto chunkFrames =
+                    std::min(kDecodeChunkFrames, blockSize - chunkStart);
+                block.copyTo(static_cast<std::size_t>(chunkStart),
+                             static_cast<std::size_t>(chunkFrames), decoded);
+                currentStart = blockStart + chunkStart;
+                currentEnd = currentStart + chunkFrames;
+                current = decoded;
+                return true;
+            }
+        };
+
+        [[nodiscard]] int64_t size() const
+        {
+            return frameCount;
+        }
+
+        [[nodiscard]] std::size_t blockCount() const
+        {
+            return blocks.size();
+        }
+
+        [[nodiscard]] int64_t blockSize(const std::size_t index) const
+        {
+            return static_cast<int64_t>(blocks[index]->size());
+        }
+
+        [[nodiscard]] Reader reader() const
+        {
+            return Reader(*this);
+        }
+
+        [[nodiscard]] float get(const int64_t frame) const
+        {
+            const auto index = blockIndexForFrame(frame);
+            return blocks[index]->sample(
+                static_cast<std::size_t>(frame - blockStarts[index]));
+        }
+
+        void set(const int64_t frame, const float value)
+        {
+            const auto index = blockIndexForFrame(frame);
+            mutableBlock(index)[static_cast<std::size_t>(
+                frame - blockStarts[index])] = value;
+        }
+
+        // Calls fn(std::span<const float>, firstFrame) for each contiguous
+        // piece of [startFrame, startFrame + count), in frame order. Compact
+        // blocks are handed out in converted chunks of a stack buffer.
+        template <typename Fn>
+        void forEachSpan(const int64_t startFrame, const int64_t count,
+                         Fn &&fn) const
+        {
+            constexpr int64_t kDecodeChunkFrames = 4096;
+
+            const auto first = std::clamp<int64_t>(startFrame, 0, frameCount);
+            const auto last =
+                std::clamp<int64_t>(startFrame + count, first, frameCount);
+            if (first >= last)
+            {
+                return;
+            }
+
+            auto index = blockIndexForFrame(first);
+            int64_t frame = first;
+            while (frame < last)
+            {
+                const auto &block = *blocks[index];
+                const auto offset = frame - blockStarts[index];
+                const auto length = std::min<int64_t>(
+                    static_cast<int64_t>(block.size()) - offset, last - frame);
+                if (block.isFloat())
+                {
+                    fn(std::span<const float>(block.data() + offset,
+                                              static_cast<std::size_t>(length)),
+                       frame);
+                }
+                else
+                {
+                    float decoded[kDecodeChunkFrames];
+                    for (int64_t done = 0; done < length;
+                         done += kDecodeChunkFrames)
+                    {
+                        const auto chunkFrames =
+                            std::min(kDecodeChunkFrames, length - done);
+                        block.copyTo(static_cast<std::size_t>(offset + done),
+                                     static_cast<std::size_t>(chunkFrames),
+                                     decoded);
+                        fn(std::span<const float>(
+                               decoded, static_cast<std::size_t>(chunkFrames)),
+                           frame + done);
+                    }
+                }
+                frame += length;
+                ++index;
+            }
+        }
+
+        template <typename Fn>
+        void forEachMutableSpan(const int64_t startFrame, const int64_t count,
+                                Fn &&fn)
+        {
+            const auto first = std::clamp<int64_t>(startFrame, 0, frameCount);
+            const auto last =
+                std::clamp<int64_t>(startFrame + count, first, frameCount);
+            if (first >= last)
+            {
+                return;
+            }
+
+            auto index = blockIndexForFrame(first);
+            int64_t frame = first;
+            while (frame < last)
+            {
+                auto &block = mutableBlock(index);
+                const auto offset = frame - blockStarts[index];
+                const auto length = std::min<int64_t>(
+                    static_cast<int64_t>(block.size()) - offset, last - frame);
+                fn(std::span<float>(block.data() + offset,
+                                    static_cast<std::size_t>(length)),
+                   frame);
+                frame += length;
+                ++index;
+            }
+        }
+
+        void read(const int64_t startFrame, float *destination,
+                  const int64_t count) const
+        {
+            const auto first = std::clamp<int64_t>(startFrame, 0, frameCount);
+            const auto last =
+                std::clamp<int64_t>(startFrame + count, first, frameCount);
+            if (first >= last)
+            {
+                return;
+            }
+
+            auto index = blockIndexForFrame(first);
+            for (int64_t frame = first; frame < last; ++index)
+            {
+                const auto &block = *blocks[index];
+                const auto offset = frame - blockStarts[index];
+                const auto length = std::min<int64_t>(
+                    static_cast<int64_t>(block.size()) - offset, last - frame);
+                block.copyTo(static_cast<std::size_t>(offset),
+                             static_cast<std::size_t>(length),
+                             destination + (frame - startFrame));
+                frame += length;
+            }
+        }
+
+        // Stores count integer PCM samples (bitDepth 16 or 24, read from
+        // source with the given element stride) starting at startFrame.
+        // Blocks the range covers entirely become compact blocks; partially
+        // covered blocks are written as float.
+        void writePcm(const int64_t startFrame, const std::int32_t *source,
+                      const int64_t count, const std::size_t stride,
+                      const int bitDepth)
+        {
+            const auto first = std::clamp<int64_t>(startFrame, 0, frameCount);
+            const auto last =
+                std::clamp<int64_t>(startFrame + count, first, frameCount);
+            if (first >= last)
+            {
+                return;
+            }
+
+            const float scale = 1.0f / static_cast<float>(1 << (bitDepth - 1));
+            auto index = blockIndexForFrame(first);
+            for (int64_t frame = first; frame < last; ++index)
+            {
+                const auto blockStart = blockStarts[index];
+                const auto blockSize =
+                    static_cast<int64_t>(blocks[index]->size());
+                const auto offset = frame - blockStart;
+                const auto length =
+                    std::min<int64_t>(blockSize - offset, last - frame);
+                const auto *blockSource =
+                    source + static_cast<std::size_t>(frame - startFrame) * stride;
+                if (offset == 0 && length == blockSize)
+                {
+                    blocks[index] = Block::packPcm(
+                        blockSource, static_cast<std::size_t>(length), stride,
+                        bitDepth);
+                    residentBytesAdded += blocks[index]->residentBytes();
+                }
+                else
+                {
+                    auto &samples = mutableBlock(index);
+                    for (int64_t i = 0; i < length; ++i)
+                    {
+                        samples[static_cast<std::size_t>(offset + i)] =
+                            static_cast<float>(
+                                blockSource[static_cast<std::size_t>(i) * stride]) *
+                            scale;
+                    }
+                }
+                frame += length;
+            }
+        }
+
+        void write(const int64_t startFrame, const float *source,
+                   const int64_t count)
+        {
+            forEachMutableSpan(startFrame, count,
+                               [&](const std::span<float> span,
+                                   const int64_t frame)
+                               {
+                                   std::memcpy(span.data(),
+                                               source + (frame - startFrame),
+                                               span.size() * sizeof(float));
+                               });
+        }
+
+        void resize(const int64_t newFrameCount)
+        {
+            if (newFrameCount < frameCount)
+            {
+                erase(std::max<int64_t>(0, newFrameCount),
+                      frameCount - std::max<int64_t>(0, newFrameCount));
+            }
+            else if (newFrameCount > frameCount)
+            {
+                insertZeros(frameCount, newFrameCount - frameCount);
+            }
+        }
+
+        void insertZeros(int64_t frameIndex, int64_t count)
+        {
+            if (count <= 0)
+            {
+                return;
+            }
+            frameIndex = std::clamp<int64_t>(frameIndex, 0, frameCount);
+
+            // Appends top up the last block first. Recording appends a small
+            // chunk per callback and would otherwise leave a trail of tiny
+            // blocks behind it.
+            if (frameIndex == frameCount && !blocks.empty())
+            {
+                auto &tail = mutableBlock(blocks.size() - 1);
+                const auto room =
+                    kBlockFrames - static_cast<int64_t>(tail.size());
+                const auto topUp = std::min<int64_t>(room, count);
+                if (topUp > 0)
+                {
+                    if (tail.capacity() < static_cast<std::size_t>(kBlockFrames))
+                    {
+                        residentBytesAdded += static_cast<int64_t>(
+                            (static_cast<std::size_t>(kBlockFrames) -
+                             tail.capacity()) *
+                            sizeof(float));
+                        tail.reserve(static_cast<std::size_t>(kBlockFrames));
+                    }
+                    tail.resize(tail.size() + static_cast<std::size_t>(topUp),
+                                0.0f);
+                    frameCount += topUp;
+                    frameIndex += topUp;
+                    count -= topUp;
+                }
+                if (count == 0)
+                {
+                    return;
+                }
+            }
+
+            const auto insertAt = splitAt(frameIndex);
+            std::vector<std::shared_ptr<Block>> inserted;
+            inserted.reserve(static_cast<std::size_t>(
+                (count + kBlockFrames - 1) / kBlockFrames));
+            for (int64_t remaining = count; remaining > 0;
+                 remaining -= kBlockFrames)
+            {
+                inserted.push_back(Block::silence(
+                    static_cast<std::size_t>(std::min(remaining, kBlockFrames))));
+            }
+            const auto insertedCount = inserted.size();
+            blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(insertAt),
+                          std::make_move_iterator(inserted.begin()),
+                          std::make_move_iterator(inserted.end()));
+            frameCount += count;
+            reindexFrom(insertAt);
+
+            // Splitting may have left a short block on either side of the
+            // inserted ones, which can now fit with its other neighbour.
+            coalesceBoundaries(insertAt > 0 ? insertAt - 1 : 0,
+                               insertAt + insertedCount + 1);
+        }
+
+        // Reports (completed, total) where total is the number of frames
+        // this call actually has to copy, plus one for the table update.
+        void erase(int64_t frameIndex, int64_t count,
+                   const ProgressCallback &progress = {})
+        {
+            frameIndex = std::clamp<int64_t>(frameIndex, 0, frameCount);
+            count = std::clamp<int64_t>(count, 0, frameCount - frameIndex);
+            if (count <= 0)
+            {
+                if (progress)
+                {
+                    progress(1, 1);
+                }
+                return;
+            }
+
+            const auto eraseEnd = frameIndex + count;
+            const auto firstIndex = blockIndexForFrame(frameIndex);
+            const auto firstBlockEnd =
+                blockStarts[firstIndex] +
+                static_cast<int64_t>(blocks[firstIndex]->size());
+
+            if (eraseEnd < firstBlockEnd)
+            {
+                eraseWithinBlock(firstIndex, frameIndex, count, progress);
+                return;
+            }
+
+            const auto lastIndex = blockIndexForFrame(eraseEnd - 1);
+            const auto lastBlockEnd =
+                blockStarts[lastIndex] +
+                static_cast<int64_t>(blocks[lastIndex]->size());
+            const int64_t totalUnits = (lastBlockEnd - eraseEnd) + 1;
+
+            keepRange(firstIndex, 0,
+                      static_cast<std::size_t>(frameIndex -
+                                               blockStarts[firstIndex]));
+            if (lastIndex != firstIndex)
+            {
+                keepRange(lastIndex,
+                          static_cast<std::size_t>(eraseEnd -
+                                                   blockStarts[lastIndex]),
+                          blocks[lastIndex]->size());
+            }
+            if (progress)
+            {
+                progress(totalUnits - 1, totalUnits);
+            }
+
+            if (lastIndex > firstIndex + 1)
+            {
+                blocks.erase(
+                    blocks.begin() + static_cast<std::ptrdiff_t>(firstIndex + 1),
+                    blocks.begin() + static_cast<std::ptrdiff_t>(lastIndex));
+            }
+            frameCount -= count;
+            dropEmptyBlocksAround(firstIndex);
+            if (progress)
+            {
+                progress(totalUnits, totalUnits);
+            }
+        }
+
+        // Bytes of RAM that blocks were given since the last call: blocks
+        // detached from shared or viewed storage, packed, sliced or grown.
+        // Freed bytes are not subtracted.
+        int64_t takeResidentBytesAdded()
+        {
+            return std::exchange(residentBytesAdded, 0);
+        }
+
+        // Leaves out blocks that other channel copies still reference.
+        [[nodiscard]] int64_t unsharedResidentBytes() const
+        {
+            int64_t total = 0;
+            for (const auto &block : blocks)
+            {
+                if (block.use_count() == 1)
+                {
+                    total += block->residentBytes();
+                }
+            }
+            return total;
+        }
+
+        [[nodiscard]] int64_t residentBytes() const
+        {
+            int64_t total = 0;
+            for (const auto &block : blocks)
+            {
+                total += block->residentBytes();
+            }
+            return total;
+        }
+
+        // Moves in-RAM blocks into scratch slots until at least
+        // bytesToRelease bytes were moved or nothing resident is left.
+        // Returns the number of bytes moved. If the scratch file cannot
+        // take a block, that block stays in RAM and the error is thrown.
+        int64_t pageOut(SampleScratchFile &scratch, const int64_t bytesToRelease)
+        {
+            int64_t released = 0;
+            for (auto &block : blocks)
+            {
+                if (released >= bytesToRelease)
+                {
+                    break;
+                }
+                if (!block->isResident())
+                {
+                    continue;
+                }
+                const auto bytes = block->residentBytes();
+                if (block->isFloat())
+                {
+                    block = std::make_shared<Block>(
+                        scratch.store(block->data(),
+                                      static_cast<int64_t>(block->size())),
+                        block->size());
+                }
+                else
+                {
+                    std::vector<float> converted(block->size());
+                    block->copyTo(0, converted.size(), converted.data());
+                    block = std::make_shared<Block>(
+                        scratch.store(converted.data(),
+                                      static_cast<int64_t>(converted.size())),
+                        converted.size());
+                }
+                released += bytes;
+            }
+            return released;
+        }
+
+    private:
+        std::vector<std::shared_ptr<Block>> blocks;
+        // blockStarts[i] is the channel frame at which blocks[i] begins.
+        std::vector<int64_t> blockStarts;
+        int64_t frameCount = 0;
+        int64_t residentBytesAdded = 0;
+
+        // Returns the samples of blocks[index] for writing, first detaching
+        // the block from any other channel copy that still references it and
+        // pulling viewed storage into RAM.
+        std::vector<float> &mutableBlock(const std::size_t index)
+        {
+            auto &block = blocks[index];
+            if (block.use_count() != 1 || !block->isResident() ||
+                !block->isFloat())
+            {
+                auto copy = std::make_shared<Block>();
+                copy->samples.reserve(static_cast<std::size_t>(kBlockFrames));
+                copy->samples.resize(block->size());
+                block->copyTo(0, block->size(), copy->samples.data());
+                residentBytesAdded += copy->residentBytes();
+                block = std::move(copy);
+            }
+            return block->samples;
+        }
+
+        // Shrinks blocks[index] to the sample range [begin, end), in place
+        // when the block is owned here and by slicing otherwise.
+        void keepRange(const std::size_t index, const std::size_t begin,
+                       const std::size_t end)
+        {
+            auto &block = blocks[index];
+            if (block.use_count() == 1 && block->isResident() &&
+                block->isFloat())
+            {
+                auto &samples = block->samples;
+                samples.resize(end);
+                samples.erase(samples.begin(),
+                              samples.begin() +
+                                  static_cast<std::ptrdiff_t>(begin));
+                return;
+            }
+            block = slice(*block, begin, end - begin);
+        }
+
+        // Block::slice(), counting what it copies into RAM.
+        std::shared_ptr<Block> slice(const Block &block,
+                                     const std::size_t offset,
+                                     const std::size_t count)
+        {
+            auto sliced = block.slice(offset, count);
+            residentBytesAdded += sliced->residentBytes();
+            return sliced;
+        }
+
+        [[nodiscard]] std::size_t blockIndexForFrame(const int64_t frame) const
+        {
+            const auto it =
+                std::upper_bound(blockStarts.begin(), blockStarts.end(), frame);
+            return static_cast<std::size_t>(
+                std::max<std::ptrdiff_t>(0, (it - blockStarts.begin()) - 1));
+        }
+
+        void reindexFrom(std::size_t index)
+        {
+            blockStarts.resize(blocks.size());
+            if (blocks.empty())
+            {
+                return;
+            }
+            if (index == 0)
+            {
+                blockStarts[0] = 0;
+                index = 1;
+            }
+            for (; index < blocks.size(); ++index)
+            {
+                blockStarts[index] =
+                    blockStarts[index - 1] +
+                    static_cast<int64_t>(blocks[index - 1]->size());
+            }
+        }
+
+        // Returns the index of the block that starts at frame, splitting the
+        // block containing it if needed. frame == size() yields blockCount().
+        std::size_t splitAt(const int64_t frame)
+        {
+            if (frame >= frameCount)
+            {
+                return blocks.size();
+            }
+
+            const auto index = blockIndexForFrame(frame);
+            const auto offset = frame - blockStarts[index];
+            if (offset == 0)
+            {
+                return index;
+            }
+
+            const auto splitOffset = static_cast<std::size_t>(offset);
+            auto tail = slice(*blocks[index], splitOffset,
+                              blocks[index]->size() - splitOffset);
+            keepRange(index, 0, splitOffset);
+            blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(index + 1),
+                          std::move(tail));
+            reindexFrom(index + 1);
+            return index + 1;
+        }
+
+        // Merges the blocks on either side of boundary (blocks[boundary - 1]
+        // and blocks[boundary]) when they fit into one block together.
+        // Returns whether they did.
+        bool coalesceBoundary(const std::size_t boundary)
+        {
+            if (boundary == 0 || boundary >= blocks.size())
+            {
+                return false;
+            }
+
+            if (static_cast<int64_t>(blocks[boundary - 1]->size() +
+                                     blocks[boundary]->size()) > kBlockFrames)
+            {
+                return false;
+            }
+
+            const auto &right = *blocks[boundary];
+            auto &left = mutableBlock(boundary - 1);
+            const auto leftSize = left.size();
+            const auto leftCapacity = left.capacity();
+            left.resize(leftSize + right.size());
+            residentBytesAdded += static_cast<int64_t>(
+                (left.capacity() - leftCapacity) * sizeof(float));
+            right.copyTo(0, right.size(), left.data() + leftSize);
+            blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(boundary));
+            reindexFrom(boundary);
+            return true;
+        }
+
+        // Coalesces boundaries first to last until none of them merges any
+        // more, restoring the invariant around an edit.
+        void coalesceBoundaries(const std::size_t first, std::size_t last)
+        {
+            bool merged = true;
+            while (merged)
+            {
+                merged = false;
+                for (auto boundary = std::max<std::size_t>(first, 1);
+                     boundary <= last && boundary < blocks.size();)
+                {
+                    if (coalesceBoundary(boundary))
+                    {
+                        // The merged block may also fit with the next one.
+                        merged = true;
+                        last = last > 0 ? last - 1 : 0;
+                        continue;
+                    }
+                    ++boundary;
+                }
+            }
+        }
+
+        void dropEmptyBlocksAround(std::size_t index)
+        {
+            const auto first = index > 0 ? index - 1 : index;
+            const auto last = std::min(blocks.size(), index + 2);
+            const auto newEnd = std::remove_if(
+                blocks.begin() + static_cast<std::ptrdiff_t>(first),
+                blocks.begin() + static_cast<std::ptrdiff_t>(last),
+                [](const std::shared_ptr<Block> &block)
+                { return block->size() == 0; });
+            blocks.erase(newEnd,
+                         blocks.begin() + static_cast<std::ptrdiff_t>(last));
+            reindexFrom(first);
+            coalesceBoundaries(first, first + 3);
+        }
+
+        void eraseWithinBlock(const std::size_t index, const int64_t frameIndex,
+                              const int64_t count,
+                              const ProgressCallback &progress)
+        {
+            constexpr int64_t kProgressStrideFrames = 16384;
+
+            auto &block = mutableBlock(index);
+            const auto offset = frameIndex - blockStarts[index];
+            const auto framesToShift =
+                static_cast<int64_t>(block.size()) - offset - count;
+            const int64_t totalUnits = framesToShift + 1;
+            for (int64_t moved = 0; moved < framesToShift;
+                 moved += kProgressStrideFrames)
+            {
+                const auto chunkFrames =
+                    std::min<int64_t>(kProgressStrideFrames, framesToShift - moved);
+                std::memmove(block.data() + offset + moved,
+                             block.data() + offset + count + moved,
+                             static_cast<std::size_t>(chunkFrames) * sizeof(float));
+                if (progress)
+                {
+                    progress(moved + chunkFrames, totalUnits);
+                }
+            }
+            block.resize(block.size() - static_cast<std::size_t>(count));
+            frameCount -= count;
+            dropEmptyBlocksAround(index);
+            if (progress)
+            {
+                progress(totalUnits, totalUnits);
+            }
+        }
+    };
+} // namespace cupuacu::audio
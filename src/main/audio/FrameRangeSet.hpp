@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace cupuacu::audio
+{
+    struct FrameRange
+    {
+        std::int64_t startFrame = 0;
+        std::int64_t endFrameExclusive = 0;
+
+        bool operator==(const FrameRange &) const = default;
+    };
+
+    // Sorted set of disjoint, non-adjacent frame ranges. Edits cost O(number
+    // of ranges) rather than O(number of frames), and marking frames in
+    // ascending order only ever extends or appends the last range.
+    class FrameRangeSet
+    {
+    public:
+        [[nodiscard]] bool empty() const
+        {
+            return ranges.empty();
+        }
+
+        [[nodiscard]] const std::vector<FrameRange> &getRanges() const
+        {
+            return ranges;
+        }
+
+        void clear()
+        {
+            ranges.clear();
+        }
+
+        [[nodiscard]] bool contains(const std::int64_t frame) const
+        {
+            const auto it = firstEndingAfter(frame);
+            return it != ranges.end() && it->startFrame <= frame;
+        }
+
+        void add(const std::int64_t startFrame,
+                 const std::int64_t endFrameExclusive)
+        {
+            if (startFrame >= endFrameExclusive)
+            {
+                return;
+            }
+
+            if (ranges.empty() || startFrame > ranges.back().endFrameExclusive)
+            {
+                ranges.push_back({startFrame, endFrameExclusive});
+                return;
+            }
+            if (startFrame >= ranges.back().startFrame)
+            {
+                ranges.back().endFrameExclusive =
+                    std::max(ranges.back().endFrameExclusive, endFrameExclusive);
+                return;
+            }
+
+            // First range that touches or follows the new one, and the first
+            // one entirely past it; everything in between is absorbed.
+            auto first = std::lower_bound(
+                ranges.begin(), ranges.end(), startFrame,
+                [](const FrameRange &range, const std::int64_t frame)
+                { return range.endFrameExclusive < frame; });
+            auto last = std::upper_bound(
+                first, ranges.end(), endFrameExclusive,
+                [](const std::int64_t frame, const FrameRange &range)
+                { return frame < range.startFrame; });
+            if (first == last)
+            {
+                ranges.insert(first, {startFrame, endFrameExclusive});
+                return;
+            }
+
+            first->startFrame = std::min(first->startFrame, startFrame);
+            first->endFrameExclusive =
+                std::max(std::prev(last)->endFrameExclusive, endFrameExclusive);
+            ranges.erase(std::next(first), last);
+        }
+
+        void remove(const std::int64_t startFrame,
+                    const std::int64_t endFrameExclusive)
+        {
+            if (startFrame >= endFrameExclusive)
+            {
+                return;
+            }
+
+            auto first = firstEndingAfter(startFrame);
+            auto last = first;
+            while (last != ranges.end() && last->startFrame < endFrameExclusive)
+            {
+                ++last;
+            }
+            if (first == last)
+            {
+                return;
+            }
+
+            std::vector<FrameRange> kept;
+            if (first->startFrame < startFrame)
+            {
+                kept.push_back({first->startFrame, startFrame});
+            }
+            if (std::prev(last)->endFrameExclusive > endFrameExclusive)
+            {
+                kept.push_back(
+                    {endFrameExclusive, std::prev(last)->endFrameExclusive});
+            }
+            const auto position = ranges.erase(first, last);
+            ranges.insert(position, kept.begin(), kept.end());
+        }
+
+        // Opens a gap of frameCount frames at frame. The gap itself is not
+        // part of the set; a range spanning the gap is split around it.
+        void insertGap(const std::int64_t frame, const std::int64_t frameCount)
+        {
+            if (frameCount <= 0)
+            {
+                return;
+            }
+
+            auto it = firstEndingAfter(frame);
+            if (it == ranges.end())
+            {
+                return;
+            }
+            if (it->startFrame < frame)
+            {
+                const FrameRange tail{frame + frameCount,
+                                      it->endFrameExclusive + frameCount};
+                it->endFrameExclusive = frame;
+                it = ranges.insert(std::next(it), tail);
+                ++it;
+            }
+            for (; it != ranges.end(); ++it)
+            {
+                it->startFrame += frameCount;
+                it->endFrameExclusive += frameCount;
+            }
+        }
+
+        // Drops [frame, frame + frameCount) and closes the hole, merging the
+        // ranges that end up touching.
+        void removeSpan(const std::int64_t frame, const std::int64_t frameCount)
+        {
+            if (frameCount <= 0)
+            {
+                return;
+            }
+
+            const auto removeEnd = frame + frameCount;
+            std::vector<FrameRange> updated;
+            updated.reserve(ranges.size());
+            for (const auto &range : ranges)
+            {
+                FrameRange shifted = range;
+                if (range.endFrameExclusive <= frame)
+                {
+                    // Entirely before the removed span.
+                }
+                else if (range.startFrame >= removeEnd)
+                {
+                    shifted.startFrame -= frameCount;
+                    shifted.endFrameExclusive -= frameCount;
+                }
+                else
+                {
+                    shifted.startFrame = std::min(range.startFrame, frame);
+                    shifted.endFrameExclusive =
+                        range.endFrameExclusive > removeEnd
+                            ? range.endFrameExclusive - frameCount
+                            : frame;
+                    if (shifted.startFrame >= shifted.endFrameExclusive)
+                    {
+                        continue;
+                    }
+                }
+
+                if (!updated.empty() &&
+                    updated.back().endFrameExclusive >= shifted.startFrame)
+                {
+                    updated.back().endFrameExclusive = std::max(
+                        updated.back().endFrameExclusive,
+                        shifted.endFrameExclusive);
+                    continue;
+                }
+                updated.push_back(shifted);
+            }
+            ranges = std::move(updated);
+        }
+
+        // Drops everything at or past frameCount.
+        void truncate(const std::int64_t frameCount)
+        {
+            while (!ranges.empty() && ranges.back().startFrame >= frameCount)
+            {
+                ranges.pop_back();
+            }
+            if (!ranges.empty())
+            {
+                ranges.back().endFrameExclusive =
+                    std::min(ranges.back().endFrameExclusive, frameCount);
+            }
+        }
+
+        // The parts of the set inside [startFrame, endFrameExclusive).
+        [[nodiscard]] std::vector<FrameRange>
+        rangesWithin(const std::int64_t startFrame,
+                     const std::int64_t endFrameExclusive) const
+        {
+            std::vector<FrameRange> result;
+            for (auto it = firstEndingAfter(startFrame);
+                 it != ranges.end() && it->startFrame < endFrameExclusive; ++it)
+            {
+                result.push_back(
+                    {std::max(it->startFrame, startFrame),
+                     std::min(it->endFrameExclusive, endFrameExclusive)});
+            }
+            return result;
+        }
+
+    private:
+        std::vector<FrameRange> ranges;
+
+        [[nodiscard]] std::vector<FrameRange>::const_iterator
+        firstEndingAfter(const std::int64_t frame) const
+        {
+            return std::upper_bound(
+                ranges.begin(), ranges.end(), frame,
+                [](const std::int64_t target, const FrameRange &range)
+                { return target < range.endFrameExclusive; });
+        }
+
+        [[nodiscard]] std::vector<FrameRange>::iterator
+        firstEndingAfter(const std::int64_t frame)
+        {
+            return std::upper_bound(
+                ranges.begin(), ranges.end(), frame,
+                [](const std::int64_t target, const FrameRange &range)
+                { return target < range.endFrameExclusive; });
+        }
+    };
+} // namespace cupuacu::audio
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace cupuacu::audio
+{
+    // A version for every frame, kept as runs of frames that were last
+    // changed together. Versions come from one counter shared by all
+    // instances, so two instances only report the same version for a range
+    // if one was copied from the other and the range has not changed since.
+    class FrameRangeVersions
+    {
+    public:
+        // Pass as endFrameExclusive for every frame from startFrame on.
+        static constexpr std::int64_t END =
+            std::numeric_limits<std::int64_t>::max();
+        // Past this many runs, the shortest neighbouring runs are merged.
+        // A merged run reports the newer of the two versions, which only
+        // ever makes a range look changed when it was not.
+        static constexpr std::size_t MAX_RUN_COUNT = 512;
+        // A change next to or inside the run the previous change made joins
+        // it, up to this many frames, so that writing a range a frame or a
+        // block at a time adds one run rather than one per write. The
+        // joined frames report the newer version too; the limit keeps how
+        // much of a long write that makes look changed again small.
+        static constexpr std::int64_t MAX_JOINED_RUN_LENGTH = 65536;
+
+        FrameRangeVersions()
+        {
+            reset();
+        }
+
+        // Gives every frame a new version.
+        void reset()
+        {
+            runs.assign(1, Run{.startFrame = 0, .version = nextVersion()});
+            lastChangedVersion = 0;
+        }
+
+        // Gives frames [startFrame, endFrameExclusive) a new version. After
+        // frames were inserted or removed at startFrame, pass END: every
+        // frame after them moved.
+        void markChanged(std::int64_t startFrame,
+                         const std::int64_t endFrameExclusive)
+        {
+            startFrame = std::max<std::int64_t>(0, startFrame);
+            if (startFrame >= endFrameExclusive)
+            {
+                return;
+            }
+            if (runs.empty())
+            {
+                reset();
+                return;
+            }
+
+            const bool hasTail = endFrameExclusive != END;
+            const std::uint64_t tailVersion =
+                hasTail ? runContaining(endFrameExclusive)->version : 0;
+            const auto first = std::lower_bound(
+                runs.begin(), runs.end(), startFrame,
+                [](const Run &run, const std::int64_t frame)
+                { return run.startFrame < frame; });
+            const auto last =
+                hasTail ? std::upper_bound(
+                              first, runs.end(), endFrameExclusive,
+                              [](const std::int64_t frame, const Run &run)
+                              { return frame < run.startFrame; })
+                        : runs.end();
+            const auto version = nextVersion();
+            const auto at = runs.erase(first, last);
+            const auto inserted = runs.insert(
+                at, Run{.startFrame = startFrame, .version = version});
+            const auto changed =
+                static_cast<std::size_t>(inserted - runs.begin());
+            if (hasTail)
+            {
+                runs.insert(inserted + 1, Run{.startFrame = endFrameExclusive,
+                                              .version = tailVersion});
+            }
+            joinLastChanged(changed);
+            lastChangedVersion = version;
+            if (runs.size() > MAX_RUN_COUNT)
+            {
+                mergeShortestRuns();
+            }
+        }
+
+        // The newest version among frames [startFrame, endFrameExclusive).
+        [[nodiscard]] std::uint64_t
+        versionOf(const std::int64_t startFrame,
+                  const std::int64_t endFrameExclusive) const
+        {
+            std::uint64_t version = 0;
+            if (runs.empty())
+            {
+                return version;
+            }
+            for (auto it = runContaining(std::max<std::int64_t>(0, startFrame));
+                 it != runs.end() && it->startFrame < endFrameExclusive; ++it)
+            {
+                version = std::max(version, it->version);
+            }
+            return version;
+        }
+
+        [[nodiscard]] std::size_t getRunCount() const
+        {
+            return runs.size();
+        }
+
+    private:
+        // Covers the frames from startFrame up to the next run.
+        struct Run
+        {
+            std::int64_t startFrame = 0;
+            std::uint64_t version = 0;
+        };
+
+        std::vector<Run> runs;
+        // The version the most recent markChanged gave, 0 if none since
+        // reset.
+        std::uint64_t lastChangedVersion = 0;
+
+        static std::uint64_t nextVersion()
+        {
+            static std::atomic<std::uint64_t> next{1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::vector<Run>::const_iterator
+        runContaining(const std::int64_t frame) const
+        {
+            return std::upper_bound(runs.begin(), runs.end(), frame,
+                                    [](const std::int64_t f, const Run &run)
+                                    { return f < run.startFrame; }) -
+                   1;
+        }
+
+        std::int64_t runEnd(const std::vector<Run>::const_iterator run) const
+        {
+            return run + 1 == runs.end() ? END : (run + 1)->startFrame;
+        }
+
+        // Joins runs[index] with the runs either side of it that the
+        // previous markChanged made, as far as MAX_JOINED_RUN_LENGTH allows.
+        void joinLastChanged(const std::size_t index)
+        {
+            if (lastChangedVersion == 0)
+            {
+                return;
+            }
+            auto changed = runs.begin() + static_cast<std::ptrdiff_t>(index);
+            if (changed != runs.begin())
+            {
+                const auto before = changed - 1;
+                if (before->version == lastChangedVersion &&
+                    runEnd(changed) - before->startFrame <=
+                        MAX_JOINED_RUN_LENGTH)
+                {
+                    before->version = changed->version;
+                    changed = runs.erase(changed) - 1;
+                }
+            }
+            const auto after = changed + 1;
+            if (after != runs.end() && after->version == lastChangedVersion &&
+                runEnd(after) - changed->startFrame <= MAX_JOINED_RUN_LENGTH)
+            {
+                runs.erase(after);
+            }
+        }
+
+        void mergeShortestRuns()
+        {
+            while (runs.size() > MAX_RUN_COUNT)
+            {
+                // The last run has no end, so it is never the shortest.
+                std::size_t shortest = 0;
+                std::int64_t shortestLength = END;
+                for (std::size_t i = 0; i + 2 < runs.size(); ++i)
+                {
+                    const std::int64_t length =
+                        runs[i + 2].startFrame - runs[i].startFrame;
+                    if (length < shortestLength)
+                    {
+                        shortest = i;
+                        shortestLength = length;
+                    }
+                }
+                runs[shortest].version =
+                    std::max(runs[shortest].version, runs[shortest + 1].version);
+                runs.erase(runs.begin() +
+                           static_cast<std::ptrdiff_t>(shortest) + 1);
+            }
+        }
+    };
+} // namespace cupuacu::audio
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioBuffer.hpp"
+#include "FrameRangeSet.hpp"
 #include "SampleProvenance.hpp"
 
 #include <algorithm>
@@ -12,34 +13,13 @@ namespace cupuacu::audio
     class PreservationTrackingAudioBuffer : public AudioBuffer
     {
     private:
-        struct ProvenanceRange
-        {
-            std::int64_t startFrame = 0;
-            std::int64_t endFrameExclusive = 0;
-            std::uint64_t sourceId = 0;
-            std::int64_t sourceStartFrame = -1;
-        };
-
-        std::vector<std::uint8_t> dirtyFlags;
+        std::vector<FrameRangeSet> dirtyRanges;
         std::vector<std::vector<ProvenanceRange>> provenanceRanges;
 
-        [[nodiscard]] std::int64_t flatIndex(const std::int64_t channel,
-                                             const std::int64_t frame) const
-        {
-            return frame * static_cast<std::int64_t>(channels.size()) + channel;
-        }
-
-        [[nodiscard]] bool dirtyBitByFlatIndex(const std::int64_t index) const
-        {
-            return (dirtyFlags[static_cast<std::size_t>(index / 8)] >>
-                    (index % 8)) &
-                   1;
-        }
-
-        void markDirtyByFlatIndex(const std::int64_t index)
+        [[nodiscard]] bool hasChannel(const std::int64_t channel) const
         {
-            dirtyFlags[static_cast<std::size_t>(index / 8)] |=
-                (1u << (index % 8));
+            return channel >= 0 &&
+                   channel < static_cast<std::int64_t>(dirtyRanges.size());
         }
 
         [[nodiscard]] static bool isValidProvenance(
@@ -164,12 +144,14 @@ namespace cupuacu::audio
             for (std::size_t channel = 0; channel < writableChannels; ++channel)
             {
                 totalSampleFrames += static_cast<std::int64_t>(std::min<std::size_t>(
-                    channels[channel].size(), samples[channel].size()));
+                    static_cast<std::size_t>(channels[channel].size()),
+                    samples[channel].size()));
                 if (channel < provenance.size())
                 {
                     totalProvenanceFrames += static_cast<std::int64_t>(
-                        std::min<std::size_t>(channels[channel].size(),
-                                              provenance[channel].size()));
+                        std::min<std::size_t>(
+                            static_cast<std::size_t>(channels[channel].size()),
+                            provenance[channel].size()));
                 }
             }
             const auto totalUnits =
@@ -180,17 +162,15 @@ namespace cupuacu::audio
             {
                 auto &destination = channels[channel];
                 const auto &source = samples[channel];
-                const auto writableFrames = std::min<std::size_t>(
-                    destination.size(), source.size());
-                for (std::size_t frame = 0; frame < writableFrames;
-                     frame += static_cast<std::size_t>(kProgressStrideFrames))
+                const auto writableFrames = std::min<std::int64_t>(
+                    destination.size(), static_cast<std::int64_t>(source.size()));
+                for (std::int64_t frame = 0; frame < writableFrames;
+                     frame += kProgressStrideFrames)
                 {
-                    const auto chunkFrames = std::min<std::size_t>(
-                        writableFrames - frame,
-                        static_cast<std::size_t>(kProgressStrideFrames));
-                    std::copy_n(source.data() + frame, chunkFrames,
-                                destination.data() + frame);
-                    completedSampleFrames += static_cast<std::int64_t>(chunkFrames);
+                    const auto chunkFrames = std::min<std::int64_t>(
+                        writableFrames - frame, kProgressStrideFrames);
+                    destination.write(frame, source.data() + frame, chunkFrames);
+                    completedSampleFrames += chunkFrames;
                     if (progress)
                     {
                         progress(completedSampleFrames, totalUnits);
@@ -200,15 +180,13 @@ namespace cupuacu::audio
 
             const auto channelCount = getChannelCount();
             const auto frameCount = getFrameCount();
-            const auto sampleCount = channelCount * frameCount;
-            const auto dirtyFillValue =
-                static_cast<std::uint8_t>(shouldMarkDirty ? 0xFF : 0x00);
-            dirtyFlags.assign(static_cast<std::size_t>((sampleCount + 7) / 8),
-                              dirtyFillValue);
-            if (shouldMarkDirty && sampleCount > 0 && sampleCount % 8 != 0)
+            dirtyRanges.assign(static_cast<std::size_t>(channelCount), {});
+            if (shouldMarkDirty)
             {
-                dirtyFlags.back() &=
-                    static_cast<std::uint8_t>((1u << (sampleCount % 8)) - 1u);
+                for (auto &ranges : dirtyRanges)
+                {
+                    ranges.add(0, frameCount);
+                }
             }
 
             provenanceRanges.assign(static_cast<std::size_t>(channelCount), {});
@@ -222,7 +200,8 @@ namespace cupuacu::audio
                 }
 
                 const auto writableFrames = std::min<std::size_t>(
-                    channels[channel].size(), provenance[channel].size());
+                    static_cast<std::size_t>(channels[channel].size()),
+                    provenance[channel].size());
                 if (writableFrames == 0)
                 {
                     continue;
@@ -293,15 +272,39 @@ namespace cupuacu::audio
         [[nodiscard]] bool isDirty(const std::int64_t channel,
                                    const std::int64_t frame) const override
         {
-            return dirtyBitByFlatIndex(flatIndex(channel, frame));
+            return hasChannel(channel) &&
+                   dirtyRanges[static_cast<std::size_t>(channel)].contains(frame);
+        }
+
+        [[nodiscard]] std::vector<FrameRange>
+        getDirtyRanges(const std::int64_t channel, const std::int64_t startFrame,
+                       const std::int64_t endFrameExclusive) const override
+        {
+            if (!hasChannel(channel))
+            {
+                return {};
+            }
+            return dirtyRanges[static_cast<std::size_t>(channel)].rangesWithin(
+                startFrame, endFrameExclusive);
+        }
+
+        void markDirty(const std::int64_t channel, const std::int64_t startFrame,
+                       const std::int64_t endFrameExclusive) override
+        {
+            if (!hasChannel(channel))
+            {
+                return;
+            }
+            dirtyRanges[static_cast<std::size_t>(channel)].add(
+                std::max<std::int64_t>(0, startFrame),
+                std::min(endFrameExclusive, getFrameCount()));
         }
 
         void resize(const std::int64_t numChannels,
                     const std::int64_t numFrames) override
         {
             AudioBuffer::resize(numChannels, numFrames);
-            const auto sampleCount = numChannels * numFrames;
-            dirtyFlags.assign(static_cast<std::size_t>((sampleCount + 7) / 8), 0);
+            dirtyRanges.assign(static_cast<std::size_t>(numChannels), {});
             provenanceRanges.assign(static_cast<std::size_t>(numChannels), {});
         }
 
@@ -312,7 +315,8 @@ namespace cupuacu::audio
             AudioBuffer::setSample(channel, frame, value, shouldMarkDirty);
             if (shouldMarkDirty)
             {
-                markDirtyByFlatIndex(flatIndex(channel, frame));
+                dirtyRanges[static_cast<std::size_t>(channel)].add(frame,
+                                                                   frame + 1);
             }
         }
 
@@ -331,18 +335,14 @@ namespace cupuacu::audio
 
             const auto oldFrameCount = getFrameCount();
             const auto channelCount = getChannelCount();
-            const auto oldSampleCount = oldFrameCount * channelCount;
 
-            // Appending does not move any existing sample, dirty bit, or
+            // Appending does not move any existing sample, dirty range, or
             // provenance range. Recording reaches this path for every small
             // captured chunk, so rebuilding metadata for the complete document
             // here would make a recording progressively more expensive.
             if (frameIndex == oldFrameCount)
             {
                 AudioBuffer::insertFrames(frameIndex, numFrames);
-                const auto newSampleCount = getFrameCount() * channelCount;
-                dirtyFlags.resize(
-                    static_cast<std::size_t>((newSampleCount + 7) / 8), 0);
                 if (progress)
                 {
                     progress(1, 1);
@@ -350,18 +350,13 @@ namespace cupuacu::audio
                 return;
             }
 
-            std::vector<std::uint8_t> oldDirtyFlags = dirtyFlags;
-            oldDirtyFlags.resize(static_cast<std::size_t>((oldSampleCount + 7) / 8),
-                                 0);
-
             std::int64_t totalRangeCount = 0;
             for (const auto &ranges : provenanceRanges)
             {
                 totalRangeCount += static_cast<std::int64_t>(ranges.size());
             }
             const std::int64_t phase1Units = std::max<std::int64_t>(1, channelCount);
-            const std::int64_t phase2Units =
-                std::max<std::int64_t>(1, oldFrameCount * channelCount);
+            const std::int64_t phase2Units = std::max<std::int64_t>(1, channelCount);
             const std::int64_t phase3Units =
                 std::max<std::int64_t>(1, totalRangeCount);
             const std::int64_t totalUnits =
@@ -384,60 +379,14 @@ namespace cupuacu::audio
                     publishProgress(completed * phase1Units / safeTotal);
                 });
 
-            const auto newFrameCount = getFrameCount();
-            const auto newSampleCount = newFrameCount * channelCount;
-            dirtyFlags.assign(static_cast<std::size_t>((newSampleCount + 7) / 8), 0);
-
-            const auto oldIsDirty = [&](const std::int64_t channel,
-                                        const std::int64_t frame) -> bool
-            {
-                const auto index = frame * channelCount + channel;
-                return (oldDirtyFlags[static_cast<std::size_t>(index / 8)] >>
-                        (index % 8)) &
-                       1;
-            };
-
-            constexpr std::int64_t kProgressStrideFrames = 16384;
-            std::int64_t dirtyUnitsCompleted = 0;
-            for (std::int64_t frame = 0; frame < frameIndex; ++frame)
+            std::int64_t dirtyChannelsCompleted = 0;
+            for (auto &ranges : dirtyRanges)
             {
-                for (std::int64_t channel = 0; channel < channelCount; ++channel)
-                {
-                    const auto index = frame * channelCount + channel;
-                    if (oldIsDirty(channel, frame))
-                    {
-                        markDirtyByFlatIndex(index);
-                    }
-                }
-                dirtyUnitsCompleted += channelCount;
-                if ((frame + 1) % kProgressStrideFrames == 0 ||
-                    frame + 1 == frameIndex)
-                {
-                    publishProgress(phase1Units +
-                                    dirtyUnitsCompleted * phase2Units /
-                                        std::max<std::int64_t>(1, oldFrameCount * channelCount));
-                }
-            }
-
-            for (std::int64_t frame = frameIndex; frame < oldFrameCount; ++frame)
-            {
-                for (std::int64_t channel = 0; channel < channelCount; ++channel)
-                {
-                    const auto newIndex =
-                        (frame + numFrames) * channelCount + channel;
-                    if (oldIsDirty(channel, frame))
-                    {
-                        markDirtyByFlatIndex(newIndex);
-                    }
-                }
-                dirtyUnitsCompleted += channelCount;
-                if ((frame - frameIndex + 1) % kProgressStrideFrames == 0 ||
-                    frame + 1 == oldFrameCount)
-                {
-                    publishProgress(phase1Units +
-                                    dirtyUnitsCompleted * phase2Units /
-                                        std::max<std::int64_t>(1, oldFrameCount * channelCount));
-                }
+                ranges.insertGap(frameIndex, numFrames);
+                ++dirtyChannelsCompleted;
+                publishProgress(phase1Units +
+                                dirtyChannelsCompleted * phase2Units /
+                                    std::max<std::int64_t>(1, channelCount));
             }
 
             std::int64_t provenanceRangesCompleted = 0;
@@ -503,13 +452,7 @@ namespace cupuacu::audio
 
             const auto oldFrameCount = getFrameCount();
             const auto channelCount = getChannelCount();
-            const auto oldSampleCount = oldFrameCount * channelCount;
             const auto newFrameCount = oldFrameCount - numFrames;
-            const auto newSampleCount = newFrameCount * channelCount;
-
-            std::vector<std::uint8_t> oldDirtyFlags = dirtyFlags;
-            oldDirtyFlags.resize(static_cast<std::size_t>((oldSampleCount + 7) / 8),
-                                 0);
 
             const std::int64_t phase1Units = std::max<std::int64_t>(
                 1, channelCount * std::max<std::int64_t>(1, newFrameCount - frameIndex));
@@ -518,8 +461,7 @@ namespace cupuacu::audio
             {
                 totalRangeCount += static_cast<std::int64_t>(ranges.size());
             }
-            const std::int64_t phase2Units =
-                std::max<std::int64_t>(1, newSampleCount);
+            const std::int64_t phase2Units = std::max<std::int64_t>(1, channelCount);
             const std::int64_t phase3Units =
                 std::max<std::int64_t>(1, totalRangeCount);
             const std::int64_t totalUnits =
@@ -542,57 +484,15 @@ namespace cupuacu::audio
                     publishProgress(completed * phase1Units / safeTotal);
                 });
 
-            dirtyFlags.assign(static_cast<std::size_t>((newSampleCount + 7) / 8), 0);
-
-            const auto oldIsDirty = [&](const std::int64_t channel,
-                                        const std::int64_t frame) -> bool
-            {
-                const auto index = frame * channelCount + channel;
-                return (oldDirtyFlags[static_cast<std::size_t>(index / 8)] >>
-                        (index % 8)) &
-                       1;
-            };
-
-            constexpr std::int64_t kProgressStrideFrames = 16384;
-            std::int64_t dirtyUnitsCompleted = 0;
-            for (std::int64_t frame = 0; frame < frameIndex; ++frame)
-            {
-                for (std::int64_t channel = 0; channel < channelCount; ++channel)
-                {
-                    const auto index = frame * channelCount + channel;
-                    if (oldIsDirty(channel, frame))
-                    {
-                        markDirtyByFlatIndex(index);
-                    }
-                }
-                dirtyUnitsCompleted += channelCount;
-                if ((frame + 1) % kProgressStrideFrames == 0 ||
-                    frame + 1 == frameIndex)
-                {
-                    publishProgress(phase1Units +
-                                    dirtyUnitsCompleted * phase2Units /
-                                        std::max<std::int64_t>(1, newFrameCount * channelCount));
-                }
-            }
-
-            for (std::int64_t frame = frameIndex; frame < newFrameCount; ++frame)
+            std::int64_t dirtyChannelsCompleted = 0;
+            for (auto &ranges : dirtyRanges)
             {
-                for (std::int64_t channel = 0; channel < channelCount; ++channel)
-                {
-                    const auto newIndex = frame * channelCount + channel;
-                    if (oldIsDirty(channel, frame + numFrames))
-                    {
-                        markDirtyByFlatIndex(newIndex);
-                    }
-                }
-                dirtyUnitsCompleted += channelCount;
-                if ((frame - frameIndex + 1) % kProgressStrideFrames == 0 ||
-                    frame + 1 == newFrameCount)
-                {
-                    publishProgress(phase1Units +
-                                    dirtyUnitsCompleted * phase2Units /
-                                        std::max<std::int64_t>(1, newFrameCount * channelCount));
-                }
+                ranges.removeSpan(frameIndex, numFrames);
+                ranges.truncate(getFrameCount());
+                ++dirtyChannelsCompleted;
+                publishProgress(phase1Units +
+                                dirtyChannelsCompleted * phase2Units /
+                                    std::max<std::int64_t>(1, channelCount));
             }
 
             const auto removeEnd = frameIndex + numFrames;
@@ -664,20 +564,8 @@ namespace cupuacu::audio
                 return {};
             }
 
-            const auto &ranges =
-                provenanceRanges[static_cast<std::size_t>(channel)];
-            auto it = std::lower_bound(
-                ranges.begin(), ranges.end(), frame,
-                [](const ProvenanceRange &range, const std::int64_t targetFrame)
-                { return range.endFrameExclusive <= targetFrame; });
-            if (it == ranges.end() || frame < it->startFrame ||
-                frame >= it->endFrameExclusive)
-            {
-                return {};
-            }
-            return {.sourceId = it->sourceId,
-                    .frameIndex =
-                        it->sourceStartFrame + (frame - it->startFrame)};
+            return findProvenance(
+                provenanceRanges[static_cast<std::size_t>(channel)], frame);
         }
 
         void setProvenance(const std::int64_t channel, const std::int64_t frame,
@@ -686,9 +574,61 @@ namespace cupuacu::audio
             assignProvenanceRange(channel, frame, frame + 1, sampleProvenance);
         }
 
+        [[nodiscard]] std::vector<ProvenanceRange> getProvenanceRanges(
+            const std::int64_t channel, const std::int64_t startFrame,
+            const std::int64_t endFrameExclusive) const override
+        {
+            if (channel < 0 ||
+                channel >= static_cast<std::int64_t>(provenanceRanges.size()))
+            {
+                return {};
+            }
+            return provenanceRangesWithin(
+                provenanceRanges[static_cast<std::size_t>(channel)], startFrame,
+                endFrameExclusive);
+        }
+
+        void setProvenanceRanges(
+            const std::int64_t channel, const std::int64_t startFrame,
+            const std::int64_t endFrameExclusive,
+            const std::vector<ProvenanceRange> &ranges) override
+        {
+            if (channel < 0 ||
+                channel >= static_cast<std::int64_t>(provenanceRanges.size()) ||
+                startFrame >= endFrameExclusive)
+            {
+                return;
+            }
+
+            assignProvenanceRange(channel, startFrame, endFrameExclusive, {});
+            auto &channelRanges =
+                provenanceRanges[static_cast<std::size_t>(channel)];
+            for (const auto &range : ranges)
+            {
+                const auto first = std::max(range.startFrame, startFrame);
+                const auto last =
+                    std::min(range.endFrameExclusive, endFrameExclusive);
+                if (first >= last || range.sourceId == 0 ||
+                    range.sourceStartFrame < 0)
+                {
+                    continue;
+                }
+                channelRanges.push_back(
+                    {.startFrame = first,
+                     .endFrameExclusive = last,
+                     .sourceId = range.sourceId,
+                     .sourceStartFrame =
+                         range.sourceStartFrame + (first - range.startFrame)});
+            }
+            mergeAdjacentRanges(channelRanges);
+        }
+
         void markAllClean() override
         {
-            std::fill(dirtyFlags.begin(), dirtyFlags.end(), 0);
+            for (auto &ranges : dirtyRanges)
+            {
+                ranges.clear();
+            }
         }
 
         void establishSequentialProvenance(const std::uint64_t sourceId) override
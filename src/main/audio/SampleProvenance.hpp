@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 namespace cupuacu::audio
 {
@@ -14,4 +16,88 @@ namespace cupuacu::audio
             return sourceId != 0 && frameIndex >= 0;
         }
     };
+
+    // Frames [startFrame, endFrameExclusive) came from consecutive frames of
+    // source sourceId, beginning at sourceStartFrame.
+    struct ProvenanceRange
+    {
+        std::int64_t startFrame = 0;
+        std::int64_t endFrameExclusive = 0;
+        std::uint64_t sourceId = 0;
+        std::int64_t sourceStartFrame = -1;
+
+        bool operator==(const ProvenanceRange &) const = default;
+    };
+
+    // Looks frame up in ranges sorted by startFrame. Frames outside every
+    // range have no provenance.
+    [[nodiscard]] inline SampleProvenance
+    findProvenance(const std::vector<ProvenanceRange> &ranges,
+                   const std::int64_t frame)
+    {
+        const auto it = std::upper_bound(
+            ranges.begin(), ranges.end(), frame,
+            [](const std::int64_t target, const ProvenanceRange &range)
+            { return target < range.endFrameExclusive; });
+        if (it == ranges.end() || frame < it->startFrame)
+        {
+            return {};
+        }
+        return {.sourceId = it->sourceId,
+                .frameIndex = it->sourceStartFrame + (frame - it->startFrame)};
+    }
+
+    // The parts of ranges inside [startFrame, endFrameExclusive), clipped to
+    // it and still in the frames of the input.
+    [[nodiscard]] inline std::vector<ProvenanceRange>
+    provenanceRangesWithin(const std::vector<ProvenanceRange> &ranges,
+                           const std::int64_t startFrame,
+                           const std::int64_t endFrameExclusive)
+    {
+        std::vector<ProvenanceRange> result;
+        auto it = std::upper_bound(
+            ranges.begin(), ranges.end(), startFrame,
+            [](const std::int64_t target, const ProvenanceRange &range)
+            { return target < range.endFrameExclusive; });
+        for (; it != ranges.end() && it->startFrame < endFrameExclusive; ++it)
+        {
+            const auto first = std::max(it->startFrame, startFrame);
+            result.push_back(
+                {.startFrame = first,
+                 .endFrameExclusive =
+                     std::min(it->endFrameExclusive, endFrameExclusive),
+                 .sourceId = it->sourceId,
+                 .sourceStartFrame =
+                     it->sourceStartFrame + (first - it->startFrame)});
+        }
+        return result;
+    }
+
+    // Appends the provenance of frame, which must follow every frame already
+    // in ranges, extending the last range when it continues it.
+    inline void appendProvenance(std::vector<ProvenanceRange> &ranges,
+                                 const std::int64_t frame,
+                                 const SampleProvenance &sampleProvenance)
+    {
+        if (!sampleProvenance.isValid())
+        {
+            return;
+        }
+        if (!ranges.empty())
+        {
+            auto &tail = ranges.back();
+            if (tail.endFrameExclusive == frame &&
+                tail.sourceId == sampleProvenance.sourceId &&
+                tail.sourceStartFrame + (frame - tail.startFrame) ==
+                    sampleProvenance.frameIndex)
+            {
+                tail.endFrameExclusive = frame + 1;
+                return;
+            }
+        }
+        ranges.push_back({.startFrame = frame,
+                          .endFrameExclusive = frame + 1,
+                          .sourceId = sampleProvenance.sourceId,
+                          .sourceStartFrame = sampleProvenance.frameIndex});
+    }
 } // namespace cupuacu::audio
@@ -0,0 +1,221 @@
+#include "SampleScratchFile.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace cupuacu::audio
+{
+    namespace
+    {
+        constexpr int64_t kSlotBytes =
+            SampleScratchFile::kSlotFrames * static_cast<int64_t>(sizeof(float));
+        constexpr int64_t kSegmentBytes =
+            kSlotBytes * SampleScratchFile::kSlotsPerSegment;
+
+        std::filesystem::path makeScratchFilePath(
+            const std::filesystem::path &directory)
+        {
+            static std::atomic<uint64_t> nextIndex{1};
+            const auto stamp = static_cast<uint64_t>(
+                std::chrono::steady_clock::now().time_since_epoch().count());
+            return directory /
+                   ("samples-" + std::to_string(stamp) + "-" +
+                    std::to_string(nextIndex.fetch_add(1)) + ".scratch");
+        }
+    } // namespace
+
+    std::shared_ptr<SampleScratchFile>
+    SampleScratchFile::create(const std::filesystem::path &directory)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+
+        std::shared_ptr<SampleScratchFile> result(new SampleScratchFile());
+        result->path = makeScratchFilePath(directory);
+
+#if defined(_WIN32)
+        const HANDLE handle = CreateFileW(
+            result->path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+            nullptr, CREATE_NEW,
+            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("Failed to create sample scratch file");
+        }
+        result->fileHandle = reinterpret_cast<std::intptr_t>(handle);
+#else
+        const int fd = ::open(result->path.c_str(),
+                              O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create sample scratch file");
+        }
+        ::unlink(result->path.c_str());
+        result->fileHandle = fd;
+#endif
+        return result;
+    }
+
+    SampleScratchFile::~SampleScratchFile()
+    {
+#if defined(_WIN32)
+        for (const auto &segment : segments)
+        {
+            UnmapViewOfFile(segment.samples);
+            CloseHandle(static_cast<HANDLE>(segment.mappingHandle));
+        }
+        if (fileHandle != -1)
+        {
+            CloseHandle(reinterpret_cast<HANDLE>(fileHandle));
+        }
+#else
+        for (const auto &segment : segments)
+        {
+            ::munmap(segment.samples, static_cast<std::size_t>(kSegmentBytes));
+        }
+        if (fileHandle != -1)
+        {
+            ::close(static_cast<int>(fileHandle));
+        }
+#endif
+    }
+
+    std::shared_ptr<const float> SampleScratchFile::store(const float *samples,
+                                                          const int64_t count)
+    {
+        if (count < 0 || count > kSlotFrames)
+        {
+            throw std::invalid_argument("Scratch block exceeds slot size");
+        }
+
+        int64_t slot = 0;
+        float *destination = nullptr;
+        {
+            std::lock_guard lock(mutex);
+            if (freeSlots.empty())
+            {
+                growUnlocked();
+            }
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            ++usedSlotCount;
+            destination = slotAddress(slot);
+        }
+
+        std::memcpy(destination, samples,
+                    static_cast<std::size_t>(count) * sizeof(float));
+
+        auto self = shared_from_this();
+        return std::shared_ptr<const float>(
+            destination, [self, slot](const float *)
+            {
+                self->release(slot);
+            });
+    }
+
+    int64_t SampleScratchFile::getSlotCount() const
+    {
+        std::lock_guard lock(mutex);
+        return static_cast<int64_t>(segments.size()) * kSlotsPerSegment;
+    }
+
+    int64_t SampleScratchFile::getUsedSlotCount() const
+    {
+        std::lock_guard lock(mutex);
+        return usedSlotCount;
+    }
+
+    float *SampleScratchFile::slotAddress(const int64_t slot) const
+    {
+        const auto &segment =
+            segments[static_cast<std::size_t>(slot / kSlotsPerSegment)];
+        return segment.samples + (slot % kSlotsPerSegment) * kSlotFrames;
+    }
+
+    void SampleScratchFile::growUnlocked()
+    {
+        const auto segmentIndex = static_cast<int64_t>(segments.size());
+        const auto newFileSize = (segmentIndex + 1) * kSegmentBytes;
+        Segment segment;
+
+#if defined(_WIN32)
+        const auto file = reinterpret_cast<HANDLE>(fileHandle);
+        const auto mapping = CreateFileMappingW(
+            file, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(static_cast<uint64_t>(newFileSize) >> 32),
+            static_cast<DWORD>(static_cast<uint64_t>(newFileSize) & 0xffffffffu),
+            nullptr);
+        if (!mapping)
+        {
+            throw std::runtime_error("Failed to grow sample scratch file");
+        }
+        const auto offset = static_cast<uint64_t>(segmentIndex * kSegmentBytes);
+        void *view = MapViewOfFile(mapping, FILE_MAP_WRITE,
+                                   static_cast<DWORD>(offset >> 32),
+                                   static_cast<DWORD>(offset & 0xffffffffu),
+                                   static_cast<SIZE_T>(kSegmentBytes));
+        if (!view)
+        {
+            CloseHandle(mapping);
+            throw std::runtime_error("Failed to map sample scratch file");
+        }
+        segment.samples = static_cast<float *>(view);
+        segment.mappingHandle = mapping;
+#else
+        // The segment's disk space is reserved up front: a sparse file on a
+        // full disk would only fail when a slot is first written through
+        // the mapping, with SIGBUS rather than an error.
+        const int fd = static_cast<int>(fileHandle);
+#if defined(__APPLE__)
+        fstore_t reservation{};
+        reservation.fst_flags = F_ALLOCATEALL;
+        reservation.fst_posmode = F_PEOFPOSMODE;
+        reservation.fst_offset = 0;
+        reservation.fst_length = static_cast<off_t>(kSegmentBytes);
+        if (::fcntl(fd, F_PREALLOCATE, &reservation) == -1 ||
+            ::ftruncate(fd, static_cast<off_t>(newFileSize)) != 0)
+#else
+        if (::posix_fallocate(
+                fd, static_cast<off_t>(segmentIndex * kSegmentBytes),
+                static_cast<off_t>(kSegmentBytes)) != 0)
+#endif
+        {
+            throw std::runtime_error("Failed to grow sample scratch file");
+        }
+        void *view = ::mmap(nullptr, static_cast<std::size_t>(kSegmentBytes),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                            static_cast<off_t>(segmentIndex * kSegmentBytes));
+        if (view == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map sample scratch file");
+        }
+        segment.samples = static_cast<float *>(view);
+#endif
+
+        segments.push_back(segment);
+        for (int64_t slot = kSlotsPerSegment - 1; slot >= 0; --slot)
+        {
+            freeSlots.push_back(segmentIndex * kSlotsPerSegment + slot);
+        }
+    }
+
+    void SampleScratchFile::release(const int64_t slot)
+    {
+        std::lock_guard lock(mutex);
+        freeSlots.push_back(slot);
+        --usedSlotCount;
+    }
+} // namespace cupuacu::audio
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cupuacu::audio
+{
+    // Memory-mapped float storage for sample blocks that should not stay in
+    // RAM. The file is split into fixed-size slots; stored blocks are read
+    // straight from the mapping, so the OS pages them in on demand and can
+    // drop them again under memory pressure without writing anything back.
+    //
+    // The file is anonymous: it is unlinked (or marked delete-on-close on
+    // Windows) as soon as it is created and disappears with the last
+    // reference to it.
+    class SampleScratchFile
+        : public std::enable_shared_from_this<SampleScratchFile>
+    {
+    public:
+        static constexpr int64_t kSlotFrames = 65536;
+        static constexpr int64_t kSlotsPerSegment = 64;
+
+        // Throws std::runtime_error when the file cannot be created.
+        [[nodiscard]] static std::shared_ptr<SampleScratchFile>
+        create(const std::filesystem::path &directory);
+
+        ~SampleScratchFile();
+
+        SampleScratchFile(const SampleScratchFile &) = delete;
+        SampleScratchFile &operator=(const SampleScratchFile &) = delete;
+
+        // Copies count (at most kSlotFrames) samples into a free slot. The
+        // returned pointer addresses the mapped copy; the slot stays reserved
+        // until the last copy of the pointer is released.
+        [[nodiscard]] std::shared_ptr<const float> store(const float *samples,
+                                                         int64_t count);
+
+        [[nodiscard]] int64_t getSlotCount() const;
+        [[nodiscard]] int64_t getUsedSlotCount() const;
+
+    private:
+        struct Segment
+        {
+            float *samples = nullptr;
+            void *mappingHandle = nullptr;
+        };
+
+        SampleScratchFile() = default;
+
+        mutable std::mutex mutex;
+        std::filesystem::path path;
+        std::intptr_t fileHandle = -1;
+        std::vector<Segment> segments;
+        std::vector<int64_t> freeSlots;
+        int64_t usedSlotCount = 0;
+
+        float *slotAddress(int64_t slot) const;
+        void growUnlocked();
+        void release(int64_t slot);
+    };
+
+    // Upper bound for sample data a document keeps in RAM before moving
+    // blocks into its scratch file. Overridable through the
+    // CUPUACU_RESIDENT_SAMPLE_BUDGET_MB environment variable; 0 disables it.
+    inline int64_t residentSampleBudgetBytesFromEnvironment()
+    {
+        constexpr int64_t kDefaultBudgetMegabytes = 4096;
+        constexpr int64_t kBytesPerMegabyte = 1024 * 1024;
+
+        int64_t megabytes = kDefaultBudgetMegabytes;
+        if (const char *value =
+                std::getenv("CUPUACU_RESIDENT_SAMPLE_BUDGET_MB"))
+        {
+            char *end = nullptr;
+            const auto parsed = std::strtoll(value, &end, 10);
+            if (end != value && parsed >= 0)
+            {
+                megabytes = parsed;
+            }
+        }
+        return megabytes * kBytesPerMegabyte;
+    }
+} // namespace cupuacu::audio
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cupuacu::concurrency
+{
+    // A few threads that run the requests of many clients. Each client is
+    // served like a LatestWinsBackgroundWorker of its own: a new request
+    // replaces the one still waiting, cancels the one running, and only its
+    // results are published. Of the waiting requests, those with the lowest
+    // priority value run first, the longest waiting first among equals.
+    template <typename Request, typename PartialResult>
+    class PrioritizedBackgroundWorkerPool
+    {
+        struct Slot;
+        struct Shared;
+
+    public:
+        struct PublishedResult
+        {
+            std::uint64_t generation = 0;
+            PartialResult result{};
+        };
+
+        using CancelCheck = std::function<bool()>;
+        using PublishFn = std::function<void(PartialResult)>;
+        using ProcessFn =
+            std::function<void(const Request &, std::uint64_t,
+                               const CancelCheck &, const PublishFn &)>;
+
+        // Where one component submits its requests and takes its results.
+        // Closing it cancels its work. It may outlive the pool, after which
+        // its requests are dropped.
+        class Client
+        {
+        public:
+            Client() = default;
+
+            Client(Client &&other) noexcept = default;
+
+            Client &operator=(Client &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    close();
+                    shared = std::move(other.shared);
+                    slot = std::move(other.slot);
+                }
+                return *this;
+            }
+
+            Client(const Client &) = delete;
+            Client &operator=(const Client &) = delete;
+
+            ~Client()
+            {
+                close();
+            }
+
+            [[nodiscard]] bool isConnected() const
+            {
+                return slot != nullptr;
+            }
+
+            // Returns 0 if the client is not connected.
+            [[nodiscard]] std::uint64_t submit(Request request,
+                                               const int priority)
+            {
+                if (!slot)
+                {
+                    return 0;
+                }
+
+                std::uint64_t generation = 0;
+                {
+                    std::lock_guard lock(shared->mutex);
+                    generation = ++slot->latestRequestedGeneration;
+                    if (shared->stopRequested)
+                    {
+                        return generation;
+                    }
+                    slot->pendingRequest = std::move(request);
+                    slot->priority = priority;
+                    slot->submissionOrder = ++shared->submissionCount;
+                }
+                shared->cv.notify_one();
+                return generation;
+            }
+
+            [[nodiscard]] std::uint64_t latestGeneration() const
+            {
+                if (!slot)
+                {
+                    return 0;
+                }
+                std::lock_guard lock(shared->mutex);
+                return slot->latestRequestedGeneration;
+            }
+
+            [[nodiscard]] std::vector<PublishedResult> takePublished()
+            {
+                std::vector<PublishedResult> drained;
+                if (!slot)
+                {
+                    return drained;
+                }
+                std::lock_guard lock(shared->mutex);
+                drained.reserve(slot->published.size());
+                while (!slot->published.empty())
+                {
+                    drained.push_back(std::move(slot->published.front()));
+                    slot->published.pop_front();
+                }
+                return drained;
+            }
+
+            void close()
+            {
+                if (!slot)
+                {
+                    return;
+                }
+                {
+                    std::lock_guard lock(shared->mutex);
+                    slot->closed = true;
+                    slot->pendingRequest.reset();
+                    slot->published.clear();
+                    std::erase(shared->slots, slot);
+                }
+                slot.reset();
+                shared.reset();
+            }
+
+        private:
+            friend class PrioritizedBackgroundWorkerPool;
+
+            Client(std::shared_ptr<Shared> sharedToUse,
+                   std::shared_ptr<Slot> slotToUse)
+                : shared(std::move(sharedToUse)), slot(std::move(slotToUse))
+            {
+            }
+
+            std::shared_ptr<Shared> shared;
+            std::shared_ptr<Slot> slot;
+        };
+
+        PrioritizedBackgroundWorkerPool(ProcessFn processToUse,
+                                        const std::size_t threadCount)
+            : shared(std::make_shared<Shared>())
+        {
+            shared->process = std::move(processToUse);
+            for (std::size_t i = 0; i < std::max<std::size_t>(1, threadCount);
+                 ++i)
+            {
+                workers.emplace_back([sharedToUse = shared]
+                                     { run(*sharedToUse); });
+            }
+        }
+
+        ~PrioritizedBackgroundWorkerPool()
+        {
+            {
+                std::lock_guard lock(shared->mutex);
+                shared->stopRequested = true;
+                for (const auto &slot : shared->slots)
+                {
+                    slot->pendingRequest.reset();
+                }
+            }
+            shared->cv.notify_all();
+            for (auto &worker : workers)
+            {
+                if (worker.joinable())
+                {
+                    worker.join();
+                }
+            }
+        }
+
+        PrioritizedBackgroundWorkerPool(
+            const PrioritizedBackgroundWorkerPool &) = delete;
+        PrioritizedBackgroundWorkerPool &
+        operator=(const PrioritizedBackgroundWorkerPool &) = delete;
+
+        [[nodiscard]] Client connect()
+        {
+            auto slot = std::make_shared<Slot>();
+            {
+                std::lock_guard lock(shared->mutex);
+                shared->slots.push_back(slot);
+            }
+            return Client(shared, std::move(slot));
+        }
+
+        [[nodiscard]] std::size_t getThreadCount() const
+        {
+            return workers.size();
+        }
+
+    private:
+        struct Slot
+        {
+            std::uint64_t latestRequestedGeneration = 0;
+            std::optional<Request> pendingRequest;
+            int priority = 0;
+            std::uint64_t submissionOrder = 0;
+            bool closed = false;
+            std::deque<PublishedResult> published;
+        };
+
+        struct Shared
+        {
+            ProcessFn process;
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool stopRequested = false;
+            std::uint64_t submissionCount = 0;
+            std::vector<std::shared_ptr<Slot>> slots;
+        };
+
+        // Call with shared.mutex held.
+        static std::shared_ptr<Slot> findMostUrgent(const Shared &shared)
+        {
+            std::shared_ptr<Slot> mostUrgent;
+            for (const auto &slot : shared.slots)
+            {
+                if (!slot->pendingRequest.has_value())
+                {
+                    continue;
+                }
+                if (!mostUrgent || slot->priority < mostUrgent->priority ||
+                    (slot->priority == mostUrgent->priority &&
+                     slot->submissionOrder < mostUrgent->submissionOrder))
+                {
+                    mostUrgent = slot;
+                }
+            }
+            return mostUrgent;
+        }
+
+        static void run(Shared &shared)
+        {
+            while (true)
+            {
+                std::shared_ptr<Slot> slot;
+                Request request;
+                std::uint64_t generation = 0;
+                {
+                    std::unique_lock lock(shared.mutex);
+                    shared.cv.wait(lock,
+                                   [&]
+                                   {
+                                       if (shared.stopRequested)
+                                       {
+                                           return true;
+                                       }
+                                       slot = findMostUrgent(shared);
+                                       return slot != nullptr;
+                                   });
+                    if (shared.stopRequested)
+                    {
+                        return;
+                    }
+                    request = std::move(*slot->pendingRequest);
+                    slot->pendingRequest.reset();
+                    generation = slot->latestRequestedGeneration;
+                }
+
+                const auto isStale = [&shared, &slot, generation]
+                {
+                    return shared.stopRequested || slot->closed ||
+                           generation != slot->latestRequestedGeneration;
+                };
+                const CancelCheck isCanceled = [&shared, &isStale]()
+                {
+                    std::lock_guard lock(shared.mutex);
+                    return isStale();
+                };
+                const PublishFn publish =
+                    [&shared, &slot, &isStale, generation](PartialResult result)
+                {
+                    std::lock_guard lock(shared.mutex);
+                    if (isStale())
+                    {
+                        return;
+                    }
+                    slot->published.push_back(
+                        PublishedResult{generation, std::move(result)});
+                };
+
+                shared.process(request, generation, isCanceled, publish);
+            }
+        }
+
+        std::shared_ptr<Shared> shared;
+        std::vector<std::thread> workers;
+    };
+} // namespace cupuacu::concurrency
@@ -311,6 +311,7 @@ namespace cupuacu::effects
               pendingNewSamples(std::move(newSamplesToUse)),
               tabIndex(tabIndexToUse)
         {
+            newSamplesReplayable = false;
             updateGui = [this]
             {
                 if (!state || state->activeTabIndex != tabIndex)
@@ -358,14 +359,16 @@ namespace cupuacu::effects
                 return;
             }
 
-            oldSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, oldSamplesHandle,
-                                          pendingOldSamples,
-                                          "amplify-envelope-old");
-            pendingOldSamples.reset();
-            applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
-                *session, pendingNewSamples, newSamplesHandle,
-                "amplify-envelope-new"));
+            applySamples(cupuacu::actions::audio::detail::
+                             materializeReplayableSampleMatrix(
+                                 *session, pendingOldSamples, oldSamplesHandle,
+                                 "amplify-envelope-old", pendingNewSamples,
+                                 newSamplesHandle, "amplify-envelope-new",
+                                 newSamplesReplayable,
+                                 [this](auto &samples)
+                                 {
+                                     renderNewSamples(samples);
+                                 }));
         }
 
         void undo() override
@@ -376,11 +379,9 @@ namespace cupuacu::effects
                 return;
             }
 
-            newSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, newSamplesHandle,
-                                          pendingNewSamples,
-                                          "amplify-envelope-new");
-            pendingNewSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                *session, pendingNewSamples, newSamplesHandle,
+                "amplify-envelope-new", newSamplesReplayable);
             applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
                 *session, pendingOldSamples, oldSamplesHandle,
                 "amplify-envelope-old"));
@@ -398,7 +399,8 @@ namespace cupuacu::effects
 
         [[nodiscard]] bool canPersistForRestart() const override
         {
-            return !oldSamplesHandle.empty() && !newSamplesHandle.empty();
+            return !oldSamplesHandle.empty() &&
+                   (newSamplesReplayable || !newSamplesHandle.empty());
         }
 
         [[nodiscard]] std::optional<nlohmann::json>
@@ -457,6 +459,32 @@ namespace cupuacu::effects
             return targetChannels;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {oldSamplesHandle, newSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingOldSamples) +
+                   cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingNewSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            oldSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleMatrixIfNeeded(session, oldSamplesHandle,
+                                          std::move(pendingOldSamples),
+                                          "amplify-envelope-old");
+            pendingOldSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                session, pendingNewSamples, newSamplesHandle,
+                "amplify-envelope-new", newSamplesReplayable);
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleMatrixHandle &
         getOldSamplesHandle() const
         {
@@ -486,6 +514,9 @@ namespace cupuacu::effects
             pendingNewSamples;
         undo::UndoStore::SampleMatrixHandle oldSamplesHandle;
         undo::UndoStore::SampleMatrixHandle newSamplesHandle;
+        // False when the new samples were handed in rather than computed
+        // here, so they have to be kept.
+        bool newSamplesReplayable = true;
         int tabIndex = -1;
 
         double gainForFrame(const int64_t frameIndex) const
@@ -551,6 +582,24 @@ namespace cupuacu::effects
             pendingNewSamples = std::move(newSamples);
         }
 
+        void renderNewSamples(
+            cupuacu::actions::audio::detail::SampleMatrix &samples) const
+        {
+            for (std::size_t frame = 0;
+                 frame < static_cast<std::size_t>(frameCount); ++frame)
+            {
+                const double gain = gainForFrame(static_cast<int64_t>(frame));
+                for (auto &channel : samples)
+                {
+                    if (frame < channel.size())
+                    {
+                        channel[frame] =
+                            static_cast<float>(channel[frame] * gain);
+                    }
+                }
+            }
+        }
+
         [[nodiscard]] cupuacu::DocumentSession *sessionForTab() const
         {
             if (!state)
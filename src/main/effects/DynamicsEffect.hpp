@@ -65,6 +65,7 @@ namespace cupuacu::effects
               pendingNewSamples(std::move(newSamplesToUse)),
               tabIndex(tabIndexToUse)
         {
+            newSamplesReplayable = false;
             updateGui = [this]
             {
                 if (!state || state->activeTabIndex != tabIndex)
@@ -111,12 +112,16 @@ namespace cupuacu::effects
                 return;
             }
 
-            oldSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, oldSamplesHandle,
-                                          pendingOldSamples, "dynamics-old");
-            pendingOldSamples.reset();
-            applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
-                *session, pendingNewSamples, newSamplesHandle, "dynamics-new"));
+            applySamples(cupuacu::actions::audio::detail::
+                             materializeReplayableSampleMatrix(
+                                 *session, pendingOldSamples, oldSamplesHandle,
+                                 "dynamics-old", pendingNewSamples,
+                                 newSamplesHandle, "dynamics-new",
+                                 newSamplesReplayable,
+                                 [this](auto &samples)
+                                 {
+                                     renderNewSamples(samples);
+                                 }));
         }
 
         void undo() override
@@ -127,10 +132,9 @@ namespace cupuacu::effects
                 return;
             }
 
-            newSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, newSamplesHandle,
-                                          pendingNewSamples, "dynamics-new");
-            pendingNewSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                *session, pendingNewSamples, newSamplesHandle,
+                "dynamics-new", newSamplesReplayable);
             applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
                 *session, pendingOldSamples, oldSamplesHandle, "dynamics-old"));
         }
@@ -147,7 +151,8 @@ namespace cupuacu::effects
 
         [[nodiscard]] bool canPersistForRestart() const override
         {
-            return !oldSamplesHandle.empty() && !newSamplesHandle.empty();
+            return !oldSamplesHandle.empty() &&
+                   (newSamplesReplayable || !newSamplesHandle.empty());
         }
 
         [[nodiscard]] std::optional<nlohmann::json>
@@ -241,6 +246,32 @@ namespace cupuacu::effects
             return targetChannels;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {oldSamplesHandle, newSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingOldSamples) +
+                   cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingNewSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            oldSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleMatrixIfNeeded(session, oldSamplesHandle,
+                                          std::move(pendingOldSamples),
+                                          "dynamics-old");
+            pendingOldSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                session, pendingNewSamples, newSamplesHandle,
+                "dynamics-new", newSamplesReplayable);
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleMatrixHandle &
         getOldSamplesHandle() const
         {
@@ -264,6 +295,9 @@ namespace cupuacu::effects
             pendingNewSamples;
         undo::UndoStore::SampleMatrixHandle oldSamplesHandle;
         undo::UndoStore::SampleMatrixHandle newSamplesHandle;
+        // False when the new samples were handed in rather than computed
+        // here, so they have to be kept.
+        bool newSamplesReplayable = true;
         int tabIndex = -1;
 
         void captureTargetsAndSamples()
@@ -317,6 +351,18 @@ namespace cupuacu::effects
             pendingNewSamples = std::move(newSamples);
         }
 
+        void renderNewSamples(
+            cupuacu::actions::audio::detail::SampleMatrix &samples) const
+        {
+            for (auto &channel : samples)
+            {
+                for (auto &sample : channel)
+                {
+                    sample = processSampleValue(settings, sample);
+                }
+            }
+        }
+
         [[nodiscard]] cupuacu::DocumentSession *sessionForTab() const
         {
             if (!state)
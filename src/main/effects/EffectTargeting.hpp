@@ -112,40 +112,55 @@ namespace cupuacu::effects
         {
             const auto &cache = session.getWaveformCache(
                 static_cast<int>(channel));
-            const auto &level0 = cache.getLevelByIndex(0);
-            if (!cache.hasDirtyBlocks() && !level0.empty())
+            const auto level0 = cache.getLevelByIndex(0);
+            if (!cache.hasDirtyBlocks() && !level0.empty() &&
+                cache.isLaidOutFor(lease.getFrameCount()))
             {
-                const int64_t firstFullBlock =
-                    (startFrame + blockSize - 1) / blockSize;
-                const int64_t lastFullBlockExclusive = endFrame / blockSize;
-                const int64_t firstFullFrame =
-                    std::min(endFrame, firstFullBlock * blockSize);
-                const int64_t lastFullFrame =
-                    std::min(endFrame, lastFullBlockExclusive * blockSize);
-
-                for (int64_t frame = startFrame; frame < firstFullFrame;
-                     ++frame)
-                {
-                    peak = std::max(
-                        peak, std::fabs(lease.getSample(channel, frame)));
-                }
-                for (int64_t block = firstFullBlock;
-                     block < lastFullBlockExclusive &&
-                     block < static_cast<int64_t>(level0.size());
-                     ++block)
-                {
-                    const auto &cachedPeak =
-                        level0[static_cast<std::size_t>(block)];
-                    peak = std::max(
-                        peak, std::max(std::fabs(cachedPeak.min),
-                                       std::fabs(cachedPeak.max)));
-                }
-                for (int64_t frame = std::max(firstFullFrame, lastFullFrame);
-                     frame < endFrame; ++frame)
-                {
-                    peak = std::max(
-                        peak, std::fabs(lease.getSample(channel, frame)));
-                }
+                // Blocks are looked up run by run, each run of frames having
+                // its own offset into the cache's grid.
+                cache.getFrameLayout().forEachRun(
+                    startFrame, endFrame,
+                    [&](const int64_t runStart, const int64_t runEnd,
+                        const int64_t runGridStart)
+                    {
+                        const int64_t gridOffset = runGridStart - runStart;
+                        const int64_t firstFullBlock =
+                            (runGridStart + blockSize - 1) / blockSize;
+                        const int64_t lastFullBlockExclusive =
+                            (runEnd + gridOffset) / blockSize;
+                        const int64_t firstFullFrame = std::min(
+                            runEnd, firstFullBlock * blockSize - gridOffset);
+                        const int64_t lastFullFrame = std::min(
+                            runEnd,
+                            lastFullBlockExclusive * blockSize - gridOffset);
+
+                        for (int64_t frame = runStart; frame < firstFullFrame;
+                             ++frame)
+                        {
+                            peak = std::max(
+                                peak,
+                                std::fabs(lease.getSample(channel, frame)));
+                        }
+                        for (int64_t block = firstFullBlock;
+                             block < lastFullBlockExclusive &&
+                             block < static_cast<int64_t>(level0.size());
+                             ++block)
+                        {
+                            const auto &cachedPeak =
+                                level0[static_cast<std::size_t>(block)];
+                            peak = std::max(
+                                peak, std::max(std::fabs(cachedPeak.min),
+                                               std::fabs(cachedPeak.max)));
+                        }
+                        for (int64_t frame =
+                                 std::max(firstFullFrame, lastFullFrame);
+                             frame < runEnd; ++frame)
+                        {
+                            peak = std::max(
+                                peak,
+                                std::fabs(lease.getSample(channel, frame)));
+                        }
+                    });
                 continue;
             }
 
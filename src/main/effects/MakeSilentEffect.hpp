@@ -73,7 +73,7 @@ namespace cupuacu::effects
 
             try
             {
-                const auto original =
+                auto original =
                     cupuacu::actions::audio::detail::captureOrLoadSegment(
                         session, originalHandle,
                         [&]
@@ -114,7 +114,7 @@ namespace cupuacu::effects
                 {
                     originalHandle =
                         cupuacu::actions::audio::detail::storeSegmentIfNeeded(
-                            session, originalHandle, original,
+                            session, originalHandle, std::move(original),
                             "make-silent-original");
                 }
 
@@ -216,6 +216,12 @@ namespace cupuacu::effects
             };
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {originalHandle};
+        }
+
         [[nodiscard]] cupuacu::file::OverwritePreservationMutation
         overwritePreservationMutation() const override
         {
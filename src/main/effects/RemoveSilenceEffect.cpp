@@ -122,10 +122,12 @@ namespace
             return;
         }
 
-        auto &document = state->getActiveDocumentSession().document;
+        const auto &session = state->getActiveDocumentSession();
+        const auto &document = session.document;
         const auto channels = getTargetChannels(state);
         const double absolute = computeAutoSilenceThresholdAbsolute(
-            document, channels, startFrame, frameCount);
+            document, channels, startFrame, frameCount,
+            &session.waveformCaches);
         settings.thresholdDb = thresholdDbFromAbsolute(absolute);
         settings.thresholdSampleValue = thresholdSampleValueFromAbsolute(
             document.getSampleFormat(), absolute);
@@ -289,7 +291,7 @@ namespace
                                          state->effectSettings.removeSilence),
                 removeSilenceModeFromIndex(
                     state->effectSettings.removeSilence.modeIndex),
-                state->effectSettings.removeSilence);
+                state->effectSettings.removeSilence, &session.waveformCaches);
 
             cachedChannelColumns.clear();
             for (std::size_t laneIndex = 0;
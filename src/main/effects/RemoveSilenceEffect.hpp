@@ -16,6 +16,8 @@
 #include "gui/TextInput.hpp"
 #include "gui/Window.hpp"
 #include "gui/Waveform.hpp"
+#include "gui/WaveformCache.hpp"
+#include "waveform/DocumentWaveformCaches.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -230,21 +232,176 @@ namespace cupuacu::effects
                                                 settings.thresholdSampleValue);
     }
 
-    inline double measureFrameMagnitude(const cupuacu::Document &document,
-                                        const std::vector<int64_t> &channels,
-                                        const int64_t frame)
+    // Frames are measured in chunks of this size so the silence scans read
+    // whole spans per channel instead of locking the document per sample.
+    inline constexpr int64_t kSilenceScanChunkFrames = 65536;
+
+    // Fills magnitudes with the peak absolute value across channels for each
+    // frame of [startFrame, startFrame + frameCount). Works on a Document or
+    // a Document::ReadLease.
+    template <typename SampleSource>
+    void measureFrameMagnitudes(const SampleSource &source,
+                                const std::vector<int64_t> &channels,
+                                const int64_t startFrame,
+                                const int64_t frameCount,
+                                std::vector<float> &channelScratch,
+                                std::vector<double> &magnitudes)
     {
-        double magnitude = 0.0;
+        const auto count = static_cast<std::size_t>(std::max<int64_t>(0, frameCount));
+        magnitudes.assign(count, 0.0);
+        channelScratch.resize(count);
+        for (const int64_t channel : channels)
+        {
+            std::fill(channelScratch.begin(), channelScratch.end(), 0.0f);
+            source.readFrames(channel, startFrame, channelScratch.data(),
+                              frameCount);
+            for (std::size_t frame = 0; frame < count; ++frame)
+            {
+                magnitudes[frame] =
+                    std::max(magnitudes[frame],
+                             static_cast<double>(std::fabs(channelScratch[frame])));
+            }
+        }
+    }
+
+    // The waveform caches of channels, if each of them is laid out for the
+    // document as it is. Their built peaks stand in for the frames they
+    // cover; without them every frame is measured.
+    inline std::vector<const gui::WaveformCache *> waveformCachesForChannels(
+        const cupuacu::Document &document,
+        const waveform::DocumentWaveformCaches *waveformCaches,
+        const std::vector<int64_t> &channels)
+    {
+        std::vector<const gui::WaveformCache *> caches;
+        if (!waveformCaches)
+        {
+            return caches;
+        }
+
         for (const int64_t channel : channels)
         {
-            magnitude = std::max(
-                magnitude,
-                static_cast<double>(
-                    std::fabs(document.getSample(channel, frame))));
+            if (channel < 0 || channel >= waveformCaches->getCacheCount())
+            {
+                return {};
+            }
+            const auto &cache =
+                waveformCaches->getCache(static_cast<int>(channel));
+            if (!cache.isLaidOutFor(document.getFrameCount()))
+            {
+                return {};
+            }
+            caches.push_back(&cache);
+        }
+        return caches;
+    }
+
+    // The peak absolute value across channels of frames
+    // [startFrame, endFrame), with caches from waveformCachesForChannels().
+    // Works on a Document or a Document::ReadLease.
+    template <typename SampleSource>
+    double measureRangeMagnitude(
+        const SampleSource &source,
+        const std::vector<const gui::WaveformCache *> &caches,
+        const std::vector<int64_t> &channels, const int64_t startFrame,
+        const int64_t endFrame, std::vector<float> &channelScratch)
+    {
+        double magnitude = 0.0;
+        for (std::size_t i = 0; i < caches.size(); ++i)
+        {
+            const auto statistics = caches[i]->getRangeStatistics(
+                startFrame, endFrame,
+                [&](const int64_t frameStart, const int64_t frameCount)
+                {
+                    channelScratch.assign(
+                        static_cast<std::size_t>(frameCount), 0.0f);
+                    source.readFrames(channels[i], frameStart,
+                                      channelScratch.data(), frameCount);
+                    return static_cast<const float *>(channelScratch.data());
+                });
+            magnitude = std::max(magnitude,
+                                 static_cast<double>(statistics.magnitude()));
         }
         return magnitude;
     }
 
+    // Collects the runs of at least minFrames silent frames from frames
+    // reported in order.
+    class SilentRunCollector
+    {
+    public:
+        explicit SilentRunCollector(const int64_t minFramesToUse)
+            : minFrames(minFramesToUse)
+        {
+        }
+
+        // Frames from frame on are silent, up to the next loud one.
+        void addSilentFrames(const int64_t frame)
+        {
+            if (!inRun)
+            {
+                inRun = true;
+                runStart = frame;
+            }
+        }
+
+        void addLoudFrame(const int64_t frame)
+        {
+            if (inRun)
+            {
+                finishRun(frame);
+            }
+        }
+
+        void addFrames(const int64_t startFrame,
+                       const std::vector<double> &magnitudes,
+                       const double thresholdAbsolute)
+        {
+            for (std::size_t offset = 0; offset < magnitudes.size(); ++offset)
+            {
+                const int64_t frame =
+                    startFrame + static_cast<int64_t>(offset);
+                if (magnitudes[offset] <= thresholdAbsolute)
+                {
+                    addSilentFrames(frame);
+                }
+                else
+                {
+                    addLoudFrame(frame);
+                }
+            }
+        }
+
+        std::vector<SilenceRange> finish(const int64_t endFrame)
+        {
+            if (inRun)
+            {
+                finishRun(endFrame);
+            }
+            return std::move(runs);
+        }
+
+    private:
+        void finishRun(const int64_t endFrame)
+        {
+            const int64_t runLength = endFrame - runStart;
+            if (runLength >= minFrames)
+            {
+                runs.push_back({.startFrame = runStart, .frameCount = runLength});
+            }
+            inRun = false;
+        }
+
+        int64_t minFrames = 1;
+        bool inRun = false;
+        int64_t runStart = 0;
+        std::vector<SilenceRange> runs;
+    };
+
+    // Waveform-cached windows that are not silent as a whole are halved
+    // down to this size before their frames are measured one by one.
+    inline constexpr int64_t kSilenceProbeFrames =
+        gui::WaveformCache::BASE_BLOCK_SIZE;
+
     inline int64_t minimumSilenceFrames(const cupuacu::Document &document,
                                         const RemoveSilenceSettings &settings)
     {
@@ -260,63 +417,117 @@ namespace cupuacu::effects
         return std::max<int64_t>(1, static_cast<int64_t>(std::ceil(frames)));
     }
 
-    inline std::vector<SilenceRange> detectSilentRanges(
-        const cupuacu::Document &document, const std::vector<int64_t> &channels,
-        const int64_t startFrame, const int64_t frameCount,
-        const double thresholdAbsolute, const RemoveSilenceSettings &settings)
+    // The runs of at least minFrames frames of
+    // [startFrame, startFrame + frameCount) whose samples are all within
+    // thresholdAbsolute. caches, from waveformCachesForChannels(), may be
+    // empty; they only narrow down where silence is looked for, as the
+    // frames of every run are read before it is returned. Works on a
+    // Document or a Document::ReadLease.
+    template <typename SampleSource>
+    std::vector<SilenceRange>
+    findSilentRuns(const SampleSource &source,
+                   const std::vector<int64_t> &channels,
+                   const int64_t startFrame, const int64_t frameCount,
+                   const double thresholdAbsolute, const int64_t minFrames,
+                   const std::vector<const gui::WaveformCache *> &caches)
     {
-        std::vector<SilenceRange> runs;
         if (frameCount <= 0 || channels.empty())
         {
-            return runs;
+            return {};
         }
 
-        bool inRun = false;
-        int64_t runStart = startFrame;
         const int64_t endFrame = startFrame + frameCount;
-        const int64_t minFrames = minimumSilenceFrames(document, settings);
-        for (int64_t frame = startFrame; frame < endFrame; ++frame)
+        SilentRunCollector collector(minFrames);
+        std::vector<float> channelScratch;
+        std::vector<double> magnitudes;
+        const auto measureFrames = [&](SilentRunCollector &target,
+                                       const int64_t from, const int64_t to)
+        {
+            for (int64_t chunkStart = from; chunkStart < to;
+                 chunkStart += kSilenceScanChunkFrames)
+            {
+                const int64_t chunkFrames =
+                    std::min(kSilenceScanChunkFrames, to - chunkStart);
+                measureFrameMagnitudes(source, channels, chunkStart,
+                                       chunkFrames, channelScratch, magnitudes);
+                target.addFrames(chunkStart, magnitudes, thresholdAbsolute);
+            }
+        };
+
+        if (caches.empty())
         {
-            const bool isSilent =
-                measureFrameMagnitude(document, channels, frame) <= thresholdAbsolute;
-            if (isSilent && !inRun)
+            measureFrames(collector, startFrame, endFrame);
+            return collector.finish(endFrame);
+        }
+
+        // Windows aligned to kSilenceScanChunkFrames are measured from the
+        // caches, and halved around the frames that are not silent, so long
+        // silences and loud stretches cost a few cache lookups each.
+        const auto probe = [&](const auto &self, const int64_t windowStart,
+                               const int64_t windowFrames) -> void
+        {
+            const int64_t from = std::max(windowStart, startFrame);
+            const int64_t to = std::min(windowStart + windowFrames, endFrame);
+            if (from >= to)
             {
-                inRun = true;
-                runStart = frame;
+                return;
             }
-            else if (!isSilent && inRun)
+            if (measureRangeMagnitude(source, caches, channels, from, to,
+                                      channelScratch) <= thresholdAbsolute)
             {
-                const int64_t runLength = frame - runStart;
-                if (runLength >= minFrames)
-                {
-                    runs.push_back(
-                        {.startFrame = runStart, .frameCount = runLength});
-                }
-                inRun = false;
+                collector.addSilentFrames(from);
+                return;
             }
+            if (windowFrames <= kSilenceProbeFrames)
+            {
+                measureFrames(collector, from, to);
+                return;
+            }
+            self(self, windowStart, windowFrames / 2);
+            self(self, windowStart + windowFrames / 2, windowFrames / 2);
+        };
+        for (int64_t windowStart = startFrame / kSilenceScanChunkFrames *
+                                   kSilenceScanChunkFrames;
+             windowStart < endFrame; windowStart += kSilenceScanChunkFrames)
+        {
+            probe(probe, windowStart, kSilenceScanChunkFrames);
         }
 
-        if (inRun)
+        // A cache loaded from disk was matched to the document by a sample
+        // of its content, so it may hold the peaks of other audio. Silence
+        // is deleted, so each run is measured before it is trusted.
+        SilentRunCollector verified(minFrames);
+        for (const auto &run : collector.finish(endFrame))
         {
-            const int64_t runLength = endFrame - runStart;
-            if (runLength >= minFrames)
-            {
-                runs.push_back(
-                    {.startFrame = runStart, .frameCount = runLength});
-            }
+            const int64_t runEnd = run.startFrame + run.frameCount;
+            measureFrames(verified, run.startFrame, runEnd);
+            verified.addLoudFrame(runEnd);
         }
+        return verified.finish(endFrame);
+    }
 
-        return runs;
+    inline std::vector<SilenceRange> detectSilentRanges(
+        const cupuacu::Document &document, const std::vector<int64_t> &channels,
+        const int64_t startFrame, const int64_t frameCount,
+        const double thresholdAbsolute, const RemoveSilenceSettings &settings,
+        const waveform::DocumentWaveformCaches *waveformCaches = nullptr)
+    {
+        return findSilentRuns(
+            document, channels, startFrame, frameCount, thresholdAbsolute,
+            minimumSilenceFrames(document, settings),
+            waveformCachesForChannels(document, waveformCaches, channels));
     }
 
     inline std::vector<SilenceRange> planSilenceRemoval(
         const cupuacu::Document &document, const std::vector<int64_t> &channels,
         const int64_t startFrame, const int64_t frameCount,
         const double thresholdAbsolute, const RemoveSilenceMode mode,
-        const RemoveSilenceSettings &settings)
+        const RemoveSilenceSettings &settings,
+        const waveform::DocumentWaveformCaches *waveformCaches = nullptr)
     {
         auto runs = detectSilentRanges(document, channels, startFrame, frameCount,
-                                       thresholdAbsolute, settings);
+                                       thresholdAbsolute, settings,
+                                       waveformCaches);
         if (mode == RemoveSilenceMode::AllSilencesInSection || runs.empty())
         {
             return runs;
@@ -344,7 +555,8 @@ namespace cupuacu::effects
 
     inline double computeAutoSilenceThresholdAbsolute(
         const cupuacu::Document &document, const std::vector<int64_t> &channels,
-        const int64_t startFrame, const int64_t frameCount)
+        const int64_t startFrame, const int64_t frameCount,
+        const waveform::DocumentWaveformCaches *waveformCaches = nullptr)
     {
         if (frameCount <= 0 || channels.empty())
         {
@@ -352,18 +564,43 @@ namespace cupuacu::effects
         }
 
         const int64_t blockSize = std::clamp<int64_t>(frameCount / 256, 64, 4096);
+        const int64_t endFrame = startFrame + frameCount;
+        // A whole number of peak blocks per chunk keeps block boundaries
+        // independent of the chunking.
+        const int64_t chunkFrames =
+            std::max<int64_t>(1, kSilenceScanChunkFrames / blockSize) * blockSize;
         std::vector<double> blockPeaks;
-        for (int64_t blockStart = startFrame; blockStart < startFrame + frameCount;
-             blockStart += blockSize)
-        {
-            const int64_t blockEnd =
-                std::min(startFrame + frameCount, blockStart + blockSize);
-            double peak = 0.0;
-            for (int64_t frame = blockStart; frame < blockEnd; ++frame)
+        std::vector<float> channelScratch;
+        std::vector<double> magnitudes;
+        const auto caches =
+            waveformCachesForChannels(document, waveformCaches, channels);
+        for (int64_t blockStart = startFrame;
+             !caches.empty() && blockStart < endFrame; blockStart += blockSize)
+        {
+            blockPeaks.push_back(measureRangeMagnitude(
+                document, caches, channels, blockStart,
+                std::min(endFrame, blockStart + blockSize), channelScratch));
+        }
+        for (int64_t chunkStart = startFrame;
+             caches.empty() && chunkStart < endFrame; chunkStart += chunkFrames)
+        {
+            const int64_t chunkEnd = std::min(endFrame, chunkStart + chunkFrames);
+            measureFrameMagnitudes(document, channels, chunkStart,
+                                   chunkEnd - chunkStart, channelScratch,
+                                   magnitudes);
+            for (int64_t blockStart = chunkStart; blockStart < chunkEnd;
+                 blockStart += blockSize)
             {
-                peak = std::max(peak, measureFrameMagnitude(document, channels, frame));
+                const int64_t blockEnd = std::min(chunkEnd, blockStart + blockSize);
+                double peak = 0.0;
+                for (int64_t frame = blockStart; frame < blockEnd; ++frame)
+                {
+                    peak = std::max(
+                        peak,
+                        magnitudes[static_cast<std::size_t>(frame - chunkStart)]);
+                }
+                blockPeaks.push_back(peak);
             }
-            blockPeaks.push_back(peak);
         }
 
         if (blockPeaks.empty())
@@ -481,7 +718,7 @@ namespace cupuacu::effects
             auto &document = session.document;
             removedSamplesHandle = cupuacu::actions::audio::detail::
                 storeSampleCubeIfNeeded(session, removedSamplesHandle,
-                                        pendingRemovedSamples,
+                                        std::move(pendingRemovedSamples),
                                         "remove-silence-removed");
             pendingRemovedSamples.reset();
             for (auto it = runs.rbegin(); it != runs.rend(); ++it)
@@ -616,6 +853,27 @@ namespace cupuacu::effects
             return runs;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {removedSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return cupuacu::actions::audio::detail::pendingSampleCubeBytes(
+                pendingRemovedSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            removedSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleCubeIfNeeded(session, removedSamplesHandle,
+                                        std::move(pendingRemovedSamples),
+                                        "remove-silence-removed");
+            pendingRemovedSamples.reset();
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleCubeHandle &
         getRemovedSamplesHandle() const
         {
@@ -697,11 +955,8 @@ namespace cupuacu::effects
                 {
                     auto &channelSamples = removedSamples[runIndex][channel];
                     channelSamples.resize(static_cast<std::size_t>(run.frameCount));
-                    for (int64_t frame = 0; frame < run.frameCount; ++frame)
-                    {
-                        channelSamples[static_cast<std::size_t>(frame)] =
-                            document.getSample(channel, run.startFrame + frame);
-                    }
+                    document.readFrames(channel, run.startFrame,
+                                        channelSamples.data(), run.frameCount);
                 }
             }
             pendingRemovedSamples = std::move(removedSamples);
@@ -795,7 +1050,7 @@ namespace cupuacu::effects
 
             oldSamplesHandle = cupuacu::actions::audio::detail::
                 storeSampleMatrixIfNeeded(*session, oldSamplesHandle,
-                                          pendingOldSamples,
+                                          std::move(pendingOldSamples),
                                           "remove-silence-compact-old");
             pendingOldSamples.reset();
             applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
@@ -813,7 +1068,7 @@ namespace cupuacu::effects
 
             newSamplesHandle = cupuacu::actions::audio::detail::
                 storeSampleMatrixIfNeeded(*session, newSamplesHandle,
-                                          pendingNewSamples,
+                                          std::move(pendingNewSamples),
                                           "remove-silence-compact-new");
             pendingNewSamples.reset();
             applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
@@ -889,6 +1144,34 @@ namespace cupuacu::effects
             return frameCount;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {oldSamplesHandle, newSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingOldSamples) +
+                   cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingNewSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            oldSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleMatrixIfNeeded(session, oldSamplesHandle,
+                                          std::move(pendingOldSamples),
+                                          "remove-silence-compact-old");
+            pendingOldSamples.reset();
+            newSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleMatrixIfNeeded(session, newSamplesHandle,
+                                          std::move(pendingNewSamples),
+                                          "remove-silence-compact-new");
+            pendingNewSamples.reset();
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleMatrixHandle &
         getOldSamplesHandle() const
         {
@@ -948,11 +1231,8 @@ namespace cupuacu::effects
                 oldChannel.resize(static_cast<std::size_t>(frameCount));
                 newChannel.assign(static_cast<std::size_t>(frameCount), 0.0f);
 
-                for (int64_t frame = 0; frame < frameCount; ++frame)
-                {
-                    oldChannel[static_cast<std::size_t>(frame)] =
-                        document.getSample(channel, startFrame + frame);
-                }
+                document.readFrames(channel, startFrame, oldChannel.data(),
+                                    frameCount);
 
                 int64_t writeFrame = 0;
                 std::size_t runIndex = 0;
@@ -55,6 +55,7 @@ namespace cupuacu::effects
               pendingNewSamples(std::move(newSamplesToUse)),
               tabIndex(tabIndexToUse)
         {
+            newSamplesReplayable = false;
             updateGui = [this]
             {
                 if (!state || state->activeTabIndex != tabIndex)
@@ -100,12 +101,16 @@ namespace cupuacu::effects
                 return;
             }
 
-            oldSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, oldSamplesHandle,
-                                          pendingOldSamples, "reverse-old");
-            pendingOldSamples.reset();
-            applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
-                *session, pendingNewSamples, newSamplesHandle, "reverse-new"));
+            applySamples(cupuacu::actions::audio::detail::
+                             materializeReplayableSampleMatrix(
+                                 *session, pendingOldSamples, oldSamplesHandle,
+                                 "reverse-old", pendingNewSamples,
+                                 newSamplesHandle, "reverse-new",
+                                 newSamplesReplayable,
+                                 [this](auto &samples)
+                                 {
+                                     renderNewSamples(samples);
+                                 }));
         }
 
         void undo() override
@@ -116,10 +121,9 @@ namespace cupuacu::effects
                 return;
             }
 
-            newSamplesHandle = cupuacu::actions::audio::detail::
-                storeSampleMatrixIfNeeded(*session, newSamplesHandle,
-                                          pendingNewSamples, "reverse-new");
-            pendingNewSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                *session, pendingNewSamples, newSamplesHandle,
+                "reverse-new", newSamplesReplayable);
             applySamples(cupuacu::actions::audio::detail::materializeSampleMatrix(
                 *session, pendingOldSamples, oldSamplesHandle, "reverse-old"));
         }
@@ -136,7 +140,8 @@ namespace cupuacu::effects
 
         [[nodiscard]] bool canPersistForRestart() const override
         {
-            return !oldSamplesHandle.empty() && !newSamplesHandle.empty();
+            return !oldSamplesHandle.empty() &&
+                   (newSamplesReplayable || !newSamplesHandle.empty());
         }
 
         [[nodiscard]] std::optional<nlohmann::json>
@@ -176,6 +181,32 @@ namespace cupuacu::effects
             return targetChannels;
         }
 
+        [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {oldSamplesHandle, newSamplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingOldSamples) +
+                   cupuacu::actions::audio::detail::pendingSampleMatrixBytes(
+                       pendingNewSamples);
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            oldSamplesHandle = cupuacu::actions::audio::detail::
+                storeSampleMatrixIfNeeded(session, oldSamplesHandle,
+                                          std::move(pendingOldSamples),
+                                          "reverse-old");
+            pendingOldSamples.reset();
+            cupuacu::actions::audio::detail::retireReplayableSampleMatrix(
+                session, pendingNewSamples, newSamplesHandle,
+                "reverse-new", newSamplesReplayable);
+        }
+
         [[nodiscard]] const undo::UndoStore::SampleMatrixHandle &
         getOldSamplesHandle() const
         {
@@ -204,6 +235,9 @@ namespace cupuacu::effects
             pendingNewSamples;
         undo::UndoStore::SampleMatrixHandle oldSamplesHandle;
         undo::UndoStore::SampleMatrixHandle newSamplesHandle;
+        // False when the new samples were handed in rather than computed
+        // here, so they have to be kept.
+        bool newSamplesReplayable = true;
         int tabIndex = -1;
 
         void captureTargetsAndSamples()
@@ -268,6 +302,15 @@ namespace cupuacu::effects
             pendingNewSamples = std::move(newSamples);
         }
 
+        void renderNewSamples(
+            cupuacu::actions::audio::detail::SampleMatrix &samples) const
+        {
+            for (auto &channel : samples)
+            {
+                std::reverse(channel.begin(), channel.end());
+            }
+        }
+
         [[nodiscard]] cupuacu::DocumentSession *sessionForTab() const
         {
             if (!state)
@@ -0,0 +1,99 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cupuacu::file
+{
+    std::shared_ptr<const MappedFile>
+    MappedFile::open(const std::filesystem::path &path)
+    {
+        std::shared_ptr<MappedFile> result(new MappedFile());
+
+#if defined(_WIN32)
+        const HANDLE handle = CreateFileW(
+            path.wstring().c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("Failed to open mapped file");
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart <= 0)
+        {
+            CloseHandle(handle);
+            throw std::runtime_error("Failed to map empty file");
+        }
+
+        const HANDLE mapping =
+            CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(handle);
+        if (!mapping)
+        {
+            throw std::runtime_error("Failed to map file");
+        }
+
+        const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(mapping);
+            throw std::runtime_error("Failed to map file");
+        }
+        result->mappingHandle = mapping;
+        result->size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open mapped file");
+        }
+
+        struct stat status = {};
+        if (::fstat(fd, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to map empty file");
+        }
+
+        const auto fileSize = static_cast<std::size_t>(status.st_size);
+        void *view = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map file");
+        }
+        result->size = fileSize;
+#endif
+
+        result->data = static_cast<const std::byte *>(view);
+        return result;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (!data)
+        {
+            return;
+        }
+
+#if defined(_WIN32)
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+#else
+        ::munmap(const_cast<std::byte *>(data), size);
+#endif
+    }
+} // namespace cupuacu::file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+namespace cupuacu::file
+{
+    // A whole file mapped read-only into memory. The OS pages its contents
+    // in as they are read and can drop them again under memory pressure.
+    //
+    // The mapping follows the file it was opened on, so files that may be
+    // mapped should be replaced by renaming a new file over them, never
+    // rewritten in place. On Windows they cannot be replaced or removed at
+    // all while mapped.
+    class MappedFile
+    {
+    public:
+        // Throws std::runtime_error when the file cannot be opened or
+        // mapped, or is empty.
+        [[nodiscard]] static std::shared_ptr<const MappedFile>
+        open(const std::filesystem::path &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        [[nodiscard]] std::span<const std::byte> bytes() const
+        {
+            return {data, size};
+        }
+
+    private:
+        MappedFile() = default;
+
+        const std::byte *data = nullptr;
+        std::size_t size = 0;
+        void *mappingHandle = nullptr;
+    };
+} // namespace cupuacu::file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../State.hpp"
+#include "../audio/FrameRangeSet.hpp"
 #include "FileIo.hpp"
 #include "PreservationWriteInput.hpp"
 #include "SampleQuantization.hpp"
@@ -13,10 +14,55 @@
 #include <fstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace cupuacu::file::preservation
 {
+    // Answers isDirty for one channel while frames are visited in ascending
+    // order, walking the channel's dirty ranges instead of looking each
+    // frame up.
+    class DirtyRangeCursor
+    {
+    public:
+        explicit DirtyRangeCursor(std::vector<cupuacu::audio::FrameRange> rangesToUse)
+            : ranges(std::move(rangesToUse))
+        {
+        }
+
+        [[nodiscard]] bool isDirty(const std::int64_t frame)
+        {
+            while (nextRange < ranges.size() &&
+                   ranges[nextRange].endFrameExclusive <= frame)
+            {
+                ++nextRange;
+            }
+            return nextRange < ranges.size() &&
+                   ranges[nextRange].startFrame <= frame;
+        }
+
+    private:
+        std::vector<cupuacu::audio::FrameRange> ranges;
+        std::size_t nextRange = 0;
+    };
+
+    template <typename DirtyRangeSource>
+    std::vector<DirtyRangeCursor>
+    makeDirtyRangeCursors(const DirtyRangeSource &source,
+                          const std::size_t channelCount,
+                          const std::size_t frames)
+    {
+        std::vector<DirtyRangeCursor> cursors;
+        cursors.reserve(channelCount);
+        for (std::size_t channel = 0; channel < channelCount; ++channel)
+        {
+            cursors.emplace_back(source.getDirtyRanges(
+                static_cast<std::int64_t>(channel), 0,
+                static_cast<std::int64_t>(frames)));
+        }
+        return cursors;
+    }
+
     inline void publishPreservationProgress(
         const cupuacu::file::PreservationProgressCallback &progress,
         const std::string &detail, const std::size_t completed,
@@ -119,46 +165,126 @@ namespace cupuacu::file::preservation
                       static_cast<std::size_t>(suffixSize), failureMessage);
     }
 
-    template <typename EncodeDirtySampleFn>
-    void patchDirtySamplesInPlace(const cupuacu::State *state, std::fstream &io,
-                                  const std::size_t sampleByteWidth,
-                                  const std::size_t channelCount,
-                                  const std::size_t sampleDataOffset,
-                                  EncodeDirtySampleFn encodeDirtySample)
+    // Rewrites the samples in the dirty ranges of an interleaved PCM file in
+    // place. Frames dirty in any channel are patched together, up to
+    // kPatchChunkFrames at a time: the chunk's bytes are read once (other
+    // channels' samples in it may be clean), the dirty samples are encoded
+    // over them and the chunk goes back with one seek and one write.
+    // readFrames(channel, startFrame, destination, frameCount) reads the
+    // document's samples; onChunk(endFrame) follows each written chunk.
+    template <typename ReadFramesFn, typename EncodeDirtySampleFn,
+              typename OnChunkFn>
+    void patchDirtyFrameRanges(
+        const std::vector<std::vector<cupuacu::audio::FrameRange>> &dirtyRanges,
+        std::fstream &io, const std::size_t sampleByteWidth,
+        const std::size_t sampleDataOffset, ReadFramesFn readFrames,
+        EncodeDirtySampleFn encodeDirtySample, OnChunkFn onChunk)
     {
-        auto buffer = state->getActiveDocumentSession().document.getAudioBuffer();
-        const std::size_t frames = static_cast<std::size_t>(
-            state->getActiveDocumentSession().document.getFrameCount());
+        constexpr std::int64_t kPatchChunkFrames = 16384;
+        const std::size_t channelCount = dirtyRanges.size();
+        const std::size_t frameBytes = channelCount * sampleByteWidth;
+
+        cupuacu::audio::FrameRangeSet dirtyFrames;
+        std::vector<DirtyRangeCursor> dirtyCursors;
+        dirtyCursors.reserve(channelCount);
+        for (const auto &ranges : dirtyRanges)
+        {
+            for (const auto &range : ranges)
+            {
+                dirtyFrames.add(range.startFrame, range.endFrameExclusive);
+            }
+            dirtyCursors.emplace_back(ranges);
+        }
 
-        for (std::size_t frame = 0; frame < frames; ++frame)
+        std::vector<float> samples(static_cast<std::size_t>(kPatchChunkFrames));
+        std::vector<char> bytes;
+        for (const auto &range : dirtyFrames.getRanges())
         {
-            for (std::size_t channel = 0; channel < channelCount; ++channel)
+            for (std::int64_t chunkStart = range.startFrame;
+                 chunkStart < range.endFrameExclusive;
+                 chunkStart += kPatchChunkFrames)
             {
-                const auto channelIndex = static_cast<std::int64_t>(channel);
-                const auto frameIndex = static_cast<std::int64_t>(frame);
-                if (!buffer->isDirty(channelIndex, frameIndex))
+                const auto chunkFrames = std::min(
+                    kPatchChunkFrames, range.endFrameExclusive - chunkStart);
+                const auto chunkOffset = static_cast<std::streamoff>(
+                    sampleDataOffset +
+                    static_cast<std::size_t>(chunkStart) * frameBytes);
+                bytes.resize(static_cast<std::size_t>(chunkFrames) *
+                             frameBytes);
+                if (channelCount > 1)
                 {
-                    continue;
+                    io.seekg(chunkOffset, std::ios::beg);
+                    if (!io.read(bytes.data(),
+                                 static_cast<std::streamsize>(bytes.size())))
+                    {
+                        throw std::runtime_error(
+                            "Failed to read sample bytes to patch");
+                    }
                 }
 
-                const float sample = buffer->getSample(channelIndex, frameIndex);
-                const auto encoded = encodeDirtySample(sample);
-                const std::size_t sampleIndex = frame * channelCount + channel;
-                const std::size_t byteOffset =
-                    sampleDataOffset + sampleIndex * sampleByteWidth;
+                for (std::size_t channel = 0; channel < channelCount;
+                     ++channel)
+                {
+                    const auto channelIndex =
+                        static_cast<std::int64_t>(channel);
+                    readFrames(channelIndex, chunkStart, samples.data(),
+                               chunkFrames);
+                    for (std::int64_t i = 0; i < chunkFrames; ++i)
+                    {
+                        if (!dirtyCursors[channel].isDirty(chunkStart + i))
+                        {
+                            continue;
+                        }
+                        const auto encoded = encodeDirtySample(
+                            samples[static_cast<std::size_t>(i)]);
+                        std::copy_n(encoded.data(), sampleByteWidth,
+                                    bytes.data() +
+                                        static_cast<std::size_t>(i) *
+                                            frameBytes +
+                                        channel * sampleByteWidth);
+                    }
+                }
 
-                io.seekp(static_cast<std::streamoff>(byteOffset), std::ios::beg);
-                io.write(encoded.data(),
-                         static_cast<std::streamsize>(encoded.size()));
+                io.seekp(chunkOffset, std::ios::beg);
+                io.write(bytes.data(),
+                         static_cast<std::streamsize>(bytes.size()));
                 if (!io)
                 {
-                    throw std::runtime_error(
-                        "Failed to patch sample bytes");
+                    throw std::runtime_error("Failed to patch sample bytes");
                 }
+                onChunk(chunkStart + chunkFrames);
             }
         }
     }
 
+    template <typename EncodeDirtySampleFn>
+    void patchDirtySamplesInPlace(const cupuacu::State *state, std::fstream &io,
+                                  const std::size_t sampleByteWidth,
+                                  const std::size_t channelCount,
+                                  const std::size_t sampleDataOffset,
+                                  EncodeDirtySampleFn encodeDirtySample)
+    {
+        auto buffer = state->getActiveDocumentSession().document.getAudioBuffer();
+        const auto frames =
+            state->getActiveDocumentSession().document.getFrameCount();
+        std::vector<std::vector<cupuacu::audio::FrameRange>> dirtyRanges;
+        for (std::size_t channel = 0; channel < channelCount; ++channel)
+        {
+            dirtyRanges.push_back(buffer->getDirtyRanges(
+                static_cast<std::int64_t>(channel), 0, frames));
+        }
+
+        patchDirtyFrameRanges(
+            dirtyRanges, io, sampleByteWidth, sampleDataOffset,
+            [&](const std::int64_t channel, const std::int64_t startFrame,
+                float *destination, const std::int64_t frameCount)
+            {
+                buffer->readChannelFrames(channel, startFrame, destination,
+                                          frameCount);
+            },
+            encodeDirtySample, [](std::int64_t) {});
+    }
+
     template <typename EncodeDirtySampleFn>
     void patchDirtySamplesInPlace(
         const cupuacu::Document::ReadLease &document, std::fstream &io,
@@ -172,42 +298,36 @@ namespace cupuacu::file::preservation
     {
         const std::size_t frames =
             static_cast<std::size_t>(document.getFrameCount());
-        constexpr std::size_t progressStrideFrames = 16384;
+        std::vector<std::vector<cupuacu::audio::FrameRange>> dirtyRanges;
+        for (std::size_t channel = 0; channel < channelCount; ++channel)
+        {
+            dirtyRanges.push_back(document.getDirtyRanges(
+                static_cast<std::int64_t>(channel), 0,
+                static_cast<std::int64_t>(frames)));
+        }
         publishPreservationProgress(progress, progressDetail, 0, frames,
                                     progressStart, progressEnd);
 
-        for (std::size_t frame = 0; frame < frames; ++frame)
-        {
-            for (std::size_t channel = 0; channel < channelCount; ++channel)
+        // Only dirty frames are visited, so clean stretches complete
+        // instantly.
+        patchDirtyFrameRanges(
+            dirtyRanges, io, sampleByteWidth, sampleDataOffset,
+            [&](const std::int64_t channel, const std::int64_t startFrame,
+                float *destination, const std::int64_t frameCount)
             {
-                const auto channelIndex = static_cast<std::int64_t>(channel);
-                const auto frameIndex = static_cast<std::int64_t>(frame);
-                if (!document.isDirty(channelIndex, frameIndex))
-                {
-                    continue;
-                }
-
-                const float sample = document.getSample(channelIndex, frameIndex);
-                const auto encoded = encodeDirtySample(sample);
-                const std::size_t sampleIndex = frame * channelCount + channel;
-                const std::size_t byteOffset =
-                    sampleDataOffset + sampleIndex * sampleByteWidth;
-
-                io.seekp(static_cast<std::streamoff>(byteOffset), std::ios::beg);
-                io.write(encoded.data(),
-                         static_cast<std::streamsize>(encoded.size()));
-                if (!io)
-                {
-                    throw std::runtime_error("Failed to patch sample bytes");
-                }
-            }
-
-            if ((frame + 1) % progressStrideFrames == 0 || frame + 1 == frames)
+                document.readFrames(channel, startFrame, destination,
+                                    frameCount);
+            },
+            encodeDirtySample,
+            [&](const std::int64_t endFrame)
             {
-                publishPreservationProgress(progress, progressDetail, frame + 1,
-                                            frames, progressStart, progressEnd);
-            }
-        }
+                publishPreservationProgress(
+                    progress, progressDetail,
+                    static_cast<std::size_t>(endFrame), frames, progressStart,
+                    progressEnd);
+            });
+        publishPreservationProgress(progress, progressDetail, frames, frames,
+                                    progressStart, progressEnd);
     }
 
     template <typename ReadOriginalBytesFn, typename EncodeDirtySampleFn>
@@ -225,6 +345,7 @@ namespace cupuacu::file::preservation
 
         std::vector<char> encodedSamples;
         encodedSamples.reserve(frames * channelCount * sampleByteWidth);
+        auto dirtyCursors = makeDirtyRangeCursors(*buffer, channelCount, frames);
 
         for (std::size_t frame = 0; frame < frames; ++frame)
         {
@@ -235,7 +356,7 @@ namespace cupuacu::file::preservation
                 const float sample = buffer->getSample(channelIndex, frameIndex);
                 const auto provenance =
                     document.getSampleProvenance(channelIndex, frameIndex);
-                if (!buffer->isDirty(channelIndex, frameIndex) &&
+                if (!dirtyCursors[channel].isDirty(frameIndex) &&
                     provenance.sourceId == document.getPreservationSourceId() &&
                     provenance.frameIndex >= 0)
                 {
@@ -272,6 +393,7 @@ namespace cupuacu::file::preservation
 
         std::vector<char> encodedSamples;
         encodedSamples.reserve(frames * channelCount * sampleByteWidth);
+        auto dirtyCursors = makeDirtyRangeCursors(document, channelCount, frames);
         publishPreservationProgress(progress, progressDetail, 0, frames,
                                     progressStart, progressEnd);
 
@@ -284,7 +406,7 @@ namespace cupuacu::file::preservation
                 const float sample = document.getSample(channelIndex, frameIndex);
                 const auto provenance =
                     document.getSampleProvenance(channelIndex, frameIndex);
-                if (!document.isDirty(channelIndex, frameIndex) &&
+                if (!dirtyCursors[channel].isDirty(frameIndex) &&
                     provenance.sourceId == document.getPreservationSourceId() &&
                     provenance.frameIndex >= 0)
                 {
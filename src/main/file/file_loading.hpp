@@ -18,6 +18,7 @@
 #include <cctype>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <functional>
@@ -506,6 +507,58 @@ namespace cupuacu::file
             doc.markCurrentStateAsSavedSource();
             return result;
         }
+
+        // 16- and 24-bit PCM can be kept in its file width until edited,
+        // halving (or better) the memory of unedited material. Set
+        // CUPUACU_COMPACT_PCM_STORAGE=0 to always load as float.
+        static bool compactPcmStorageEnabledFromEnvironment()
+        {
+            const char *value = std::getenv("CUPUACU_COMPACT_PCM_STORAGE");
+            return !value || std::string(value) != "0";
+        }
+
+        static int compactStorageBitDepth(const SampleFormat sampleFormat)
+        {
+            switch (sampleFormat)
+            {
+                case SampleFormat::PCM_S16:
+                    return 16;
+                case SampleFormat::PCM_S24:
+                    return 24;
+                default:
+                    return 0;
+            }
+        }
+
+        // Files whose decoded samples exceed the resident budget are loaded
+        // into blocks that page out to a scratch file as they fill, so only
+        // the budget (plus what the OS keeps cached) occupies RAM.
+        static void enableOutOfCoreSamplesIfNeeded(Document &doc,
+                                                   const int channels,
+                                                   const sf_count_t frames)
+        {
+            const auto budgetBytes =
+                audio::residentSampleBudgetBytesFromEnvironment();
+            const auto decodedBytes = static_cast<int64_t>(frames) *
+                                      static_cast<int64_t>(channels) *
+                                      static_cast<int64_t>(sizeof(float));
+            if (budgetBytes <= 0 || decodedBytes <= budgetBytes)
+            {
+                return;
+            }
+
+            try
+            {
+                doc.setResidentSampleBudget(
+                    audio::SampleScratchFile::create(
+                        std::filesystem::temp_directory_path() / "Cupuacu"),
+                    budgetBytes);
+            }
+            catch (const std::exception &)
+            {
+                // Without a scratch file the document stays fully in RAM.
+            }
+        }
     } // namespace detail
 
     static LoadedAudioFile loadAudioFile(
@@ -549,12 +602,28 @@ namespace cupuacu::file
         result.exportSettings =
             inferExportSettingsForFile(path, sfinfo.format, sampleFormat);
 
+        detail::enableOutOfCoreSamplesIfNeeded(doc, channels, frames);
         doc.initialize(sampleFormat, sfinfo.samplerate, channels, frames);
 
+        // Matches ChannelBlocks::kBlockFrames so compact loads fill whole
+        // blocks.
         constexpr sf_count_t kLoadBlockFrames = 65536;
-        std::vector<float> interleaved(
-            static_cast<std::size_t>(kLoadBlockFrames) *
-            static_cast<std::size_t>(channels));
+        const int compactBitDepth =
+            detail::compactPcmStorageEnabledFromEnvironment()
+                ? detail::compactStorageBitDepth(sampleFormat)
+                : 0;
+        std::vector<float> interleaved;
+        std::vector<std::int32_t> interleavedPcm;
+        if (compactBitDepth > 0)
+        {
+            interleavedPcm.resize(static_cast<std::size_t>(kLoadBlockFrames) *
+                                  static_cast<std::size_t>(channels));
+        }
+        else
+        {
+            interleaved.resize(static_cast<std::size_t>(kLoadBlockFrames) *
+                               static_cast<std::size_t>(channels));
+        }
         sf_count_t totalFramesRead = 0;
         detail::updateLoadProgress(progress, path, 0, frames);
         while (totalFramesRead < frames)
@@ -563,7 +632,9 @@ namespace cupuacu::file
             const sf_count_t framesToRead =
                 std::min<sf_count_t>(kLoadBlockFrames, frames - totalFramesRead);
             const sf_count_t framesRead =
-                sf_readf_float(snd, interleaved.data(), framesToRead);
+                compactBitDepth > 0
+                    ? sf_readf_int(snd, interleavedPcm.data(), framesToRead)
+                    : sf_readf_float(snd, interleaved.data(), framesToRead);
             if (framesRead <= 0)
             {
                 const std::string detail = sf_strerror(snd);
@@ -572,8 +643,25 @@ namespace cupuacu::file
                                          path + ": " + detail);
             }
 
-            doc.writeInterleavedFloatBlock(totalFramesRead, interleaved.data(),
-                                           framesRead, channels, false);
+            if (compactBitDepth > 0)
+            {
+                // libsndfile returns integer samples left-justified in 32 bits.
+                const auto valueCount = static_cast<std::size_t>(framesRead) *
+                                        static_cast<std::size_t>(channels);
+                for (std::size_t i = 0; i < valueCount; ++i)
+                {
+                    interleavedPcm[i] >>= 32 - compactBitDepth;
+                }
+                doc.writeInterleavedPcmBlock(totalFramesRead,
+                                             interleavedPcm.data(), framesRead,
+                                             channels, compactBitDepth);
+            }
+            else
+            {
+                doc.writeInterleavedFloatBlock(totalFramesRead,
+                                               interleaved.data(), framesRead,
+                                               channels, false);
+            }
 
             totalFramesRead += framesRead;
             detail::updateLoadProgress(progress, path, totalFramesRead, frames);
@@ -610,10 +698,10 @@ namespace cupuacu::file
         return result;
     }
 
-    static void commitLoadedAudioFile(cupuacu::DocumentSession &session,
-                                      const std::string &path,
-                                      LoadedAudioFile loaded,
-                                      const cupuacu::Paths *paths = nullptr)
+    static void commitLoadedAudioFile(
+        cupuacu::DocumentSession &session, const std::string &path,
+        LoadedAudioFile loaded, const cupuacu::Paths *paths = nullptr,
+        const cupuacu::waveform::PersistentCacheSettings &cacheSettings = {})
     {
         session.stopWaveformCacheBuild();
         session.currentFileExportSettings = loaded.exportSettings;
@@ -646,7 +734,8 @@ namespace cupuacu::file
         }
         else if (paths)
         {
-            if (cupuacu::waveform::loadPersistentWaveformCache(session, *paths))
+            if (cupuacu::waveform::loadPersistentWaveformCache(
+                    session, *paths, cacheSettings))
             {
                 session.clearPendingPersistentWaveformCacheSave();
             }
@@ -673,7 +762,8 @@ namespace cupuacu::file
             {
                 return cupuacu::isLongTaskCancelRequested(state);
             });
-        commitLoadedAudioFile(session, path, std::move(loaded), state->paths.get());
+        commitLoadedAudioFile(session, path, std::move(loaded),
+                              state->paths.get(), state->waveformCacheSettings);
         cupuacu::file::OverwritePreservation::refreshActiveSession(state);
     }
 } // namespace cupuacu::file
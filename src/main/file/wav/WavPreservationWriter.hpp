@@ -312,8 +312,31 @@ namespace cupuacu::file::wav
                 previousOriginalSampleIndex = -1;
             };
 
+            // Samples are fetched per channel one progress stride at a time
+            // rather than one locked lookup per dirty sample.
+            std::vector<float> chunkSamples(channelCount * progressStrideFrames);
+            auto dirtyCursors =
+                cupuacu::file::preservation::makeDirtyRangeCursors(
+                    document, channelCount, frames);
+            std::size_t chunkStartFrame = 0;
             for (std::size_t frame = 0; frame < frames; ++frame)
             {
+                if (frame % progressStrideFrames == 0)
+                {
+                    chunkStartFrame = frame;
+                    const auto chunkFrames =
+                        std::min(progressStrideFrames, frames - frame);
+                    for (std::size_t channel = 0; channel < channelCount;
+                         ++channel)
+                    {
+                        document.readFrames(
+                            static_cast<std::int64_t>(channel),
+                            static_cast<std::int64_t>(frame),
+                            chunkSamples.data() + channel * progressStrideFrames,
+                            static_cast<std::int64_t>(chunkFrames));
+                    }
+                }
+
                 for (std::size_t channel = 0; channel < channelCount; ++channel)
                 {
                     const auto channelIndex = static_cast<std::int64_t>(channel);
@@ -321,7 +344,7 @@ namespace cupuacu::file::wav
                     const auto provenance =
                         document.getSampleProvenance(channelIndex, frameIndex);
                     const bool canCopyOriginal =
-                        !document.isDirty(channelIndex, frameIndex) &&
+                        !dirtyCursors[channel].isDirty(frameIndex) &&
                         provenance.sourceId == document.getPreservationSourceId() &&
                         provenance.frameIndex >= 0;
 
@@ -351,7 +374,9 @@ namespace cupuacu::file::wav
 
                     flushOriginalSpan();
 
-                    const float sample = document.getSample(channelIndex, frameIndex);
+                    const float sample =
+                        chunkSamples[channel * progressStrideFrames +
+                                     (frame - chunkStartFrame)];
                     if (document.getSampleFormat() ==
                         cupuacu::SampleFormat::FLOAT32)
                     {
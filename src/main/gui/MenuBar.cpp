@@ -333,6 +333,11 @@ MenuBar::MenuBar(State *stateToUse) : Component(stateToUse, "MenuBar")
                                          {
                                              state->undo();
                                          });
+    undoMenu->setTooltipText(
+        [&]
+        {
+            return buildUndoTooltipText(state);
+        });
     undoMenu->setAvailability(
         [&]
         {
@@ -43,6 +43,20 @@ namespace cupuacu::gui
         return "Undo" + description + menuBarPrimaryShortcut("Z");
     }
 
+    inline std::string buildUndoTooltipText(const cupuacu::State *state)
+    {
+        const auto *tab = state->getActiveTab();
+        if (!tab)
+        {
+            return "";
+        }
+        return "Undo history: " +
+               cupuacu::undo::describeUndoHistoryUsage(
+                   cupuacu::undo::measureUndoHistory(*tab),
+                   state->undoHistoryBudget) +
+               ".";
+    }
+
     inline std::string buildRedoMenuLabel(cupuacu::State *state)
     {
         auto description = state->getRedoDescription();
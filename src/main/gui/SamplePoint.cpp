@@ -63,9 +63,8 @@ bool SamplePoint::mouseUp(const MouseEvent &e)
     auto &session = state->getActiveDocumentSession();
     auto &waveformCache = session.getWaveformCache(channelIndex);
     waveformCache.invalidateSample(sampleIndex);
-    waveformCache.rebuildDirty(session.document.getAudioBuffer()
-                                   ->getImmutableChannelData(channelIndex)
-                                   .data());
+    waveformCache.rebuildDirty(
+        session.document.getAudioBuffer()->getChannelReader(channelIndex));
     state->lastRealtimeDocumentMutationAt = std::chrono::steady_clock::now();
 
     undoable.reset();
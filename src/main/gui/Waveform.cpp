@@ -4,14 +4,13 @@
 #include "WaveformBlockRenderPlanning.hpp"
 #include "WaveformOverviewPlanning.hpp"
 #include "WaveformSamplePointPlanning.hpp"
+#include "WaveformSmoothReconstruction.hpp"
 #include "WaveformSmoothRenderPlanning.hpp"
 #include "WaveformsUnderlay.hpp"
 #include "WaveformCache.hpp"
 #include "WaveformVisualState.hpp"
 #include "Window.hpp"
 
-#include "smooth_line.hpp"
-
 #include <algorithm>
 #include <cmath>
 #include <limits>
@@ -21,7 +20,16 @@ using namespace cupuacu::gui;
 
 namespace
 {
-    constexpr int kBackgroundBlockRenderChunkWidth = 64;
+    constexpr int kBackgroundTileRenderCancelCheckWidth = 64;
+    // How many tiles past each side of the view are rendered ahead.
+    constexpr int64_t kPrefetchTileDistance = 2;
+
+    uint64_t getBlockTileSizeBytes(const WaveformTileKey &key)
+    {
+        // RGBA8888.
+        return uint64_t{4} * WAVEFORM_TILE_WIDTH *
+               static_cast<uint64_t>(std::max(0, key.height));
+    }
 
     void appendColoredQuad(std::vector<SDL_Vertex> &vertices,
                            std::vector<int> &indices,
@@ -78,15 +86,17 @@ namespace
 }
 
 Waveform::Waveform(State *state, const uint8_t channelIndexToUse)
-    : Component(state, "Waveform"), channelIndex(channelIndexToUse)
+    : Component(state, "Waveform"), channelIndex(channelIndexToUse),
+      blockTiles([this](SDL_Texture *texture) { destroyTexture(texture); })
 {
-    ensureBackgroundBlockRenderWorker();
+    connectTileRenderClient();
 }
 
 Waveform::~Waveform()
 {
-    backgroundBlockRenderWorker.reset();
+    tileRenderClient.close();
     invalidateBaseTexture();
+    blockTiles.clear();
 }
 
 uint8_t Waveform::getChannelIndex() const
@@ -110,29 +120,14 @@ bool Waveform::hasRenderableChannel() const
 void Waveform::resized()
 {
     updateSamplePoints();
-
-    const auto newKey = computeBaseTextureCacheKey();
-    if (newKey.samplesPerPixel >= 1.0)
-    {
-        requestBackgroundBlockRenderPlan(
-            chooseBaseTextureTargetKey(newKey, !isWaveformCacheBuildActive()));
-    }
 }
 
+// Block tiles stay: their keys carry the version of the frames they show,
+// so tiles of edited frames are simply no longer looked up.
 void Waveform::invalidateBaseTexture() const
 {
     cachedBaseTextureValid = false;
-    cachedBaseTextureBuiltSamplePrefixEnd = -1;
-    progressiveBlockTextureRefreshPending = false;
-    requestedBackgroundBlockRenderKey.reset();
-    backgroundBlockRenderProgress.reset();
-    latestBackgroundBlockRenderGeneration = 0;
     destroyTexture(cachedBaseTexture);
-    for (auto &stored : storedBlockTextures)
-    {
-        destroyTexture(stored.texture);
-    }
-    storedBlockTextures.clear();
 }
 
 Waveform::BaseTextureCacheKey Waveform::computeBaseTextureCacheKey() const
@@ -154,92 +149,6 @@ Waveform::BaseTextureCacheKey Waveform::computeBaseTextureCacheKey() const
     return key;
 }
 
-Waveform::BaseTextureCacheKey Waveform::makeCurrentBlockTextureCoverageKey(
-    const BaseTextureCacheKey &currentViewKey) const
-{
-    const int coverageWidth =
-        std::max(currentViewKey.viewWidth * 2, currentViewKey.viewWidth + 64);
-    const int extraWidth = coverageWidth - currentViewKey.viewWidth;
-    const double extraSamples =
-        currentViewKey.samplesPerPixel * static_cast<double>(extraWidth) * 0.5;
-    const int64_t coverageSpanSamples = static_cast<int64_t>(
-        std::ceil(currentViewKey.samplesPerPixel * coverageWidth));
-    const int64_t maxCoverageOffset = std::max<int64_t>(
-        0, currentViewKey.frameCount - coverageSpanSamples);
-    const int64_t coverageOffset = std::clamp<int64_t>(
-        currentViewKey.sampleOffset -
-            static_cast<int64_t>(std::llround(extraSamples)),
-        0, maxCoverageOffset);
-
-    auto coverageKey = currentViewKey;
-    coverageKey.width = coverageWidth;
-    coverageKey.height = currentViewKey.viewHeight;
-    coverageKey.sampleOffset = coverageOffset;
-    return coverageKey;
-}
-
-Waveform::BaseTextureCacheKey Waveform::chooseBaseTextureTargetKey(
-    const BaseTextureCacheKey &newKey, const bool allowBlockCoverageReuse) const
-{
-    if (!allowBlockCoverageReuse)
-    {
-        return newKey;
-    }
-
-    auto targetKey = makeCurrentBlockTextureCoverageKey(newKey);
-    const double sourceX =
-        (static_cast<double>(newKey.sampleOffset) -
-         static_cast<double>(targetKey.sampleOffset)) /
-        newKey.samplesPerPixel;
-    const bool hasReusableCrop =
-        sourceX >= 0.0 &&
-        sourceX + static_cast<double>(newKey.viewWidth) <=
-            static_cast<double>(targetKey.width);
-    return hasReusableCrop ? targetKey : newKey;
-}
-
-bool Waveform::canRenderCurrentViewFromCachedBlockTexture(
-    const BaseTextureCacheKey &currentViewKey,
-    const BaseTextureCacheKey &sourceTextureKey, SDL_FRect &outSourceRect) const
-{
-    if (currentViewKey.samplesPerPixel < 1.0)
-    {
-        return false;
-    }
-
-    if (sourceTextureKey.viewWidth != currentViewKey.viewWidth ||
-        sourceTextureKey.viewHeight != currentViewKey.viewHeight ||
-        sourceTextureKey.height != currentViewKey.viewHeight ||
-        sourceTextureKey.frameCount != currentViewKey.frameCount ||
-        sourceTextureKey.waveformDataVersion != currentViewKey.waveformDataVersion ||
-        sourceTextureKey.pixelScale != currentViewKey.pixelScale ||
-        sourceTextureKey.samplesPerPixel != currentViewKey.samplesPerPixel ||
-        sourceTextureKey.verticalZoom != currentViewKey.verticalZoom)
-    {
-        return false;
-    }
-
-    const double sourceX =
-        (static_cast<double>(currentViewKey.sampleOffset) -
-         static_cast<double>(sourceTextureKey.sampleOffset)) /
-        currentViewKey.samplesPerPixel;
-    if (sourceX < 0.0)
-    {
-        return false;
-    }
-
-    if (sourceX + static_cast<double>(currentViewKey.viewWidth) >
-        static_cast<double>(sourceTextureKey.width))
-    {
-        return false;
-    }
-
-    outSourceRect = {static_cast<float>(sourceX), 0.0f,
-                     static_cast<float>(currentViewKey.viewWidth),
-                     static_cast<float>(currentViewKey.viewHeight)};
-    return true;
-}
-
 bool Waveform::ensureBaseTextureStorage(
     SDL_Renderer *renderer, const BaseTextureCacheKey &targetKey) const
 {
@@ -249,7 +158,6 @@ bool Waveform::ensureBaseTextureStorage(
         return true;
     }
 
-    storeCurrentBlockTexture();
     destroyTexture(cachedBaseTexture);
 
     cachedBaseTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
@@ -266,8 +174,7 @@ bool Waveform::ensureBaseTextureStorage(
 }
 
 void Waveform::renderBaseTexture(SDL_Renderer *renderer,
-                                 const BaseTextureCacheKey &targetKey,
-                                 const bool isBlockMode) const
+                                 const BaseTextureCacheKey &targetKey) const
 {
     SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
     SDL_Rect previousViewport{};
@@ -276,63 +183,218 @@ void Waveform::renderBaseTexture(SDL_Renderer *renderer,
     SDL_SetRenderTarget(renderer, cachedBaseTexture);
     const SDL_Rect localViewport{0, 0, targetKey.width, targetKey.height};
     SDL_SetRenderViewport(renderer, &localViewport);
-    if (isBlockMode)
-    {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(renderer, nullptr);
-        drawHorizontalLines(renderer);
-        renderBlockWaveformRange(renderer, 0, targetKey.width, targetKey.width,
-                                 targetKey.sampleOffset);
-        rememberRenderedBlockTextureFrontier(targetKey);
-    }
-    else
-    {
-        drawBaseWaveformContents(renderer);
-        cachedBaseTextureBuiltSamplePrefixEnd = -1;
-        progressiveBlockTextureRefreshPending = false;
-    }
+    drawBaseWaveformContents(renderer);
 
     SDL_SetRenderTarget(renderer, previousTarget);
     SDL_SetRenderViewport(renderer, &previousViewport);
 }
 
-void Waveform::renderBaseTextureFromBackgroundPlan(
-    SDL_Renderer *renderer, const BackgroundBlockRenderProgress &plan) const
+WaveformTileKey Waveform::makeBlockTileKey(const int64_t tileIndex) const
 {
-    if (!cachedBaseTexture)
+    const auto &viewState = state->getActiveViewState();
+    const auto &document = state->getActiveDocumentSession().document;
+    const auto frameRange =
+        waveformTileFrameRange(tileIndex, viewState.samplesPerPixel);
+    return {
+        .channel = channelIndex,
+        .samplesPerPixel = viewState.samplesPerPixel,
+        .verticalZoom = viewState.verticalZoom,
+        .height = getHeight(),
+        .pixelScale = state->pixelScale,
+        .uiScale = state->uiScale,
+        .tileIndex = tileIndex,
+        .dataVersion = document.getFrameRangeVersion(
+            channelIndex, frameRange.startFrame, frameRange.endFrameExclusive),
+    };
+}
+
+SDL_Texture *
+Waveform::createBlockTileTexture(SDL_Renderer *renderer,
+                                 const WaveformTileKey &key) const
+{
+    SDL_Texture *texture = SDL_CreateTexture(
+        renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+        WAVEFORM_TILE_WIDTH, key.height);
+    if (texture)
     {
-        return;
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
     }
+    return texture;
+}
 
+void Waveform::fillBlockTileTexture(SDL_Renderer *renderer,
+                                    SDL_Texture *texture,
+                                    const std::vector<SDL_Vertex> &vertices,
+                                    const std::vector<int> &indices) const
+{
     SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
     SDL_Rect previousViewport{};
     SDL_GetRenderViewport(renderer, &previousViewport);
 
-    SDL_SetRenderTarget(renderer, cachedBaseTexture);
-    const SDL_Rect localViewport{0, 0, plan.key.width, plan.key.height};
+    SDL_SetRenderTarget(renderer, texture);
+    const SDL_Rect localViewport{0, 0, WAVEFORM_TILE_WIDTH, getHeight()};
     SDL_SetRenderViewport(renderer, &localViewport);
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderFillRect(renderer, nullptr);
     drawHorizontalLines(renderer);
-    if (!plan.vertices.empty() && !plan.indices.empty())
+    if (!vertices.empty() && !indices.empty())
     {
-        SDL_RenderGeometry(renderer, nullptr, plan.vertices.data(),
-                           static_cast<int>(plan.vertices.size()),
-                           plan.indices.data(),
-                           static_cast<int>(plan.indices.size()));
+        SDL_RenderGeometry(renderer, nullptr, vertices.data(),
+                           static_cast<int>(vertices.size()), indices.data(),
+                           static_cast<int>(indices.size()));
     }
-    cachedBaseTextureBuiltSamplePrefixEnd = plan.key.frameCount;
-    progressiveBlockTextureRefreshPending = false;
 
     SDL_SetRenderTarget(renderer, previousTarget);
     SDL_SetRenderViewport(renderer, &previousViewport);
 }
 
-std::optional<Waveform::BackgroundBlockRenderRequest>
-Waveform::captureBackgroundBlockRenderRequest(
-    const BaseTextureCacheKey &targetKey) const
+SDL_Texture *Waveform::renderBlockTile(SDL_Renderer *renderer,
+                                       const WaveformTileKey &key) const
+{
+    SDL_Texture *texture = createBlockTileTexture(renderer, key);
+    if (!texture)
+    {
+        return nullptr;
+    }
+
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    appendBlockWaveformGeometryRange(
+        vertices, indices, 0, WAVEFORM_TILE_WIDTH, WAVEFORM_TILE_WIDTH,
+        waveformTileSampleOffset(key.tileIndex, key.samplesPerPixel));
+    fillBlockTileTexture(renderer, texture, vertices, indices);
+    return blockTiles.insert(key, texture, getBlockTileSizeBytes(key));
+}
+
+bool Waveform::drawBlockTiles(SDL_Renderer *renderer) const
+{
+    viewDrawnFromBlockTiles = false;
+    if (!renderer || !hasRenderableChannel() || getWidth() <= 0 ||
+        getHeight() <= 0)
+    {
+        return false;
+    }
+
+    storeBackgroundRenderedTile(renderer);
+
+    const auto &viewState = state->getActiveViewState();
+    const auto span = planWaveformTileSpan(
+        viewState.sampleOffset, viewState.samplesPerPixel, getWidth());
+    for (int64_t i = 0; i < span.tileCount; ++i)
+    {
+        const auto key = makeBlockTileKey(span.firstTileIndex + i);
+        const auto *pooledTexture = blockTiles.find(key);
+        // Drawn before the next tile is rendered, which may evict this one.
+        SDL_Texture *texture =
+            pooledTexture ? *pooledTexture : renderBlockTile(renderer, key);
+        if (!texture)
+        {
+            return false;
+        }
+
+        const SDL_FRect destination{
+            static_cast<float>(span.firstTileX + i * WAVEFORM_TILE_WIDTH),
+            0.0f, static_cast<float>(WAVEFORM_TILE_WIDTH),
+            static_cast<float>(getHeight())};
+        SDL_RenderTexture(renderer, texture, nullptr, &destination);
+    }
+
+    prefetchBlockTilesAround(span);
+    viewDrawnFromBlockTiles = true;
+    return true;
+}
+
+void Waveform::prefetchBlockTilesAround(const WaveformTileSpan &span) const
+{
+    connectTileRenderClient();
+    const auto &viewState = state->getActiveViewState();
+    const int64_t frameCount =
+        state->getActiveDocumentSession().document.getFrameCount();
+
+    // Nearest first, and to the right before the left at equal distance,
+    // as views are mostly scrolled forwards.
+    std::optional<WaveformTileKey> nextKey;
+    int64_t nextKeyDistance = 0;
+    for (int64_t distance = 1; distance <= kPrefetchTileDistance; ++distance)
+    {
+        for (const int64_t tileIndex :
+             {span.firstTileIndex + span.tileCount - 1 + distance,
+              span.firstTileIndex - distance})
+        {
+            if (tileIndex < 0 ||
+                waveformTileSampleOffset(tileIndex,
+                                         viewState.samplesPerPixel) >=
+                    frameCount)
+            {
+                continue;
+            }
+
+            const auto key = makeBlockTileKey(tileIndex);
+            if (blockTiles.contains(key) ||
+                (backgroundTileRenderResult.has_value() &&
+                 backgroundTileRenderResult->tileKey == key))
+            {
+                continue;
+            }
+            if (requestedBackgroundTileKey == key)
+            {
+                // Still wanted, so let it finish.
+                return;
+            }
+            if (!nextKey.has_value())
+            {
+                nextKey = key;
+                nextKeyDistance = distance;
+            }
+        }
+    }
+
+    if (!nextKey.has_value())
+    {
+        return;
+    }
+
+    auto request = captureBackgroundTileRenderRequest(*nextKey);
+    if (!request.has_value())
+    {
+        return;
+    }
+    requestedBackgroundTileKey = *nextKey;
+    // The pool renders the tiles nearest to any view first.
+    latestBackgroundTileRenderGeneration = tileRenderClient.submit(
+        std::move(*request), static_cast<int>(nextKeyDistance));
+}
+
+void Waveform::storeBackgroundRenderedTile(SDL_Renderer *renderer) const
 {
-    if (!state || targetKey.width <= 0 || targetKey.height <= 0)
+    consumePublishedBackgroundTileRenders();
+    if (!backgroundTileRenderResult.has_value())
+    {
+        return;
+    }
+
+    const auto result = std::move(*backgroundTileRenderResult);
+    backgroundTileRenderResult.reset();
+    // The view or the tile's frames may have changed since it was requested.
+    if (result.tileKey != makeBlockTileKey(result.tileKey.tileIndex))
+    {
+        return;
+    }
+
+    SDL_Texture *texture = createBlockTileTexture(renderer, result.tileKey);
+    if (!texture)
+    {
+        return;
+    }
+    fillBlockTileTexture(renderer, texture, result.vertices, result.indices);
+    blockTiles.insert(result.tileKey, texture,
+                      getBlockTileSizeBytes(result.tileKey));
+}
+
+std::optional<WaveformTileRenderRequest>
+Waveform::captureBackgroundTileRenderRequest(const WaveformTileKey &key) const
+{
+    if (!state || key.height <= 0 || key.samplesPerPixel < 1.0)
     {
         return std::nullopt;
     }
@@ -348,80 +410,55 @@ Waveform::captureBackgroundBlockRenderRequest(
     }
 
     const auto &waveformCache = session.getWaveformCache(channelIndex);
-    if (waveformCache.hasDirtyBlocks())
+    if (waveformCache.hasDirtyBlocks() ||
+        !waveformCache.isLaidOutFor(frameCount))
     {
         return std::nullopt;
     }
+    // The frames of the tile's columns and the one on either side of it.
+    const auto frameRange =
+        waveformTileFrameRange(key.tileIndex, key.samplesPerPixel);
     const auto inputPlan = planBackgroundBlockRenderInput(
-        frameCount, targetKey.sampleOffset, targetKey.samplesPerPixel,
-        targetKey.width, targetKey.pixelScale, waveformCache);
+        frameCount, frameRange.startFrame, key.samplesPerPixel,
+        WAVEFORM_TILE_WIDTH + 2, key.pixelScale, waveformCache);
 
-    std::vector<float> rawSamples;
-    std::vector<Peak> cachedPeaks;
-    int64_t cachedPeakStart = 0;
+    WaveformTileRenderRequest request{
+        .tileKey = key,
+        .sampleOffset =
+            waveformTileSampleOffset(key.tileIndex, key.samplesPerPixel),
+        .frameCount = frameCount,
+        .color = waveformFColor,
+        .bypassCache = inputPlan.bypassCache,
+        .samplesPerPeak = inputPlan.samplesPerPeak,
+    };
+    // Read in place by the worker, so nothing is copied here.
     if (inputPlan.bypassCache)
     {
-        rawSamples.reserve(static_cast<std::size_t>(
-            std::max<int64_t>(0, inputPlan.rawSampleEndExclusive -
-                                     inputPlan.rawSampleStart)));
-        for (int64_t sample = inputPlan.rawSampleStart;
-             sample < inputPlan.rawSampleEndExclusive; ++sample)
-        {
-            rawSamples.push_back(lease.getSample(channelIndex, sample));
-        }
+        request.samples.emplace(std::move(lease));
     }
     else
     {
-        const auto &selectedLevel =
-            waveformCache.getLevelByIndex(inputPlan.cacheLevel);
-        const auto visibleSampleStart =
-            std::clamp<int64_t>(targetKey.sampleOffset, 0, frameCount);
-        const auto visibleSampleEnd = std::clamp<int64_t>(
-            targetKey.sampleOffset +
-                static_cast<int64_t>(std::ceil(
-                    targetKey.samplesPerPixel *
-                    static_cast<double>(targetKey.width + 1))),
-            0, frameCount);
-        cachedPeakStart = std::clamp<int64_t>(
-            visibleSampleStart / inputPlan.samplesPerPeak, 0,
-            static_cast<int64_t>(selectedLevel.size()));
-        const auto cachedPeakEnd = std::clamp<int64_t>(
-            static_cast<int64_t>(
-                std::ceil(static_cast<double>(visibleSampleEnd) /
-                          static_cast<double>(inputPlan.samplesPerPeak))),
-            cachedPeakStart, static_cast<int64_t>(selectedLevel.size()));
-        cachedPeaks.assign(selectedLevel.begin() + cachedPeakStart,
-                           selectedLevel.begin() + cachedPeakEnd);
-    }
-    return BackgroundBlockRenderRequest{
-        .key = targetKey,
-        .frameCount = frameCount,
-        .uiScale = state->uiScale,
-        .bypassCache = inputPlan.bypassCache,
-        .cacheLevel = inputPlan.cacheLevel,
-        .samplesPerPeak = inputPlan.samplesPerPeak,
-        .cachedPeakStart = cachedPeakStart,
-        .rawSampleStart = inputPlan.rawSampleStart,
-        .rawSamples = std::move(rawSamples),
-        .cachedPeaks = std::move(cachedPeaks),
-    };
+        request.peaks = waveformCache.pinLevel(inputPlan.cacheLevel);
+        request.frameLayout = waveformCache.getFrameLayout();
+    }
+    return request;
 }
 
-void Waveform::processBackgroundBlockRenderRequest(
-    const BackgroundBlockRenderRequest &request, const std::uint64_t generation,
-    const BackgroundBlockRenderWorker::CancelCheck &isCanceled,
-    const BackgroundBlockRenderWorker::PublishFn &publish) const
+void Waveform::processBackgroundTileRenderRequest(
+    const WaveformTileRenderRequest &request, const std::uint64_t generation,
+    const WaveformTileRenderPool::CancelCheck &isCanceled,
+    const WaveformTileRenderPool::PublishFn &publish)
 {
     (void)generation;
+    const auto &key = request.tileKey;
     const double blockRenderPhasePx =
-        getBlockRenderPhasePixels(request.key.sampleOffset,
-                                  request.key.samplesPerPixel);
+        getBlockRenderPhasePixels(request.sampleOffset, key.samplesPerPixel);
     const uint16_t samplePointSize =
-        getWaveformSamplePointSize(request.key.pixelScale, request.uiScale);
-    const int drawableHeight = request.key.height - samplePointSize;
+        getWaveformSamplePointSize(key.pixelScale, key.uiScale);
+    const int drawableHeight = key.height - samplePointSize;
     const float scale = static_cast<float>(
-        request.key.verticalZoom * static_cast<double>(drawableHeight) * 0.5);
-    const int centerY = request.key.height / 2;
+        key.verticalZoom * static_cast<double>(drawableHeight) * 0.5);
+    const int centerY = key.height / 2;
 
     auto computePeakForWindow = [&](const double startSampleInclusive,
                                     const double endSampleExclusive,
@@ -434,20 +471,6 @@ void Waveform::processBackgroundBlockRenderRequest(
             return false;
         }
 
-        const auto sampleEndExclusive =
-            request.rawSampleStart +
-            static_cast<int64_t>(request.rawSamples.size());
-        const auto sampleAt = [&](const int64_t sampleIndex) -> float
-        {
-            const auto localIndex = sampleIndex - request.rawSampleStart;
-            if (localIndex < 0 ||
-                localIndex >= static_cast<int64_t>(request.rawSamples.size()))
-            {
-                return 0.0f;
-            }
-            return request.rawSamples[static_cast<std::size_t>(localIndex)];
-        };
-
         int64_t a = static_cast<int64_t>(std::floor(startSampleInclusive));
         int64_t b = static_cast<int64_t>(std::floor(endSampleExclusive));
         a = std::clamp<int64_t>(a, 0, frameCount - 1);
@@ -455,104 +478,82 @@ void Waveform::processBackgroundBlockRenderRequest(
 
         if (request.bypassCache)
         {
-            if (a < request.rawSampleStart || b > sampleEndExclusive)
+            if (!request.samples.has_value())
             {
                 return false;
             }
-            float minv = sampleAt(a);
-            float maxv = minv;
-            for (int64_t i = a + 1; i < b; ++i)
+            Peak peak = WaveformCache::EMPTY_PEAK;
+            request.samples->forEachSpan(
+                key.channel, a, b - a,
+                [&peak](const std::span<const float> samples, const int64_t)
+                {
+                    for (const float v : samples)
+                    {
+                        peak.min = std::min(peak.min, v);
+                        peak.max = std::max(peak.max, v);
+                    }
+                });
+            if (peak.min > peak.max)
             {
-                const float v = sampleAt(i);
-                minv = std::min(minv, v);
-                maxv = std::max(maxv, v);
+                return false;
             }
-            outPeak = {minv, maxv};
+            outPeak = peak;
             return true;
         }
 
-        if (request.samplesPerPeak <= 0 || request.cachedPeaks.empty())
+        const auto peaks = request.peaks.peaks;
+        if (request.samplesPerPeak <= 0 || peaks.empty())
         {
             return false;
         }
 
-        const int64_t firstPeakIndex =
-            a / request.samplesPerPeak - request.cachedPeakStart;
-        const int64_t lastPeakIndexExclusive =
-            static_cast<int64_t>(
-                std::ceil(static_cast<double>(b) /
-                          static_cast<double>(request.samplesPerPeak))) -
-            request.cachedPeakStart;
+        const int64_t gridA = request.frameLayout.gridPositionOf(a);
+        const int64_t gridB = request.frameLayout.gridPositionOf(b - 1) + 1;
+        const int64_t firstPeakIndex = gridA / request.samplesPerPeak;
+        const int64_t lastPeakIndexExclusive = static_cast<int64_t>(
+            std::ceil(static_cast<double>(gridB) /
+                      static_cast<double>(request.samplesPerPeak)));
         if (firstPeakIndex < 0 ||
             lastPeakIndexExclusive <= firstPeakIndex ||
-            lastPeakIndexExclusive >
-                static_cast<int64_t>(request.cachedPeaks.size()))
+            lastPeakIndexExclusive > static_cast<int64_t>(peaks.size()))
         {
             return false;
         }
 
-        Peak peak =
-            request.cachedPeaks[static_cast<std::size_t>(firstPeakIndex)];
+        Peak peak = peaks[static_cast<std::size_t>(firstPeakIndex)];
         for (int64_t i = firstPeakIndex + 1; i < lastPeakIndexExclusive; ++i)
         {
-            peak.min = std::min(
-                peak.min,
-                request.cachedPeaks[static_cast<std::size_t>(i)].min);
-            peak.max = std::max(
-                peak.max,
-                request.cachedPeaks[static_cast<std::size_t>(i)].max);
+            peak.min =
+                std::min(peak.min, peaks[static_cast<std::size_t>(i)].min);
+            peak.max =
+                std::max(peak.max, peaks[static_cast<std::size_t>(i)].max);
         }
 
         outPeak = peak;
         return true;
     };
 
-    BackgroundBlockRenderChunk chunk{
-        .key = request.key,
-        .reset = true,
-    };
-    chunk.vertices.reserve(
-        static_cast<std::size_t>(kBackgroundBlockRenderChunkWidth) * 8);
-    chunk.indices.reserve(
-        static_cast<std::size_t>(kBackgroundBlockRenderChunkWidth) * 12);
-    const auto publishChunk = [&]()
-    {
-        if (!chunk.reset && !chunk.complete && chunk.vertices.empty() &&
-            chunk.indices.empty())
-        {
-            return;
-        }
-        publish(std::move(chunk));
-        chunk = BackgroundBlockRenderChunk{
-            .key = request.key,
-            .reset = false,
-            .complete = false,
-        };
-        chunk.vertices.reserve(
-            static_cast<std::size_t>(kBackgroundBlockRenderChunkWidth) * 8);
-        chunk.indices.reserve(
-            static_cast<std::size_t>(kBackgroundBlockRenderChunkWidth) * 12);
-    };
+    WaveformTileRenderResult result{.tileKey = key};
+    result.vertices.reserve(static_cast<std::size_t>(WAVEFORM_TILE_WIDTH) * 8);
+    result.indices.reserve(static_cast<std::size_t>(WAVEFORM_TILE_WIDTH) * 12);
 
     int prevX = 0;
     int prevY = 0;
     bool hasPrev = false;
     int lastDrawXi = std::numeric_limits<int>::min();
 
-    for (int x = 0; x < request.key.width + 1; ++x)
+    // From the column left of the tile, for the line connecting to it.
+    for (int x = -1; x < WAVEFORM_TILE_WIDTH + 1; ++x)
     {
-        if (x > 0 && (x % kBackgroundBlockRenderChunkWidth) == 0)
+        if (x > 0 && (x % kBackgroundTileRenderCancelCheckWidth) == 0 &&
+            isCanceled())
         {
-            publishChunk();
-            if (isCanceled())
-            {
-                return;
-            }
+            return;
         }
 
         const float drawX = static_cast<float>(x - blockRenderPhasePx);
         const int drawXi = static_cast<int>(std::lround(drawX));
-        if (drawXi < 0 || drawXi > request.key.width)
+        if (drawXi < -1 || drawXi > WAVEFORM_TILE_WIDTH)
         {
             continue;
         }
@@ -563,8 +564,8 @@ void Waveform::processBackgroundBlockRenderRequest(
 
         double aD = 0.0;
         double bD = 0.0;
-        getBlockRenderSampleWindowForPixel(
-            x, request.key.sampleOffset, request.key.samplesPerPixel, aD, bD);
+        getBlockRenderSampleWindowForPixel(x, request.sampleOffset,
+                                           key.samplesPerPixel, aD, bD);
         if (bD <= 0.0 || aD >= static_cast<double>(request.frameCount))
         {
             continue;
@@ -583,25 +584,25 @@ void Waveform::processBackgroundBlockRenderRequest(
 
         if (y1 != y2)
         {
-            appendLineQuad(chunk.vertices, chunk.indices,
+            appendLineQuad(result.vertices, result.indices,
                            static_cast<float>(drawXi),
                            static_cast<float>(y1),
                            static_cast<float>(drawXi),
-                           static_cast<float>(y2), waveformFColor);
+                           static_cast<float>(y2), request.color);
         }
         else
         {
-            appendPointQuad(chunk.vertices, chunk.indices, drawXi, y1,
-                            waveformFColor);
+            appendPointQuad(result.vertices, result.indices, drawXi, y1,
+                            request.color);
         }
 
         if (connectFromPrevious)
         {
-            appendLineQuad(chunk.vertices, chunk.indices,
+            appendLineQuad(result.vertices, result.indices,
                            static_cast<float>(prevX),
                            static_cast<float>(prevY),
                            static_cast<float>(drawXi),
-                           static_cast<float>(midY), waveformFColor);
+                           static_cast<float>(midY), request.color);
         }
 
         prevX = drawXi;
@@ -614,124 +615,40 @@ void Waveform::processBackgroundBlockRenderRequest(
     {
         return;
     }
-    publishChunk();
-    chunk.complete = true;
-    publishChunk();
-}
-
-void Waveform::ensureBackgroundBlockRenderWorker() const
-{
-    if (backgroundBlockRenderWorker)
-    {
-        return;
-    }
-
-    backgroundBlockRenderWorker =
-        std::make_unique<BackgroundBlockRenderWorker>(
-            [this](const BackgroundBlockRenderRequest &request,
-                   const std::uint64_t generation,
-                   const BackgroundBlockRenderWorker::CancelCheck &isCanceled,
-                   const BackgroundBlockRenderWorker::PublishFn &publish)
-            {
-                processBackgroundBlockRenderRequest(request, generation,
-                                                    isCanceled, publish);
-            });
+    publish(std::move(result));
 }
 
-void Waveform::requestBackgroundBlockRenderPlan(
-    const BaseTextureCacheKey &targetKey) const
+void Waveform::connectTileRenderClient() const
 {
-    if (targetKey.samplesPerPixel < 1.0 || targetKey.width <= 0 ||
-        targetKey.height <= 0)
+    if (tileRenderClient.isConnected() || !state)
     {
         return;
     }
 
-    ensureBackgroundBlockRenderWorker();
-    if (requestedBackgroundBlockRenderKey.has_value() &&
-        *requestedBackgroundBlockRenderKey == targetKey)
+    if (!state->waveformTileRenderPool)
     {
-        return;
-    }
-    auto request = captureBackgroundBlockRenderRequest(targetKey);
-    if (!request.has_value())
-    {
-        return;
+        state->waveformTileRenderPool.reset(new WaveformTileRenderPool(
+            &Waveform::processBackgroundTileRenderRequest));
     }
-    requestedBackgroundBlockRenderKey = targetKey;
-    backgroundBlockRenderProgress.reset();
-    latestBackgroundBlockRenderGeneration =
-        backgroundBlockRenderWorker->submit(std::move(*request));
+    tileRenderClient = state->waveformTileRenderPool->connect();
 }
 
-bool Waveform::consumePublishedBackgroundBlockRenderChunks() const
+bool Waveform::consumePublishedBackgroundTileRenders() const
 {
-    if (!backgroundBlockRenderWorker)
-    {
-        return false;
-    }
-
     bool consumedAny = false;
-    auto published = backgroundBlockRenderWorker->takePublished();
-    for (auto &publishedChunk : published)
+    for (auto &published : tileRenderClient.takePublished())
     {
-        if (publishedChunk.generation != latestBackgroundBlockRenderGeneration)
+        if (published.generation != latestBackgroundTileRenderGeneration)
         {
             continue;
         }
 
-        auto &chunk = publishedChunk.result;
-        if (!backgroundBlockRenderProgress.has_value() || chunk.reset ||
-            backgroundBlockRenderProgress->generation != publishedChunk.generation ||
-            backgroundBlockRenderProgress->key != chunk.key)
-        {
-            backgroundBlockRenderProgress = BackgroundBlockRenderProgress{
-                .generation = publishedChunk.generation,
-                .key = chunk.key,
-                .complete = false,
-                .vertices = {},
-                .indices = {},
-            };
-        }
-
-        auto &progress = *backgroundBlockRenderProgress;
-        if (chunk.complete)
-        {
-            progress.complete = true;
-            consumedAny = true;
-            continue;
-        }
-        const int baseIndex = static_cast<int>(progress.vertices.size());
-        progress.vertices.insert(progress.vertices.end(),
-                                 std::make_move_iterator(chunk.vertices.begin()),
-                                 std::make_move_iterator(chunk.vertices.end()));
-        for (const int index : chunk.indices)
-        {
-            progress.indices.push_back(baseIndex + index);
-        }
+        backgroundTileRenderResult = std::move(published.result);
         consumedAny = true;
     }
     return consumedAny;
 }
 
-void Waveform::finalizeBaseTextureForView(
-    const BaseTextureCacheKey &newKey, const BaseTextureCacheKey &targetKey,
-    const bool allowBlockCoverageReuse) const
-{
-    cachedBaseTextureKey = targetKey;
-    cachedBaseTextureValid = true;
-    if (allowBlockCoverageReuse && targetKey != newKey)
-    {
-        canRenderCurrentViewFromCachedBlockTexture(newKey, targetKey,
-                                                   cachedBaseTextureSourceRect);
-        return;
-    }
-
-    cachedBaseTextureSourceRect = {
-        0.0f, 0.0f, static_cast<float>(newKey.width),
-        static_cast<float>(newKey.height)};
-}
-
 bool Waveform::isWaveformCacheBuildActive() const
 {
     if (!state)
@@ -765,88 +682,6 @@ bool Waveform::hasProgressiveBlockBuildGeometryForKey(
            !progressiveBlockBuildIndices.empty();
 }
 
-void Waveform::rememberRenderedBlockTextureFrontier(
-    const BaseTextureCacheKey &targetKey) const
-{
-    if (targetKey.samplesPerPixel < 1.0)
-    {
-        cachedBaseTextureBuiltSamplePrefixEnd = -1;
-        progressiveBlockTextureRefreshPending = false;
-        return;
-    }
-
-    cachedBaseTextureBuiltSamplePrefixEnd =
-        isWaveformCacheBuildActive() ? currentBuiltSamplePrefixEnd()
-                                     : targetKey.frameCount;
-    progressiveBlockTextureRefreshPending = false;
-}
-
-bool Waveform::refreshProgressiveBlockTexture(
-    SDL_Renderer *renderer, const BaseTextureCacheKey &targetKey) const
-{
-    if (!renderer || !cachedBaseTexture || !cachedBaseTextureValid ||
-        targetKey.samplesPerPixel < 1.0)
-    {
-        progressiveBlockTextureRefreshPending = false;
-        return false;
-    }
-
-    if (!isWaveformCacheBuildActive())
-    {
-        cachedBaseTextureBuiltSamplePrefixEnd = targetKey.frameCount;
-        progressiveBlockTextureRefreshPending = false;
-        return false;
-    }
-
-    const int64_t previousBuiltEnd =
-        std::max<int64_t>(0, cachedBaseTextureBuiltSamplePrefixEnd);
-    const int64_t newBuiltEnd = currentBuiltSamplePrefixEnd();
-    if (newBuiltEnd <= previousBuiltEnd)
-    {
-        progressiveBlockTextureRefreshPending = false;
-        return false;
-    }
-
-    const double startXD =
-        (static_cast<double>(previousBuiltEnd) -
-         static_cast<double>(targetKey.sampleOffset)) /
-        targetKey.samplesPerPixel;
-    const double endXD =
-        (static_cast<double>(newBuiltEnd) -
-         static_cast<double>(targetKey.sampleOffset)) /
-        targetKey.samplesPerPixel;
-    const int xStart =
-        std::clamp(static_cast<int>(std::floor(startXD)) - 2, 0, targetKey.width);
-    const int xEndExclusive =
-        std::clamp(static_cast<int>(std::ceil(endXD)) + 2, 0, targetKey.width);
-    cachedBaseTextureBuiltSamplePrefixEnd = newBuiltEnd;
-    progressiveBlockTextureRefreshPending = false;
-    if (xEndExclusive <= xStart)
-    {
-        return false;
-    }
-
-    SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
-    SDL_Rect previousViewport{};
-    SDL_GetRenderViewport(renderer, &previousViewport);
-
-    SDL_SetRenderTarget(renderer, cachedBaseTexture);
-    const SDL_Rect localViewport{0, 0, targetKey.width, targetKey.height};
-    SDL_SetRenderViewport(renderer, &localViewport);
-    const SDL_FRect updateRect{static_cast<float>(xStart), 0.0f,
-                               static_cast<float>(xEndExclusive - xStart),
-                               static_cast<float>(targetKey.height)};
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderFillRect(renderer, &updateRect);
-    drawHorizontalLines(renderer);
-    renderBlockWaveformRange(renderer, xStart, xEndExclusive, targetKey.width,
-                             targetKey.sampleOffset);
-
-    SDL_SetRenderTarget(renderer, previousTarget);
-    SDL_SetRenderViewport(renderer, &previousViewport);
-    return true;
-}
-
 void Waveform::handleWaveformCacheUpdate() const
 {
     const auto newKey = computeBaseTextureCacheKey();
@@ -867,14 +702,14 @@ void Waveform::handleWaveformCacheUpdate() const
     {
         clearProgressiveBlockBuildGeometry();
         progressiveBlockBuildGeometryKey = newKey;
-        if (cachedBaseTextureValid && cachedBaseTexture)
+        if (viewDrawnFromBlockTiles)
         {
             progressiveBlockBuildSamplePrefixEnd = currentBuiltSamplePrefixEnd();
             appendBlockWaveformGeometryRange(progressiveBlockBuildVertices,
                                              progressiveBlockBuildIndices, 0,
                                              newKey.width, newKey.width,
                                              newKey.sampleOffset);
-            invalidateBaseTexture();
+            viewDrawnFromBlockTiles = false;
             return;
         }
 
@@ -950,45 +785,6 @@ void Waveform::drawProgressiveBlockBuildWaveform(
     }
 }
 
-bool Waveform::promoteProgressiveBlockBuildGeometryToTexture(
-    SDL_Renderer *renderer, const BaseTextureCacheKey &key) const
-{
-    if (!renderer || !hasProgressiveBlockBuildGeometryForKey(key))
-    {
-        return false;
-    }
-
-    if (!ensureBaseTextureStorage(renderer, key))
-    {
-        return false;
-    }
-
-    SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
-    SDL_Rect previousViewport{};
-    SDL_GetRenderViewport(renderer, &previousViewport);
-
-    SDL_SetRenderTarget(renderer, cachedBaseTexture);
-    const SDL_Rect localViewport{0, 0, key.width, key.height};
-    SDL_SetRenderViewport(renderer, &localViewport);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderFillRect(renderer, nullptr);
-    drawHorizontalLines(renderer);
-    SDL_SetRenderDrawColor(renderer, waveformColor.r, waveformColor.g,
-                           waveformColor.b, waveformColor.a);
-    SDL_RenderGeometry(renderer, nullptr, progressiveBlockBuildVertices.data(),
-                       static_cast<int>(progressiveBlockBuildVertices.size()),
-                       progressiveBlockBuildIndices.data(),
-                       static_cast<int>(progressiveBlockBuildIndices.size()));
-
-    SDL_SetRenderTarget(renderer, previousTarget);
-    SDL_SetRenderViewport(renderer, &previousViewport);
-
-    finalizeBaseTextureForView(key, key, false);
-    rememberRenderedBlockTextureFrontier(key);
-    clearProgressiveBlockBuildGeometry();
-    return true;
-}
-
 void Waveform::appendBlockWaveformGeometryRange(
     std::vector<SDL_Vertex> &vertices, std::vector<int> &indices, int xStart,
     int xEndExclusive, int widthToUse, int64_t sampleOffset) const
@@ -1046,14 +842,16 @@ void Waveform::appendBlockWaveformGeometryRange(
     int prevY = 0;
     bool hasPrev = false;
     int lastDrawXi = std::numeric_limits<int>::min();
-    const int lookupStart = std::max(0, xStart - 1);
+    // From the column left of the range, which may be left of the view, for
+    // the line connecting to it.
+    const int lookupStart = std::max(-1, xStart - 1);
     const int lookupEndExclusive = std::min(widthToUse + 1, xEndExclusive + 1);
 
     for (int x = lookupStart; x < lookupEndExclusive; ++x)
     {
         const float drawX = static_cast<float>(x - blockRenderPhasePx);
         const int drawXi = static_cast<int>(std::lround(drawX));
-        if (drawXi < 0 || drawXi > widthToUse)
+        if (drawXi < -1 || drawXi > widthToUse)
         {
             continue;
         }
@@ -1122,225 +920,20 @@ bool Waveform::ensureBaseTexture(SDL_Renderer *renderer) const
     }
 
     const auto newKey = computeBaseTextureCacheKey();
-    const bool isBlockMode = newKey.samplesPerPixel >= 1.0;
-    if (isBlockMode && isWaveformCacheBuildActive())
-    {
-        invalidateBaseTexture();
-        return false;
-    }
-    if (isBlockMode &&
-        hasProgressiveBlockBuildGeometryForKey(newKey) &&
-        (!cachedBaseTextureValid || cachedBaseTextureKey != newKey))
-    {
-        if (!isWaveformCacheBuildActive())
-        {
-            clearProgressiveBlockBuildGeometry();
-            if (!ensureBaseTextureStorage(renderer, newKey))
-            {
-                return false;
-            }
-
-            renderBaseTexture(renderer, newKey, true);
-            finalizeBaseTextureForView(newKey, newKey, false);
-            return true;
-        }
-    }
-    const bool allowBlockCoverageReuse =
-        isBlockMode && !isWaveformCacheBuildActive();
-    if (allowBlockCoverageReuse && cachedBaseTextureValid && cachedBaseTexture)
-    {
-        SDL_FRect sourceRect{};
-        if (canRenderCurrentViewFromCachedBlockTexture(newKey, cachedBaseTextureKey,
-                                                       sourceRect))
-        {
-            cachedBaseTextureSourceRect = sourceRect;
-            return true;
-        }
-    }
-    if (allowBlockCoverageReuse && activateStoredBlockTextureForView(newKey))
-    {
-        return true;
-    }
-
     if (cachedBaseTextureValid && cachedBaseTexture &&
         cachedBaseTextureKey == newKey)
     {
-        if (isBlockMode && progressiveBlockTextureRefreshPending)
-        {
-            (void)refreshProgressiveBlockTexture(renderer, newKey);
-        }
-        cachedBaseTextureSourceRect = {0.0f, 0.0f, static_cast<float>(newKey.width),
-                                       static_cast<float>(newKey.height)};
-        return true;
-    }
-
-    int pixelShift = 0;
-    if (isBlockMode && cachedBaseTextureValid && cachedBaseTexture &&
-        canReuseBlockTextureForHorizontalShift(newKey, pixelShift) &&
-        rebuildShiftedBlockTexture(renderer, newKey, pixelShift))
-    {
-        cachedBaseTextureKey = newKey;
-        cachedBaseTextureValid = true;
-        cachedBaseTextureSourceRect = {0.0f, 0.0f, static_cast<float>(newKey.width),
-                                       static_cast<float>(newKey.height)};
         return true;
     }
 
-    const auto targetKey =
-        chooseBaseTextureTargetKey(newKey, allowBlockCoverageReuse);
-    if (isBlockMode)
-    {
-        consumePublishedBackgroundBlockRenderChunks();
-        if (backgroundBlockRenderProgress.has_value() &&
-            backgroundBlockRenderProgress->generation ==
-                latestBackgroundBlockRenderGeneration &&
-            backgroundBlockRenderProgress->key == targetKey &&
-            backgroundBlockRenderProgress->complete)
-        {
-            if (!ensureBaseTextureStorage(renderer, targetKey))
-            {
-                return false;
-            }
-
-            renderBaseTextureFromBackgroundPlan(
-                renderer, *backgroundBlockRenderProgress);
-            finalizeBaseTextureForView(newKey, targetKey,
-                                       allowBlockCoverageReuse);
-            return true;
-        }
-
-        requestBackgroundBlockRenderPlan(targetKey);
-        if (cachedBaseTextureValid && cachedBaseTexture)
-        {
-            return true;
-        }
-        if (hasProgressiveBlockBuildGeometryForKey(newKey))
-        {
-            return false;
-        }
-    }
-
-    if (!ensureBaseTextureStorage(renderer, targetKey))
-    {
-        return false;
-    }
-
-    renderBaseTexture(renderer, targetKey, isBlockMode);
-    finalizeBaseTextureForView(newKey, targetKey, allowBlockCoverageReuse);
-    return true;
-}
-
-bool Waveform::canReuseBlockTextureForHorizontalShift(
-    const BaseTextureCacheKey &newKey, int &outPixelShift) const
-{
-    outPixelShift = 0;
-    if (!cachedBaseTextureValid)
-    {
-        return false;
-    }
-
-    if (cachedBaseTextureKey.width != newKey.width ||
-        cachedBaseTextureKey.height != newKey.height ||
-        cachedBaseTextureKey.frameCount != newKey.frameCount ||
-        cachedBaseTextureKey.waveformDataVersion != newKey.waveformDataVersion ||
-        cachedBaseTextureKey.pixelScale != newKey.pixelScale)
-    {
-        return false;
-    }
-
-    if (cachedBaseTextureKey.samplesPerPixel != newKey.samplesPerPixel ||
-        cachedBaseTextureKey.verticalZoom != newKey.verticalZoom)
-    {
-        return false;
-    }
-
-    if (newKey.samplesPerPixel < 1.0)
-    {
-        return false;
-    }
-
-    const int64_t deltaSamples =
-        newKey.sampleOffset - cachedBaseTextureKey.sampleOffset;
-    if (deltaSamples == 0)
+    if (!ensureBaseTextureStorage(renderer, newKey))
     {
         return false;
     }
 
-    const double pixelShiftD =
-        -static_cast<double>(deltaSamples) / newKey.samplesPerPixel;
-    const int pixelShift = static_cast<int>(std::lround(pixelShiftD));
-    if (pixelShift == 0 || std::abs(pixelShift) >= newKey.width)
-    {
-        return false;
-    }
-    if (std::abs(pixelShiftD - static_cast<double>(pixelShift)) > 1e-6)
-    {
-        return false;
-    }
-
-    outPixelShift = pixelShift;
-    return true;
-}
-
-bool Waveform::rebuildShiftedBlockTexture(SDL_Renderer *renderer,
-                                          const BaseTextureCacheKey &newKey,
-                                          int pixelShift) const
-{
-    if (!cachedBaseTexture)
-    {
-        return false;
-    }
-
-    SDL_Texture *shiftedTexture = SDL_CreateTexture(
-        renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
-        newKey.width, newKey.height);
-    if (!shiftedTexture)
-    {
-        return false;
-    }
-    SDL_SetTextureScaleMode(shiftedTexture, SDL_SCALEMODE_NEAREST);
-
-    SDL_Texture *previousTarget = SDL_GetRenderTarget(renderer);
-    SDL_Rect previousViewport{};
-    SDL_GetRenderViewport(renderer, &previousViewport);
-
-    SDL_SetRenderTarget(renderer, shiftedTexture);
-    const SDL_Rect fullViewport{0, 0, newKey.width, newKey.height};
-    SDL_SetRenderViewport(renderer, &fullViewport);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderFillRect(renderer, nullptr);
-
-    SDL_FRect shiftedDest{static_cast<float>(pixelShift), 0.0f,
-                          static_cast<float>(newKey.width),
-                          static_cast<float>(newKey.height)};
-    SDL_RenderTexture(renderer, cachedBaseTexture, nullptr, &shiftedDest);
-
-    SDL_Rect exposedRect{};
-    if (pixelShift > 0)
-    {
-        exposedRect = {0, 0, pixelShift, newKey.height};
-    }
-    else
-    {
-        exposedRect = {newKey.width + pixelShift, 0, -pixelShift, newKey.height};
-    }
-
-    if (exposedRect.w > 0 && exposedRect.h > 0)
-    {
-        SDL_SetRenderViewport(renderer, &exposedRect);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderFillRect(renderer, nullptr);
-        drawHorizontalLines(renderer);
-        renderBlockWaveformRange(renderer, exposedRect.x,
-                                 exposedRect.x + exposedRect.w, newKey.width,
-                                 newKey.sampleOffset);
-    }
-
-    SDL_SetRenderTarget(renderer, previousTarget);
-    SDL_SetRenderViewport(renderer, &previousViewport);
-
-    destroyTexture(cachedBaseTexture);
-    cachedBaseTexture = shiftedTexture;
+    renderBaseTexture(renderer, newKey);
+    cachedBaseTextureKey = newKey;
+    cachedBaseTextureValid = true;
     return true;
 }
 
@@ -1359,90 +952,6 @@ void Waveform::destroyTexture(SDL_Texture *&texture) const
     texture = nullptr;
 }
 
-void Waveform::storeCurrentBlockTexture() const
-{
-    if (!cachedBaseTexture || !cachedBaseTextureValid ||
-        cachedBaseTextureKey.samplesPerPixel < 1.0)
-    {
-        return;
-    }
-
-    for (auto it = storedBlockTextures.begin(); it != storedBlockTextures.end();)
-    {
-        if (it->key == cachedBaseTextureKey)
-        {
-            destroyTexture(it->texture);
-            it = storedBlockTextures.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
-    }
-
-    storedBlockTextures.push_back(
-        {.texture = cachedBaseTexture, .key = cachedBaseTextureKey, .valid = true});
-    cachedBaseTexture = nullptr;
-    cachedBaseTextureValid = false;
-    trimStoredBlockTextures();
-}
-
-void Waveform::trimStoredBlockTextures() const
-{
-    constexpr std::size_t kMaxStoredBlockTextures = 24;
-    while (storedBlockTextures.size() > kMaxStoredBlockTextures)
-    {
-        destroyTexture(storedBlockTextures.front().texture);
-        storedBlockTextures.erase(storedBlockTextures.begin());
-    }
-}
-
-bool Waveform::activateStoredBlockTextureForView(
-    const BaseTextureCacheKey &newKey) const
-{
-    SDL_FRect sourceRect{};
-    for (std::size_t i = storedBlockTextures.size(); i > 0; --i)
-    {
-        auto &stored = storedBlockTextures[i - 1];
-        if (!stored.texture || !stored.valid)
-        {
-            continue;
-        }
-
-        const bool exactMatch = stored.key == newKey;
-        const bool reusable =
-            exactMatch ||
-            canRenderCurrentViewFromCachedBlockTexture(newKey, stored.key,
-                                                       sourceRect);
-        if (!reusable)
-        {
-            continue;
-        }
-
-        SDL_Texture *selectedTexture = stored.texture;
-        const BaseTextureCacheKey selectedKey = stored.key;
-        const bool selectedValid = stored.valid;
-        const SDL_FRect selectedSourceRect =
-            exactMatch
-                ? SDL_FRect{0.0f, 0.0f, static_cast<float>(newKey.width),
-                            static_cast<float>(newKey.height)}
-                : sourceRect;
-        stored.texture = nullptr;
-        stored.valid = false;
-        storedBlockTextures.erase(storedBlockTextures.begin() +
-                                  static_cast<std::ptrdiff_t>(i - 1));
-
-        storeCurrentBlockTexture();
-        cachedBaseTexture = selectedTexture;
-        cachedBaseTextureKey = selectedKey;
-        cachedBaseTextureValid = selectedValid;
-        cachedBaseTextureSourceRect = selectedSourceRect;
-        return true;
-    }
-
-    return false;
-}
-
 void Waveform::updateSamplePoints()
 {
     removeAllChildren();
@@ -1625,15 +1134,14 @@ std::vector<std::unique_ptr<SamplePoint>> Waveform::computeSamplePoints()
     const auto &session = state->getActiveDocumentSession();
     const auto &doc = session.document;
     const auto &viewState = state->getActiveViewState();
-    const auto sampleData =
-        doc.getAudioBuffer()->getImmutableChannelData(channelIndex);
+    auto sampleData = doc.getAudioBuffer()->getChannelReader(channelIndex);
     const auto plannedPoints = planWaveformSamplePoints(
         getWidth(), getHeight(), viewState.samplesPerPixel,
         viewState.sampleOffset, state->pixelScale, viewState.verticalZoom,
         doc.getFrameCount(),
         [&](const int64_t sampleIndex)
         {
-            return sampleData[static_cast<std::size_t>(sampleIndex)];
+            return sampleData[sampleIndex];
         },
         state->uiScale);
 
@@ -1729,34 +1237,23 @@ void Waveform::renderSmoothWaveform(SDL_Renderer *renderer) const
     }
 
     const auto &session = state->getActiveDocumentSession();
-    const auto &doc = session.document;
     const auto &viewState = state->getActiveViewState();
-    const auto samplesPerPixel = viewState.samplesPerPixel;
-    const double halfSampleWidth = 0.5 / samplesPerPixel;
-    const int64_t sampleOffset = viewState.sampleOffset;
-    const auto sampleData =
-        doc.getAudioBuffer()->getImmutableChannelData(channelIndex);
-    const auto frameCount = doc.getFrameCount();
+    const auto lease = session.document.acquireReadLease();
     const auto verticalZoom = viewState.verticalZoom;
-    const auto widthToUse = getWidth();
     const auto heightToUse = getHeight();
     const auto samplePointSize =
         getWaveformSamplePointSize(state->pixelScale, state->uiScale);
     const auto drawableHeight = heightToUse - samplePointSize;
 
-    const auto input = planWaveformSmoothRenderInput(
-        widthToUse, samplesPerPixel, sampleOffset, halfSampleWidth, frameCount,
-        [&](const int64_t sampleIndex)
+    const auto smoothedY = smoothReconstructor.reconstruct(
+        getWidth(), viewState.samplesPerPixel, viewState.sampleOffset,
+        lease.getFrameCount(),
+        [&](const int64_t startFrame, float *destination,
+            const int64_t frameCount)
         {
-            return sampleData[static_cast<std::size_t>(sampleIndex)];
+            return lease.readFrames(channelIndex, startFrame, destination,
+                                    frameCount);
         });
-
-    if (input.sampleX.empty())
-    {
-        return;
-    }
-
-    const auto smoothedY = evaluateWaveformSmoothSpline(input);
     if (smoothedY.empty())
     {
         return;
@@ -1765,16 +1262,6 @@ void Waveform::renderSmoothWaveform(SDL_Renderer *renderer) const
     SDL_SetRenderDrawColor(renderer, waveformColor.r, waveformColor.g,
                            waveformColor.b, waveformColor.a);
 
-    if (smoothedY.size() == 1 || input.queryX.size() == 1)
-    {
-        const int x = static_cast<int>(std::lround(input.queryX.front()));
-        const int y = static_cast<int>(
-            std::lround(heightToUse / 2.0f - smoothedY.front() * verticalZoom *
-                                                  drawableHeight / 2.0f));
-        SDL_RenderPoint(renderer, x, y);
-        return;
-    }
-
     const auto sampleYToScreenY = [&](const double sampleValue)
     {
         return static_cast<int>(std::lround(
@@ -1783,29 +1270,26 @@ void Waveform::renderSmoothWaveform(SDL_Renderer *renderer) const
                 2.0f));
     };
 
-    std::vector<SDL_Vertex> vertices;
-    std::vector<int> indices;
-    vertices.reserve(smoothedY.size() * 4);
-    indices.reserve(smoothedY.size() * 6);
+    if (smoothedY.size() == 1)
+    {
+        SDL_RenderPoint(renderer, 0, sampleYToScreenY(smoothedY.front()));
+        return;
+    }
+
+    auto &vertices = smoothVertices;
+    auto &indices = smoothIndices;
+    vertices.clear();
+    indices.clear();
 
-    for (std::size_t i = 0; i + 1 < smoothedY.size() && i + 1 < input.queryX.size();
-         ++i)
+    // smoothedY[x] is the value at pixel x.
+    for (std::size_t i = 0; i + 1 < smoothedY.size(); ++i)
     {
-        const float x1 = static_cast<float>(input.queryX[i]);
-        const float x2 = static_cast<float>(input.queryX[i + 1]);
+        const float x1 = static_cast<float>(i);
+        const float x2 = static_cast<float>(i + 1);
         const float y1 = static_cast<float>(sampleYToScreenY(smoothedY[i]));
         const float y2 = static_cast<float>(sampleYToScreenY(smoothedY[i + 1]));
 
-        if (std::lround(x1) == std::lround(x2) &&
-            std::lround(y1) == std::lround(y2))
-        {
-            appendPointQuad(vertices, indices, static_cast<int>(std::lround(x1)),
-                            static_cast<int>(std::lround(y1)), waveformFColor);
-        }
-        else
-        {
-            appendLineQuad(vertices, indices, x1, y1, x2, y2, waveformFColor);
-        }
+        appendLineQuad(vertices, indices, x1, y1, x2, y2, waveformFColor);
     }
 
     if (!vertices.empty() && !indices.empty())
@@ -2041,41 +1525,28 @@ void Waveform::drawHighlight(SDL_Renderer *renderer) const
 void Waveform::onDraw(SDL_Renderer *renderer)
 {
     const auto currentKey = computeBaseTextureCacheKey();
-    const bool progressiveGeometryVisible =
-        currentKey.samplesPerPixel >= 1.0 &&
-        hasProgressiveBlockBuildGeometryForKey(currentKey);
-    if (progressiveGeometryVisible &&
-        (isWaveformCacheBuildActive() || !cachedBaseTextureValid))
+    const bool isBlockMode = currentKey.samplesPerPixel >= 1.0;
+    const bool isBuildActive = isBlockMode && isWaveformCacheBuildActive();
+    if (isBuildActive && hasProgressiveBlockBuildGeometryForKey(currentKey))
     {
-        if (isWaveformCacheBuildActive())
+        handleWaveformCacheUpdate();
+        drawProgressiveBlockBuildWaveform(renderer, currentKey);
+    }
+    else if (isBlockMode)
+    {
+        // While peaks are being built the view follows them directly.
+        if (isBuildActive || !drawBlockTiles(renderer))
         {
-            handleWaveformCacheUpdate();
-            drawProgressiveBlockBuildWaveform(renderer, currentKey);
+            drawBaseWaveformContents(renderer);
         }
-        else
+        if (!isBuildActive)
         {
-            if (ensureBaseTexture(renderer))
-            {
-                SDL_RenderTexture(renderer, cachedBaseTexture,
-                                  &cachedBaseTextureSourceRect, nullptr);
-            }
-            else
-            {
-                drawProgressiveBlockBuildWaveform(renderer, currentKey);
-            }
+            clearProgressiveBlockBuildGeometry();
         }
-        drawSelection(renderer);
-        drawHighlight(renderer);
-        drawMarkers(renderer);
-        drawCursor(renderer);
-        drawPlaybackPosition(renderer);
-        return;
     }
-
-    if (ensureBaseTexture(renderer))
+    else if (ensureBaseTexture(renderer))
     {
-        SDL_RenderTexture(renderer, cachedBaseTexture,
-                          &cachedBaseTextureSourceRect, nullptr);
+        SDL_RenderTexture(renderer, cachedBaseTexture, nullptr, nullptr);
     }
     else
     {
@@ -2164,12 +1635,12 @@ void Waveform::timerCallback()
 {
     if (state &&
         state->getActiveDocumentSession().pumpWaveformCacheWork(
-            state->paths.get()))
+            state->paths.get(), state->waveformCacheSettings))
     {
         applyAllPendingCacheUpdates(state);
     }
 
-    if (consumePublishedBackgroundBlockRenderChunks())
+    if (consumePublishedBackgroundTileRenders())
     {
         setDirty();
     }
@@ -1,10 +1,13 @@
 #pragma once
 #include "Component.hpp"
 #include "../State.hpp"
-#include "../concurrency/LatestWinsBackgroundWorker.hpp"
 #include <SDL3/SDL.h>
 
 #include "SamplePoint.hpp"
+#include "WaveformFrameLayout.hpp"
+#include "WaveformSmoothReconstruction.hpp"
+#include "WaveformTilePool.hpp"
+#include "WaveformTileRenderPool.hpp"
 
 #include <memory>
 #include <optional>
@@ -254,6 +257,8 @@ namespace cupuacu::gui
         mutable std::vector<double> smoothXBuffer;
         mutable std::vector<double> smoothYBuffer;
         mutable std::vector<double> smoothQueryBuffer;
+        // The whole view, while samples are drawn as a smooth line. Block
+        // mode draws from blockTiles instead.
         mutable SDL_Texture *cachedBaseTexture = nullptr;
 
         struct BaseTextureCacheKey
@@ -271,64 +276,27 @@ namespace cupuacu::gui
 
             bool operator==(const BaseTextureCacheKey &other) const = default;
         };
-        struct StoredBlockTexture
-        {
-            SDL_Texture *texture = nullptr;
-            BaseTextureCacheKey key{};
-            bool valid = false;
-        };
-        struct BackgroundBlockRenderRequest
-        {
-            BaseTextureCacheKey key{};
-            int64_t frameCount = 0;
-            float uiScale = 1.0f;
-            bool bypassCache = true;
-            int cacheLevel = 0;
-            int64_t samplesPerPeak = 0;
-            int64_t cachedPeakStart = 0;
-            int64_t rawSampleStart = 0;
-            std::vector<float> rawSamples;
-            std::vector<Peak> cachedPeaks;
-        };
-        struct BackgroundBlockRenderChunk
-        {
-            BaseTextureCacheKey key{};
-            bool reset = false;
-            bool complete = false;
-            std::vector<SDL_Vertex> vertices;
-            std::vector<int> indices;
-        };
-        struct BackgroundBlockRenderProgress
-        {
-            std::uint64_t generation = 0;
-            BaseTextureCacheKey key{};
-            bool complete = false;
-            std::vector<SDL_Vertex> vertices;
-            std::vector<int> indices;
-        };
-        using BackgroundBlockRenderWorker =
-            cupuacu::concurrency::LatestWinsBackgroundWorker<
-                BackgroundBlockRenderRequest, BackgroundBlockRenderChunk>;
 
         mutable BaseTextureCacheKey cachedBaseTextureKey{};
         mutable bool cachedBaseTextureValid = false;
-        mutable SDL_FRect cachedBaseTextureSourceRect{
-            0.0f, 0.0f, 0.0f, 0.0f};
-        mutable int64_t cachedBaseTextureBuiltSamplePrefixEnd = -1;
-        mutable bool progressiveBlockTextureRefreshPending = false;
         mutable std::optional<BaseTextureCacheKey>
             progressiveBlockBuildGeometryKey;
         mutable int64_t progressiveBlockBuildSamplePrefixEnd = -1;
         mutable std::vector<SDL_Vertex> progressiveBlockBuildVertices;
         mutable std::vector<int> progressiveBlockBuildIndices;
-        mutable std::vector<StoredBlockTexture> storedBlockTextures;
-        mutable std::unique_ptr<BackgroundBlockRenderWorker>
-            backgroundBlockRenderWorker;
-        mutable std::optional<BaseTextureCacheKey>
-            requestedBackgroundBlockRenderKey;
-        mutable std::optional<BackgroundBlockRenderProgress>
-            backgroundBlockRenderProgress;
-        mutable std::uint64_t latestBackgroundBlockRenderGeneration = 0;
+        mutable WaveformSmoothReconstructor smoothReconstructor;
+        mutable std::vector<SDL_Vertex> smoothVertices;
+        mutable std::vector<int> smoothIndices;
+        mutable WaveformTilePool<SDL_Texture *> blockTiles;
+        // Whether the last block mode frame was drawn whole from blockTiles.
+        mutable bool viewDrawnFromBlockTiles = false;
+        // Prefetches tiles on the pool that all waveforms share.
+        mutable WaveformTileRenderPool::Client tileRenderClient;
+        mutable std::optional<WaveformTileKey> requestedBackgroundTileKey;
+        mutable std::uint64_t latestBackgroundTileRenderGeneration = 0;
+        // A prefetched tile waiting for the renderer to give it a texture.
+        mutable std::optional<WaveformTileRenderResult>
+            backgroundTileRenderResult;
 
         std::vector<std::unique_ptr<SamplePoint>> computeSamplePoints();
 
@@ -336,49 +304,30 @@ namespace cupuacu::gui
         void invalidateBaseTexture() const;
         bool ensureBaseTexture(SDL_Renderer *) const;
         BaseTextureCacheKey computeBaseTextureCacheKey() const;
-        BaseTextureCacheKey
-        makeCurrentBlockTextureCoverageKey(const BaseTextureCacheKey &) const;
-        BaseTextureCacheKey chooseBaseTextureTargetKey(
-            const BaseTextureCacheKey &, bool allowBlockCoverageReuse) const;
-        bool canRenderCurrentViewFromCachedBlockTexture(
-            const BaseTextureCacheKey &currentViewKey,
-            const BaseTextureCacheKey &sourceTextureKey,
-            SDL_FRect &outSourceRect) const;
         bool ensureBaseTextureStorage(SDL_Renderer *,
                                       const BaseTextureCacheKey &) const;
         void renderBaseTexture(SDL_Renderer *,
-                               const BaseTextureCacheKey &targetKey,
-                               bool isBlockMode) const;
+                               const BaseTextureCacheKey &targetKey) const;
         bool isWaveformCacheBuildActive() const;
         int64_t currentBuiltSamplePrefixEnd() const;
         bool hasProgressiveBlockBuildGeometryForKey(
             const BaseTextureCacheKey &key) const;
-        void rememberRenderedBlockTextureFrontier(
-            const BaseTextureCacheKey &targetKey) const;
-        bool refreshProgressiveBlockTexture(
-            SDL_Renderer *renderer,
-            const BaseTextureCacheKey &targetKey) const;
         void handleWaveformCacheUpdate() const;
-        void renderBaseTextureFromBackgroundPlan(
-            SDL_Renderer *, const BackgroundBlockRenderProgress &plan) const;
-        void finalizeBaseTextureForView(const BaseTextureCacheKey &newKey,
-                                        const BaseTextureCacheKey &targetKey,
-                                        bool allowBlockCoverageReuse) const;
-        bool canReuseBlockTextureForHorizontalShift(
-            const BaseTextureCacheKey &newKey, int &outPixelShift) const;
-        bool rebuildShiftedBlockTexture(SDL_Renderer *,
-                                        const BaseTextureCacheKey &newKey,
-                                        int pixelShift) const;
         void destroyTexture(SDL_Texture *&) const;
-        void storeCurrentBlockTexture() const;
-        void trimStoredBlockTextures() const;
-        bool activateStoredBlockTextureForView(
-            const BaseTextureCacheKey &newKey) const;
+        WaveformTileKey makeBlockTileKey(int64_t tileIndex) const;
+        SDL_Texture *createBlockTileTexture(SDL_Renderer *,
+                                            const WaveformTileKey &) const;
+        void fillBlockTileTexture(SDL_Renderer *, SDL_Texture *,
+                                  const std::vector<SDL_Vertex> &vertices,
+                                  const std::vector<int> &indices) const;
+        SDL_Texture *renderBlockTile(SDL_Renderer *,
+                                     const WaveformTileKey &) const;
+        bool drawBlockTiles(SDL_Renderer *) const;
+        void prefetchBlockTilesAround(const WaveformTileSpan &) const;
+        void storeBackgroundRenderedTile(SDL_Renderer *) const;
         void drawBaseWaveformContents(SDL_Renderer *) const;
         void drawProgressiveBlockBuildWaveform(
             SDL_Renderer *, const BaseTextureCacheKey &key) const;
-        bool promoteProgressiveBlockBuildGeometryToTexture(
-            SDL_Renderer *, const BaseTextureCacheKey &key) const;
         void appendBlockWaveformGeometryRange(
             std::vector<SDL_Vertex> &vertices, std::vector<int> &indices,
             int xStart, int xEndExclusive, int widthToUse,
@@ -407,17 +356,14 @@ namespace cupuacu::gui
         void drawPlaybackPosition(SDL_Renderer *) const;
         void drawMarkers(SDL_Renderer *) const;
         void drawCursor(SDL_Renderer *) const;
-        std::optional<BackgroundBlockRenderRequest>
-        captureBackgroundBlockRenderRequest(
-            const BaseTextureCacheKey &targetKey) const;
-        void processBackgroundBlockRenderRequest(
-            const BackgroundBlockRenderRequest &request,
+        std::optional<WaveformTileRenderRequest>
+        captureBackgroundTileRenderRequest(const WaveformTileKey &) const;
+        static void processBackgroundTileRenderRequest(
+            const WaveformTileRenderRequest &request,
             std::uint64_t generation,
-            const BackgroundBlockRenderWorker::CancelCheck &isCanceled,
-            const BackgroundBlockRenderWorker::PublishFn &publish) const;
-        void ensureBackgroundBlockRenderWorker() const;
-        void requestBackgroundBlockRenderPlan(
-            const BaseTextureCacheKey &targetKey) const;
-        bool consumePublishedBackgroundBlockRenderChunks() const;
+            const WaveformTileRenderPool::CancelCheck &isCanceled,
+            const WaveformTileRenderPool::PublishFn &publish);
+        void connectTileRenderClient() const;
+        bool consumePublishedBackgroundTileRenders() const;
     };
 } // namespace cupuacu::gui
@@ -1,29 +1,46 @@
 #pragma once
+#include "WaveformFrameLayout.hpp"
+#include "WaveformPeakKernels.hpp"
+
 #include <vector>
 #include <cstdint>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <span>
+#include <type_traits>
 
 namespace cupuacu::gui
 {
-
-    struct Peak
-    {
-        float min;
-        float max;
-    };
-
     class WaveformCache
     {
     public:
         constexpr static int BASE_BLOCK_SIZE = 128;
         constexpr static int MAX_LEVEL_COUNT = 16;
 
+        // Inserts and erases move frames through the grid by multiples of
+        // SHIFT_ALIGNMENT, so the peaks of the levels below
+        // SHIFTED_LEVEL_COUNT move along unchanged. Only the peaks next to
+        // the edit and the levels above are computed again.
+        constexpr static int SHIFTED_LEVEL_COUNT = 7;
+        constexpr static int64_t SHIFT_ALIGNMENT =
+            int64_t{BASE_BLOCK_SIZE} << (SHIFTED_LEVEL_COUNT - 1);
+
+        // The peak of grid positions that hold no frames.
+        constexpr static Peak EMPTY_PEAK{
+            std::numeric_limits<float>::infinity(),
+            -std::numeric_limits<float>::infinity()};
+        constexpr static BlockEnergy EMPTY_ENERGY{};
+
+        // Each peak node has an energy node beside it, kept in
+        // energyLevels, which are shaped like the levels of peaks.
         struct LevelSpanUpdate
         {
             int level = 0;
             int64_t fromIndex = 0;
             std::vector<Peak> peaks;
+            std::vector<BlockEnergy> energies;
         };
 
         struct BuildState
@@ -32,6 +49,8 @@ namespace cupuacu::gui
             int64_t dirtyFromBlock = INT64_MAX;
             int64_t dirtyToBlock = -1;
             std::vector<std::vector<Peak>> levels;
+            std::vector<std::vector<BlockEnergy>> energyLevels;
+            WaveformFrameLayout layout;
         };
 
         struct BuildResult
@@ -40,6 +59,51 @@ namespace cupuacu::gui
             int64_t dirtyFromBlock = INT64_MAX;
             int64_t dirtyToBlock = -1;
             std::vector<std::vector<Peak>> levels;
+            std::vector<std::vector<BlockEnergy>> energyLevels;
+            WaveformFrameLayout layout;
+        };
+
+        // Built peaks of every level held in memory the cache does not own,
+        // such as a mapped cache file, which storage keeps alive. They are
+        // read in place and only copied once the cache is changed.
+        struct MappedLevels
+        {
+            std::shared_ptr<const void> storage;
+            std::vector<std::span<const Peak>> levels;
+            std::vector<std::span<const BlockEnergy>> energyLevels;
+        };
+
+        // The peaks of one level, which stay as they are for as long as
+        // storage is held, however the cache changes since.
+        struct PinnedLevel
+        {
+            std::shared_ptr<const void> storage;
+            std::span<const Peak> peaks;
+        };
+
+        // The extremes, energy and clip count of a range of frames.
+        struct RangeStatistics
+        {
+            Peak peak = EMPTY_PEAK;
+            double sumOfSquares = 0.0;
+            int64_t clipCount = 0;
+            int64_t frameCount = 0;
+
+            // The largest sample magnitude, 0 for no frames.
+            [[nodiscard]] float magnitude() const
+            {
+                return frameCount > 0
+                           ? std::max(std::fabs(peak.min), std::fabs(peak.max))
+                           : 0.0f;
+            }
+
+            [[nodiscard]] double rms() const
+            {
+                return frameCount > 0
+                           ? std::sqrt(std::max(0.0, sumOfSquares) /
+                                       static_cast<double>(frameCount))
+                           : 0.0;
+            }
         };
 
         WaveformCache()
@@ -49,8 +113,11 @@ namespace cupuacu::gui
 
         void clear()
         {
-            levels.clear();
+            levels = std::make_shared<PeakLevels>();
+            energyLevels.clear();
+            mappedLevels.reset();
             numSamples = 0;
+            layout.reset(0);
             dirtyFromBlock = INT64_MAX;
             dirtyToBlock = -1;
         }
@@ -58,6 +125,7 @@ namespace cupuacu::gui
         void init(const int64_t n)
         {
             numSamples = std::max<int64_t>(0, n);
+            layout.reset(numSamples);
             buildStorage();
             markAllDirty();
         }
@@ -65,6 +133,7 @@ namespace cupuacu::gui
         void rebuildAll(const float *samples, const int64_t n)
         {
             numSamples = std::max<int64_t>(0, n);
+            layout.reset(numSamples);
             buildStorage();
             dirtyFromBlock = 0;
             dirtyToBlock = level0Size() - 1;
@@ -77,7 +146,7 @@ namespace cupuacu::gui
             {
                 std::swap(startSample, endSample);
             }
-            if (levels.empty() || numSamples <= 0)
+            if (storedLevelCount() == 0 || numSamples <= 0)
             {
                 return;
             }
@@ -85,8 +154,9 @@ namespace cupuacu::gui
             startSample = std::clamp<int64_t>(startSample, 0, numSamples - 1);
             endSample = std::clamp<int64_t>(endSample, 0, numSamples - 1);
 
-            const int64_t b0 = startSample / BASE_BLOCK_SIZE;
-            const int64_t b1 = endSample / BASE_BLOCK_SIZE;
+            const int64_t b0 =
+                layout.gridPositionOf(startSample) / BASE_BLOCK_SIZE;
+            const int64_t b1 = layout.gridPositionOf(endSample) / BASE_BLOCK_SIZE;
             markDirtyBlocks(b0, b1);
         }
 
@@ -97,14 +167,14 @@ namespace cupuacu::gui
 
         int getLevelIndex(const double samplesPerPixel) const
         {
-            if (levels.empty())
+            if (storedLevelCount() == 0)
             {
                 return 0;
             }
             const double eff =
                 std::max(1.0, samplesPerPixel / (double)BASE_BLOCK_SIZE);
             const int level = (int)std::floor(std::log2(eff));
-            return std::clamp(level, 0, (int)levels.size() - 1);
+            return std::clamp(level, 0, storedLevelCount() - 1);
         }
 
         static int64_t samplesPerPeakForLevel(int level)
@@ -113,14 +183,58 @@ namespace cupuacu::gui
             return (int64_t)BASE_BLOCK_SIZE << level;
         }
 
-        const std::vector<Peak> &getLevelByIndex(int level) const
+        std::span<const Peak> getLevelByIndex(int level) const
         {
-            if (levels.empty())
+            if (storedLevelCount() == 0)
+            {
+                return {};
+            }
+            level = std::clamp(level, 0, storedLevelCount() - 1);
+            if (mappedLevels)
             {
-                return empty;
+                return mappedLevels->levels[static_cast<std::size_t>(level)];
             }
-            level = std::clamp(level, 0, (int)levels.size() - 1);
-            return levels[level];
+            return (*levels)[static_cast<std::size_t>(level)];
+        }
+
+        // getLevelByIndex(level), for reading on another thread without
+        // copying it. The next change to the cache copies the levels
+        // instead of changing them while it is held.
+        [[nodiscard]] PinnedLevel pinLevel(int level) const
+        {
+            if (storedLevelCount() == 0)
+            {
+                return {};
+            }
+            level = std::clamp(level, 0, storedLevelCount() - 1);
+            if (mappedLevels)
+            {
+                return {
+                    .storage = mappedLevels,
+                    .peaks =
+                        mappedLevels->levels[static_cast<std::size_t>(level)],
+                };
+            }
+            return {
+                .storage = levels,
+                .peaks = (*levels)[static_cast<std::size_t>(level)],
+            };
+        }
+
+        // The energies beside the peaks of getLevelByIndex(level).
+        std::span<const BlockEnergy> getEnergyLevelByIndex(int level) const
+        {
+            if (storedLevelCount() == 0)
+            {
+                return {};
+            }
+            level = std::clamp(level, 0, storedLevelCount() - 1);
+            if (mappedLevels)
+            {
+                return mappedLevels
+                    ->energyLevels[static_cast<std::size_t>(level)];
+            }
+            return energyLevels[static_cast<std::size_t>(level)];
         }
 
         void applyInsert(int64_t posSample, const int64_t countSamples)
@@ -131,37 +245,43 @@ namespace cupuacu::gui
             }
 
             posSample = std::clamp<int64_t>(posSample, 0, numSamples);
-            numSamples += countSamples;
-
-            if (levels.empty())
+            copyMappedLevels();
+            if (levels->empty() || numSamples <= 0)
             {
+                numSamples += countSamples;
+                layout.reset(numSamples);
                 buildStorage();
+                markAllDirty();
+                return;
             }
-            else
-            {
-                const int64_t oldL0 = (int64_t)levels[0].size();
-                const int64_t newL0 = level0Size();
-
-                levels[0].resize(newL0);
 
-                const int64_t insertBlock = posSample / BASE_BLOCK_SIZE;
-                const int64_t shift = newL0 - oldL0;
-                if (shift > 0 && insertBlock < oldL0)
-                {
-                    std::move_backward(levels[0].begin() + insertBlock,
-                                       levels[0].begin() + oldL0,
-                                       levels[0].begin() + oldL0 + shift);
-                }
+            const auto insertion =
+                layout.insertFrames(posSample, countSamples, SHIFT_ALIGNMENT);
+            numSamples += countSamples;
 
-                for (int l = 1; l < (int)levels.size(); ++l)
+            int64_t lastDirtyBlock =
+                (insertion.gridStart + countSamples - 1) / BASE_BLOCK_SIZE;
+            if (insertion.shift > 0)
+            {
+                const int64_t firstMovedBlock =
+                    (insertion.shiftAt + BASE_BLOCK_SIZE - 1) / BASE_BLOCK_SIZE;
+                insertBlocks(firstMovedBlock,
+                             insertion.shift / BASE_BLOCK_SIZE);
+                // The block the moved frames start in was split. Its tail
+                // now shares a block with whatever precedes it.
+                if (insertion.shiftAt % BASE_BLOCK_SIZE != 0)
                 {
-                    levels[l].resize(levelSize(l));
+                    lastDirtyBlock = (insertion.shiftAt + insertion.shift) /
+                                     BASE_BLOCK_SIZE;
                 }
             }
+            else if (static_cast<int64_t>((*levels)[0].size()) != level0Size())
+            {
+                resizeLevels(insertion.gridStart / BASE_BLOCK_SIZE);
+            }
 
-            dirtyFromBlock =
-                std::min<int64_t>(dirtyFromBlock, posSample / BASE_BLOCK_SIZE);
-            dirtyToBlock = level0Size() - 1;
+            markDirtyBlocks(insertion.gridStart / BASE_BLOCK_SIZE,
+                            lastDirtyBlock);
         }
 
         void applyErase(int64_t startSample, int64_t endSample)
@@ -182,60 +302,62 @@ namespace cupuacu::gui
                 return;
             }
 
-            if (levels.empty())
+            const int64_t eraseCount = endSample - startSample;
+            copyMappedLevels();
+            if (levels->empty() || eraseCount >= numSamples)
             {
-                numSamples = std::max<int64_t>(
-                    0, numSamples - (endSample - startSample));
+                numSamples = std::max<int64_t>(0, numSamples - eraseCount);
+                layout.reset(numSamples);
                 buildStorage();
                 markAllDirty();
                 return;
             }
 
-            const int64_t eraseCount = endSample - startSample;
-
-            const int64_t oldL0 = (int64_t)levels[0].size();
-
-            const int64_t b0 = startSample / BASE_BLOCK_SIZE;
-            const int64_t b1 = (endSample - 1) / BASE_BLOCK_SIZE;
-            const int64_t tailStart = b1 + 1;
+            const auto gap = layout.eraseFrames(startSample, endSample);
+            numSamples -= eraseCount;
 
-            numSamples = std::max<int64_t>(0, numSamples - eraseCount);
-            const int64_t newL0 = level0Size();
-
-            if (oldL0 > 0)
+            if (gap.gridEnd >= layout.getGridLength())
             {
-                const int64_t dst = std::min<int64_t>(b0, oldL0);
-                const int64_t src = std::min<int64_t>(tailStart, oldL0);
-                if (src < oldL0 && dst < oldL0)
-                {
-                    std::move(levels[0].begin() + src,
-                              levels[0].begin() + oldL0,
-                              levels[0].begin() + dst);
-                }
-                levels[0].resize(newL0);
+                layout.truncateGrid(gap.gridStart);
+                const int64_t lastBlock = level0Size() - 1;
+                resizeLevels(lastBlock);
+                clampDirtyBlocks();
+                // The last block, and the nodes above it, may have covered
+                // erased frames.
+                markDirtyBlocks(lastBlock, lastBlock);
+                return;
             }
-            else
+
+            // Whole aligned stretches of the gap are taken out of the grid,
+            // which moves the frames after them left with their peaks.
+            const int64_t removeFrom = (gap.gridStart + SHIFT_ALIGNMENT - 1) /
+                                       SHIFT_ALIGNMENT * SHIFT_ALIGNMENT;
+            const int64_t removeTo =
+                gap.gridEnd / SHIFT_ALIGNMENT * SHIFT_ALIGNMENT;
+            int64_t gapEnd = gap.gridEnd;
+            if (removeTo > removeFrom)
             {
-                levels[0].resize(newL0);
+                layout.removeGridRange(removeFrom, removeTo);
+                removeBlocks(removeFrom / BASE_BLOCK_SIZE,
+                             (removeTo - removeFrom) / BASE_BLOCK_SIZE);
+                gapEnd -= removeTo - removeFrom;
             }
 
-            for (int l = 1; l < (int)levels.size(); ++l)
+            if (gapEnd > gap.gridStart)
             {
-                levels[l].resize(levelSize(l));
+                markDirtyBlocks(gap.gridStart / BASE_BLOCK_SIZE,
+                                (gapEnd - 1) / BASE_BLOCK_SIZE);
             }
-
-            dirtyFromBlock = std::min<int64_t>(dirtyFromBlock, b0);
-            dirtyToBlock = level0Size() - 1;
         }
 
-        const std::vector<Peak> &getLevel(const double samplesPerPixel) const
+        std::span<const Peak> getLevel(const double samplesPerPixel) const
         {
             return getLevelByIndex(getLevelIndex(samplesPerPixel));
         }
 
         int levelsCount() const
         {
-            return (int)levels.size();
+            return storedLevelCount();
         }
 
         [[nodiscard]] bool hasDirtyBlocks() const
@@ -243,6 +365,16 @@ namespace cupuacu::gui
             return dirtyToBlock >= dirtyFromBlock;
         }
 
+        [[nodiscard]] int64_t dirtyBlockCount() const
+        {
+            return hasDirtyBlocks() ? dirtyToBlock - dirtyFromBlock + 1 : 0;
+        }
+
+        [[nodiscard]] bool hasMappedLevels() const
+        {
+            return mappedLevels != nullptr;
+        }
+
         [[nodiscard]] int64_t builtSamplePrefixEnd() const
         {
             if (dirtyToBlock < dirtyFromBlock)
@@ -250,13 +382,14 @@ namespace cupuacu::gui
                 return numSamples;
             }
             return std::clamp<int64_t>(
-                dirtyFromBlock * static_cast<int64_t>(BASE_BLOCK_SIZE), 0,
-                numSamples);
+                layout.framesBefore(dirtyFromBlock *
+                                    static_cast<int64_t>(BASE_BLOCK_SIZE)),
+                0, numSamples);
         }
 
         [[nodiscard]] int64_t validPeakCountForLevel(const int level) const
         {
-            const auto &levelData = getLevelByIndex(level);
+            const auto levelData = getLevelByIndex(level);
             if (dirtyToBlock < dirtyFromBlock)
             {
                 return static_cast<int64_t>(levelData.size());
@@ -275,32 +408,88 @@ namespace cupuacu::gui
                 static_cast<int64_t>(levelData.size()));
         }
 
+        [[nodiscard]] const WaveformFrameLayout &getFrameLayout() const
+        {
+            return layout;
+        }
+
+        // True if the levels are laid out for a document of frameCount
+        // frames, built or not.
+        [[nodiscard]] bool isLaidOutFor(const int64_t frameCount) const
+        {
+            return storedLevelCount() > 0 && numSamples == frameCount &&
+                   layout.getFrameCount() == numSamples &&
+                   static_cast<int64_t>(getLevelByIndex(0).size()) ==
+                       level0Size();
+        }
+
         [[nodiscard]] BuildState snapshotBuildState() const
         {
-            return {
+            BuildState state{
                 .numSamples = numSamples,
                 .dirtyFromBlock = dirtyFromBlock,
                 .dirtyToBlock = dirtyToBlock,
-                .levels = levels,
+                .layout = layout,
             };
+            if (mappedLevels)
+            {
+                for (const auto &level : mappedLevels->levels)
+                {
+                    state.levels.emplace_back(level.begin(), level.end());
+                }
+                for (const auto &level : mappedLevels->energyLevels)
+                {
+                    state.energyLevels.emplace_back(level.begin(),
+                                                    level.end());
+                }
+            }
+            else
+            {
+                state.levels = *levels;
+                state.energyLevels = energyLevels;
+            }
+            return state;
         }
 
+        // Samples is anything indexable by int64_t frame: a raw pointer or an
+        // audio::ChannelBlocks::Reader.
+        template <typename Samples>
         [[nodiscard]] static BuildResult buildFromState(
             const BuildState &state,
-            const float *samples)
+            Samples samples)
         {
             BuildResult result{
                 .numSamples = state.numSamples,
                 .dirtyFromBlock = state.dirtyFromBlock,
                 .dirtyToBlock = state.dirtyToBlock,
                 .levels = state.levels,
+                .energyLevels = state.energyLevels,
+                .layout = state.layout,
             };
-            rebuildDirtyLevels(result.levels, result.numSamples,
+            rebuildDirtyLevels(result.levels, result.energyLevels,
+                               result.layout,
                                result.dirtyFromBlock, result.dirtyToBlock,
                                samples);
             return result;
         }
 
+        // The peak count of each level of a cache of numSamplesToUse
+        // frames laid out one after the other.
+        [[nodiscard]] static std::vector<int64_t>
+        levelSizesFor(const int64_t numSamplesToUse)
+        {
+            std::vector<int64_t> sizes{level0SizeFromSamples(numSamplesToUse)};
+            for (int l = 1; l < MAX_LEVEL_COUNT; ++l)
+            {
+                sizes.push_back((sizes.back() + 1) / 2);
+                if (sizes.back() <= 1)
+                {
+                    break;
+                }
+            }
+            return sizes;
+        }
+
         [[nodiscard]] static BuildState makeFullBuildState(
             const int64_t numSamplesToUse)
         {
@@ -318,28 +507,62 @@ namespace cupuacu::gui
             return state.dirtyToBlock - state.dirtyFromBlock + 1;
         }
 
+        // Results read back from older files carry no layout. Theirs is
+        // taken to be the plain one. Results without energies beside their
+        // peaks are built again from scratch.
         void applyBuildResult(BuildResult result)
         {
             numSamples = result.numSamples;
             dirtyFromBlock = result.dirtyFromBlock;
             dirtyToBlock = result.dirtyToBlock;
-            levels = std::move(result.levels);
+            levels =
+                std::make_shared<PeakLevels>(std::move(result.levels));
+            energyLevels = std::move(result.energyLevels);
+            mappedLevels.reset();
+            layout = std::move(result.layout);
+            if (layout.getFrameCount() != numSamples)
+            {
+                layout.reset(numSamples);
+            }
+            fitEnergyLevelsToLevels();
+        }
+
+        // Uses the fully built, plainly laid out peaks and energies of a
+        // document of numSamplesToUse frames in place. Both must have the
+        // sizes init(numSamplesToUse) would give the levels.
+        void applyMappedLevels(const int64_t numSamplesToUse,
+                               MappedLevels mapped)
+        {
+            numSamples = std::max<int64_t>(0, numSamplesToUse);
+            layout.reset(numSamples);
+            levels = std::make_shared<PeakLevels>();
+            energyLevels.clear();
+            mappedLevels =
+                std::make_shared<const MappedLevels>(std::move(mapped));
+            dirtyFromBlock = INT64_MAX;
+            dirtyToBlock = -1;
+            if (!sameShape(mappedLevels->energyLevels, mappedLevels->levels))
+            {
+                copyMappedLevels();
+            }
         }
 
-        static void rebuildDirtyBlockRange(std::vector<std::vector<Peak>> &levelsToUse,
-                                           const int64_t numSamplesToUse,
-                                           const int64_t fromBlock,
-                                           const int64_t toBlock,
-                                           const float *samples)
+        static void rebuildDirtyBlockRange(
+            std::vector<std::vector<Peak>> &levelsToUse,
+            std::vector<std::vector<BlockEnergy>> &energyLevelsToUse,
+            const int64_t numSamplesToUse, const int64_t fromBlock,
+            const int64_t toBlock, const float *samples)
         {
             int64_t dirtyFromBlockToUse = fromBlock;
             int64_t dirtyToBlockToUse = toBlock;
-            rebuildDirtyLevels(levelsToUse, numSamplesToUse, dirtyFromBlockToUse,
-                               dirtyToBlockToUse, samples);
+            rebuildDirtyLevels(levelsToUse, energyLevelsToUse,
+                               WaveformFrameLayout(numSamplesToUse),
+                               dirtyFromBlockToUse, dirtyToBlockToUse, samples);
         }
 
         static void rebuildDirtyBlockRangeFromSlice(
             std::vector<std::vector<Peak>> &levelsToUse,
+            std::vector<std::vector<BlockEnergy>> &energyLevelsToUse,
             const int64_t numSamplesToUse, const int64_t fromBlock,
             const int64_t toBlock, const int64_t sampleBaseIndex,
             const float *samples, const int64_t samplesCount)
@@ -359,73 +582,46 @@ namespace cupuacu::gui
             const int64_t from0 = std::clamp<int64_t>(fromBlock, 0, max0);
             const int64_t to0 = std::clamp<int64_t>(toBlock, 0, max0);
 
-            for (int64_t blk = from0; blk <= to0; ++blk)
+            // Blocks not wholly inside the slice keep their peaks. The ones
+            // inside it are contiguous.
+            const auto blockInSlice = [&](const int64_t blk)
             {
                 const int64_t s0 = blk * static_cast<int64_t>(BASE_BLOCK_SIZE);
                 const int64_t s1 =
                     std::min<int64_t>(s0 + BASE_BLOCK_SIZE, numSamplesToUse);
-                if (s0 >= s1)
-                {
-                    levelsToUse[0][blk] = {0.0f, 0.0f};
-                    continue;
-                }
-
-                const int64_t localS0 = s0 - sampleBaseIndex;
-                const int64_t localS1 = s1 - sampleBaseIndex;
-                if (localS0 < 0 || localS1 > samplesCount)
-                {
-                    continue;
-                }
-
-                float minv = samples[localS0];
-                float maxv = minv;
-                for (int64_t i = localS0 + 1; i < localS1; ++i)
-                {
-                    const float v = samples[i];
-                    minv = std::min(minv, v);
-                    maxv = std::max(maxv, v);
-                }
-                levelsToUse[0][blk] = {minv, maxv};
+                return s0 >= sampleBaseIndex &&
+                       s1 - sampleBaseIndex <= samplesCount;
+            };
+            int64_t sliceFrom = from0;
+            int64_t sliceTo = to0;
+            while (sliceFrom <= sliceTo && !blockInSlice(sliceFrom))
+            {
+                ++sliceFrom;
             }
-
-            int64_t pFrom = from0;
-            int64_t pTo = to0;
-            for (int level = 1; level < static_cast<int>(levelsToUse.size());
-                 ++level)
+            while (sliceTo >= sliceFrom && !blockInSlice(sliceTo))
             {
-                auto &prev = levelsToUse[static_cast<std::size_t>(level - 1)];
-                auto &cur = levelsToUse[static_cast<std::size_t>(level)];
-                if (cur.empty())
-                {
-                    break;
-                }
-
-                int64_t cFrom = std::clamp<int64_t>(
-                    pFrom / 2, 0, static_cast<int64_t>(cur.size()) - 1);
-                int64_t cTo = std::clamp<int64_t>(
-                    pTo / 2, 0, static_cast<int64_t>(cur.size()) - 1);
-                for (int64_t i = cFrom; i <= cTo; ++i)
-                {
-                    const int64_t a = i * 2;
-                    const int64_t b = a + 1;
-
-                    float minv = prev[a].min;
-                    float maxv = prev[a].max;
-                    if (b < static_cast<int64_t>(prev.size()))
-                    {
-                        minv = std::min(minv, prev[b].min);
-                        maxv = std::max(maxv, prev[b].max);
-                    }
-                    cur[i] = {minv, maxv};
-                }
-
-                pFrom = cFrom;
-                pTo = cTo;
-                if (static_cast<int64_t>(cur.size()) <= 1)
+                --sliceTo;
+            }
+            if (sliceFrom <= sliceTo)
+            {
+                const int64_t s0 =
+                    sliceFrom * static_cast<int64_t>(BASE_BLOCK_SIZE);
+                const int64_t s1 = std::min<int64_t>(
+                    (sliceTo + 1) * BASE_BLOCK_SIZE, numSamplesToUse);
+                computeBlockPeaks(samples + (s0 - sampleBaseIndex), s1 - s0,
+                                  BASE_BLOCK_SIZE,
+                                  levelsToUse[0].data() + sliceFrom);
+                if (!energyLevelsToUse.empty())
                 {
-                    break;
+                    computeBlockEnergies(samples + (s0 - sampleBaseIndex),
+                                         s1 - s0, BASE_BLOCK_SIZE,
+                                         energyLevelsToUse[0].data() +
+                                             sliceFrom);
                 }
             }
+
+            foldDirtyLevels(levelsToUse, from0, to0);
+            foldDirtyLevels(energyLevelsToUse, from0, to0);
         }
 
         void applyLevelSpanUpdates(const int64_t numSamplesToUse,
@@ -433,11 +629,11 @@ namespace cupuacu::gui
                                    const int64_t builtToBlock,
                                    const std::vector<LevelSpanUpdate> &updates)
         {
-            numSamples = std::max<int64_t>(0, numSamplesToUse);
-            const int64_t expectedLevel0Size = level0SizeFromSamples(numSamples);
-            if (levels.empty() ||
-                static_cast<int64_t>(levels.front().size()) != expectedLevel0Size)
+            copyMappedLevels();
+            if (!isLaidOutFor(std::max<int64_t>(0, numSamplesToUse)))
             {
+                numSamples = std::max<int64_t>(0, numSamplesToUse);
+                layout.reset(numSamples);
                 buildStorage();
                 markAllDirty();
             }
@@ -445,13 +641,17 @@ namespace cupuacu::gui
             for (const auto &update : updates)
             {
                 if (update.level < 0 ||
-                    update.level >= static_cast<int>(levels.size()) ||
-                    update.peaks.empty())
+                    update.level >= static_cast<int>(levels->size()) ||
+                    update.peaks.empty() ||
+                    update.energies.size() != update.peaks.size())
                 {
                     continue;
                 }
 
-                auto &level = levels[static_cast<std::size_t>(update.level)];
+                auto &level =
+                    ownLevels()[static_cast<std::size_t>(update.level)];
+                auto &energyLevel =
+                    energyLevels[static_cast<std::size_t>(update.level)];
                 const int64_t fromIndex =
                     std::clamp<int64_t>(update.fromIndex, 0,
                                         static_cast<int64_t>(level.size()));
@@ -461,8 +661,10 @@ namespace cupuacu::gui
                     static_cast<int64_t>(update.peaks.size()), 0, maxWritable);
                 for (int64_t i = 0; i < count; ++i)
                 {
-                    level[static_cast<std::size_t>(fromIndex + i)] =
-                        update.peaks[static_cast<std::size_t>(i)];
+                    const auto at = static_cast<std::size_t>(fromIndex + i);
+                    level[at] = update.peaks[static_cast<std::size_t>(i)];
+                    energyLevel[at] =
+                        update.energies[static_cast<std::size_t>(i)];
                 }
             }
 
@@ -483,20 +685,195 @@ namespace cupuacu::gui
             }
         }
 
-        void rebuildDirty(const float *samples)
+        // Refolds levels 1 and up above level-0 blocks from0..to0, which
+        // must be indices into levelsToUse[0]. Works on peaks and energies.
+        template <typename Node>
+        static void foldDirtyLevels(std::vector<std::vector<Node>> &levelsToUse,
+                                    const int64_t from0, const int64_t to0)
+        {
+            int64_t pFrom = from0;
+            int64_t pTo = to0;
+
+            for (int l = 1; l < (int)levelsToUse.size(); ++l)
+            {
+                const auto &prev = levelsToUse[l - 1];
+                auto &cur = levelsToUse[l];
+
+                if (cur.empty())
+                {
+                    break;
+                }
+
+                int64_t cFrom = pFrom / 2;
+                int64_t cTo = pTo / 2;
+
+                cFrom = std::clamp<int64_t>(cFrom, 0, (int64_t)cur.size() - 1);
+                cTo = std::clamp<int64_t>(cTo, 0, (int64_t)cur.size() - 1);
+
+                const int64_t prevFrom = cFrom * 2;
+                const int64_t prevCount = std::min<int64_t>(
+                    (cTo - cFrom + 1) * 2, (int64_t)prev.size() - prevFrom);
+                foldNodes(prev.data() + prevFrom, prevCount,
+                          cur.data() + cFrom);
+
+                pFrom = cFrom;
+                pTo = cTo;
+                if ((int64_t)cur.size() <= 1)
+                {
+                    break;
+                }
+            }
+        }
+
+        template <typename Samples>
+        void rebuildDirty(Samples samples)
         {
             auto result = buildFromState(snapshotBuildState(), samples);
             applyBuildResult(std::move(result));
         }
 
+        // Computes the level-0 peaks and energies of blocks
+        // fromBlock..toBlock into peaks and energies.
+        // readFrames(frameStart, frameCount) returns a pointer to that many
+        // frames, which stays valid until it is called again.
+        template <typename ReadFrames>
+        static void computeLevel0Peaks(const WaveformFrameLayout &layoutToUse,
+                                       const int64_t fromBlock,
+                                       const int64_t toBlock,
+                                       ReadFrames &&readFrames, Peak *peaks,
+                                       BlockEnergy *energies)
+        {
+            if (toBlock < fromBlock)
+            {
+                return;
+            }
+
+            std::fill(peaks, peaks + (toBlock - fromBlock + 1), EMPTY_PEAK);
+            std::fill(energies, energies + (toBlock - fromBlock + 1),
+                      EMPTY_ENERGY);
+            layoutToUse.forEachRunInGrid(
+                fromBlock * BASE_BLOCK_SIZE, (toBlock + 1) * BASE_BLOCK_SIZE,
+                [&](const int64_t frameStart, const int64_t frameEnd,
+                    const int64_t gridStart)
+                {
+                    const int64_t count = frameEnd - frameStart;
+                    const float *frames = readFrames(frameStart, count);
+
+                    // A run starting inside a block shares it with the
+                    // frames before, so its head is merged into that peak.
+                    const int64_t head = std::min<int64_t>(
+                        count, (BASE_BLOCK_SIZE - gridStart % BASE_BLOCK_SIZE) %
+                                   BASE_BLOCK_SIZE);
+                    if (head > 0)
+                    {
+                        const int64_t block =
+                            gridStart / BASE_BLOCK_SIZE - fromBlock;
+                        auto &peak = peaks[block];
+                        for (int64_t i = 0; i < head; ++i)
+                        {
+                            peak.min = std::min(peak.min, frames[i]);
+                            peak.max = std::max(peak.max, frames[i]);
+                        }
+                        energies[block] =
+                            addEnergies(energies[block],
+                                        computeEnergy(frames, head));
+                    }
+                    if (count > head)
+                    {
+                        const int64_t block =
+                            (gridStart + head) / BASE_BLOCK_SIZE - fromBlock;
+                        computeBlockPeaks(frames + head, count - head,
+                                          BASE_BLOCK_SIZE, peaks + block);
+                        computeBlockEnergies(frames + head, count - head,
+                                             BASE_BLOCK_SIZE,
+                                             energies + block);
+                    }
+                });
+        }
+
+        // The statistics of frames [frameStart, frameEnd). Built nodes that
+        // lie wholly inside the range stand in for their frames, so a range
+        // within one run of the layout takes O(log n) nodes. The frames of
+        // the blocks at its ends, and of dirty blocks, are read with
+        // readFrames as for computeLevel0Peaks(), as are all of them while
+        // the cache is not laid out for its frame count.
+        template <typename ReadFrames>
+        [[nodiscard]] RangeStatistics
+        getRangeStatistics(int64_t frameStart, int64_t frameEnd,
+                           ReadFrames &&readFrames) const
+        {
+            RangeStatistics statistics;
+            frameStart = std::max<int64_t>(0, frameStart);
+            frameEnd = std::min(frameEnd, numSamples);
+            if (frameEnd <= frameStart)
+            {
+                return statistics;
+            }
+
+            if (!isLaidOutFor(numSamples))
+            {
+                addFrameStatistics(statistics, frameStart,
+                                   frameEnd - frameStart, readFrames);
+                return statistics;
+            }
+
+            layout.forEachRun(
+                frameStart, frameEnd,
+                [&](const int64_t runFrameStart, const int64_t runFrameEnd,
+                    const int64_t runGridStart)
+                {
+                    const int64_t gridEnd =
+                        runGridStart + runFrameEnd - runFrameStart;
+                    const int64_t firstBlock =
+                        (runGridStart + BASE_BLOCK_SIZE - 1) / BASE_BLOCK_SIZE;
+                    const int64_t endBlock = gridEnd / BASE_BLOCK_SIZE;
+                    if (endBlock <= firstBlock)
+                    {
+                        addFrameStatistics(statistics, runFrameStart,
+                                           runFrameEnd - runFrameStart,
+                                           readFrames);
+                        return;
+                    }
+
+                    const auto frameOf = [&](const int64_t block)
+                    {
+                        return runFrameStart + block * BASE_BLOCK_SIZE -
+                               runGridStart;
+                    };
+                    addFrameStatistics(statistics, runFrameStart,
+                                       frameOf(firstBlock) - runFrameStart,
+                                       readFrames);
+
+                    // Dirty blocks are read; the built ones around them are
+                    // taken from the levels.
+                    const int64_t dirtyFrom =
+                        std::clamp(dirtyFromBlock, firstBlock, endBlock);
+                    const int64_t dirtyEnd = std::clamp(
+                        dirtyToBlock + 1, dirtyFrom, endBlock);
+                    addNodeStatistics(statistics, firstBlock, dirtyFrom);
+                    addFrameStatistics(statistics, frameOf(dirtyFrom),
+                                       (dirtyEnd - dirtyFrom) *
+                                           BASE_BLOCK_SIZE,
+                                       readFrames);
+                    addNodeStatistics(statistics, dirtyEnd, endBlock);
+
+                    addFrameStatistics(statistics, frameOf(endBlock),
+                                       runFrameEnd - frameOf(endBlock),
+                                       readFrames);
+                });
+            return statistics;
+        }
+
     private:
-        static void rebuildDirtyLevels(std::vector<std::vector<Peak>> &levelsToUse,
-                                       const int64_t numSamplesToUse,
-                                       int64_t &dirtyFromBlockToUse,
-                                       int64_t &dirtyToBlockToUse,
-                                       const float *samples)
+        template <typename Samples>
+        static void rebuildDirtyLevels(
+            std::vector<std::vector<Peak>> &levelsToUse,
+            std::vector<std::vector<BlockEnergy>> &energyLevelsToUse,
+            const WaveformFrameLayout &layoutToUse,
+            int64_t &dirtyFromBlockToUse, int64_t &dirtyToBlockToUse,
+            Samples &samples)
         {
-            if (levelsToUse.empty() || numSamplesToUse <= 0)
+            if (levelsToUse.empty() || layoutToUse.getFrameCount() <= 0)
             {
                 dirtyFromBlockToUse = INT64_MAX;
                 dirtyToBlockToUse = -1;
@@ -507,7 +884,8 @@ namespace cupuacu::gui
                 return;
             }
 
-            const int64_t max0 = level0SizeFromSamples(numSamplesToUse) - 1;
+            const int64_t max0 =
+                level0SizeFromSamples(layoutToUse.getGridLength()) - 1;
             if (max0 < 0)
             {
                 dirtyFromBlockToUse = INT64_MAX;
@@ -515,73 +893,48 @@ namespace cupuacu::gui
                 return;
             }
 
-            const int64_t from0 =
-                std::clamp<int64_t>(dirtyFromBlockToUse, 0, max0);
-            const int64_t to0 = std::clamp<int64_t>(dirtyToBlockToUse, 0, max0);
+            int64_t from0 = std::clamp<int64_t>(dirtyFromBlockToUse, 0, max0);
+            int64_t to0 = std::clamp<int64_t>(dirtyToBlockToUse, 0, max0);
 
-            for (int64_t blk = from0; blk <= to0; ++blk)
+            // Energies that do not sit beside the peaks are all computed.
+            if (!sameShape(energyLevelsToUse, levelsToUse))
             {
-                const int64_t s0 = blk * (int64_t)BASE_BLOCK_SIZE;
-                const int64_t s1 =
-                    std::min<int64_t>(s0 + BASE_BLOCK_SIZE, numSamplesToUse);
-                if (s0 >= s1)
-                {
-                    levelsToUse[0][blk] = {0.0f, 0.0f};
-                    continue;
-                }
-
-                float minv = samples[s0];
-                float maxv = samples[s0];
-                for (int64_t i = s0 + 1; i < s1; ++i)
+                energyLevelsToUse.clear();
+                for (const auto &level : levelsToUse)
                 {
-                    const float v = samples[i];
-                    minv = std::min(minv, v);
-                    maxv = std::max(maxv, v);
+                    energyLevelsToUse.emplace_back(level.size());
                 }
-                levelsToUse[0][blk] = {minv, maxv};
+                from0 = 0;
+                to0 = max0;
             }
 
-            int64_t pFrom = from0;
-            int64_t pTo = to0;
-
-            for (int l = 1; l < (int)levelsToUse.size(); ++l)
+            std::vector<float> frames;
+            const auto readFrames = [&](const int64_t frameStart,
+                                        const int64_t frameCount) -> const float *
             {
-                auto &prev = levelsToUse[l - 1];
-                auto &cur = levelsToUse[l];
-
-                if (cur.empty())
+                if constexpr (std::is_pointer_v<Samples>)
                 {
-                    break;
+                    return samples + frameStart;
                 }
-
-                int64_t cFrom = pFrom / 2;
-                int64_t cTo = pTo / 2;
-
-                cFrom = std::clamp<int64_t>(cFrom, 0, (int64_t)cur.size() - 1);
-                cTo = std::clamp<int64_t>(cTo, 0, (int64_t)cur.size() - 1);
-
-                for (int64_t i = cFrom; i <= cTo; ++i)
+                else
                 {
-                    const int64_t a = i * 2;
-                    const int64_t b = a + 1;
-
-                    float minv = prev[a].min;
-                    float maxv = prev[a].max;
-                    if (b < (int64_t)prev.size())
+                    // Readers decode in chunks, so they are read sample by
+                    // sample.
+                    frames.resize(static_cast<std::size_t>(frameCount));
+                    for (int64_t i = 0; i < frameCount; ++i)
                     {
-                        minv = std::min(minv, prev[b].min);
-                        maxv = std::max(maxv, prev[b].max);
+                        frames[static_cast<std::size_t>(i)] =
+                            samples[frameStart + i];
                     }
-                    cur[i] = {minv, maxv};
+                    return frames.data();
                 }
+            };
+            computeLevel0Peaks(layoutToUse, from0, to0, readFrames,
+                               levelsToUse[0].data() + from0,
+                               energyLevelsToUse[0].data() + from0);
 
-                pFrom = cFrom;
-                pTo = cTo;
-                if ((int64_t)cur.size() <= 1)
-                {
-                    break;
-                }
-            }
+            foldDirtyLevels(levelsToUse, from0, to0);
+            foldDirtyLevels(energyLevelsToUse, from0, to0);
 
             dirtyFromBlockToUse = INT64_MAX;
             dirtyToBlockToUse = -1;
@@ -589,22 +942,13 @@ namespace cupuacu::gui
 
         void buildStorage()
         {
-            levels.clear();
-            levels.resize(MAX_LEVEL_COUNT);
-
-            const int64_t sz0 = level0Size();
-            levels[0].resize(sz0);
-
-            for (int l = 1; l < MAX_LEVEL_COUNT; ++l)
+            levels = std::make_shared<PeakLevels>();
+            energyLevels.clear();
+            mappedLevels.reset();
+            for (const auto size : levelSizesFor(layout.getGridLength()))
             {
-                const int64_t prev = (int64_t)levels[l - 1].size();
-                const int64_t cur = (prev + 1) / 2;
-                levels[l].resize(cur);
-                if (cur <= 1)
-                {
-                    levels.resize(l + 1);
-                    break;
-                }
+                levels->emplace_back(static_cast<std::size_t>(size));
+                energyLevels.emplace_back(static_cast<std::size_t>(size));
             }
         }
 
@@ -619,17 +963,7 @@ namespace cupuacu::gui
 
         int64_t level0Size() const
         {
-            return level0SizeFromSamples(numSamples);
-        }
-
-        int64_t levelSize(const int level) const
-        {
-            int64_t sz = level0Size();
-            for (int l = 1; l <= level; ++l)
-            {
-                sz = (sz + 1) / 2;
-            }
-            return sz;
+            return level0SizeFromSamples(layout.getGridLength());
         }
 
         void markAllDirty()
@@ -640,7 +974,7 @@ namespace cupuacu::gui
 
         void markDirtyBlocks(int64_t from0, int64_t to0)
         {
-            if (levels.empty())
+            if (storedLevelCount() == 0)
             {
                 return;
             }
@@ -657,12 +991,329 @@ namespace cupuacu::gui
             dirtyToBlock = std::max(dirtyToBlock, to0);
         }
 
+        void clampDirtyBlocks()
+        {
+            dirtyToBlock = std::min(dirtyToBlock, level0Size() - 1);
+            if (dirtyToBlock < dirtyFromBlock)
+            {
+                dirtyFromBlock = INT64_MAX;
+                dirtyToBlock = -1;
+            }
+        }
+
+        static void foldNodes(const Peak *nodes, const int64_t count,
+                              Peak *folded)
+        {
+            foldPeaks(nodes, count, folded);
+        }
+
+        static void foldNodes(const BlockEnergy *nodes, const int64_t count,
+                              BlockEnergy *folded)
+        {
+            foldEnergies(nodes, count, folded);
+        }
+
+        static BlockEnergy addEnergies(const BlockEnergy &a,
+                                       const BlockEnergy &b)
+        {
+            return {.sumOfSquares = a.sumOfSquares + b.sumOfSquares,
+                    .clipCount = a.clipCount + b.clipCount};
+        }
+
+        // True if a and b have as many levels, of the same sizes.
+        template <typename A, typename B>
+        static bool sameShape(const A &a, const B &b)
+        {
+            return a.size() == b.size() &&
+                   std::equal(a.begin(), a.end(), b.begin(),
+                              [](const auto &x, const auto &y)
+                              { return x.size() == y.size(); });
+        }
+
+        // Gives levels zeroed energies to be built again if the ones beside
+        // them do not fit.
+        void fitEnergyLevelsToLevels()
+        {
+            if (sameShape(energyLevels, *levels))
+            {
+                return;
+            }
+            energyLevels.clear();
+            for (const auto &level : *levels)
+            {
+                energyLevels.emplace_back(level.size());
+            }
+            markAllDirty();
+        }
+
+        template <typename ReadFrames>
+        static void addFrameStatistics(RangeStatistics &statistics,
+                                       int64_t frameStart, int64_t frameCount,
+                                       ReadFrames &readFrames)
+        {
+            constexpr int64_t kReadChunkFrames = 65536;
+            while (frameCount > 0)
+            {
+                const int64_t count = std::min(frameCount, kReadChunkFrames);
+                const float *frames = readFrames(frameStart, count);
+                Peak peak;
+                computeBlockPeaks(frames, count, count, &peak);
+                const auto energy = computeEnergy(frames, count);
+                statistics.peak = {std::min(statistics.peak.min, peak.min),
+                                   std::max(statistics.peak.max, peak.max)};
+                statistics.sumOfSquares += energy.sumOfSquares;
+                statistics.clipCount += energy.clipCount;
+                statistics.frameCount += count;
+                frameStart += count;
+                frameCount -= count;
+            }
+        }
+
+        // Adds the built level-0 blocks [fromBlock, endBlock), taking each
+        // as part of the largest node that lies wholly inside them.
+        void addNodeStatistics(RangeStatistics &statistics, int64_t fromBlock,
+                               int64_t endBlock) const
+        {
+            const auto addNode = [&](const int level, const int64_t index)
+            {
+                const auto at = static_cast<std::size_t>(index);
+                const auto &peak = getLevelByIndex(level)[at];
+                const auto &energy = getEnergyLevelByIndex(level)[at];
+                statistics.peak = {std::min(statistics.peak.min, peak.min),
+                                   std::max(statistics.peak.max, peak.max)};
+                statistics.sumOfSquares += energy.sumOfSquares;
+                statistics.clipCount += energy.clipCount;
+            };
+
+            const int64_t blockCount = endBlock - fromBlock;
+            if (blockCount <= 0)
+            {
+                return;
+            }
+            statistics.frameCount += blockCount * BASE_BLOCK_SIZE;
+
+            const int topLevel = storedLevelCount() - 1;
+            for (int level = 0; fromBlock < endBlock; ++level)
+            {
+                if (level == topLevel)
+                {
+                    for (int64_t i = fromBlock; i < endBlock; ++i)
+                    {
+                        addNode(level, i);
+                    }
+                    break;
+                }
+                if (fromBlock & 1)
+                {
+                    addNode(level, fromBlock++);
+                }
+                if (endBlock & 1)
+                {
+                    addNode(level, --endBlock);
+                }
+                fromBlock >>= 1;
+                endBlock >>= 1;
+            }
+        }
+
+        // Refolds nodes from..to of level from the level below.
+        template <typename Node>
+        static void refoldNodes(std::vector<std::vector<Node>> &levelsToUse,
+                                const int level, int64_t from, int64_t to)
+        {
+            const auto &below = levelsToUse[static_cast<std::size_t>(level - 1)];
+            auto &cur = levelsToUse[static_cast<std::size_t>(level)];
+            from = std::max<int64_t>(0, from);
+            to = std::min<int64_t>(to, static_cast<int64_t>(cur.size()) - 1);
+            if (to < from)
+            {
+                return;
+            }
+            const int64_t belowCount = std::min<int64_t>(
+                (to - from + 1) * 2,
+                static_cast<int64_t>(below.size()) - from * 2);
+            foldNodes(below.data() + from * 2, belowCount, cur.data() + from);
+        }
+
+        // Fits the levels to level0Size(), padding them with EMPTY_PEAK and
+        // EMPTY_ENERGY, and refolds the levels from SHIFTED_LEVEL_COUNT up
+        // from level-0 block refoldFromBlock on. Levels that were not there
+        // are folded whole.
+        void resizeLevels(const int64_t refoldFromBlock)
+        {
+            resizeLevels(ownLevels(), EMPTY_PEAK, refoldFromBlock);
+            resizeLevels(energyLevels, EMPTY_ENERGY, refoldFromBlock);
+        }
+
+        template <typename Node>
+        void resizeLevels(std::vector<std::vector<Node>> &levelsToUse,
+                          const Node &empty, const int64_t refoldFromBlock)
+        {
+            const int64_t sz0 = level0Size();
+            int levelCount = MAX_LEVEL_COUNT;
+            for (int64_t l = 1, sz = sz0; l < MAX_LEVEL_COUNT; ++l)
+            {
+                sz = (sz + 1) / 2;
+                if (sz <= 1)
+                {
+                    levelCount = static_cast<int>(l) + 1;
+                    break;
+                }
+            }
+
+            const auto oldLevelCount = static_cast<int>(levelsToUse.size());
+            levelsToUse.resize(static_cast<std::size_t>(levelCount));
+            levelsToUse[0].resize(static_cast<std::size_t>(sz0), empty);
+            for (int l = 1; l < levelCount; ++l)
+            {
+                const auto size = (levelsToUse[l - 1].size() + 1) / 2;
+                levelsToUse[l].resize(size, empty);
+                if (l < oldLevelCount && l < SHIFTED_LEVEL_COUNT)
+                {
+                    continue;
+                }
+                refoldNodes(levelsToUse, l,
+                            l < oldLevelCount ? refoldFromBlock >> l : 0,
+                            static_cast<int64_t>(size) - 1);
+            }
+        }
+
+        // Inserts blockCount empty blocks, a multiple of
+        // 1 << (SHIFTED_LEVEL_COUNT - 1), before level-0 block at.
+        void insertBlocks(const int64_t at, const int64_t blockCount)
+        {
+            insertNodes(ownLevels(), EMPTY_PEAK, at, blockCount);
+            insertNodes(energyLevels, EMPTY_ENERGY, at, blockCount);
+            resizeLevels(at);
+
+            if (dirtyFromBlock >= at && dirtyFromBlock != INT64_MAX)
+            {
+                dirtyFromBlock += blockCount;
+            }
+            if (dirtyToBlock >= at)
+            {
+                dirtyToBlock += blockCount;
+            }
+        }
+
+        template <typename Node>
+        static void insertNodes(std::vector<std::vector<Node>> &levelsToUse,
+                                const Node &empty, const int64_t at,
+                                const int64_t blockCount)
+        {
+            levelsToUse[0].insert(levelsToUse[0].begin() + at,
+                                  static_cast<std::size_t>(blockCount), empty);
+            for (int l = 1; l < SHIFTED_LEVEL_COUNT &&
+                            l < static_cast<int>(levelsToUse.size());
+                 ++l)
+            {
+                auto &level = levelsToUse[static_cast<std::size_t>(l)];
+                const int64_t nodeAt = std::min<int64_t>(
+                    ((at - 1) >> l) + 1, static_cast<int64_t>(level.size()));
+                level.insert(level.begin() + nodeAt,
+                             static_cast<std::size_t>(blockCount >> l), empty);
+                // The nodes where the new blocks start and end may also
+                // cover blocks from either side.
+                refoldNodes(levelsToUse, l, at >> l, at >> l);
+                refoldNodes(levelsToUse, l, (at + blockCount) >> l,
+                            (at + blockCount) >> l);
+            }
+        }
+
+        // Removes level-0 blocks [at, at + blockCount), at and blockCount
+        // being multiples of 1 << (SHIFTED_LEVEL_COUNT - 1).
+        void removeBlocks(const int64_t at, const int64_t blockCount)
+        {
+            removeNodes(ownLevels(), at, blockCount);
+            removeNodes(energyLevels, at, blockCount);
+            resizeLevels(at);
+
+            if (dirtyToBlock < dirtyFromBlock)
+            {
+                return;
+            }
+            const int64_t removedEnd = at + blockCount;
+            dirtyFromBlock = dirtyFromBlock >= removedEnd
+                                 ? dirtyFromBlock - blockCount
+                                 : std::min(dirtyFromBlock, at);
+            dirtyToBlock = dirtyToBlock >= removedEnd ? dirtyToBlock - blockCount
+                           : dirtyToBlock >= at       ? at - 1
+                                                      : dirtyToBlock;
+            if (dirtyToBlock < dirtyFromBlock)
+            {
+                dirtyFromBlock = INT64_MAX;
+                dirtyToBlock = -1;
+            }
+        }
+
+        template <typename Node>
+        static void removeNodes(std::vector<std::vector<Node>> &levelsToUse,
+                                const int64_t at, const int64_t blockCount)
+        {
+            for (int l = 0; l < SHIFTED_LEVEL_COUNT &&
+                            l < static_cast<int>(levelsToUse.size());
+                 ++l)
+            {
+                auto &level = levelsToUse[static_cast<std::size_t>(l)];
+                const auto size = static_cast<int64_t>(level.size());
+                level.erase(level.begin() + std::min(at >> l, size),
+                            level.begin() +
+                                std::min((at + blockCount) >> l, size));
+            }
+        }
+
+        int storedLevelCount() const
+        {
+            return static_cast<int>(mappedLevels ? mappedLevels->levels.size()
+                                                 : levels->size());
+        }
+
+        // Copies mapped levels into levels, which can then be changed.
+        void copyMappedLevels()
+        {
+            if (!mappedLevels)
+            {
+                return;
+            }
+
+            levels = std::make_shared<PeakLevels>();
+            for (const auto &level : mappedLevels->levels)
+            {
+                levels->emplace_back(level.begin(), level.end());
+            }
+            energyLevels.clear();
+            for (const auto &level : mappedLevels->energyLevels)
+            {
+                energyLevels.emplace_back(level.begin(), level.end());
+            }
+            mappedLevels.reset();
+            fitEnergyLevelsToLevels();
+        }
+
     private:
+        using PeakLevels = std::vector<std::vector<Peak>>;
+
+        // The levels, copied first if a pinned level still shares them.
+        PeakLevels &ownLevels()
+        {
+            if (levels.use_count() > 1)
+            {
+                levels = std::make_shared<PeakLevels>(*levels);
+            }
+            return *levels;
+        }
+
         int64_t numSamples;
-        std::vector<std::vector<Peak>> levels;
+        WaveformFrameLayout layout;
+        // Shared with the holders of pinLevel() results, so changes go
+        // through ownLevels().
+        std::shared_ptr<PeakLevels> levels = std::make_shared<PeakLevels>();
+        std::vector<std::vector<BlockEnergy>> energyLevels;
+        // Set instead of levels and energyLevels while they are read in
+        // place.
+        std::shared_ptr<const MappedLevels> mappedLevels;
         int64_t dirtyFromBlock;
         int64_t dirtyToBlock;
-        inline static const std::vector<Peak> empty;
     };
 
 } // namespace cupuacu::gui
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cupuacu::gui
+{
+    // Where a WaveformCache keeps each document frame. Frames are stored in
+    // runs that each sit at their own position in the cache's block grid, so
+    // that an edit can move the frames after it by whole blocks and leave
+    // their peaks as they are. Grid positions between runs hold no frames.
+    class WaveformFrameLayout
+    {
+    public:
+        struct Run
+        {
+            int64_t frameStart = 0;
+            int64_t frameCount = 0;
+            int64_t gridStart = 0;
+
+            bool operator==(const Run &) const = default;
+        };
+
+        // The inserted frames were put at gridStart. If shift is not 0,
+        // everything from grid position shiftAt on was first moved shift
+        // positions to the right to make room for them.
+        struct Insertion
+        {
+            int64_t gridStart = 0;
+            int64_t shiftAt = 0;
+            int64_t shift = 0;
+        };
+
+        // The grid positions between the frames before and after an erase,
+        // which hold no frames.
+        struct Gap
+        {
+            int64_t gridStart = 0;
+            int64_t gridEnd = 0;
+        };
+
+        WaveformFrameLayout() = default;
+
+        explicit WaveformFrameLayout(const int64_t frameCountToUse)
+        {
+            reset(frameCountToUse);
+        }
+
+        bool operator==(const WaveformFrameLayout &) const = default;
+
+        // Lays frameCountToUse frames out one after the other from grid
+        // position 0.
+        void reset(const int64_t frameCountToUse)
+        {
+            runs.clear();
+            frameCount = std::max<int64_t>(0, frameCountToUse);
+            gridLength = frameCount;
+            if (frameCount > 0)
+            {
+                runs.push_back({.frameStart = 0,
+                                .frameCount = frameCount,
+                                .gridStart = 0});
+            }
+        }
+
+        // Replaces the layout with runsToUse, as written out by getRuns().
+        // Returns false, leaving the layout as it was, if the runs do not
+        // cover frames 0 and up in order without overlapping in the grid.
+        [[nodiscard]] bool assign(std::vector<Run> runsToUse,
+                                  const int64_t gridLengthToUse)
+        {
+            int64_t nextFrame = 0;
+            int64_t nextGridPosition = 0;
+            for (const auto &run : runsToUse)
+            {
+                if (run.frameStart != nextFrame || run.frameCount <= 0 ||
+                    run.gridStart < nextGridPosition)
+                {
+                    return false;
+                }
+                nextFrame += run.frameCount;
+                nextGridPosition = run.gridStart + run.frameCount;
+            }
+            if (gridLengthToUse < nextGridPosition)
+            {
+                return false;
+            }
+
+            runs = std::move(runsToUse);
+            frameCount = nextFrame;
+            gridLength = gridLengthToUse;
+            return true;
+        }
+
+        [[nodiscard]] int64_t getFrameCount() const
+        {
+            return frameCount;
+        }
+
+        [[nodiscard]] int64_t getGridLength() const
+        {
+            return gridLength;
+        }
+
+        [[nodiscard]] const std::vector<Run> &getRuns() const
+        {
+            return runs;
+        }
+
+        [[nodiscard]] bool isIdentity() const
+        {
+            return gridLength == frameCount && runs.size() <= 1;
+        }
+
+        // The grid position of frame. Frames from getFrameCount() on are
+        // placed right after the last run.
+        [[nodiscard]] int64_t gridPositionOf(const int64_t frame) const
+        {
+            if (runs.empty())
+            {
+                return 0;
+            }
+            if (frame >= frameCount)
+            {
+                return gridEndOf(runs.back());
+            }
+
+            const int64_t clampedFrame = std::max<int64_t>(0, frame);
+            const auto &run = runs[runIndexContaining(clampedFrame)];
+            return run.gridStart + clampedFrame - run.frameStart;
+        }
+
+        // How many frames sit before gridPosition.
+        [[nodiscard]] int64_t framesBefore(const int64_t gridPosition) const
+        {
+            const auto next = std::partition_point(
+                runs.begin(), runs.end(), [&](const Run &run)
+                { return run.gridStart < gridPosition; });
+            if (next == runs.begin())
+            {
+                return 0;
+            }
+
+            const auto &run = *(next - 1);
+            return run.frameStart +
+                   std::clamp<int64_t>(gridPosition - run.gridStart, 0,
+                                       run.frameCount);
+        }
+
+        // Calls fn(runFrameStart, runFrameEnd, runGridStart) for each part of
+        // frames [frameStart, frameEnd) that lies in a single run.
+        template <typename Fn>
+        void forEachRun(int64_t frameStart, int64_t frameEnd, Fn &&fn) const
+        {
+            frameStart = std::max<int64_t>(0, frameStart);
+            frameEnd = std::min(frameEnd, frameCount);
+            if (frameStart >= frameEnd)
+            {
+                return;
+            }
+
+            for (std::size_t i = runIndexContaining(frameStart);
+                 i < runs.size() && runs[i].frameStart < frameEnd; ++i)
+            {
+                const auto &run = runs[i];
+                const int64_t runFrameStart =
+                    std::max(frameStart, run.frameStart);
+                const int64_t runFrameEnd =
+                    std::min(frameEnd, run.frameStart + run.frameCount);
+                fn(runFrameStart, runFrameEnd,
+                   run.gridStart + runFrameStart - run.frameStart);
+            }
+        }
+
+        // As forEachRun(), for the frames in grid positions
+        // [gridStart, gridEnd).
+        template <typename Fn>
+        void forEachRunInGrid(const int64_t gridStart, const int64_t gridEnd,
+                              Fn &&fn) const
+        {
+            auto i = static_cast<std::size_t>(
+                std::partition_point(runs.begin(), runs.end(),
+                                     [&](const Run &run)
+                                     { return gridEndOf(run) <= gridStart; }) -
+                runs.begin());
+            for (; i < runs.size() && runs[i].gridStart < gridEnd; ++i)
+            {
+                const auto &run = runs[i];
+                const int64_t runGridStart = std::max(gridStart, run.gridStart);
+                const int64_t runGridEnd = std::min(gridEnd, gridEndOf(run));
+                fn(run.frameStart + runGridStart - run.gridStart,
+                   run.frameStart + runGridEnd - run.gridStart, runGridStart);
+            }
+        }
+
+        // Inserts count frames before frame. They go into the empty grid
+        // positions there if those fit them, and otherwise the frames after
+        // them are moved right by a multiple of alignment.
+        Insertion insertFrames(int64_t frame, const int64_t count,
+                               const int64_t alignment)
+        {
+            if (count <= 0)
+            {
+                return {};
+            }
+
+            frame = std::clamp<int64_t>(frame, 0, frameCount);
+            const std::size_t next = splitAt(frame);
+            const int64_t gapStart = next > 0 ? gridEndOf(runs[next - 1]) : 0;
+            const int64_t gapEnd =
+                next < runs.size() ? runs[next].gridStart : gridLength;
+
+            Insertion insertion{.gridStart = gapStart, .shiftAt = gapEnd};
+            if (count > gapEnd - gapStart)
+            {
+                if (next < runs.size())
+                {
+                    const int64_t missing = count - (gapEnd - gapStart);
+                    insertion.shift =
+                        (missing + alignment - 1) / alignment * alignment;
+                    for (std::size_t i = next; i < runs.size(); ++i)
+                    {
+                        runs[i].gridStart += insertion.shift;
+                    }
+                    gridLength += insertion.shift;
+                }
+                else
+                {
+                    gridLength = gapStart + count;
+                }
+            }
+
+            for (std::size_t i = next; i < runs.size(); ++i)
+            {
+                runs[i].frameStart += count;
+            }
+            runs.insert(runs.begin() + static_cast<std::ptrdiff_t>(next),
+                        Run{.frameStart = frame,
+                            .frameCount = count,
+                            .gridStart = gapStart});
+            frameCount += count;
+            mergeAdjacentRuns();
+            return insertion;
+        }
+
+        // Erases frames [frameStart, frameEnd), which leaves their grid
+        // positions empty.
+        Gap eraseFrames(int64_t frameStart, int64_t frameEnd)
+        {
+            frameStart = std::clamp<int64_t>(frameStart, 0, frameCount);
+            frameEnd = std::clamp<int64_t>(frameEnd, frameStart, frameCount);
+
+            const std::size_t first = splitAt(frameStart);
+            const std::size_t last = splitAt(frameEnd);
+            runs.erase(runs.begin() + static_cast<std::ptrdiff_t>(first),
+                       runs.begin() + static_cast<std::ptrdiff_t>(last));
+
+            const int64_t count = frameEnd - frameStart;
+            for (std::size_t i = first; i < runs.size(); ++i)
+            {
+                runs[i].frameStart -= count;
+            }
+            frameCount -= count;
+
+            return {.gridStart = first > 0 ? gridEndOf(runs[first - 1]) : 0,
+                    .gridEnd = first < runs.size() ? runs[first].gridStart
+                                                   : gridLength};
+        }
+
+        // Removes grid positions [gridStart, gridEnd), which must be empty.
+        void removeGridRange(const int64_t gridStart, const int64_t gridEnd)
+        {
+            const int64_t count = gridEnd - gridStart;
+            if (count <= 0)
+            {
+                return;
+            }
+
+            for (auto &run : runs)
+            {
+                if (run.gridStart >= gridEnd)
+                {
+                    run.gridStart -= count;
+                }
+            }
+            gridLength -= count;
+            mergeAdjacentRuns();
+        }
+
+        // Drops the grid positions from gridLengthToUse on, which must be
+        // empty.
+        void truncateGrid(const int64_t gridLengthToUse)
+        {
+            gridLength = std::max<int64_t>(
+                gridLengthToUse, runs.empty() ? 0 : gridEndOf(runs.back()));
+        }
+
+    private:
+        std::vector<Run> runs;
+        int64_t frameCount = 0;
+        int64_t gridLength = 0;
+
+        static int64_t gridEndOf(const Run &run)
+        {
+            return run.gridStart + run.frameCount;
+        }
+
+        std::size_t runIndexContaining(const int64_t frame) const
+        {
+            const auto next = std::partition_point(
+                runs.begin(), runs.end(),
+                [&](const Run &run) { return run.frameStart <= frame; });
+            return next == runs.begin()
+                       ? 0
+                       : static_cast<std::size_t>(next - runs.begin()) - 1;
+        }
+
+        // Splits the run frame falls inside of, if any, and returns the
+        // index of the first run starting at or after frame.
+        std::size_t splitAt(const int64_t frame)
+        {
+            const auto i = static_cast<std::size_t>(
+                std::partition_point(runs.begin(), runs.end(),
+                                     [&](const Run &run)
+                                     {
+                                         return run.frameStart +
+                                                    run.frameCount <=
+                                                frame;
+                                     }) -
+                runs.begin());
+            if (i >= runs.size() || runs[i].frameStart >= frame)
+            {
+                return i;
+            }
+
+            auto &run = runs[i];
+            const int64_t headCount = frame - run.frameStart;
+            const Run tail{.frameStart = frame,
+                           .frameCount = run.frameCount - headCount,
+                           .gridStart = run.gridStart + headCount};
+            run.frameCount = headCount;
+            runs.insert(runs.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+                        tail);
+            return i + 1;
+        }
+
+        void mergeAdjacentRuns()
+        {
+            std::size_t kept = 0;
+            for (std::size_t i = 1; i < runs.size(); ++i)
+            {
+                if (gridEndOf(runs[kept]) == runs[i].gridStart)
+                {
+                    runs[kept].frameCount += runs[i].frameCount;
+                }
+                else
+                {
+                    runs[++kept] = runs[i];
+                }
+            }
+            if (!runs.empty())
+            {
+                runs.resize(kept + 1);
+            }
+        }
+    };
+} // namespace cupuacu::gui
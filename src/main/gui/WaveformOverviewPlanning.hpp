@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <vector>
 
 namespace cupuacu::gui
@@ -72,8 +73,8 @@ namespace cupuacu::gui
         WaveformOverviewDebugStats *debugStats = nullptr)
     {
         const auto &document = session.document;
-        const auto &sampleData =
-            document.getAudioBuffer()->getImmutableChannelData(channelIndex);
+        auto sampleData =
+            document.getAudioBuffer()->getChannelReader(channelIndex);
         const int64_t frameCount = document.getFrameCount();
         if (frameCount <= 0 || channelIndex < 0 ||
             channelIndex >= document.getChannelCount() ||
@@ -92,8 +93,9 @@ namespace cupuacu::gui
             bypassCache ? 0 : waveformCache.getLevelIndex(samplesPerPixel);
         const int64_t samplesPerPeak =
             bypassCache ? 0 : WaveformCache::samplesPerPeakForLevel(cacheLevel);
-        const std::vector<Peak> *peaks =
-            bypassCache ? nullptr : &waveformCache.getLevel(samplesPerPixel);
+        const std::span<const Peak> peaks =
+            bypassCache ? std::span<const Peak>{}
+                        : waveformCache.getLevel(samplesPerPixel);
         const int64_t validCachedPeakCount =
             bypassCache ? 0 : waveformCache.validPeakCountForLevel(cacheLevel);
 
@@ -161,57 +163,79 @@ namespace cupuacu::gui
             ++debugStats->windowsUsedCache;
         }
 
-        if (!peaks || peaks->empty())
+        if (peaks.empty() || !waveformCache.isLaidOutFor(frameCount))
         {
             return false;
         }
 
         Peak peak{};
         bool hasPeak = false;
-        const int64_t firstFullBlockStart =
-            ((a + samplesPerPeak - 1) / samplesPerPeak) * samplesPerPeak;
-        const int64_t lastFullBlockEnd = (b / samplesPerPeak) * samplesPerPeak;
-
-        accumulateRawPeakRange(a, std::min(b, firstFullBlockStart), peak, hasPeak);
-
-        if (firstFullBlockStart < lastFullBlockEnd)
+        // Each run of frames has its own offset into the cache's grid, so
+        // the full cached peaks are looked up run by run.
+        const auto accumulateRunPeak = [&](const int64_t runStart,
+                                           const int64_t runEnd,
+                                           const int64_t runGridStart)
         {
-            const int64_t requestedI0 = firstFullBlockStart / samplesPerPeak;
-            const int64_t requestedI1Exclusive = lastFullBlockEnd / samplesPerPeak;
-            const int64_t cachedI0 = std::clamp<int64_t>(
-                requestedI0, 0, validCachedPeakCount);
-            const int64_t cachedI1Exclusive = std::clamp<int64_t>(
-                requestedI1Exclusive, 0, validCachedPeakCount);
-            const int64_t cachedFullBlockStart = cachedI0 * samplesPerPeak;
-            const int64_t cachedFullBlockEnd = cachedI1Exclusive * samplesPerPeak;
+            const int64_t gridOffset = runGridStart - runStart;
+            const int64_t gridA = runStart + gridOffset;
+            const int64_t gridB = runEnd + gridOffset;
+            const int64_t firstFullBlockStart =
+                ((gridA + samplesPerPeak - 1) / samplesPerPeak) * samplesPerPeak;
+            const int64_t lastFullBlockEnd =
+                (gridB / samplesPerPeak) * samplesPerPeak;
 
-            accumulateRawPeakRange(firstFullBlockStart,
-                                   std::min(lastFullBlockEnd, cachedFullBlockStart),
-                                   peak, hasPeak);
+            accumulateRawPeakRange(
+                runStart, std::min(gridB, firstFullBlockStart) - gridOffset,
+                peak, hasPeak);
 
-            for (int64_t i = cachedI0; i < cachedI1Exclusive; ++i)
+            if (firstFullBlockStart < lastFullBlockEnd)
             {
-                if (debugStats)
-                {
-                    ++debugStats->cachedPeaksUsed;
-                }
-                if (!hasPeak)
-                {
-                    peak = (*peaks)[i];
-                    hasPeak = true;
-                }
-                else
+                const int64_t requestedI0 = firstFullBlockStart / samplesPerPeak;
+                const int64_t requestedI1Exclusive =
+                    lastFullBlockEnd / samplesPerPeak;
+                const int64_t cachedI0 = std::clamp<int64_t>(
+                    requestedI0, 0, validCachedPeakCount);
+                const int64_t cachedI1Exclusive = std::clamp<int64_t>(
+                    requestedI1Exclusive, 0, validCachedPeakCount);
+                const int64_t cachedFullBlockStart = cachedI0 * samplesPerPeak;
+                const int64_t cachedFullBlockEnd =
+                    cachedI1Exclusive * samplesPerPeak;
+
+                accumulateRawPeakRange(
+                    firstFullBlockStart - gridOffset,
+                    std::min(lastFullBlockEnd, cachedFullBlockStart) -
+                        gridOffset,
+                    peak, hasPeak);
+
+                for (int64_t i = cachedI0; i < cachedI1Exclusive; ++i)
                 {
-                    peak.min = std::min(peak.min, (*peaks)[i].min);
-                    peak.max = std::max(peak.max, (*peaks)[i].max);
+                    if (debugStats)
+                    {
+                        ++debugStats->cachedPeaksUsed;
+                    }
+                    if (!hasPeak)
+                    {
+                        peak = peaks[i];
+                        hasPeak = true;
+                    }
+                    else
+                    {
+                        peak.min = std::min(peak.min, peaks[i].min);
+                        peak.max = std::max(peak.max, peaks[i].max);
+                    }
                 }
+
+                accumulateRawPeakRange(
+                    std::max(firstFullBlockStart, cachedFullBlockEnd) -
+                        gridOffset,
+                    lastFullBlockEnd - gridOffset, peak, hasPeak);
             }
 
-            accumulateRawPeakRange(std::max(firstFullBlockStart, cachedFullBlockEnd),
-                                   lastFullBlockEnd, peak, hasPeak);
-        }
+            accumulateRawPeakRange(std::max(gridA, lastFullBlockEnd) - gridOffset,
+                                   runEnd, peak, hasPeak);
+        };
+        waveformCache.getFrameLayout().forEachRun(a, b, accumulateRunPeak);
 
-        accumulateRawPeakRange(std::max(a, lastFullBlockEnd), b, peak, hasPeak);
         if (!hasPeak)
         {
             return false;
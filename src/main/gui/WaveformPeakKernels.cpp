@@ -0,0 +1,493 @@
+#include "WaveformPeakKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CUPUACU_PEAK_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CUPUACU_TARGET_AVX2
+#else
+#define CUPUACU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CUPUACU_PEAK_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace cupuacu::gui
+{
+    namespace
+    {
+        static_assert(sizeof(Peak) == 2 * sizeof(float));
+
+        const float *peakFloats(const Peak *peaks)
+        {
+            return reinterpret_cast<const float *>(peaks);
+        }
+
+        float *peakFloats(Peak *peaks)
+        {
+            return reinterpret_cast<float *>(peaks);
+        }
+
+        Peak scalarMinMax(const float *samples, const int64_t count)
+        {
+            float minv = samples[0];
+            float maxv = minv;
+            for (int64_t i = 1; i < count; ++i)
+            {
+                const float v = samples[i];
+                minv = std::min(minv, v);
+                maxv = std::max(maxv, v);
+            }
+            return {minv, maxv};
+        }
+
+        Peak unite(const Peak &a, const Peak &b)
+        {
+            return {std::min(a.min, b.min), std::max(a.max, b.max)};
+        }
+
+        template <typename MinMax>
+        void computeBlockPeaksWith(MinMax minMax, const float *samples,
+                                   const int64_t sampleCount,
+                                   const int64_t blockSize, Peak *peaks)
+        {
+            for (int64_t start = 0, block = 0; start < sampleCount;
+                 start += blockSize, ++block)
+            {
+                peaks[block] = minMax(samples + start,
+                                      std::min(blockSize, sampleCount - start));
+            }
+        }
+
+        void foldPeaksScalar(const Peak *peaks, const int64_t first,
+                             const int64_t peakCount, Peak *folded)
+        {
+            int64_t i = first;
+            for (; i + 1 < peakCount; i += 2)
+            {
+                folded[i / 2] = unite(peaks[i], peaks[i + 1]);
+            }
+            if (i < peakCount)
+            {
+                folded[i / 2] = peaks[i];
+            }
+        }
+
+#if CUPUACU_PEAK_KERNELS_X86
+        float horizontalMin(__m128 v)
+        {
+            v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+            return _mm_cvtss_f32(v);
+        }
+
+        float horizontalMax(__m128 v)
+        {
+            v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+            v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+            return _mm_cvtss_f32(v);
+        }
+
+        Peak sse2MinMax(const float *samples, const int64_t count)
+        {
+            if (count < 8)
+            {
+                return scalarMinMax(samples, count);
+            }
+
+            __m128 min0 = _mm_loadu_ps(samples);
+            __m128 min1 = _mm_loadu_ps(samples + 4);
+            __m128 max0 = min0;
+            __m128 max1 = min1;
+            int64_t i = 8;
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m128 a = _mm_loadu_ps(samples + i);
+                const __m128 b = _mm_loadu_ps(samples + i + 4);
+                min0 = _mm_min_ps(min0, a);
+                max0 = _mm_max_ps(max0, a);
+                min1 = _mm_min_ps(min1, b);
+                max1 = _mm_max_ps(max1, b);
+            }
+            if (i < count)
+            {
+                // The last 8 samples overlap ones already seen, which does
+                // not change a min or max.
+                const __m128 a = _mm_loadu_ps(samples + count - 8);
+                const __m128 b = _mm_loadu_ps(samples + count - 4);
+                min0 = _mm_min_ps(min0, a);
+                max0 = _mm_max_ps(max0, a);
+                min1 = _mm_min_ps(min1, b);
+                max1 = _mm_max_ps(max1, b);
+            }
+            return {horizontalMin(_mm_min_ps(min0, min1)),
+                    horizontalMax(_mm_max_ps(max0, max1))};
+        }
+
+        void foldPeaksSse2(const Peak *peaks, const int64_t peakCount,
+                           Peak *folded)
+        {
+            const float *in = peakFloats(peaks);
+            float *out = peakFloats(folded);
+            int64_t i = 0;
+            for (; i + 4 <= peakCount; i += 4)
+            {
+                // [min0 max0 min1 max1] and [min2 max2 min3 max3] become
+                // [min0 max0 min2 max2] and [min1 max1 min3 max3].
+                const __m128 v0 = _mm_loadu_ps(in + i * 2);
+                const __m128 v1 = _mm_loadu_ps(in + i * 2 + 4);
+                const __m128 even =
+                    _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 1, 0));
+                const __m128 odd =
+                    _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 2, 3, 2));
+                const __m128 mins = _mm_min_ps(even, odd);
+                const __m128 maxs = _mm_max_ps(even, odd);
+                // Lanes 0 and 2 of mins and 1 and 3 of maxs are wanted:
+                // [min01 min23 max01 max23] -> [min01 max01 min23 max23].
+                const __m128 packed =
+                    _mm_shuffle_ps(mins, maxs, _MM_SHUFFLE(3, 1, 2, 0));
+                _mm_storeu_ps(out + i,
+                              _mm_shuffle_ps(packed, packed,
+                                             _MM_SHUFFLE(3, 1, 2, 0)));
+            }
+            foldPeaksScalar(peaks, i, peakCount, folded);
+        }
+
+        CUPUACU_TARGET_AVX2 Peak avx2MinMax(const float *samples,
+                                            const int64_t count)
+        {
+            if (count < 16)
+            {
+                return sse2MinMax(samples, count);
+            }
+
+            __m256 min0 = _mm256_loadu_ps(samples);
+            __m256 min1 = _mm256_loadu_ps(samples + 8);
+            __m256 max0 = min0;
+            __m256 max1 = min1;
+            int64_t i = 16;
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m256 a = _mm256_loadu_ps(samples + i);
+                const __m256 b = _mm256_loadu_ps(samples + i + 8);
+                min0 = _mm256_min_ps(min0, a);
+                max0 = _mm256_max_ps(max0, a);
+                min1 = _mm256_min_ps(min1, b);
+                max1 = _mm256_max_ps(max1, b);
+            }
+            if (i < count)
+            {
+                const __m256 a = _mm256_loadu_ps(samples + count - 16);
+                const __m256 b = _mm256_loadu_ps(samples + count - 8);
+                min0 = _mm256_min_ps(min0, a);
+                max0 = _mm256_max_ps(max0, a);
+                min1 = _mm256_min_ps(min1, b);
+                max1 = _mm256_max_ps(max1, b);
+            }
+            const __m256 mins = _mm256_min_ps(min0, min1);
+            const __m256 maxs = _mm256_max_ps(max0, max1);
+            return {horizontalMin(_mm_min_ps(_mm256_castps256_ps128(mins),
+                                             _mm256_extractf128_ps(mins, 1))),
+                    horizontalMax(_mm_max_ps(_mm256_castps256_ps128(maxs),
+                                             _mm256_extractf128_ps(maxs, 1)))};
+        }
+
+        CUPUACU_TARGET_AVX2 void
+        computeBlockPeaksAvx2(const float *samples, const int64_t sampleCount,
+                              const int64_t blockSize, Peak *peaks)
+        {
+            computeBlockPeaksWith(avx2MinMax, samples, sampleCount, blockSize,
+                                  peaks);
+        }
+
+        CUPUACU_TARGET_AVX2 void foldPeaksAvx2(const Peak *peaks,
+                                               const int64_t peakCount,
+                                               Peak *folded)
+        {
+            const float *in = peakFloats(peaks);
+            float *out = peakFloats(folded);
+            int64_t i = 0;
+            for (; i + 8 <= peakCount; i += 8)
+            {
+                // As in foldPeaksSse2, per 128-bit lane: the low lanes fold
+                // peaks 0-1 and 4-5, the high lanes peaks 2-3 and 6-7.
+                const __m256 v0 = _mm256_loadu_ps(in + i * 2);
+                const __m256 v1 = _mm256_loadu_ps(in + i * 2 + 8);
+                const __m256 even =
+                    _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 1, 0));
+                const __m256 odd =
+                    _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 2, 3, 2));
+                const __m256 lanes = _mm256_blend_ps(
+                    _mm256_min_ps(even, odd), _mm256_max_ps(even, odd), 0xAA);
+                // Folded peaks are in the order 0 2 1 3.
+                _mm256_storeu_ps(
+                    out + i,
+                    _mm256_castpd_ps(_mm256_permute4x64_pd(
+                        _mm256_castps_pd(lanes), _MM_SHUFFLE(3, 1, 2, 0))));
+            }
+            foldPeaksScalar(peaks, i, peakCount, folded);
+        }
+
+        bool cpuSupportsAvx2()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4]{};
+            __cpuid(info, 1);
+            const bool osSavesYmm = (info[2] & (1 << 27)) != 0 &&
+                                    (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+#if CUPUACU_PEAK_KERNELS_NEON
+        Peak neonMinMax(const float *samples, const int64_t count)
+        {
+            if (count < 8)
+            {
+                return scalarMinMax(samples, count);
+            }
+
+            float32x4_t min0 = vld1q_f32(samples);
+            float32x4_t min1 = vld1q_f32(samples + 4);
+            float32x4_t max0 = min0;
+            float32x4_t max1 = min1;
+            int64_t i = 8;
+            for (; i + 8 <= count; i += 8)
+            {
+                const float32x4_t a = vld1q_f32(samples + i);
+                const float32x4_t b = vld1q_f32(samples + i + 4);
+                min0 = vminq_f32(min0, a);
+                max0 = vmaxq_f32(max0, a);
+                min1 = vminq_f32(min1, b);
+                max1 = vmaxq_f32(max1, b);
+            }
+            if (i < count)
+            {
+                const float32x4_t a = vld1q_f32(samples + count - 8);
+                const float32x4_t b = vld1q_f32(samples + count - 4);
+                min0 = vminq_f32(min0, a);
+                max0 = vmaxq_f32(max0, a);
+                min1 = vminq_f32(min1, b);
+                max1 = vmaxq_f32(max1, b);
+            }
+            return {vminvq_f32(vminq_f32(min0, min1)),
+                    vmaxvq_f32(vmaxq_f32(max0, max1))};
+        }
+
+        void foldPeaksNeon(const Peak *peaks, const int64_t peakCount,
+                           Peak *folded)
+        {
+            const float *in = peakFloats(peaks);
+            float *out = peakFloats(folded);
+            int64_t i = 0;
+            for (; i + 8 <= peakCount; i += 8)
+            {
+                // Deinterleaved: val[0] holds mins, val[1] maxes.
+                const float32x4x2_t v0 = vld2q_f32(in + i * 2);
+                const float32x4x2_t v1 = vld2q_f32(in + i * 2 + 8);
+                float32x4x2_t result;
+                result.val[0] = vpminq_f32(v0.val[0], v1.val[0]);
+                result.val[1] = vpmaxq_f32(v0.val[1], v1.val[1]);
+                vst2q_f32(out + i, result);
+            }
+            foldPeaksScalar(peaks, i, peakCount, folded);
+        }
+#endif
+
+        PeakKernelSet detectPeakKernelSet()
+        {
+#if CUPUACU_PEAK_KERNELS_X86
+            return cpuSupportsAvx2() ? PeakKernelSet::Avx2
+                                     : PeakKernelSet::Sse2;
+#elif CUPUACU_PEAK_KERNELS_NEON
+            return PeakKernelSet::Neon;
+#else
+            return PeakKernelSet::Scalar;
+#endif
+        }
+    } // namespace
+
+    bool isPeakKernelSetSupported(const PeakKernelSet kernelSet)
+    {
+        switch (kernelSet)
+        {
+            case PeakKernelSet::Scalar:
+                return true;
+#if CUPUACU_PEAK_KERNELS_X86
+            case PeakKernelSet::Sse2:
+                return true;
+            case PeakKernelSet::Avx2:
+                return cpuSupportsAvx2();
+#endif
+#if CUPUACU_PEAK_KERNELS_NEON
+            case PeakKernelSet::Neon:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    PeakKernelSet activePeakKernelSet()
+    {
+        static const PeakKernelSet kernelSet = detectPeakKernelSet();
+        return kernelSet;
+    }
+
+    std::string_view peakKernelSetName(const PeakKernelSet kernelSet)
+    {
+        switch (kernelSet)
+        {
+            case PeakKernelSet::Sse2:
+                return "SSE2";
+            case PeakKernelSet::Avx2:
+                return "AVX2";
+            case PeakKernelSet::Neon:
+                return "NEON";
+            case PeakKernelSet::Scalar:
+            default:
+                return "scalar";
+        }
+    }
+
+    void computeBlockPeaks(const float *samples, const int64_t sampleCount,
+                           const int64_t blockSize, Peak *peaks)
+    {
+        computeBlockPeaks(activePeakKernelSet(), samples, sampleCount,
+                          blockSize, peaks);
+    }
+
+    void foldPeaks(const Peak *peaks, const int64_t peakCount, Peak *folded)
+    {
+        foldPeaks(activePeakKernelSet(), peaks, peakCount, folded);
+    }
+
+    void computeBlockPeaks(const PeakKernelSet kernelSet, const float *samples,
+                           const int64_t sampleCount, const int64_t blockSize,
+                           Peak *peaks)
+    {
+        if (sampleCount <= 0 || blockSize <= 0)
+        {
+            return;
+        }
+
+        switch (kernelSet)
+        {
+#if CUPUACU_PEAK_KERNELS_X86
+            case PeakKernelSet::Avx2:
+                computeBlockPeaksAvx2(samples, sampleCount, blockSize, peaks);
+                return;
+            case PeakKernelSet::Sse2:
+                computeBlockPeaksWith(sse2MinMax, samples, sampleCount,
+                                      blockSize, peaks);
+                return;
+#endif
+#if CUPUACU_PEAK_KERNELS_NEON
+            case PeakKernelSet::Neon:
+                computeBlockPeaksWith(neonMinMax, samples, sampleCount,
+                                      blockSize, peaks);
+                return;
+#endif
+            default:
+                computeBlockPeaksWith(scalarMinMax, samples, sampleCount,
+                                      blockSize, peaks);
+                return;
+        }
+    }
+
+    void foldPeaks(const PeakKernelSet kernelSet, const Peak *peaks,
+                   const int64_t peakCount, Peak *folded)
+    {
+        if (peakCount <= 0)
+        {
+            return;
+        }
+
+        switch (kernelSet)
+        {
+#if CUPUACU_PEAK_KERNELS_X86
+            case PeakKernelSet::Avx2:
+                foldPeaksAvx2(peaks, peakCount, folded);
+                return;
+            case PeakKernelSet::Sse2:
+                foldPeaksSse2(peaks, peakCount, folded);
+                return;
+#endif
+#if CUPUACU_PEAK_KERNELS_NEON
+            case PeakKernelSet::Neon:
+                foldPeaksNeon(peaks, peakCount, folded);
+                return;
+#endif
+            default:
+                foldPeaksScalar(peaks, 0, peakCount, folded);
+                return;
+        }
+    }
+
+    BlockEnergy computeEnergy(const float *samples, const int64_t sampleCount)
+    {
+        // Four running sums let the additions overlap.
+        float sums[4] = {};
+        uint32_t clipCount = 0;
+        int64_t i = 0;
+        for (; i + 4 <= sampleCount; i += 4)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                const float v = samples[i + lane];
+                sums[lane] += v * v;
+                clipCount += std::fabs(v) >= CLIPPED_SAMPLE_LEVEL ? 1u : 0u;
+            }
+        }
+        for (; i < sampleCount; ++i)
+        {
+            const float v = samples[i];
+            sums[0] += v * v;
+            clipCount += std::fabs(v) >= CLIPPED_SAMPLE_LEVEL ? 1u : 0u;
+        }
+        return {.sumOfSquares = (sums[0] + sums[1]) + (sums[2] + sums[3]),
+                .clipCount = clipCount};
+    }
+
+    void computeBlockEnergies(const float *samples, const int64_t sampleCount,
+                              const int64_t blockSize, BlockEnergy *energies)
+    {
+        if (blockSize <= 0)
+        {
+            return;
+        }
+
+        for (int64_t start = 0, block = 0; start < sampleCount;
+             start += blockSize, ++block)
+        {
+            energies[block] = computeEnergy(
+                samples + start, std::min(blockSize, sampleCount - start));
+        }
+    }
+
+    void foldEnergies(const BlockEnergy *energies, const int64_t energyCount,
+                      BlockEnergy *folded)
+    {
+        int64_t i = 0;
+        for (; i + 1 < energyCount; i += 2)
+        {
+            folded[i / 2] = {
+                .sumOfSquares =
+                    energies[i].sumOfSquares + energies[i + 1].sumOfSquares,
+                .clipCount = energies[i].clipCount + energies[i + 1].clipCount};
+        }
+        if (i < energyCount)
+        {
+            folded[i / 2] = energies[i];
+        }
+    }
+} // namespace cupuacu::gui
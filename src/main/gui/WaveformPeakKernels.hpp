@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace cupuacu::gui
+{
+    struct Peak
+    {
+        float min;
+        float max;
+    };
+
+    // The energy of a run of samples: the sum of their squares, and how many
+    // of them are clipped.
+    struct BlockEnergy
+    {
+        float sumOfSquares = 0.0f;
+        uint32_t clipCount = 0;
+    };
+
+    // Samples of at least this magnitude count as clipped. It is the largest
+    // positive 16-bit value, so full scale clips in every format.
+    constexpr float CLIPPED_SAMPLE_LEVEL = 32767.0f / 32768.0f;
+
+    // Instruction sets the peak kernels are built for. The fastest one the
+    // CPU supports is picked on first use.
+    enum class PeakKernelSet
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+        Neon
+    };
+
+    [[nodiscard]] bool isPeakKernelSetSupported(PeakKernelSet kernelSet);
+    [[nodiscard]] PeakKernelSet activePeakKernelSet();
+    [[nodiscard]] std::string_view peakKernelSetName(PeakKernelSet kernelSet);
+
+    // peaks[i] becomes the min and max of samples [i * blockSize,
+    // (i + 1) * blockSize), the last block being cut short by sampleCount.
+    void computeBlockPeaks(const float *samples, int64_t sampleCount,
+                           int64_t blockSize, Peak *peaks);
+
+    // folded[i] becomes the union of peaks[2 * i] and peaks[2 * i + 1], an
+    // odd last peak being copied. folded holds (peakCount + 1) / 2 peaks.
+    void foldPeaks(const Peak *peaks, int64_t peakCount, Peak *folded);
+
+    // The energy of samples [0, sampleCount).
+    [[nodiscard]] BlockEnergy computeEnergy(const float *samples,
+                                            int64_t sampleCount);
+
+    // As computeBlockPeaks(), for the energy of each block.
+    void computeBlockEnergies(const float *samples, int64_t sampleCount,
+                              int64_t blockSize, BlockEnergy *energies);
+
+    // folded[i] becomes the sum of energies[2 * i] and energies[2 * i + 1],
+    // an odd last energy being copied.
+    void foldEnergies(const BlockEnergy *energies, int64_t energyCount,
+                      BlockEnergy *folded);
+
+    // As above, with kernelSet instead of activePeakKernelSet(). kernelSet
+    // must be supported.
+    void computeBlockPeaks(PeakKernelSet kernelSet, const float *samples,
+                           int64_t sampleCount, int64_t blockSize, Peak *peaks);
+    void foldPeaks(PeakKernelSet kernelSet, const Peak *peaks,
+                   int64_t peakCount, Peak *folded);
+} // namespace cupuacu::gui
@@ -0,0 +1,257 @@
+#include "WaveformSmoothReconstruction.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CUPUACU_SMOOTH_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CUPUACU_TARGET_AVX2
+#else
+#define CUPUACU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CUPUACU_SMOOTH_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace cupuacu::gui
+{
+    namespace
+    {
+        constexpr int kTaps = SMOOTH_RECONSTRUCTION_TAPS;
+        constexpr int kPhases = SMOOTH_RECONSTRUCTION_PHASES;
+        // The taps left of the frame at or before a pixel's position.
+        constexpr int kTapsBefore = kTaps / 2 - 1;
+        static_assert(kTaps == 8, "the SIMD kernels take 8 taps at once");
+        // Positions in the window step from pixel to pixel in fixed point,
+        // whose top fraction bits pick the table row.
+        constexpr int kFractionBits = 32;
+        static_assert(std::has_single_bit(unsigned{kPhases}));
+        constexpr int kPhaseShift =
+            kFractionBits - std::countr_zero(unsigned{kPhases});
+
+        struct alignas(32) KernelPhase
+        {
+            std::array<float, kTaps> weights{};
+        };
+
+        using KernelTable = std::array<KernelPhase, kPhases>;
+
+        double lanczos(const double x)
+        {
+            constexpr double lobes = kTaps / 2;
+            if (x == 0.0)
+            {
+                return 1.0;
+            }
+            if (std::abs(x) >= lobes)
+            {
+                return 0.0;
+            }
+            const double piX = std::numbers::pi * x;
+            return lobes * std::sin(piX) * std::sin(piX / lobes) /
+                   (piX * piX);
+        }
+
+        // Row p weighs the frames around a position p / kPhases of the way
+        // from one frame to the next. Each row sums to 1, so a constant
+        // signal comes out unchanged.
+        const KernelTable &kernelTable()
+        {
+            static const KernelTable table = []
+            {
+                KernelTable result{};
+                for (int phase = 0; phase < kPhases; ++phase)
+                {
+                    const double fraction =
+                        static_cast<double>(phase) / kPhases;
+                    double sum = 0.0;
+                    std::array<double, kTaps> weights{};
+                    for (int tap = 0; tap < kTaps; ++tap)
+                    {
+                        weights[tap] = lanczos(tap - kTapsBefore - fraction);
+                        sum += weights[tap];
+                    }
+                    for (int tap = 0; tap < kTaps; ++tap)
+                    {
+                        result[phase].weights[tap] =
+                            static_cast<float>(weights[tap] / sum);
+                    }
+                }
+                return result;
+            }();
+            return table;
+        }
+
+        double pixelFrame(const int x, const double samplesPerPixel,
+                          const int64_t sampleOffset)
+        {
+            return static_cast<double>(x) * samplesPerPixel +
+                   (static_cast<double>(sampleOffset) - 0.5);
+        }
+
+        float dotScalar(const float *samples, const float *weights)
+        {
+            float sum = 0.0f;
+            for (int tap = 0; tap < kTaps; ++tap)
+            {
+                sum += samples[tap] * weights[tap];
+            }
+            return sum;
+        }
+
+        // dot(firstTap, weights) weighs the kTaps frames from firstTap.
+        // A template argument rather than a pointer, so that it is inlined.
+        template <float (*dot)(const float *, const float *)>
+        void reconstructWith(const float *samples,
+                             const WaveformSmoothSampleWindow &window,
+                             const double samplesPerPixel,
+                             const int64_t sampleOffset, float *values)
+        {
+            const auto &table = kernelTable();
+            constexpr double one = static_cast<double>(1ull << kFractionBits);
+            // Rounded to the nearest row, which may be frame + 1's first.
+            uint64_t position =
+                static_cast<uint64_t>(std::llround(
+                    (pixelFrame(0, samplesPerPixel, sampleOffset) -
+                     static_cast<double>(window.firstFrame + kTapsBefore)) *
+                    one)) +
+                (1ull << (kPhaseShift - 1));
+            const auto step =
+                static_cast<uint64_t>(std::llround(samplesPerPixel * one));
+            for (int x = 0; x < window.pixelCount; ++x, position += step)
+            {
+                const auto phase = (position >> kPhaseShift) & (kPhases - 1);
+                values[x] = dot(samples + (position >> kFractionBits),
+                                table[phase].weights.data());
+            }
+        }
+
+#if CUPUACU_SMOOTH_KERNELS_X86
+        float horizontalSum(const __m128 v)
+        {
+            const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+            return _mm_cvtss_f32(
+                _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+        }
+
+        float dotSse2(const float *samples, const float *weights)
+        {
+            const __m128 low =
+                _mm_mul_ps(_mm_loadu_ps(samples), _mm_load_ps(weights));
+            const __m128 high = _mm_mul_ps(_mm_loadu_ps(samples + 4),
+                                           _mm_load_ps(weights + 4));
+            return horizontalSum(_mm_add_ps(low, high));
+        }
+
+        CUPUACU_TARGET_AVX2 float dotAvx2(const float *samples,
+                                          const float *weights)
+        {
+            const __m256 products = _mm256_mul_ps(_mm256_loadu_ps(samples),
+                                                  _mm256_load_ps(weights));
+            return horizontalSum(
+                _mm_add_ps(_mm256_castps256_ps128(products),
+                           _mm256_extractf128_ps(products, 1)));
+        }
+
+        CUPUACU_TARGET_AVX2 void
+        reconstructAvx2(const float *samples,
+                        const WaveformSmoothSampleWindow &window,
+                        const double samplesPerPixel,
+                        const int64_t sampleOffset, float *values)
+        {
+            reconstructWith<dotAvx2>(samples, window, samplesPerPixel,
+                                     sampleOffset, values);
+        }
+#endif
+
+#if CUPUACU_SMOOTH_KERNELS_NEON
+        float dotNeon(const float *samples, const float *weights)
+        {
+            float32x4_t sum =
+                vmulq_f32(vld1q_f32(samples), vld1q_f32(weights));
+            sum = vmlaq_f32(sum, vld1q_f32(samples + 4),
+                            vld1q_f32(weights + 4));
+            return vaddvq_f32(sum);
+        }
+#endif
+    } // namespace
+
+    WaveformSmoothSampleWindow
+    planWaveformSmoothSampleWindow(const int width,
+                                   const double samplesPerPixel,
+                                   const int64_t sampleOffset,
+                                   const int64_t documentFrameCount)
+    {
+        if (width < 0 || samplesPerPixel <= 0.0 || sampleOffset < 0 ||
+            sampleOffset >= documentFrameCount)
+        {
+            return {};
+        }
+
+        const double pixelsToEnd =
+            std::ceil(static_cast<double>(documentFrameCount - sampleOffset) /
+                      samplesPerPixel);
+        const int lastPixel =
+            pixelsToEnd < width ? static_cast<int>(pixelsToEnd) : width;
+        const auto firstFrame =
+            static_cast<int64_t>(
+                std::floor(pixelFrame(0, samplesPerPixel, sampleOffset))) -
+            kTapsBefore;
+        // A position rounded up to the next frame's row reaches one frame
+        // further, and one more allows for the fixed point steps.
+        const auto lastFrame =
+            static_cast<int64_t>(std::floor(
+                pixelFrame(lastPixel, samplesPerPixel, sampleOffset))) +
+            2 + (kTaps - 1 - kTapsBefore);
+        return {
+            .firstFrame = firstFrame,
+            .frameCount = lastFrame - firstFrame + 1,
+            .pixelCount = lastPixel + 1,
+        };
+    }
+
+    void reconstructSmoothWaveform(const float *samples,
+                                   const WaveformSmoothSampleWindow &window,
+                                   const double samplesPerPixel,
+                                   const int64_t sampleOffset, float *values)
+    {
+        reconstructSmoothWaveform(activePeakKernelSet(), samples, window,
+                                  samplesPerPixel, sampleOffset, values);
+    }
+
+    void reconstructSmoothWaveform(const PeakKernelSet kernelSet,
+                                   const float *samples,
+                                   const WaveformSmoothSampleWindow &window,
+                                   const double samplesPerPixel,
+                                   const int64_t sampleOffset, float *values)
+    {
+        switch (kernelSet)
+        {
+#if CUPUACU_SMOOTH_KERNELS_X86
+            case PeakKernelSet::Avx2:
+                reconstructAvx2(samples, window, samplesPerPixel,
+                                sampleOffset, values);
+                return;
+            case PeakKernelSet::Sse2:
+                reconstructWith<dotSse2>(samples, window, samplesPerPixel,
+                                         sampleOffset, values);
+                return;
+#endif
+#if CUPUACU_SMOOTH_KERNELS_NEON
+            case PeakKernelSet::Neon:
+                reconstructWith<dotNeon>(samples, window, samplesPerPixel,
+                                         sampleOffset, values);
+                return;
+#endif
+            default:
+                reconstructWith<dotScalar>(samples, window, samplesPerPixel,
+                                           sampleOffset, values);
+                return;
+        }
+    }
+} // namespace cupuacu::gui
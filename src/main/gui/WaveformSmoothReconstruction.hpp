@@ -0,0 +1,105 @@
+#pragma once
+
+#include "WaveformPeakKernels.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cupuacu::gui
+{
+    // Smooth mode draws the waveform band-limited: each pixel's value is
+    // the frames around it weighed by a Lanczos windowed sinc. The weights
+    // for SMOOTH_RECONSTRUCTION_PHASES positions between two frames are
+    // worked out once, so a value costs one short dot product.
+    constexpr int SMOOTH_RECONSTRUCTION_TAPS = 8;
+    constexpr int SMOOTH_RECONSTRUCTION_PHASES = 256;
+
+    // The frames that values for pixels [0, pixelCount) are reconstructed
+    // from. Pixel x is at frame x * samplesPerPixel + sampleOffset - 0.5,
+    // so that frames are drawn at the centre of the pixels they cover.
+    struct WaveformSmoothSampleWindow
+    {
+        int64_t firstFrame = 0;
+        int64_t frameCount = 0;
+        int pixelCount = 0;
+    };
+
+    // The window for pixels 0 to width, cut short at the pixel where the
+    // last frame ends. Frames before 0 and from documentFrameCount on are
+    // part of it, for the taps of the pixels near either end.
+    [[nodiscard]] WaveformSmoothSampleWindow
+    planWaveformSmoothSampleWindow(int width, double samplesPerPixel,
+                                   int64_t sampleOffset,
+                                   int64_t documentFrameCount);
+
+    // values[x] becomes the reconstructed value at pixel x, for each of
+    // window.pixelCount pixels. samples holds the window's frames.
+    void reconstructSmoothWaveform(const float *samples,
+                                   const WaveformSmoothSampleWindow &window,
+                                   double samplesPerPixel,
+                                   int64_t sampleOffset, float *values);
+
+    // As above, with kernelSet instead of activePeakKernelSet(). kernelSet
+    // must be supported.
+    void reconstructSmoothWaveform(PeakKernelSet kernelSet,
+                                   const float *samples,
+                                   const WaveformSmoothSampleWindow &window,
+                                   double samplesPerPixel,
+                                   int64_t sampleOffset, float *values);
+
+    // Reconstructs into buffers it keeps, so once they are large enough for
+    // the view no frame allocates.
+    class WaveformSmoothReconstructor
+    {
+    public:
+        // readFrames(startFrame, destination, frameCount) copies frames that
+        // lie in the document and returns how many it copied. Frames past
+        // either end repeat the first or last one. Returns a value for each
+        // pixel up to where the document ends, valid until the next call.
+        template <typename ReadFrames>
+        std::span<const float>
+        reconstruct(const int width, const double samplesPerPixel,
+                    const int64_t sampleOffset,
+                    const int64_t documentFrameCount, ReadFrames &&readFrames)
+        {
+            const auto window = planWaveformSmoothSampleWindow(
+                width, samplesPerPixel, sampleOffset, documentFrameCount);
+            if (window.pixelCount <= 0)
+            {
+                return {};
+            }
+
+            samples.resize(static_cast<std::size_t>(window.frameCount));
+            const int64_t readStart =
+                std::max<int64_t>(0, window.firstFrame);
+            const int64_t readEnd = std::min(
+                documentFrameCount, window.firstFrame + window.frameCount);
+            const int64_t offset = readStart - window.firstFrame;
+            const int64_t read =
+                readEnd > readStart
+                    ? readFrames(readStart, samples.data() + offset,
+                                 readEnd - readStart)
+                    : 0;
+            if (read <= 0)
+            {
+                return {};
+            }
+
+            std::fill(samples.begin(), samples.begin() + offset,
+                      samples[static_cast<std::size_t>(offset)]);
+            std::fill(samples.begin() + offset + read, samples.end(),
+                      samples[static_cast<std::size_t>(offset + read - 1)]);
+
+            values.resize(static_cast<std::size_t>(window.pixelCount));
+            reconstructSmoothWaveform(samples.data(), window, samplesPerPixel,
+                                      sampleOffset, values.data());
+            return values;
+        }
+
+    private:
+        std::vector<float> samples;
+        std::vector<float> values;
+    };
+} // namespace cupuacu::gui
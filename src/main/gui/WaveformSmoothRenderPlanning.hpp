@@ -26,6 +26,8 @@ namespace cupuacu::gui
         std::array<SDL_FPoint, 4> vertices{};
     };
 
+    // The natural spline smooth mode drew before WaveformSmoothReconstructor
+    // took over. The smooth benchmark still measures against it.
     inline std::vector<float> evaluateWaveformSmoothSpline(
         const WaveformSmoothRenderInput &input)
     {
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace cupuacu::gui
+{
+    // Block-mode waveforms are drawn from tiles of WAVEFORM_TILE_WIDTH
+    // pixels. At a given samplesPerPixel, tile i shows pixels
+    // [i * WAVEFORM_TILE_WIDTH, (i + 1) * WAVEFORM_TILE_WIDTH) of the channel
+    // drawn from frame 0, so a tile looks the same from every scroll
+    // position that shows it.
+    constexpr int WAVEFORM_TILE_WIDTH = 256;
+
+    struct WaveformTileKey
+    {
+        uint8_t channel = 0;
+        double samplesPerPixel = 0.0;
+        double verticalZoom = 0.0;
+        int height = 0;
+        uint8_t pixelScale = 0;
+        float uiScale = 0.0f;
+        int64_t tileIndex = 0;
+        // Document::getFrameRangeVersion() of waveformTileFrameRange().
+        uint64_t dataVersion = 0;
+
+        bool operator==(const WaveformTileKey &) const = default;
+    };
+
+    struct WaveformTileKeyHash
+    {
+        std::size_t operator()(const WaveformTileKey &key) const
+        {
+            std::size_t hash = std::hash<int64_t>{}(key.tileIndex);
+            const auto combine = [&](const std::size_t value)
+            {
+                hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) +
+                        (hash >> 2);
+            };
+            combine(std::hash<uint64_t>{}(key.dataVersion));
+            combine(std::hash<double>{}(key.samplesPerPixel));
+            combine(std::hash<double>{}(key.verticalZoom));
+            combine(std::hash<int>{}(key.height));
+            combine(std::hash<float>{}(key.uiScale));
+            combine((std::size_t{key.channel} << 8) | key.pixelScale);
+            return hash;
+        }
+    };
+
+    // The tiles that cover a view.
+    struct WaveformTileSpan
+    {
+        int64_t firstTileIndex = 0;
+        int64_t tileCount = 0;
+        // Where the left edge of the first tile lies in the view, 0 or left
+        // of it.
+        int firstTileX = 0;
+    };
+
+    inline WaveformTileSpan planWaveformTileSpan(const int64_t sampleOffset,
+                                                 const double samplesPerPixel,
+                                                 const int viewWidth)
+    {
+        if (samplesPerPixel <= 0.0 || viewWidth <= 0)
+        {
+            return {};
+        }
+
+        const double viewStartPixel =
+            static_cast<double>(sampleOffset) / samplesPerPixel;
+        const auto firstTileIndex = static_cast<int64_t>(
+            std::floor(viewStartPixel / WAVEFORM_TILE_WIDTH));
+        // Rounding the position rather than each tile's keeps neighbouring
+        // tiles exactly WAVEFORM_TILE_WIDTH apart.
+        const auto firstTileX = static_cast<int>(std::llround(
+            static_cast<double>(firstTileIndex) * WAVEFORM_TILE_WIDTH -
+            viewStartPixel));
+        return {
+            .firstTileIndex = firstTileIndex,
+            .tileCount = (viewWidth - firstTileX + WAVEFORM_TILE_WIDTH - 1) /
+                         WAVEFORM_TILE_WIDTH,
+            .firstTileX = firstTileX,
+        };
+    }
+
+    // The frame a tile's left edge is drawn from.
+    inline int64_t waveformTileSampleOffset(const int64_t tileIndex,
+                                            const double samplesPerPixel)
+    {
+        return static_cast<int64_t>(
+            std::llround(static_cast<double>(tileIndex) *
+                         WAVEFORM_TILE_WIDTH * samplesPerPixel));
+    }
+
+    struct WaveformTileFrameRange
+    {
+        int64_t startFrame = 0;
+        int64_t endFrameExclusive = 0;
+    };
+
+    // The frames a tile's pixels can depend on: its own, those of the
+    // pixels on either side of it, which its edge connecting lines go to,
+    // and a pixel's worth more on each side for cached peaks that straddle
+    // the edges.
+    inline WaveformTileFrameRange
+    waveformTileFrameRange(const int64_t tileIndex,
+                           const double samplesPerPixel)
+    {
+        const auto sampleOffset =
+            static_cast<double>(waveformTileSampleOffset(tileIndex,
+                                                         samplesPerPixel));
+        return {
+            .startFrame = static_cast<int64_t>(
+                std::floor(sampleOffset - 2.0 * samplesPerPixel)),
+            .endFrameExclusive = static_cast<int64_t>(std::ceil(
+                sampleOffset +
+                (WAVEFORM_TILE_WIDTH + 2.0) * samplesPerPixel)),
+        };
+    }
+
+    // Rendered tiles, least recently used first out once their total size
+    // passes the budget. Texture is a handle that destroyTexture frees.
+    template <typename Texture> class WaveformTilePool
+    {
+    public:
+        using DestroyTexture = std::function<void(Texture)>;
+
+        // Room for 128 tiles 512 pixels high.
+        static constexpr uint64_t DEFAULT_BUDGET_BYTES =
+            uint64_t{64} * 1024 * 1024;
+
+        explicit WaveformTilePool(
+            DestroyTexture destroyTextureToUse,
+            const uint64_t budgetBytesToUse = DEFAULT_BUDGET_BYTES)
+            : destroyTexture(std::move(destroyTextureToUse)),
+              budgetBytes(budgetBytesToUse)
+        {
+        }
+
+        WaveformTilePool(const WaveformTilePool &) = delete;
+        WaveformTilePool &operator=(const WaveformTilePool &) = delete;
+
+        ~WaveformTilePool()
+        {
+            clear();
+        }
+
+        // The texture of key, which becomes the most recently used tile,
+        // or nullptr.
+        const Texture *find(const WaveformTileKey &key)
+        {
+            const auto it = index.find(key);
+            if (it == index.end())
+            {
+                return nullptr;
+            }
+            tiles.splice(tiles.begin(), tiles, it->second);
+            return &it->second->texture;
+        }
+
+        [[nodiscard]] bool contains(const WaveformTileKey &key) const
+        {
+            return index.contains(key);
+        }
+
+        // Takes texture, of sizeBytes, as the most recently used tile and
+        // frees the least recently used ones past the budget. The newest
+        // tile is kept even if it alone is over it.
+        const Texture &insert(const WaveformTileKey &key, Texture texture,
+                              const uint64_t sizeBytes)
+        {
+            if (const auto it = index.find(key); it != index.end())
+            {
+                erase(it->second);
+            }
+
+            tiles.push_front(Tile{.key = key,
+                                  .texture = std::move(texture),
+                                  .sizeBytes = sizeBytes});
+            index.emplace(key, tiles.begin());
+            usedBytes += sizeBytes;
+            while (usedBytes > budgetBytes && tiles.size() > 1)
+            {
+                erase(std::prev(tiles.end()));
+            }
+            return tiles.front().texture;
+        }
+
+        void clear()
+        {
+            while (!tiles.empty())
+            {
+                erase(tiles.begin());
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return tiles.size();
+        }
+
+        [[nodiscard]] uint64_t getUsedBytes() const
+        {
+            return usedBytes;
+        }
+
+        [[nodiscard]] uint64_t getBudgetBytes() const
+        {
+            return budgetBytes;
+        }
+
+    private:
+        struct Tile
+        {
+            WaveformTileKey key{};
+            Texture texture{};
+            uint64_t sizeBytes = 0;
+        };
+
+        DestroyTexture destroyTexture;
+        uint64_t budgetBytes = 0;
+        uint64_t usedBytes = 0;
+        // Most recently used first.
+        std::list<Tile> tiles;
+        std::unordered_map<WaveformTileKey,
+                           typename std::list<Tile>::iterator,
+                           WaveformTileKeyHash>
+            index;
+
+        void erase(const typename std::list<Tile>::iterator it)
+        {
+            index.erase(it->key);
+            usedBytes -= it->sizeBytes;
+            if (destroyTexture)
+            {
+                destroyTexture(it->texture);
+            }
+            tiles.erase(it);
+        }
+    };
+} // namespace cupuacu::gui
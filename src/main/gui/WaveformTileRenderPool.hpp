@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../Document.hpp"
+#include "../concurrency/PrioritizedBackgroundWorkerPool.hpp"
+#include "WaveformCache.hpp"
+#include "WaveformFrameLayout.hpp"
+#include "WaveformTilePool.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cupuacu::gui
+{
+    // A block-mode tile to draw off the main thread. The samples and peaks
+    // are read in place from a document snapshot and a pinned cache level.
+    struct WaveformTileRenderRequest
+    {
+        WaveformTileKey tileKey{};
+        int64_t sampleOffset = 0;
+        int64_t frameCount = 0;
+        SDL_FColor color{};
+        bool bypassCache = true;
+        int64_t samplesPerPeak = 0;
+        // Set when bypassCache is.
+        std::optional<Document::ReadLease> samples;
+        // Set when bypassCache is not, with the layout of its peaks.
+        WaveformCache::PinnedLevel peaks;
+        WaveformFrameLayout frameLayout;
+    };
+
+    struct WaveformTileRenderResult
+    {
+        WaveformTileKey tileKey{};
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    // The threads that render tiles for every Waveform. State owns the one
+    // instance.
+    class WaveformTileRenderPool
+        : public concurrency::PrioritizedBackgroundWorkerPool<
+              WaveformTileRenderRequest, WaveformTileRenderResult>
+    {
+    public:
+        explicit WaveformTileRenderPool(
+            ProcessFn processToUse,
+            const std::size_t threadCount = defaultThreadCount())
+            : PrioritizedBackgroundWorkerPool(std::move(processToUse),
+                                              threadCount)
+        {
+        }
+
+        // Half the cores, up to 4, leaving the rest to the UI, audio and
+        // peak building.
+        static std::size_t defaultThreadCount()
+        {
+            return std::clamp<std::size_t>(
+                std::thread::hardware_concurrency() / 2, 1, 4);
+        }
+    };
+} // namespace cupuacu::gui
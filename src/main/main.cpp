@@ -22,6 +22,7 @@
 #include "actions/io/BackgroundOpen.hpp"
 #include "actions/io/BackgroundSave.hpp"
 #include "undo/UndoManifestPersistence.hpp"
+#include "undo/UndoPayloadWriter.hpp"
 
 #include <cstdint>
 #include <filesystem>
@@ -33,6 +34,8 @@
 #include "persistence/DisplayPropertiesPersistence.hpp"
 #include "persistence/RecentFilesPersistence.hpp"
 #include "persistence/SessionStatePersistence.hpp"
+#include "persistence/UndoHistoryPropertiesPersistence.hpp"
+#include "persistence/WaveformCachePropertiesPersistence.hpp"
 
 #if defined(__APPLE__)
 #include "platform/macos/MenuAdjustments.hpp"
@@ -129,6 +132,35 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char **argv)
         state->audioDevices->setDeviceSelection(
             persistedAudioProperties->deviceSelection);
     }
+    if (const auto persistedWaveformCacheProperties =
+            cupuacu::persistence::WaveformCachePropertiesPersistence::load(
+                state->paths->waveformCachePropertiesPath());
+        persistedWaveformCacheProperties.has_value())
+    {
+        state->waveformCacheSettings = *persistedWaveformCacheProperties;
+    }
+    else if (std::error_code ec; !std::filesystem::exists(
+                 state->paths->waveformCachePropertiesPath(), ec))
+    {
+        // Written out so that the defaults can be found and edited.
+        cupuacu::persistence::WaveformCachePropertiesPersistence::save(
+            state->paths->waveformCachePropertiesPath(),
+            state->waveformCacheSettings);
+    }
+    if (const auto persistedUndoHistoryProperties =
+            cupuacu::persistence::UndoHistoryPropertiesPersistence::load(
+                state->paths->undoHistoryPropertiesPath());
+        persistedUndoHistoryProperties.has_value())
+    {
+        state->undoHistoryBudget = *persistedUndoHistoryProperties;
+    }
+    else if (std::error_code ec; !std::filesystem::exists(
+                 state->paths->undoHistoryPropertiesPath(), ec))
+    {
+        cupuacu::persistence::UndoHistoryPropertiesPersistence::save(
+            state->paths->undoHistoryPropertiesPath(),
+            state->undoHistoryBudget);
+    }
     const auto persistedRecentFiles =
         cupuacu::persistence::RecentFilesPersistence::load(
             state->paths->recentlyOpenedFilesPath());
@@ -303,6 +335,8 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result)
     cupuacu::actions::persistSessionStateForShutdown(state,
                                                      persistedSessionState);
     const auto sessionPersistedAt = std::chrono::steady_clock::now();
+    cupuacu::undo::drainUndoPayloadWrites();
+    const auto undoDrainedAt = std::chrono::steady_clock::now();
     cupuacu::undo::pruneUndoStores(
         state->paths->undoPath(), persistedSessionState);
     const auto undoPrunedAt = std::chrono::steady_clock::now();
@@ -339,10 +373,15 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result)
             std::chrono::duration_cast<std::chrono::milliseconds>(
                 sessionPersistedAt - sessionBuiltAt)
                 .count()) +
+        " drain_undo_ms=" +
+        std::to_string(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                undoDrainedAt - sessionPersistedAt)
+                .count()) +
         " prune_undo_ms=" +
         std::to_string(
             std::chrono::duration_cast<std::chrono::milliseconds>(
-                undoPrunedAt - sessionPersistedAt)
+                undoPrunedAt - undoDrainedAt)
                 .count()) +
         " display_props_ms=" +
         std::to_string(
@@ -22,7 +22,7 @@ namespace cupuacu::persistence
     namespace
     {
         constexpr char kMagic[] = "CUPUACU_AUTOSAVE";
-        constexpr uint32_t kVersion = 2;
+        constexpr uint32_t kVersion = 4;
         constexpr int64_t kAudioBlockFrames = 16384;
 
         class ClipboardSnapshotWorker
@@ -285,6 +285,15 @@ namespace cupuacu::persistence
             writeI64(output, state.numSamples);
             writeI64(output, state.dirtyFromBlock);
             writeI64(output, state.dirtyToBlock);
+            writeI64(output, state.layout.getGridLength());
+            const auto &runs = state.layout.getRuns();
+            writeI64(output, static_cast<int64_t>(runs.size()));
+            for (const auto &run : runs)
+            {
+                writeI64(output, run.frameStart);
+                writeI64(output, run.frameCount);
+                writeI64(output, run.gridStart);
+            }
             writeU32(output, static_cast<uint32_t>(state.levels.size()));
             for (const auto &level : state.levels)
             {
@@ -300,6 +309,22 @@ namespace cupuacu::persistence
                     writeFloat(output, peak.max);
                 }
             }
+            for (std::size_t levelIndex = 0; levelIndex < state.levels.size();
+                 ++levelIndex)
+            {
+                if (levelIndex >= state.energyLevels.size() ||
+                    state.energyLevels[levelIndex].size() !=
+                        state.levels[levelIndex].size())
+                {
+                    throw std::runtime_error(
+                        "Autosave waveform cache energies do not match peaks");
+                }
+                for (const auto &energy : state.energyLevels[levelIndex])
+                {
+                    writeFloat(output, energy.sumOfSquares);
+                    writeU32(output, energy.clipCount);
+                }
+            }
         }
 
         gui::WaveformCache::BuildResult readWaveformCacheResult(
@@ -309,6 +334,27 @@ namespace cupuacu::persistence
             result.numSamples = readI64(input);
             result.dirtyFromBlock = readI64(input);
             result.dirtyToBlock = readI64(input);
+            const auto gridLength = readI64(input);
+            const auto runCount = readI64(input);
+            if (runCount < 0 || runCount > gridLength)
+            {
+                throw std::runtime_error(
+                    "Invalid autosave waveform cache layout");
+            }
+            std::vector<gui::WaveformFrameLayout::Run> runs(
+                static_cast<std::size_t>(runCount));
+            for (auto &run : runs)
+            {
+                run.frameStart = readI64(input);
+                run.frameCount = readI64(input);
+                run.gridStart = readI64(input);
+            }
+            if (!result.layout.assign(std::move(runs), gridLength) ||
+                result.layout.getFrameCount() != result.numSamples)
+            {
+                throw std::runtime_error(
+                    "Invalid autosave waveform cache layout");
+            }
             const auto levelCount = readU32(input);
             result.levels.resize(levelCount);
             for (uint32_t levelIndex = 0; levelIndex < levelCount; ++levelIndex)
@@ -324,6 +370,16 @@ namespace cupuacu::persistence
                     };
                 }
             }
+            for (const auto &level : result.levels)
+            {
+                auto &energyLevel = result.energyLevels.emplace_back(
+                    level.size());
+                for (auto &energy : energyLevel)
+                {
+                    energy.sumOfSquares = readFloat(input);
+                    energy.clipCount = readU32(input);
+                }
+            }
             return result;
         }
 
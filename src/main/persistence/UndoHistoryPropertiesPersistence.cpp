@@ -0,0 +1,97 @@
+#include "persistence/UndoHistoryPropertiesPersistence.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace cupuacu::persistence
+{
+    namespace
+    {
+        constexpr int kFormatVersion = 1;
+    } // namespace
+
+    bool UndoHistoryPropertiesPersistence::save(
+        const std::filesystem::path &path,
+        const undo::UndoHistoryBudget &budget)
+    {
+        if (path.empty())
+        {
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.good())
+        {
+            return false;
+        }
+
+        const nlohmann::json json{
+            {"version", kFormatVersion},
+            {"maxPendingBytes", budget.maxPendingBytes},
+            {"maxSessionBytes", budget.maxSessionBytes},
+            {"maxTotalBytes", budget.maxTotalBytes}};
+        out << json.dump(2);
+        return out.good();
+    }
+
+    std::optional<undo::UndoHistoryBudget>
+    UndoHistoryPropertiesPersistence::load(const std::filesystem::path &path)
+    {
+        if (path.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in.good())
+        {
+            return std::nullopt;
+        }
+
+        nlohmann::json json;
+        try
+        {
+            in >> json;
+        }
+        catch (const std::exception &)
+        {
+            return std::nullopt;
+        }
+
+        if (!json.is_object() || !json.contains("version") ||
+            !json.contains("maxPendingBytes") ||
+            !json.contains("maxSessionBytes") ||
+            !json.contains("maxTotalBytes"))
+        {
+            return std::nullopt;
+        }
+
+        const auto &version = json.at("version");
+        const auto &maxPendingBytes = json.at("maxPendingBytes");
+        const auto &maxSessionBytes = json.at("maxSessionBytes");
+        const auto &maxTotalBytes = json.at("maxTotalBytes");
+        if (!version.is_number_integer() ||
+            version.get<int>() != kFormatVersion ||
+            !maxPendingBytes.is_number_unsigned() ||
+            !maxSessionBytes.is_number_unsigned() ||
+            !maxTotalBytes.is_number_unsigned())
+        {
+            return std::nullopt;
+        }
+
+        return undo::UndoHistoryBudget{
+            .maxPendingBytes = maxPendingBytes.get<std::uint64_t>(),
+            .maxSessionBytes = maxSessionBytes.get<std::uint64_t>(),
+            .maxTotalBytes = maxTotalBytes.get<std::uint64_t>()};
+    }
+} // namespace cupuacu::persistence
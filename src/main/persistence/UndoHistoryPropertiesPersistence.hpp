@@ -0,0 +1,19 @@
+#pragma once
+
+#include "undo/UndoHistoryBudget.hpp"
+
+#include <filesystem>
+#include <optional>
+
+namespace cupuacu::persistence
+{
+    class UndoHistoryPropertiesPersistence
+    {
+    public:
+        static bool save(const std::filesystem::path &path,
+                         const undo::UndoHistoryBudget &budget);
+
+        static std::optional<undo::UndoHistoryBudget>
+        load(const std::filesystem::path &path);
+    };
+} // namespace cupuacu::persistence
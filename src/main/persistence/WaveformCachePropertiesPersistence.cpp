@@ -0,0 +1,124 @@
+#include "persistence/WaveformCachePropertiesPersistence.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace cupuacu::persistence
+{
+    namespace
+    {
+        constexpr int kFormatVersion = 1;
+
+        std::string
+        toPersistedKeyMode(const waveform::PersistentCacheKeyMode keyMode)
+        {
+            switch (keyMode)
+            {
+            case waveform::PersistentCacheKeyMode::SampledContent:
+                return "sampled_content";
+            case waveform::PersistentCacheKeyMode::SourceFile:
+            default:
+                return "source_file";
+            }
+        }
+
+        std::optional<waveform::PersistentCacheKeyMode>
+        parsePersistedKeyMode(const std::string &value)
+        {
+            if (value == "source_file")
+            {
+                return waveform::PersistentCacheKeyMode::SourceFile;
+            }
+            if (value == "sampled_content")
+            {
+                return waveform::PersistentCacheKeyMode::SampledContent;
+            }
+            return std::nullopt;
+        }
+    } // namespace
+
+    bool WaveformCachePropertiesPersistence::save(
+        const std::filesystem::path &path,
+        const waveform::PersistentCacheSettings &settings)
+    {
+        if (path.empty())
+        {
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (ec)
+        {
+            return false;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.good())
+        {
+            return false;
+        }
+
+        const nlohmann::json json{
+            {"version", kFormatVersion},
+            {"keyMode", toPersistedKeyMode(settings.keyMode)},
+            {"maxDirectoryBytes", settings.maxDirectoryBytes}};
+        out << json.dump(2);
+        return out.good();
+    }
+
+    std::optional<waveform::PersistentCacheSettings>
+    WaveformCachePropertiesPersistence::load(const std::filesystem::path &path)
+    {
+        if (path.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in.good())
+        {
+            return std::nullopt;
+        }
+
+        nlohmann::json json;
+        try
+        {
+            in >> json;
+        }
+        catch (const std::exception &)
+        {
+            return std::nullopt;
+        }
+
+        if (!json.is_object() || !json.contains("version") ||
+            !json.contains("keyMode") || !json.contains("maxDirectoryBytes"))
+        {
+            return std::nullopt;
+        }
+
+        const auto &version = json.at("version");
+        const auto &keyMode = json.at("keyMode");
+        const auto &maxDirectoryBytes = json.at("maxDirectoryBytes");
+        if (!version.is_number_integer() ||
+            version.get<int>() != kFormatVersion || !keyMode.is_string() ||
+            !maxDirectoryBytes.is_number_unsigned())
+        {
+            return std::nullopt;
+        }
+
+        const auto parsedKeyMode =
+            parsePersistedKeyMode(keyMode.get<std::string>());
+        if (!parsedKeyMode.has_value())
+        {
+            return std::nullopt;
+        }
+
+        return waveform::PersistentCacheSettings{
+            .keyMode = *parsedKeyMode,
+            .maxDirectoryBytes = maxDirectoryBytes.get<uint64_t>()};
+    }
+} // namespace cupuacu::persistence
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "waveform/PersistentCacheSettings.hpp"
+
+#include <filesystem>
+#include <optional>
+
+namespace cupuacu::persistence
+{
+    class WaveformCachePropertiesPersistence
+    {
+    public:
+        static bool save(const std::filesystem::path &path,
+                         const waveform::PersistentCacheSettings &settings);
+
+        static std::optional<waveform::PersistentCacheSettings>
+        load(const std::filesystem::path &path);
+    };
+} // namespace cupuacu::persistence
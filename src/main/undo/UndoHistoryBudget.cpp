@@ -0,0 +1,266 @@
+#include "UndoHistoryBudget.hpp"
+
+#include "../Logger.hpp"
+#include "../State.hpp"
+#include "../actions/Undoable.hpp"
+#include "UndoManifestPersistence.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+namespace cupuacu::undo
+{
+    namespace
+    {
+        bool exceeds(const std::uint64_t bytes, const std::uint64_t limit)
+        {
+            return limit != 0 && bytes > limit;
+        }
+
+        std::string formatMegabytes(const std::uint64_t bytes)
+        {
+            std::ostringstream output;
+            output.setf(std::ios::fixed);
+            output.precision(1);
+            output << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MB";
+            return output.str();
+        }
+
+        std::uint64_t pendingBytes(const cupuacu::DocumentTab &tab)
+        {
+            std::uint64_t bytes = 0;
+            for (const auto &undoable : tab.undoables)
+            {
+                bytes += undoable ? undoable->pendingPayloadBytes() : 0;
+            }
+            for (const auto &redoable : tab.redoables)
+            {
+                bytes += redoable ? redoable->pendingPayloadBytes() : 0;
+            }
+            return bytes;
+        }
+
+        std::uint64_t dropOldestUndoStep(cupuacu::DocumentTab &tab)
+        {
+            const auto undoable = std::move(tab.undoables.front());
+            tab.undoables.pop_front();
+            return undoable ? releaseUndoPayloads(tab, *undoable) : 0;
+        }
+
+        void logDroppedUndoSteps(const cupuacu::DocumentTab &tab,
+                                 const std::size_t count,
+                                 const std::string &limitName)
+        {
+            cupuacu::logging::info(
+                "Dropped " + std::to_string(count) +
+                " oldest undo step(s) of \"" + tab.title + "\" to stay within " +
+                limitName + "; its undo store now holds " +
+                describeUndoStoreStats(tab.session.undoStore.stats()));
+        }
+
+        void spillPendingPayloads(cupuacu::State *state,
+                                  const UndoHistoryBudget &budget)
+        {
+            std::uint64_t totalPendingBytes = 0;
+            for (const auto &tab : state->tabs)
+            {
+                totalPendingBytes += pendingBytes(tab);
+            }
+
+            for (auto &tab : state->tabs)
+            {
+                if (!exceeds(totalPendingBytes, budget.maxPendingBytes))
+                {
+                    return;
+                }
+                if (!tab.session.undoStore.isAttached())
+                {
+                    continue;
+                }
+
+                std::uint64_t spilledBytes = 0;
+                for (const auto &undoable : tab.undoables)
+                {
+                    if (!exceeds(totalPendingBytes, budget.maxPendingBytes))
+                    {
+                        break;
+                    }
+                    if (!undoable)
+                    {
+                        continue;
+                    }
+                    const auto before = undoable->pendingPayloadBytes();
+                    try
+                    {
+                        undoable->spillPendingPayloads(tab.session);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        cupuacu::logging::warn(
+                            "Failed to spill undo sample data of \"" +
+                            tab.title + "\": " + e.what());
+                        return;
+                    }
+                    const auto freed =
+                        before - std::min(before, undoable->pendingPayloadBytes());
+                    spilledBytes += freed;
+                    totalPendingBytes -= std::min(totalPendingBytes, freed);
+                }
+
+                if (spilledBytes > 0)
+                {
+                    cupuacu::logging::info(
+                        "Moved " + formatMegabytes(spilledBytes) +
+                        " of undo sample data of \"" + tab.title +
+                        "\" from memory to its undo store");
+                }
+            }
+        }
+
+        void enforceSessionLimit(cupuacu::DocumentTab &tab,
+                                 const UndoHistoryBudget &budget)
+        {
+            std::uint64_t storedBytes = tab.session.undoStore.stats().totalBytes;
+            std::size_t droppedCount = 0;
+            while (exceeds(storedBytes, budget.maxSessionBytes) &&
+                   tab.undoables.size() > 1)
+            {
+                storedBytes -= std::min(storedBytes, dropOldestUndoStep(tab));
+                ++droppedCount;
+            }
+
+            if (droppedCount > 0)
+            {
+                logDroppedUndoSteps(tab, droppedCount, "its undo budget");
+            }
+        }
+
+        void enforceTotalLimit(cupuacu::State *state,
+                               const UndoHistoryBudget &budget)
+        {
+            std::vector<std::uint64_t> storedBytes;
+            std::uint64_t totalBytes = 0;
+            for (const auto &tab : state->tabs)
+            {
+                storedBytes.push_back(tab.session.undoStore.stats().totalBytes);
+                totalBytes += storedBytes.back();
+            }
+
+            std::vector<std::size_t> droppedCounts(state->tabs.size(), 0);
+            while (exceeds(totalBytes, budget.maxTotalBytes))
+            {
+                std::optional<std::size_t> largest;
+                for (std::size_t index = 0; index < state->tabs.size(); ++index)
+                {
+                    if (state->tabs[index].undoables.size() > 1 &&
+                        (!largest || storedBytes[index] > storedBytes[*largest]))
+                    {
+                        largest = index;
+                    }
+                }
+                if (!largest)
+                {
+                    break;
+                }
+
+                const auto freed = std::min(
+                    storedBytes[*largest],
+                    dropOldestUndoStep(state->tabs[*largest]));
+                storedBytes[*largest] -= freed;
+                totalBytes -= freed;
+                ++droppedCounts[*largest];
+            }
+
+            for (std::size_t index = 0; index < state->tabs.size(); ++index)
+            {
+                if (droppedCounts[index] > 0)
+                {
+                    logDroppedUndoSteps(state->tabs[index],
+                                        droppedCounts[index],
+                                        "the undo budget of all documents");
+                }
+            }
+        }
+    } // namespace
+
+    UndoHistoryUsage measureUndoHistory(const cupuacu::DocumentTab &tab)
+    {
+        return {
+            .storedBytes = tab.session.undoStore.stats().totalBytes,
+            .pendingBytes = pendingBytes(tab),
+            .undoStepCount = tab.undoables.size(),
+        };
+    }
+
+    std::string describeUndoHistoryUsage(const UndoHistoryUsage &usage,
+                                         const UndoHistoryBudget &budget)
+    {
+        std::string description =
+            std::to_string(usage.undoStepCount) + " undo step(s), " +
+            formatMegabytes(usage.storedBytes) + " on disk";
+        if (budget.maxSessionBytes != 0)
+        {
+            description += " of " + formatMegabytes(budget.maxSessionBytes);
+        }
+        if (usage.pendingBytes > 0)
+        {
+            description += ", " + formatMegabytes(usage.pendingBytes) +
+                           " in memory";
+        }
+        return description;
+    }
+
+    std::uint64_t releaseUndoPayloads(cupuacu::DocumentTab &tab,
+                                      const cupuacu::actions::Undoable &undoable)
+    {
+        std::uint64_t freedBytes = 0;
+        for (const auto &handle : undoable.payloadHandles())
+        {
+            freedBytes += tab.session.undoStore.remove(handle);
+        }
+        return freedBytes;
+    }
+
+    std::size_t dropUnavailableUndoSteps(
+        cupuacu::DocumentTab &tab,
+        std::deque<std::shared_ptr<cupuacu::actions::Undoable>> &stack,
+        const cupuacu::actions::Undoable &unavailable)
+    {
+        const auto dropped = std::move(stack);
+        stack.clear();
+        releaseUndoPayloads(tab, unavailable);
+        for (const auto &undoable : dropped)
+        {
+            if (undoable)
+            {
+                releaseUndoPayloads(tab, *undoable);
+            }
+        }
+        return dropped.size() + 1;
+    }
+
+    void enforceUndoHistoryBudget(cupuacu::State *state)
+    {
+        if (!state)
+        {
+            return;
+        }
+
+        const auto &budget = state->undoHistoryBudget;
+        spillPendingPayloads(state, budget);
+        if (budget.maxSessionBytes != 0)
+        {
+            for (auto &tab : state->tabs)
+            {
+                enforceSessionLimit(tab, budget);
+            }
+        }
+        if (budget.maxTotalBytes != 0)
+        {
+            enforceTotalLimit(state, budget);
+        }
+    }
+} // namespace cupuacu::undo
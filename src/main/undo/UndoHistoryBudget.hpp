@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace cupuacu
+{
+    struct State;
+    struct DocumentTab;
+
+    namespace actions
+    {
+        class Undoable;
+    }
+} // namespace cupuacu
+
+namespace cupuacu::undo
+{
+    // Limits on the resources held by undo history, read from the undo
+    // history properties in the config directory. A limit of 0 disables
+    // it. The most recent undo step of a tab is never dropped, so a single
+    // large edit can still exceed a limit.
+    struct UndoHistoryBudget
+    {
+        // Sample data undo steps keep in memory, over all tabs, before the
+        // oldest of it is written to the undo stores.
+        std::uint64_t maxPendingBytes = 512ull * 1024ull * 1024ull;
+        // Undo store bytes of one tab before its oldest undo steps are
+        // dropped.
+        std::uint64_t maxSessionBytes = 4ull * 1024ull * 1024ull * 1024ull;
+        // Undo store bytes over all tabs before the oldest undo steps of the
+        // largest store are dropped.
+        std::uint64_t maxTotalBytes = 16ull * 1024ull * 1024ull * 1024ull;
+
+        bool operator==(const UndoHistoryBudget &) const = default;
+    };
+
+    struct UndoHistoryUsage
+    {
+        std::uint64_t storedBytes = 0;
+        std::uint64_t pendingBytes = 0;
+        std::size_t undoStepCount = 0;
+    };
+
+    [[nodiscard]] UndoHistoryUsage
+    measureUndoHistory(const cupuacu::DocumentTab &tab);
+
+    [[nodiscard]] std::string
+    describeUndoHistoryUsage(const UndoHistoryUsage &usage,
+                             const UndoHistoryBudget &budget);
+
+    // Deletes the undo store payloads of an undoable that has left the
+    // history of tab. Returns the number of bytes freed.
+    std::uint64_t releaseUndoPayloads(cupuacu::DocumentTab &tab,
+                                      const cupuacu::actions::Undoable &undoable);
+
+    // Drops unavailable, an undo step of tab that could not be undone or
+    // redone, along with stack, the steps that would have followed it and
+    // only apply on top of it, and deletes their payloads. Returns the
+    // number of steps dropped, unavailable included.
+    std::size_t dropUnavailableUndoSteps(
+        cupuacu::DocumentTab &tab,
+        std::deque<std::shared_ptr<cupuacu::actions::Undoable>> &stack,
+        const cupuacu::actions::Undoable &unavailable);
+
+    // Spills pending sample data and then drops the oldest undo steps until
+    // every tab and the total are within state->undoHistoryBudget.
+    void enforceUndoHistoryBudget(cupuacu::State *state);
+} // namespace cupuacu::undo
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace cupuacu::actions
+{
+    class Undoable;
+}
+
+namespace cupuacu::undo
+{
+    // The undo history a session's manifest on disk describes. The manifest
+    // is a compacted snapshot plus a journal of the changes made since;
+    // saving appends the difference between this and the current history
+    // and compacts once the journal outgrows the history.
+    struct UndoManifestJournal
+    {
+        std::filesystem::path manifestPath;
+        std::uint64_t generation = 0;
+        std::vector<std::weak_ptr<cupuacu::actions::Undoable>> undoables;
+        std::vector<std::weak_ptr<cupuacu::actions::Undoable>> redoables;
+        std::size_t appendedRecordCount = 0;
+    };
+} // namespace cupuacu::undo
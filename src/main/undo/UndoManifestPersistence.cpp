@@ -19,9 +19,13 @@
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <map>
+#include <random>
 #include <sstream>
 #include <set>
 
@@ -30,6 +34,9 @@ namespace cupuacu::undo
     namespace
     {
         constexpr int kFormatVersion = 1;
+        // The journal is compacted into the manifest once it holds more
+        // records than this or than the history has entries.
+        constexpr std::size_t kMinJournalRecordsBeforeCompaction = 64;
         constexpr std::uint64_t kMaxRestartUndoStoreBytes =
             512ull * 1024ull * 1024ull;
 
@@ -97,6 +104,13 @@ namespace cupuacu::undo
             return !path.empty() && std::filesystem::exists(path);
         }
 
+        // Replayable effects recompute their new samples and leave the
+        // handle empty.
+        bool optionalPayloadPathExists(const std::string &path)
+        {
+            return path.empty() || std::filesystem::exists(path);
+        }
+
         bool payloadPathsExist(
             const std::initializer_list<std::string> &paths)
         {
@@ -290,7 +304,8 @@ namespace cupuacu::undo
                          json.value("oldSamplesHandle", std::string{});
                      const auto newHandlePath =
                          json.value("newSamplesHandle", std::string{});
-                     if (!payloadPathsExist({oldHandlePath, newHandlePath}))
+                     if (!payloadPathsExist({oldHandlePath}) ||
+                         !optionalPayloadPathExists(newHandlePath))
                      {
                          return std::shared_ptr<actions::Undoable>{};
                      }
@@ -311,7 +326,8 @@ namespace cupuacu::undo
                          json.value("oldSamplesHandle", std::string{});
                      const auto newHandlePath =
                          json.value("newSamplesHandle", std::string{});
-                     if (!payloadPathsExist({oldHandlePath, newHandlePath}))
+                     if (!payloadPathsExist({oldHandlePath}) ||
+                         !optionalPayloadPathExists(newHandlePath))
                      {
                          return std::shared_ptr<actions::Undoable>{};
                      }
@@ -342,7 +358,8 @@ namespace cupuacu::undo
                          json.value("oldSamplesHandle", std::string{});
                      const auto newHandlePath =
                          json.value("newSamplesHandle", std::string{});
-                     if (!payloadPathsExist({oldHandlePath, newHandlePath}))
+                     if (!payloadPathsExist({oldHandlePath}) ||
+                         !optionalPayloadPathExists(newHandlePath))
                      {
                          return std::shared_ptr<actions::Undoable>{};
                      }
@@ -369,7 +386,8 @@ namespace cupuacu::undo
                          json.value("oldSamplesHandle", std::string{});
                      const auto newHandlePath =
                          json.value("newSamplesHandle", std::string{});
-                     if (!payloadPathsExist({oldHandlePath, newHandlePath}))
+                     if (!payloadPathsExist({oldHandlePath}) ||
+                         !optionalPayloadPathExists(newHandlePath))
                      {
                          return std::shared_ptr<actions::Undoable>{};
                      }
@@ -487,6 +505,497 @@ namespace cupuacu::undo
             }
             return it->second(state, tabIndex, json);
         }
+
+        // Stands in for an undoable restored from a manifest entry until the
+        // entry is first needed, so that restoring a long history does not
+        // construct and check every undoable up front.
+        class RestoredUndoable final : public actions::Undoable
+        {
+        public:
+            RestoredUndoable(State *stateToUse, nlohmann::json entryToUse)
+                : Undoable(stateToUse), entry(std::move(entryToUse))
+            {
+                updateGui = [this]
+                {
+                    if (delegate)
+                    {
+                        delegate->updateGui();
+                    }
+                };
+            }
+
+            // State::undo and redo take the entry off the active tab's
+            // stack before calling these.
+            void redo() override
+            {
+                if (auto *undoable = restore(state->activeTabIndex))
+                {
+                    undoable->redo();
+                }
+            }
+
+            void undo() override
+            {
+                if (auto *undoable = restore(state->activeTabIndex))
+                {
+                    undoable->undo();
+                }
+            }
+
+            std::string getRedoDescription() override
+            {
+                auto *undoable = restore(findTabIndex());
+                return undoable ? undoable->getRedoDescription()
+                                : std::string{"Unavailable edit"};
+            }
+
+            std::string getUndoDescription() override
+            {
+                auto *undoable = restore(findTabIndex());
+                return undoable ? undoable->getUndoDescription()
+                                : std::string{"Unavailable edit"};
+            }
+
+            [[nodiscard]] cupuacu::file::OverwritePreservationMutation
+            overwritePreservationMutation() const override
+            {
+                auto *undoable = restore(findTabIndex());
+                return undoable ? undoable->overwritePreservationMutation()
+                                : cupuacu::file::OverwritePreservationMutation{};
+            }
+
+            [[nodiscard]] bool lastOperationCommitted() const override
+            {
+                return delegate && delegate->lastOperationCommitted();
+            }
+
+            [[nodiscard]] bool isUnavailable() const override
+            {
+                return restoreFailed;
+            }
+
+            [[nodiscard]] bool canPersistForRestart() const override
+            {
+                return !delegate || delegate->canPersistForRestart();
+            }
+
+            [[nodiscard]] std::optional<nlohmann::json>
+            serializeForRestart() const override
+            {
+                return delegate ? delegate->serializeForRestart() : entry;
+            }
+
+            [[nodiscard]] std::vector<undo::UndoStore::PayloadHandle>
+            payloadHandles() const override
+            {
+                if (delegate)
+                {
+                    return delegate->payloadHandles();
+                }
+
+                // Read from the entry, whose payload paths are kept under
+                // keys ending in "Handle", so that releasing the payloads
+                // of an entry never restores it.
+                std::vector<undo::UndoStore::PayloadHandle> handles;
+                for (const auto &item : entry.items())
+                {
+                    if (item.key().ends_with("Handle") &&
+                        item.value().is_string() &&
+                        !item.value().get_ref<const std::string &>().empty())
+                    {
+                        handles.push_back(
+                            handleFromString(item.value().get<std::string>()));
+                    }
+                }
+                return handles;
+            }
+
+            [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+            {
+                return delegate ? delegate->pendingPayloadBytes() : 0;
+            }
+
+            void spillPendingPayloads(cupuacu::DocumentSession &session) override
+            {
+                if (delegate)
+                {
+                    delegate->spillPendingPayloads(session);
+                }
+            }
+
+        private:
+            nlohmann::json entry;
+            mutable std::shared_ptr<actions::Undoable> delegate;
+            mutable bool restoreFailed = false;
+
+            actions::Undoable *restore(const int tabIndex) const
+            {
+                if (delegate || restoreFailed)
+                {
+                    return delegate.get();
+                }
+
+                if (tabIndex < 0)
+                {
+                    return nullptr;
+                }
+
+                delegate = restoreUndoable(state, tabIndex, entry);
+                if (!delegate)
+                {
+                    restoreFailed = true;
+                    cupuacu::logging::warn(
+                        "Failed to restore a \"" +
+                        entry.value("kind", std::string{}) +
+                        "\" entry of the restart undo history");
+                }
+                return delegate.get();
+            }
+
+            int findTabIndex() const
+            {
+                for (std::size_t index = 0; index < state->tabs.size(); ++index)
+                {
+                    const auto &tab = state->tabs[index];
+                    const auto isThis = [this](const auto &undoable)
+                    {
+                        return undoable.get() == this;
+                    };
+                    if (std::any_of(tab.undoables.begin(), tab.undoables.end(),
+                                    isThis) ||
+                        std::any_of(tab.redoables.begin(), tab.redoables.end(),
+                                    isThis))
+                    {
+                        return static_cast<int>(index);
+                    }
+                }
+                return -1;
+            }
+        };
+
+        std::shared_ptr<actions::Undoable>
+        restoreUndoableLazily(State *state, const nlohmann::json &json)
+        {
+            if (!json.is_object() ||
+                !restoreRegistry().contains(json.value("kind", std::string{})))
+            {
+                return nullptr;
+            }
+            return std::make_shared<RestoredUndoable>(state, json);
+        }
+
+        std::filesystem::path
+        journalPathForManifest(const std::filesystem::path &manifestPath)
+        {
+            auto journalPath = manifestPath;
+            journalPath.replace_extension(".journal");
+            return journalPath;
+        }
+
+        using TrackedStack = std::vector<std::weak_ptr<actions::Undoable>>;
+        using UndoableStack = std::deque<std::shared_ptr<actions::Undoable>>;
+
+        TrackedStack trackStack(const UndoableStack &undoables)
+        {
+            return {undoables.begin(), undoables.end()};
+        }
+
+        bool isSameUndoable(const std::weak_ptr<actions::Undoable> &tracked,
+                            const std::shared_ptr<actions::Undoable> &undoable)
+        {
+            return !tracked.owner_before(undoable) &&
+                   !undoable.owner_before(tracked);
+        }
+
+        // How a stack changed since it was last journaled: its oldest
+        // entries were dropped, its newest popped and then new ones pushed.
+        struct StackDiff
+        {
+            std::size_t droppedCount = 0;
+            std::size_t poppedCount = 0;
+            std::size_t keptCount = 0;
+
+            [[nodiscard]] std::size_t
+            recordCount(const UndoableStack &undoables) const
+            {
+                return (droppedCount > 0 ? 1 : 0) + (poppedCount > 0 ? 1 : 0) +
+                       (undoables.size() - keptCount);
+            }
+        };
+
+        StackDiff diffStack(const TrackedStack &tracked,
+                            const UndoableStack &undoables)
+        {
+            StackDiff diff{};
+            if (!undoables.empty())
+            {
+                const auto first =
+                    std::find_if(tracked.begin(), tracked.end(),
+                                 [&](const auto &trackedUndoable)
+                                 {
+                                     return isSameUndoable(trackedUndoable,
+                                                           undoables.front());
+                                 });
+                diff.droppedCount = first == tracked.end()
+                                        ? 0
+                                        : static_cast<std::size_t>(
+                                              first - tracked.begin());
+                if (first == tracked.end())
+                {
+                    diff.poppedCount = tracked.size();
+                    return diff;
+                }
+            }
+
+            while (diff.droppedCount + diff.keptCount < tracked.size() &&
+                   diff.keptCount < undoables.size() &&
+                   isSameUndoable(tracked[diff.droppedCount + diff.keptCount],
+                                  undoables[diff.keptCount]))
+            {
+                ++diff.keptCount;
+            }
+            diff.poppedCount =
+                tracked.size() - diff.droppedCount - diff.keptCount;
+            return diff;
+        }
+
+        bool appendStackRecords(nlohmann::json &records,
+                                const std::string &stack, const StackDiff &diff,
+                                const UndoableStack &undoables)
+        {
+            if (diff.droppedCount > 0)
+            {
+                records.push_back({{"stack", stack}, {"drop", diff.droppedCount}});
+            }
+            if (diff.poppedCount > 0)
+            {
+                records.push_back({{"stack", stack}, {"pop", diff.poppedCount}});
+            }
+            for (auto index = diff.keptCount; index < undoables.size(); ++index)
+            {
+                const auto entry = undoables[index]->serializeForRestart();
+                if (!entry.has_value() || entry->is_null() || entry->empty())
+                {
+                    return false;
+                }
+                records.push_back({{"stack", stack}, {"push", *entry}});
+            }
+            return true;
+        }
+
+        bool applyJournalRecord(const nlohmann::json &record,
+                                std::vector<nlohmann::json> &undoEntries,
+                                std::vector<nlohmann::json> &redoEntries)
+        {
+            if (!record.is_object())
+            {
+                return false;
+            }
+            const auto stack = record.value("stack", std::string{});
+            if (stack != "undo" && stack != "redo")
+            {
+                return false;
+            }
+            auto &entries = stack == "undo" ? undoEntries : redoEntries;
+
+            if (record.contains("push"))
+            {
+                entries.push_back(record.at("push"));
+                return true;
+            }
+            const auto count = record.contains("drop")
+                                   ? record.value("drop", std::size_t{0})
+                                   : record.value("pop", std::size_t{0});
+            if (count == 0 || count > entries.size())
+            {
+                return false;
+            }
+            if (record.contains("drop"))
+            {
+                entries.erase(entries.begin(),
+                              entries.begin() +
+                                  static_cast<std::ptrdiff_t>(count));
+            }
+            else
+            {
+                entries.resize(entries.size() - count);
+            }
+            return true;
+        }
+
+        struct JournalReplay
+        {
+            std::size_t appliedRecordCount = 0;
+            // False if the journal does not belong to the manifest or has a
+            // line that was not applied. Records appended to it would not
+            // be applied either.
+            bool complete = true;
+        };
+
+        // Applies the journal of a manifest with generation to its entries.
+        // A journal left from an older manifest is ignored, and so is
+        // everything from the first line that cannot be applied or has no
+        // newline, such as one cut short by a crash.
+        JournalReplay
+        replayUndoManifestJournal(const std::filesystem::path &journalPath,
+                                  const std::uint64_t generation,
+                                  std::vector<nlohmann::json> &undoEntries,
+                                  std::vector<nlohmann::json> &redoEntries)
+        {
+            std::ifstream input(journalPath);
+            if (!input.is_open())
+            {
+                return {};
+            }
+            std::string line;
+            if (!std::getline(input, line) || input.eof())
+            {
+                return {.complete = false};
+            }
+            const auto header = nlohmann::json::parse(line, nullptr, false);
+            if (!header.is_object() ||
+                header.value("generation", std::uint64_t{0}) != generation)
+            {
+                return {.complete = false};
+            }
+
+            JournalReplay replay;
+            while (std::getline(input, line))
+            {
+                const auto json = nlohmann::json::parse(line, nullptr, false);
+                if (input.eof() || !json.is_object() ||
+                    !json.contains("records") ||
+                    !json.at("records").is_array())
+                {
+                    replay.complete = false;
+                    break;
+                }
+
+                auto nextUndoEntries = undoEntries;
+                auto nextRedoEntries = redoEntries;
+                const auto &records = json.at("records");
+                if (!std::all_of(records.begin(), records.end(),
+                                 [&](const auto &record)
+                                 {
+                                     return applyJournalRecord(
+                                         record, nextUndoEntries,
+                                         nextRedoEntries);
+                                 }))
+                {
+                    replay.complete = false;
+                    break;
+                }
+                undoEntries = std::move(nextUndoEntries);
+                redoEntries = std::move(nextRedoEntries);
+                replay.appliedRecordCount += records.size();
+            }
+            return replay;
+        }
+
+        // A save cut short leaves a line without a newline at the end of the
+        // journal, after which nothing appended would be applied.
+        bool journalEndsWithNewline(const std::filesystem::path &journalPath)
+        {
+            std::ifstream input(journalPath, std::ios::binary | std::ios::ate);
+            if (!input.is_open() || input.tellg() <= 0)
+            {
+                return false;
+            }
+            input.seekg(-1, std::ios::end);
+            char last = 0;
+            return input.get(last) && last == '\n';
+        }
+
+        // A generation for a new manifest. It is random rather than counted,
+        // as a count starts over in every session: a crash between writing
+        // a manifest and its journal would leave a journal behind, from an
+        // earlier manifest or session, that could carry the same number.
+        std::uint64_t newManifestGeneration(const std::uint64_t previous)
+        {
+            thread_local std::mt19937_64 random{
+                (static_cast<std::uint64_t>(std::random_device{}()) << 32) ^
+                static_cast<std::uint64_t>(
+                    std::chrono::system_clock::now().time_since_epoch().count())};
+            std::uint64_t generation = 0;
+            while (generation == 0 || generation == previous)
+            {
+                generation = random();
+            }
+            return generation;
+        }
+
+        // Rewrites the manifest with the whole history and starts an empty
+        // journal for it.
+        bool compactUndoManifest(const std::filesystem::path &manifestPath,
+                                 const cupuacu::DocumentTab &tab)
+        {
+            const auto serializeEntries =
+                [](const auto &undoables) -> std::optional<nlohmann::json>
+            {
+                nlohmann::json entries = nlohmann::json::array();
+                for (const auto &undoable : undoables)
+                {
+                    const auto entry = undoable->serializeForRestart();
+                    if (!entry.has_value() || entry->is_null() ||
+                        entry->empty())
+                    {
+                        return std::nullopt;
+                    }
+                    entries.push_back(*entry);
+                }
+                return entries;
+            };
+
+            const auto undoEntries = serializeEntries(tab.undoables);
+            const auto redoEntries = serializeEntries(tab.redoables);
+            if (!undoEntries.has_value() || !redoEntries.has_value())
+            {
+                return false;
+            }
+
+            auto &journal = tab.session.undoManifestJournal;
+            const auto generation = newManifestGeneration(journal.generation);
+            const nlohmann::json json{
+                {"version", kFormatVersion},
+                {"generation", generation},
+                {"entries", std::move(*undoEntries)},
+                {"redoEntries", std::move(*redoEntries)},
+            };
+
+            try
+            {
+                cupuacu::file::writeFileAtomically(
+                    manifestPath,
+                    [&](const std::filesystem::path &temporaryPath)
+                    {
+                        std::ofstream output(temporaryPath);
+                        output << json.dump(2) << '\n';
+                    });
+                cupuacu::file::writeFileAtomically(
+                    journalPathForManifest(manifestPath),
+                    [&](const std::filesystem::path &temporaryPath)
+                    {
+                        std::ofstream output(temporaryPath);
+                        output << nlohmann::json{{"generation", generation}}
+                                      .dump()
+                               << '\n';
+                    });
+            }
+            catch (...)
+            {
+                journal = {};
+                return false;
+            }
+
+            journal = {
+                .manifestPath = manifestPath,
+                .generation = generation,
+                .undoables = trackStack(tab.undoables),
+                .redoables = trackStack(tab.redoables),
+                .appendedRecordCount = 0,
+            };
+            return true;
+        }
     } // namespace
 
     std::uint64_t maxRestartUndoStoreBytes()
@@ -522,54 +1031,84 @@ namespace cupuacu::undo
             return false;
         }
 
-        const auto serializeEntries =
-            [](const auto &undoables) -> std::optional<nlohmann::json>
+        const auto canPersist = [](const auto &undoables)
         {
-            nlohmann::json entries = nlohmann::json::array();
-            for (const auto &undoable : undoables)
-            {
-                if (!undoable || !undoable->canPersistForRestart())
-                {
-                    return std::nullopt;
-                }
-                const auto entry = undoable->serializeForRestart();
-                if (!entry.has_value() || entry->is_null() || entry->empty())
-                {
-                    return std::nullopt;
-                }
-                entries.push_back(*entry);
-            }
-            return entries;
+            return std::all_of(undoables.begin(), undoables.end(),
+                               [](const auto &undoable)
+                               {
+                                   return undoable &&
+                                          undoable->canPersistForRestart();
+                               });
         };
-
-        const auto undoEntries = serializeEntries(tab.undoables);
-        const auto redoEntries = serializeEntries(tab.redoables);
-        if (!undoEntries.has_value() || !redoEntries.has_value())
+        if (!canPersist(tab.undoables) || !canPersist(tab.redoables))
         {
             return false;
         }
 
-        const nlohmann::json json{
-            {"version", kFormatVersion},
-            {"entries", std::move(*undoEntries)},
-            {"redoEntries", std::move(*redoEntries)},
-        };
+        // The manifest must only name payload files that are on disk.
+        tab.session.undoStore.flush();
 
-        try
+        auto &journal = tab.session.undoManifestJournal;
+        const auto journalPath = journalPathForManifest(manifestPath);
+        std::error_code ec;
+        if (journal.manifestPath == manifestPath &&
+            std::filesystem::exists(manifestPath, ec) &&
+            journalEndsWithNewline(journalPath))
         {
-            cupuacu::file::writeFileAtomically(
-                manifestPath,
-                [&](const std::filesystem::path &temporaryPath)
+            const auto undoDiff = diffStack(journal.undoables, tab.undoables);
+            const auto redoDiff = diffStack(journal.redoables, tab.redoables);
+            const auto recordCount = undoDiff.recordCount(tab.undoables) +
+                                     redoDiff.recordCount(tab.redoables);
+            if (recordCount == 0)
+            {
+                return true;
+            }
+
+            const auto entryCount =
+                tab.undoables.size() + tab.redoables.size();
+            if (journal.appendedRecordCount + recordCount <
+                std::max(kMinJournalRecordsBeforeCompaction, entryCount))
+            {
+                nlohmann::json records = nlohmann::json::array();
+                if (!appendStackRecords(records, "undo", undoDiff,
+                                        tab.undoables) ||
+                    !appendStackRecords(records, "redo", redoDiff,
+                                        tab.redoables))
                 {
-                    std::ofstream output(temporaryPath);
-                    output << json.dump(2) << '\n';
-                });
-            return true;
-        }
-        catch (...)
-        {
-            return false;
+                    return false;
+                }
+
+                try
+                {
+                    // One line per save, so that a save cut short by a crash
+                    // is dropped as a whole on restore.
+                    std::ofstream output(journalPath, std::ios::app);
+                    output << nlohmann::json{{"records", std::move(records)}}
+                                  .dump()
+                           << '\n';
+                    output.flush();
+                    if (!output)
+                    {
+                        // The next save compacts instead of appending
+                        // after what may have been written.
+                        journal = {};
+                        return false;
+                    }
+                }
+                catch (...)
+                {
+                    journal = {};
+                    return false;
+                }
+
+                journal.undoables = trackStack(tab.undoables);
+                journal.redoables = trackStack(tab.redoables);
+                journal.appendedRecordCount += recordCount;
+                return true;
+            }
         }
+
+        return compactUndoManifest(manifestPath, tab);
     }
 
     bool restoreUndoManifest(cupuacu::State *state, const int tabIndex,
@@ -613,42 +1152,69 @@ namespace cupuacu::undo
             return false;
         }
 
+        const auto generation = json.value("generation", std::uint64_t{0});
+        std::vector<nlohmann::json> undoEntries(json.at("entries").begin(),
+                                                json.at("entries").end());
+        std::vector<nlohmann::json> redoEntries;
+        if (json.contains("redoEntries"))
+        {
+            redoEntries.assign(json.at("redoEntries").begin(),
+                               json.at("redoEntries").end());
+        }
+        const auto replay = replayUndoManifestJournal(
+            journalPathForManifest(manifestPath), generation, undoEntries,
+            redoEntries);
+
         auto &tab = state->tabs[static_cast<std::size_t>(tabIndex)];
         tab.session.undoStore.attach(undoStorePath);
         tab.undoables.clear();
         tab.redoables.clear();
 
-        for (const auto &entry : json.at("entries"))
+        const auto restoreEntries =
+            [&](const std::vector<nlohmann::json> &entries, auto &undoables,
+                const std::string &historyName)
         {
-            auto undoable = restoreUndoable(state, tabIndex, entry);
-            if (!undoable)
+            for (std::size_t index = 0; index < entries.size(); ++index)
             {
-                tab.undoables.clear();
-                tab.redoables.clear();
-                cupuacu::logging::warn(
-                    "Failed to restore restart undo history from " +
-                    undoStorePath.string());
-                return false;
-            }
-            tab.undoables.push_back(std::move(undoable));
-        }
-
-        if (json.contains("redoEntries"))
-        {
-            for (const auto &entry : json.at("redoEntries"))
-            {
-                auto redoable = restoreUndoable(state, tabIndex, entry);
-                if (!redoable)
+                // Only the entry the next undo or redo needs is restored
+                // now; the others are restored when the user gets to them.
+                auto undoable =
+                    index + 1 == entries.size()
+                        ? restoreUndoable(state, tabIndex, entries[index])
+                        : restoreUndoableLazily(state, entries[index]);
+                if (!undoable)
                 {
                     tab.undoables.clear();
                     tab.redoables.clear();
-                    cupuacu::logging::warn(
-                        "Failed to restore restart redo history from " +
-                        undoStorePath.string());
+                    cupuacu::logging::warn("Failed to restore restart " +
+                                           historyName + " history from " +
+                                           undoStorePath.string());
                     return false;
                 }
-                tab.redoables.push_back(std::move(redoable));
+                undoables.push_back(std::move(undoable));
             }
+            return true;
+        };
+        if (!restoreEntries(undoEntries, tab.undoables, "undo") ||
+            !restoreEntries(redoEntries, tab.redoables, "redo"))
+        {
+            return false;
+        }
+
+        tab.session.undoManifestJournal = {
+            .manifestPath = manifestPath,
+            .generation = generation,
+            .undoables = trackStack(tab.undoables),
+            .redoables = trackStack(tab.redoables),
+            .appendedRecordCount = replay.appliedRecordCount,
+        };
+        // Later saves could not append to a journal that was not replayed
+        // to its end, so it is folded into the manifest now.
+        if (!replay.complete && !compactUndoManifest(manifestPath, tab))
+        {
+            cupuacu::logging::warn(
+                "Failed to compact restart undo history journal of " +
+                undoStorePath.string());
         }
 
         cupuacu::logging::info(
@@ -0,0 +1,555 @@
+#include "UndoPayloadCodec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace cupuacu::undo
+{
+    namespace
+    {
+        enum class Scheme : std::uint8_t
+        {
+            RawFloat = 0,
+            OrderedFloatBits = 1,
+            PcmCodes = 2,
+        };
+
+        // Residuals are coded in blocks of this many samples, each with its
+        // own predictor order and Rice parameter.
+        constexpr std::size_t kBlockSize = 256;
+        constexpr int kMaxPredictorOrder = 2;
+        constexpr int kMaxRiceParameter = 62;
+        // Parameter value marking a block whose residuals are all zero and
+        // which therefore stores none.
+        constexpr std::uint64_t kExactBlockParameter = 63;
+        // A quotient this large is written as that many one bits followed by
+        // the residual in full, which bounds the cost of outliers.
+        constexpr std::uint32_t kEscapeQuotient = 24;
+
+        class BitWriter
+        {
+        public:
+            explicit BitWriter(std::vector<std::uint8_t> &outputToUse)
+                : output(outputToUse)
+            {
+            }
+
+            // count must not exceed 32.
+            void write(const std::uint64_t value, const int count)
+            {
+                if (count == 0)
+                {
+                    return;
+                }
+                accumulator |= (value & (~std::uint64_t{0} >> (64 - count)))
+                               << pendingBits;
+                pendingBits += count;
+                while (pendingBits >= 8)
+                {
+                    output.push_back(
+                        static_cast<std::uint8_t>(accumulator & 0xffu));
+                    accumulator >>= 8;
+                    pendingBits -= 8;
+                }
+            }
+
+            void writeWide(const std::uint64_t value, const int count)
+            {
+                if (count > 32)
+                {
+                    write(value, 32);
+                    write(value >> 32, count - 32);
+                    return;
+                }
+                write(value, count);
+            }
+
+            void writeOnes(std::uint32_t count)
+            {
+                while (count > 0)
+                {
+                    const auto chunk = std::min<std::uint32_t>(count, 32);
+                    write(~std::uint64_t{0}, static_cast<int>(chunk));
+                    count -= chunk;
+                }
+            }
+
+            void flush()
+            {
+                if (pendingBits > 0)
+                {
+                    output.push_back(
+                        static_cast<std::uint8_t>(accumulator & 0xffu));
+                }
+                accumulator = 0;
+                pendingBits = 0;
+            }
+
+        private:
+            std::vector<std::uint8_t> &output;
+            std::uint64_t accumulator = 0;
+            int pendingBits = 0;
+        };
+
+        class BitReader
+        {
+        public:
+            BitReader(const std::uint8_t *dataToUse, const std::size_t sizeToUse)
+                : data(dataToUse), size(sizeToUse)
+            {
+            }
+
+            // count must not exceed 32.
+            std::uint64_t read(const int count)
+            {
+                if (availableBits < count)
+                {
+                    refill();
+                    if (availableBits < count)
+                    {
+                        throw std::runtime_error("Truncated undo payload");
+                    }
+                }
+                const auto value =
+                    count == 0
+                        ? std::uint64_t{0}
+                        : accumulator & (~std::uint64_t{0} >> (64 - count));
+                accumulator >>= count;
+                availableBits -= count;
+                return value;
+            }
+
+            std::uint64_t readWide(const int count)
+            {
+                if (count > 32)
+                {
+                    const auto low = read(32);
+                    return low | (read(count - 32) << 32);
+                }
+                return read(count);
+            }
+
+            // Counts one bits up to and including the terminating zero, or
+            // up to kEscapeQuotient ones.
+            std::uint32_t readQuotient()
+            {
+                if (availableBits <= static_cast<int>(kEscapeQuotient))
+                {
+                    refill();
+                }
+                // Bits above availableBits are always zero, so this never
+                // counts past the bits read so far.
+                const auto ones =
+                    static_cast<std::uint32_t>(std::countr_one(accumulator));
+                if (ones >= kEscapeQuotient)
+                {
+                    accumulator >>= kEscapeQuotient;
+                    availableBits -= static_cast<int>(kEscapeQuotient);
+                    return kEscapeQuotient;
+                }
+                if (static_cast<int>(ones) >= availableBits)
+                {
+                    throw std::runtime_error("Truncated undo payload");
+                }
+                accumulator >>= ones + 1;
+                availableBits -= static_cast<int>(ones) + 1;
+                return ones;
+            }
+
+        private:
+            void refill()
+            {
+                while (availableBits <= 56 && position < size)
+                {
+                    accumulator |= static_cast<std::uint64_t>(data[position++])
+                                   << availableBits;
+                    availableBits += 8;
+                }
+            }
+
+            const std::uint8_t *data = nullptr;
+            std::size_t size = 0;
+            std::size_t position = 0;
+            std::uint64_t accumulator = 0;
+            int availableBits = 0;
+        };
+
+        std::uint64_t zigzag(const std::int64_t value)
+        {
+            return (static_cast<std::uint64_t>(value) << 1) ^
+                   static_cast<std::uint64_t>(value >> 63);
+        }
+
+        std::int64_t unzigzag(const std::uint64_t value)
+        {
+            return static_cast<std::int64_t>(value >> 1) ^
+                   -static_cast<std::int64_t>(value & 1u);
+        }
+
+        std::int64_t predict(const int order, const std::int64_t previous,
+                             const std::int64_t beforePrevious)
+        {
+            switch (order)
+            {
+                case 1:
+                    return previous;
+                case 2:
+                    return 2 * previous - beforePrevious;
+                default:
+                    return 0;
+            }
+        }
+
+        std::uint64_t riceCost(const std::uint64_t *residuals,
+                               const std::size_t count, const int parameter)
+        {
+            std::uint64_t bits = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto quotient = residuals[i] >> parameter;
+                bits += quotient < kEscapeQuotient
+                            ? quotient + 1 + static_cast<std::uint64_t>(parameter)
+                            : kEscapeQuotient + 64;
+            }
+            return bits;
+        }
+
+        void writeRice(BitWriter &writer, const std::uint64_t residual,
+                       const int parameter)
+        {
+            const auto quotient = residual >> parameter;
+            if (quotient >= kEscapeQuotient)
+            {
+                writer.writeOnes(kEscapeQuotient);
+                writer.writeWide(residual, 64);
+                return;
+            }
+
+            // quotient one bits, a zero, then the low parameter bits.
+            const auto unaryBits = static_cast<int>(quotient) + 1;
+            const auto unary = (std::uint64_t{1} << quotient) - 1;
+            if (unaryBits + parameter <= 32)
+            {
+                writer.write(unary | (residual << unaryBits),
+                             unaryBits + parameter);
+                return;
+            }
+            writer.write(unary, unaryBits);
+            writer.writeWide(residual, parameter);
+        }
+
+        // Codes values (which the caller has already mapped to integers)
+        // block by block, choosing the cheapest predictor order and Rice
+        // parameter for each block.
+        void encodeResiduals(const std::vector<std::int64_t> &values,
+                             BitWriter &writer)
+        {
+            std::array<std::array<std::uint64_t, kBlockSize>,
+                       kMaxPredictorOrder + 1>
+                residuals{};
+            std::int64_t previous = 0;
+            std::int64_t beforePrevious = 0;
+            for (std::size_t first = 0; first < values.size();
+                 first += kBlockSize)
+            {
+                const auto count = std::min(kBlockSize, values.size() - first);
+                // The order with the smallest residuals wins; the Rice
+                // parameter is then tuned around the one its mean suggests.
+                int bestOrder = 0;
+                auto bestSum = std::numeric_limits<std::uint64_t>::max();
+                for (int order = 0; order <= kMaxPredictorOrder; ++order)
+                {
+                    auto &orderResiduals = residuals[static_cast<std::size_t>(order)];
+                    auto last = previous;
+                    auto beforeLast = beforePrevious;
+                    std::uint64_t sum = 0;
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        const auto value = values[first + i];
+                        orderResiduals[i] =
+                            zigzag(value - predict(order, last, beforeLast));
+                        sum += std::min<std::uint64_t>(orderResiduals[i],
+                                                       std::uint64_t{1} << 40);
+                        beforeLast = last;
+                        last = value;
+                    }
+                    if (sum < bestSum)
+                    {
+                        bestSum = sum;
+                        bestOrder = order;
+                    }
+                }
+
+                const auto &chosen = residuals[static_cast<std::size_t>(bestOrder)];
+                writer.write(static_cast<std::uint64_t>(bestOrder), 2);
+                if (bestSum == 0)
+                {
+                    writer.write(kExactBlockParameter, 6);
+                }
+                else
+                {
+                    const int estimate =
+                        static_cast<int>(std::bit_width(bestSum / count));
+                    int bestParameter = 0;
+                    auto bestCost = std::numeric_limits<std::uint64_t>::max();
+                    for (int parameter = std::max(0, estimate - 1);
+                         parameter <= std::min(kMaxRiceParameter, estimate + 1);
+                         ++parameter)
+                    {
+                        const auto cost = riceCost(chosen.data(), count, parameter);
+                        if (cost < bestCost)
+                        {
+                            bestCost = cost;
+                            bestParameter = parameter;
+                        }
+                    }
+
+                    writer.write(static_cast<std::uint64_t>(bestParameter), 6);
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        writeRice(writer, chosen[i], bestParameter);
+                    }
+                }
+
+                beforePrevious =
+                    count > 1 ? values[first + count - 2] : previous;
+                previous = values[first + count - 1];
+            }
+            writer.flush();
+        }
+
+        template <typename Fn>
+        void decodeResiduals(BitReader &reader, const std::size_t count,
+                             Fn &&emit)
+        {
+            std::int64_t previous = 0;
+            std::int64_t beforePrevious = 0;
+            for (std::size_t first = 0; first < count; first += kBlockSize)
+            {
+                const auto blockCount = std::min(kBlockSize, count - first);
+                const auto order = static_cast<int>(reader.read(2));
+                const auto parameterBits = reader.read(6);
+                const bool exact = parameterBits == kExactBlockParameter;
+                const auto parameter = static_cast<int>(parameterBits);
+                if (order > kMaxPredictorOrder ||
+                    (!exact && parameter > kMaxRiceParameter))
+                {
+                    throw std::runtime_error("Invalid undo payload block");
+                }
+                for (std::size_t i = 0; i < blockCount; ++i)
+                {
+                    std::uint64_t residual = 0;
+                    if (!exact)
+                    {
+                        const auto quotient = reader.readQuotient();
+                        residual =
+                            quotient < kEscapeQuotient
+                                ? (static_cast<std::uint64_t>(quotient)
+                                   << parameter) |
+                                      reader.readWide(parameter)
+                                : reader.readWide(64);
+                    }
+                    // Wraps instead of overflowing on corrupt input; the
+                    // caller range checks every value.
+                    const auto value = static_cast<std::int64_t>(
+                        static_cast<std::uint64_t>(
+                            predict(order, previous, beforePrevious)) +
+                        static_cast<std::uint64_t>(unzigzag(residual)));
+                    emit(first + i, value);
+                    beforePrevious = previous;
+                    previous = value;
+                }
+            }
+        }
+
+        std::uint32_t floatBits(const float value)
+        {
+            std::uint32_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        float floatFromBits(const std::uint32_t bits)
+        {
+            float value = 0.0f;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // Maps float bits to integers that increase with the float value, so
+        // neighbouring samples of a smooth signal map to nearby integers.
+        std::int64_t orderedFromBits(const std::uint32_t bits)
+        {
+            return static_cast<std::int64_t>(
+                (bits & 0x80000000u) != 0 ? ~bits : bits | 0x80000000u);
+        }
+
+        std::uint32_t bitsFromOrdered(const std::uint32_t ordered)
+        {
+            return (ordered & 0x80000000u) != 0 ? ordered & 0x7fffffffu
+                                                : ~ordered;
+        }
+
+        constexpr float kPcm24Scale = 8388608.0f;
+
+        // Returns the smallest of 8, 16 and 24 for which every sample is
+        // exactly code / 2^(bitDepth - 1), or 0 if there is none.
+        int detectPcmBitDepth(const float *samples, const std::size_t count)
+        {
+            std::uint32_t lowBits = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const float scaled = samples[i] * kPcm24Scale;
+                if (!(scaled >= -kPcm24Scale && scaled < kPcm24Scale))
+                {
+                    return 0;
+                }
+                // Also rejects -0.0f, which decodes as code 0.
+                const auto code = static_cast<std::int32_t>(scaled);
+                if (floatBits(static_cast<float>(code) / kPcm24Scale) !=
+                    floatBits(samples[i]))
+                {
+                    return 0;
+                }
+                lowBits |= static_cast<std::uint32_t>(code);
+            }
+            if ((lowBits & 0xffffu) == 0)
+            {
+                return 8;
+            }
+            if ((lowBits & 0xffu) == 0)
+            {
+                return 16;
+            }
+            return 24;
+        }
+
+        void storeRaw(const float *samples, const std::size_t count,
+                      std::vector<std::uint8_t> &output)
+        {
+            output.reserve(output.size() + count * sizeof(float));
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto bits = floatBits(samples[i]);
+                for (std::size_t byte = 0; byte < sizeof(bits); ++byte)
+                {
+                    output.push_back(static_cast<std::uint8_t>(bits & 0xffu));
+                    bits >>= 8;
+                }
+            }
+        }
+    } // namespace
+
+    std::vector<std::uint8_t> encodeSamples(const float *samples,
+                                            const std::size_t count)
+    {
+        std::vector<std::int64_t> values(count);
+        std::vector<std::uint8_t> encoded;
+        const int bitDepth = detectPcmBitDepth(samples, count);
+        if (bitDepth > 0)
+        {
+            const float scale = static_cast<float>(1 << (bitDepth - 1));
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                values[i] = static_cast<std::int64_t>(samples[i] * scale);
+            }
+            encoded.push_back(static_cast<std::uint8_t>(Scheme::PcmCodes));
+            encoded.push_back(static_cast<std::uint8_t>(bitDepth));
+        }
+        else
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                values[i] = orderedFromBits(floatBits(samples[i]));
+            }
+            encoded.push_back(
+                static_cast<std::uint8_t>(Scheme::OrderedFloatBits));
+        }
+
+        BitWriter writer(encoded);
+        encodeResiduals(values, writer);
+        if (encoded.size() < 1 + count * sizeof(float))
+        {
+            return encoded;
+        }
+
+        encoded.assign(1, static_cast<std::uint8_t>(Scheme::RawFloat));
+        storeRaw(samples, count, encoded);
+        return encoded;
+    }
+
+    void decodeSamples(const std::uint8_t *bytes, const std::size_t byteCount,
+                       float *samples, const std::size_t count)
+    {
+        if (byteCount < 1)
+        {
+            throw std::runtime_error("Truncated undo payload");
+        }
+
+        switch (static_cast<Scheme>(bytes[0]))
+        {
+            case Scheme::RawFloat:
+            {
+                if (byteCount - 1 < count * sizeof(float))
+                {
+                    throw std::runtime_error("Truncated undo payload");
+                }
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const auto *sampleBytes = bytes + 1 + i * sizeof(float);
+                    const auto bits =
+                        static_cast<std::uint32_t>(sampleBytes[0]) |
+                        (static_cast<std::uint32_t>(sampleBytes[1]) << 8) |
+                        (static_cast<std::uint32_t>(sampleBytes[2]) << 16) |
+                        (static_cast<std::uint32_t>(sampleBytes[3]) << 24);
+                    samples[i] = floatFromBits(bits);
+                }
+                return;
+            }
+            case Scheme::OrderedFloatBits:
+            {
+                BitReader reader(bytes + 1, byteCount - 1);
+                decodeResiduals(
+                    reader, count,
+                    [&](const std::size_t index, const std::int64_t value)
+                    {
+                        if (value < 0 ||
+                            value > std::numeric_limits<std::uint32_t>::max())
+                        {
+                            throw std::runtime_error("Invalid undo payload sample");
+                        }
+                        samples[index] = floatFromBits(
+                            bitsFromOrdered(static_cast<std::uint32_t>(value)));
+                    });
+                return;
+            }
+            case Scheme::PcmCodes:
+            {
+                if (byteCount < 2 ||
+                    (bytes[1] != 8 && bytes[1] != 16 && bytes[1] != 24))
+                {
+                    throw std::runtime_error("Invalid undo payload bit depth");
+                }
+                const auto limit = std::int64_t{1} << (bytes[1] - 1);
+                const float scale = static_cast<float>(limit);
+                BitReader reader(bytes + 2, byteCount - 2);
+                decodeResiduals(
+                    reader, count,
+                    [&](const std::size_t index, const std::int64_t value)
+                    {
+                        if (value < -limit || value >= limit)
+                        {
+                            throw std::runtime_error("Invalid undo payload sample");
+                        }
+                        samples[index] = static_cast<float>(value) / scale;
+                    });
+                return;
+            }
+        }
+        throw std::runtime_error("Unsupported undo payload encoding");
+    }
+} // namespace cupuacu::undo
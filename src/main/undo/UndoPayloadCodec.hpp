@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cupuacu::undo
+{
+    enum class PayloadCodec : std::uint8_t
+    {
+        // Little-endian IEEE floats, one per sample.
+        Raw = 0,
+        // Bit-exact compression of each channel; see encodeSamples.
+        Lossless = 1,
+    };
+
+    // Encodes count samples without loss. Channels whose samples are all
+    // exact 8, 16 or 24 bit PCM codes are coded as those integers, others
+    // through an order-preserving map of their float bits. Either sequence
+    // is predicted from the previous samples and the residuals are Rice
+    // coded in small blocks. If that does not save space the samples are
+    // stored raw. The first byte of the result names the scheme used.
+    [[nodiscard]] std::vector<std::uint8_t> encodeSamples(const float *samples,
+                                                          std::size_t count);
+
+    // Decodes exactly count samples produced by encodeSamples. Throws
+    // std::runtime_error if bytes is truncated or malformed.
+    void decodeSamples(const std::uint8_t *bytes, std::size_t byteCount,
+                       float *samples, std::size_t count);
+} // namespace cupuacu::undo
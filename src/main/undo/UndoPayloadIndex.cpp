@@ -0,0 +1,406 @@
+#include "UndoPayloadIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <system_error>
+
+namespace cupuacu::undo
+{
+    namespace
+    {
+        enum PayloadKind : std::uint32_t
+        {
+            kSegmentPayload = 1,
+            kSampleMatrixPayload = 2,
+            kSampleCubePayload = 3
+        };
+
+        // Two independent multiply-rotate lanes over 64-bit words, so that a
+        // collision needs both 64-bit hashes to collide.
+        class ContentHasher
+        {
+        public:
+            void addBytes(const void *data, const std::size_t size)
+            {
+                if (size == 0)
+                {
+                    return;
+                }
+
+                const auto *bytes = static_cast<const unsigned char *>(data);
+                std::size_t offset = 0;
+                for (; offset + sizeof(std::uint64_t) <= size;
+                     offset += sizeof(std::uint64_t))
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, bytes + offset, sizeof(word));
+                    mix(word);
+                }
+                if (offset < size)
+                {
+                    std::uint64_t word = 0;
+                    std::memcpy(&word, bytes + offset, size - offset);
+                    mix(word);
+                }
+                length += size;
+            }
+
+            template <typename T> void addValue(const T value)
+            {
+                addBytes(&value, sizeof(value));
+            }
+
+            void addSamples(const std::vector<float> &samples)
+            {
+                addValue(static_cast<std::uint64_t>(samples.size()));
+                addBytes(samples.data(), samples.size() * sizeof(float));
+                sampleCount += samples.size();
+            }
+
+            void addSamples(const std::vector<std::vector<float>> &samples)
+            {
+                addValue(static_cast<std::uint64_t>(samples.size()));
+                for (const auto &channel : samples)
+                {
+                    addSamples(channel);
+                }
+            }
+
+            [[nodiscard]] PayloadContentKey
+            finish(const std::uint32_t kind, const PayloadCodec codec) const
+            {
+                return {.kind = kind,
+                        .codec = codec,
+                        .sampleCount = sampleCount,
+                        .hash0 = avalanche(hash0 ^ length),
+                        .hash1 = avalanche(hash1 + length)};
+            }
+
+        private:
+            static constexpr std::uint64_t kPrime0 = 0x9E3779B185EBCA87ull;
+            static constexpr std::uint64_t kPrime1 = 0xC2B2AE3D27D4EB4Full;
+            static constexpr std::uint64_t kPrime2 = 0x165667B19E3779F9ull;
+            static constexpr std::uint64_t kPrime3 = 0xFF51AFD7ED558CCDull;
+
+            std::uint64_t hash0 = 0x243F6A8885A308D3ull;
+            std::uint64_t hash1 = 0x13198A2E03707344ull;
+            std::uint64_t length = 0;
+            std::uint64_t sampleCount = 0;
+
+            void mix(const std::uint64_t word)
+            {
+                hash0 = std::rotl(hash0 ^ (word * kPrime0), 31) * kPrime1;
+                hash1 = std::rotl(hash1 + word * kPrime2, 29) * kPrime3;
+            }
+
+            static std::uint64_t avalanche(std::uint64_t value)
+            {
+                value ^= value >> 33;
+                value *= 0xFF51AFD7ED558CCDull;
+                value ^= value >> 33;
+                value *= 0xC4CEB9FE1A85EC53ull;
+                value ^= value >> 33;
+                return value;
+            }
+        };
+    } // namespace
+
+    PayloadContentKey
+    payloadContentKey(const cupuacu::Document::AudioSegment &segment,
+                      const PayloadCodec codec)
+    {
+        ContentHasher hasher;
+        hasher.addValue(static_cast<std::int32_t>(segment.format));
+        hasher.addValue(static_cast<std::int32_t>(segment.sampleRate));
+        hasher.addValue(segment.channelCount);
+        hasher.addValue(segment.frameCount);
+        hasher.addSamples(segment.samples);
+        hasher.addValue(static_cast<std::uint64_t>(segment.dirty.size()));
+        for (const auto &dirty : segment.dirty)
+        {
+            hasher.addValue(
+                static_cast<std::uint64_t>(dirty.getRanges().size()));
+            for (const auto &range : dirty.getRanges())
+            {
+                hasher.addValue(range.startFrame);
+                hasher.addValue(range.endFrameExclusive);
+            }
+        }
+        hasher.addValue(static_cast<std::uint64_t>(segment.provenance.size()));
+        for (const auto &ranges : segment.provenance)
+        {
+            hasher.addValue(static_cast<std::uint64_t>(ranges.size()));
+            for (const auto &range : ranges)
+            {
+                hasher.addValue(range.startFrame);
+                hasher.addValue(range.endFrameExclusive);
+                hasher.addValue(range.sourceId);
+                hasher.addValue(range.sourceStartFrame);
+            }
+        }
+        return hasher.finish(kSegmentPayload, codec);
+    }
+
+    PayloadContentKey
+    payloadContentKey(const std::vector<std::vector<float>> &samples,
+                      const PayloadCodec codec)
+    {
+        ContentHasher hasher;
+        hasher.addSamples(samples);
+        return hasher.finish(kSampleMatrixPayload, codec);
+    }
+
+    PayloadContentKey payloadContentKey(
+        const std::vector<std::vector<std::vector<float>>> &samples,
+        const PayloadCodec codec)
+    {
+        ContentHasher hasher;
+        hasher.addValue(static_cast<std::uint64_t>(samples.size()));
+        for (const auto &matrix : samples)
+        {
+            hasher.addSamples(matrix);
+        }
+        return hasher.finish(kSampleCubePayload, codec);
+    }
+
+    bool UndoPayloadIndex::linkExisting(
+        const PayloadContentKey &key, const std::filesystem::path &path,
+        const std::function<bool(const std::filesystem::path &)> &holdsContent)
+    {
+        std::vector<std::shared_ptr<PayloadFile>> files;
+        {
+            std::lock_guard lock(mutex);
+            const auto it = filesByKey.find(key);
+            if (it == filesByKey.end())
+            {
+                return false;
+            }
+            files = it->second;
+        }
+
+        // Files are checked without the lock held, as reading one back can
+        // take long and every undo store's stats and removals need the
+        // lock. Whatever changed meanwhile is checked again before linking.
+        for (const auto &file : files)
+        {
+            std::vector<std::filesystem::path> candidates;
+            std::uint64_t bytes = 0;
+            {
+                std::lock_guard lock(mutex);
+                candidates = file->links;
+                bytes = file->bytes;
+            }
+
+            bool verified = false;
+            for (const auto &candidate : candidates)
+            {
+                std::error_code ec;
+                const auto size = std::filesystem::file_size(candidate, ec);
+                if (!ec && !verified)
+                {
+                    if (size != bytes || !holdsContent(candidate))
+                    {
+                        // Every link is the same file, so none of them will
+                        // do.
+                        break;
+                    }
+                    verified = true;
+                }
+
+                std::lock_guard lock(mutex);
+                // Links deleted since they were added, for example with
+                // their undo store, are dropped as they are found.
+                const auto indexed = filesByLink.find(candidate);
+                if (indexed == filesByLink.end() || indexed->second != file)
+                {
+                    continue;
+                }
+                if (!ec)
+                {
+                    std::filesystem::create_hard_link(candidate, path, ec);
+                    if (!ec)
+                    {
+                        forgetLocked(path);
+                        addLinkLocked(file, path);
+                        return true;
+                    }
+                }
+                if (!std::filesystem::exists(candidate, ec))
+                {
+                    forgetLocked(candidate);
+                }
+            }
+        }
+        return false;
+    }
+
+    void UndoPayloadIndex::add(const PayloadContentKey &key,
+                               std::filesystem::path path,
+                               const std::uint64_t bytes)
+    {
+        std::lock_guard lock(mutex);
+        forgetLocked(path);
+        auto file = std::make_shared<PayloadFile>();
+        file->key = key;
+        file->bytes = bytes;
+        filesByKey[key].push_back(file);
+        addLinkLocked(file, std::move(path));
+    }
+
+    void UndoPayloadIndex::addUnindexed(std::filesystem::path path,
+                                        const std::uint64_t bytes)
+    {
+        std::lock_guard lock(mutex);
+        if (filesByLink.contains(path))
+        {
+            return;
+        }
+        auto file = std::make_shared<PayloadFile>();
+        file->bytes = bytes;
+        addLinkLocked(file, std::move(path));
+    }
+
+    std::uint64_t UndoPayloadIndex::forget(const std::filesystem::path &path)
+    {
+        std::lock_guard lock(mutex);
+        return forgetLocked(path);
+    }
+
+    void UndoPayloadIndex::forgetAllIn(const std::filesystem::path &directory)
+    {
+        std::lock_guard lock(mutex);
+        std::vector<std::filesystem::path> forgotten;
+        for (const auto &[path, file] : filesByLink)
+        {
+            if (path.parent_path() == directory)
+            {
+                forgotten.push_back(path);
+            }
+        }
+        for (const auto &path : forgotten)
+        {
+            forgetLocked(path);
+        }
+    }
+
+    UndoPayloadUsage UndoPayloadIndex::usageIn(
+        const std::filesystem::path &directory,
+        const std::map<std::filesystem::path, std::uint64_t> &excluded) const
+    {
+        std::lock_guard lock(mutex);
+        const auto it = usageByDirectory.find(directory);
+        if (it == usageByDirectory.end())
+        {
+            return {};
+        }
+
+        auto usage = it->second;
+        for (const auto &[path, bytes] : excluded)
+        {
+            const auto file = filesByLink.find(path);
+            if (file == filesByLink.end())
+            {
+                continue;
+            }
+            const auto share = file->second->bytes / file->second->links.size();
+            usage.fileCount -= std::min<std::uint64_t>(usage.fileCount, 1);
+            usage.totalBytes -= std::min(usage.totalBytes, share);
+        }
+        return usage;
+    }
+
+    void UndoPayloadIndex::addLinkLocked(
+        const std::shared_ptr<PayloadFile> &file, std::filesystem::path path)
+    {
+        countLocked(*file, false);
+        file->links.push_back(path);
+        filesByLink[std::move(path)] = file;
+        countLocked(*file, true);
+    }
+
+    std::uint64_t
+    UndoPayloadIndex::forgetLocked(const std::filesystem::path &path)
+    {
+        const auto it = filesByLink.find(path);
+        if (it == filesByLink.end())
+        {
+            return 0;
+        }
+
+        const auto file = it->second;
+        filesByLink.erase(it);
+        const auto share = file->bytes / file->links.size();
+        countLocked(*file, false);
+        std::erase(file->links, path);
+        if (!file->links.empty())
+        {
+            countLocked(*file, true);
+        }
+        else if (file->key)
+        {
+            auto &sameKey = filesByKey[*file->key];
+            std::erase(sameKey, file);
+            if (sameKey.empty())
+            {
+                filesByKey.erase(*file->key);
+            }
+        }
+
+        const auto usage = usageByDirectory.find(path.parent_path());
+        if (usage != usageByDirectory.end() && usage->second.fileCount == 0)
+        {
+            usageByDirectory.erase(usage);
+        }
+        return share;
+    }
+
+    // Splits file's size between the directories holding its links in
+    // proportion to their link counts, rounding so that the shares add up
+    // to the size exactly, and adds them to or takes them from the
+    // directories' usage.
+    void UndoPayloadIndex::countLocked(const PayloadFile &file, const bool add)
+    {
+        const std::uint64_t linkCount = file.links.size();
+        if (linkCount == 0)
+        {
+            return;
+        }
+
+        std::map<std::filesystem::path, std::uint64_t> linksByDirectory;
+        for (const auto &link : file.links)
+        {
+            ++linksByDirectory[link.parent_path()];
+        }
+
+        const auto bytesUpTo = [&](const std::uint64_t links)
+        {
+            return file.bytes / linkCount * links +
+                   file.bytes % linkCount * links / linkCount;
+        };
+        std::uint64_t linksSoFar = 0;
+        for (const auto &[directory, links] : linksByDirectory)
+        {
+            const auto share = bytesUpTo(linksSoFar + links) -
+                               bytesUpTo(linksSoFar);
+            linksSoFar += links;
+            auto &usage = usageByDirectory[directory];
+            if (add)
+            {
+                usage.fileCount += links;
+                usage.totalBytes += share;
+            }
+            else
+            {
+                usage.fileCount -= std::min(usage.fileCount, links);
+                usage.totalBytes -= std::min(usage.totalBytes, share);
+            }
+        }
+    }
+
+    UndoPayloadIndex &undoPayloadIndex()
+    {
+        static UndoPayloadIndex index;
+        return index;
+    }
+} // namespace cupuacu::undo
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../Document.hpp"
+#include "UndoPayloadCodec.hpp"
+
+#include <compare>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace cupuacu::undo
+{
+    // Identifies the file an undo payload is likely written to: payloads
+    // with the same key are the same size and, barring a hash collision,
+    // produce the same bytes.
+    struct PayloadContentKey
+    {
+        std::uint32_t kind = 0;
+        PayloadCodec codec = PayloadCodec::Raw;
+        std::uint64_t sampleCount = 0;
+        std::uint64_t hash0 = 0;
+        std::uint64_t hash1 = 0;
+
+        auto operator<=>(const PayloadContentKey &) const = default;
+    };
+
+    [[nodiscard]] PayloadContentKey
+    payloadContentKey(const cupuacu::Document::AudioSegment &segment,
+                      PayloadCodec codec);
+    [[nodiscard]] PayloadContentKey
+    payloadContentKey(const std::vector<std::vector<float>> &samples,
+                      PayloadCodec codec);
+    [[nodiscard]] PayloadContentKey payloadContentKey(
+        const std::vector<std::vector<std::vector<float>>> &samples,
+        PayloadCodec codec);
+
+    struct UndoPayloadUsage
+    {
+        std::uint64_t fileCount = 0;
+        std::uint64_t totalBytes = 0;
+    };
+
+    // Complete undo payload files by content, shared by every undo store in
+    // the process. A payload with known content is stored as a hard link to
+    // the existing file instead of being written again, so the file system's
+    // link count is the reference count of the content: deleting one
+    // undoable's payload leaves the others intact. Payloads are matched as
+    // whole files; two that share only part of their samples are both
+    // written in full.
+    //
+    // The index also keeps what each directory's payloads take on disk, a
+    // file's size split between its links, up to date as links come and
+    // go, so an undo store's size is known without listing its files.
+    class UndoPayloadIndex
+    {
+    public:
+        // Creates path as a hard link to a file with content key that is
+        // still the size it was added with and for which holdsContent
+        // returns true, so that a hash collision is never linked to.
+        // Returns false if there is no such file or it cannot be linked to.
+        // holdsContent is called without the index locked.
+        bool linkExisting(
+            const PayloadContentKey &key, const std::filesystem::path &path,
+            const std::function<bool(const std::filesystem::path &)>
+                &holdsContent);
+
+        // path was written with content key and is bytes long.
+        void add(const PayloadContentKey &key, std::filesystem::path path,
+                 std::uint64_t bytes);
+        // Counts a payload file of unknown content, such as one restored
+        // from an earlier session, as bytes long. Never linked to, and
+        // ignored if path is known.
+        void addUnindexed(std::filesystem::path path, std::uint64_t bytes);
+
+        // Returns path's share of its file's size.
+        std::uint64_t forget(const std::filesystem::path &path);
+        void forgetAllIn(const std::filesystem::path &directory);
+
+        // The payloads in directory other than those in excluded, which
+        // are counted elsewhere.
+        [[nodiscard]] UndoPayloadUsage usageIn(
+            const std::filesystem::path &directory,
+            const std::map<std::filesystem::path, std::uint64_t> &excluded)
+            const;
+
+    private:
+        struct PayloadFile
+        {
+            std::optional<PayloadContentKey> key;
+            std::uint64_t bytes = 0;
+            // Every hard link to the file, oldest first.
+            std::vector<std::filesystem::path> links;
+        };
+
+        mutable std::mutex mutex;
+        std::map<PayloadContentKey, std::vector<std::shared_ptr<PayloadFile>>>
+            filesByKey;
+        std::map<std::filesystem::path, std::shared_ptr<PayloadFile>>
+            filesByLink;
+        std::map<std::filesystem::path, UndoPayloadUsage> usageByDirectory;
+
+        void addLinkLocked(const std::shared_ptr<PayloadFile> &file,
+                           std::filesystem::path path);
+        std::uint64_t forgetLocked(const std::filesystem::path &path);
+        void countLocked(const PayloadFile &file, bool add);
+    };
+
+    [[nodiscard]] UndoPayloadIndex &undoPayloadIndex();
+} // namespace cupuacu::undo
@@ -0,0 +1,251 @@
+#include "UndoPayloadWriter.hpp"
+
+#include "../Logger.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <system_error>
+
+namespace cupuacu::undo
+{
+    namespace
+    {
+        constexpr std::uint64_t kMaxQueuedUndoPayloadBytes =
+            512ull * 1024ull * 1024ull;
+    } // namespace
+
+    UndoPayloadWriter::UndoPayloadWriter(const std::uint64_t maxQueuedBytesToUse)
+        : maxQueuedBytes(maxQueuedBytesToUse),
+          worker([this]
+                 { run(); })
+    {
+    }
+
+    UndoPayloadWriter::~UndoPayloadWriter()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopRequested = true;
+        }
+        workAvailable.notify_all();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    void UndoPayloadWriter::enqueue(std::filesystem::path path,
+                                    std::shared_ptr<const Payload> payload,
+                                    const std::uint64_t bytes, WriteFn write)
+    {
+        auto entry = std::make_shared<Entry>();
+        entry->path = std::move(path);
+        entry->payload = std::move(payload);
+        entry->bytes = bytes;
+        entry->write = std::move(write);
+
+        std::unique_lock lock(mutex);
+        progress.wait(lock,
+                      [&]
+                      {
+                          return queuedBytes == 0 ||
+                                 queuedBytes + bytes <= maxQueuedBytes;
+                      });
+        queuedBytes += bytes;
+        entries[entry->path] = entry;
+        queue.push_back(std::move(entry));
+        workAvailable.notify_one();
+    }
+
+    void UndoPayloadWriter::enqueue(std::filesystem::path path,
+                                    Payload &&payload,
+                                    const std::uint64_t bytes, WriteFn write)
+    {
+        enqueue(std::move(path),
+                std::make_shared<const Payload>(std::move(payload)), bytes,
+                std::move(write));
+    }
+
+    auto UndoPayloadWriter::find(const std::filesystem::path &path) const
+        -> std::shared_ptr<const Payload>
+    {
+        std::lock_guard lock(mutex);
+        const auto it = entries.find(path);
+        return it == entries.end() ? nullptr : it->second->payload;
+    }
+
+    std::uint64_t UndoPayloadWriter::cancel(const std::filesystem::path &path)
+    {
+        std::uint64_t bytes = 0;
+        {
+            std::unique_lock lock(mutex);
+            const auto it = entries.find(path);
+            if (it == entries.end())
+            {
+                return 0;
+            }
+
+            const auto entry = it->second;
+            entries.erase(it);
+            entry->canceled = true;
+            bytes = entry->bytes;
+            const auto queued = std::find(queue.begin(), queue.end(), entry);
+            if (queued != queue.end())
+            {
+                queue.erase(queued);
+                queuedBytes -= entry->bytes;
+            }
+            else
+            {
+                progress.wait(lock,
+                              [&]
+                              {
+                                  return inFlight != entry;
+                              });
+            }
+        }
+        progress.notify_all();
+        return bytes;
+    }
+
+    void UndoPayloadWriter::cancelAllIn(const std::filesystem::path &directory)
+    {
+        std::vector<std::filesystem::path> paths;
+        {
+            std::lock_guard lock(mutex);
+            for (const auto &[path, entry] : entries)
+            {
+                if (path.parent_path() == directory)
+                {
+                    paths.push_back(path);
+                }
+            }
+        }
+        for (const auto &path : paths)
+        {
+            cancel(path);
+        }
+    }
+
+    void UndoPayloadWriter::waitUntilWritten(
+        const std::filesystem::path &directory) const
+    {
+        std::unique_lock lock(mutex);
+        progress.wait(lock,
+                      [&]
+                      {
+                          return !hasPendingWriteIn(directory);
+                      });
+    }
+
+    void UndoPayloadWriter::waitUntilIdle() const
+    {
+        std::unique_lock lock(mutex);
+        progress.wait(lock,
+                      [this]
+                      {
+                          return queue.empty() && !inFlight;
+                      });
+    }
+
+    std::map<std::filesystem::path, std::uint64_t>
+    UndoPayloadWriter::queuedIn(const std::filesystem::path &directory) const
+    {
+        std::lock_guard lock(mutex);
+        std::map<std::filesystem::path, std::uint64_t> result;
+        for (const auto &[path, entry] : entries)
+        {
+            if (path.parent_path() == directory)
+            {
+                result.emplace(path, entry->bytes);
+            }
+        }
+        return result;
+    }
+
+    bool UndoPayloadWriter::hasPendingWriteIn(
+        const std::filesystem::path &directory) const
+    {
+        if (inFlight && inFlight->path.parent_path() == directory)
+        {
+            return true;
+        }
+        return std::any_of(queue.begin(), queue.end(),
+                           [&](const auto &entry)
+                           {
+                               return entry->path.parent_path() == directory;
+                           });
+    }
+
+    void UndoPayloadWriter::run()
+    {
+        while (true)
+        {
+            std::shared_ptr<Entry> entry;
+            {
+                std::unique_lock lock(mutex);
+                workAvailable.wait(lock,
+                                   [this]
+                                   {
+                                       return stopRequested || !queue.empty();
+                                   });
+                if (queue.empty())
+                {
+                    return;
+                }
+                entry = queue.front();
+                queue.pop_front();
+                inFlight = entry;
+            }
+
+            std::string error;
+            try
+            {
+                entry->write(entry->path, *entry->payload);
+            }
+            catch (const std::exception &e)
+            {
+                error = e.what();
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                inFlight.reset();
+                queuedBytes -= entry->bytes;
+                if (entry->canceled)
+                {
+                    std::error_code ec;
+                    std::filesystem::remove(entry->path, ec);
+                }
+                else if (error.empty())
+                {
+                    entries.erase(entry->path);
+                }
+                else
+                {
+                    entry->failed = true;
+                }
+            }
+            progress.notify_all();
+
+            if (!error.empty() && !entry->canceled)
+            {
+                cupuacu::logging::error("Failed to write undo payload " +
+                                        entry->path.string() + ": " + error +
+                                        "; keeping it in memory");
+            }
+        }
+    }
+
+    UndoPayloadWriter &undoPayloadWriter()
+    {
+        static UndoPayloadWriter writer{kMaxQueuedUndoPayloadBytes};
+        return writer;
+    }
+
+    void drainUndoPayloadWrites()
+    {
+        undoPayloadWriter().waitUntilIdle();
+    }
+} // namespace cupuacu::undo
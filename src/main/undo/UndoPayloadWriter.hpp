@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../Document.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace cupuacu::undo
+{
+    // Writes undo payload files on a dedicated thread so that an edit does
+    // not wait for the disk. A queued payload stays readable from memory
+    // until its file is complete, and a payload whose write failed stays in
+    // memory for the rest of the session.
+    class UndoPayloadWriter
+    {
+    public:
+        using Payload =
+            std::variant<cupuacu::Document::AudioSegment,
+                         std::vector<std::vector<float>>,
+                         std::vector<std::vector<std::vector<float>>>>;
+        using WriteFn = std::function<void(const std::filesystem::path &,
+                                           const Payload &)>;
+
+        explicit UndoPayloadWriter(std::uint64_t maxQueuedBytesToUse);
+        // Finishes every queued write before returning.
+        ~UndoPayloadWriter();
+
+        UndoPayloadWriter(const UndoPayloadWriter &) = delete;
+        UndoPayloadWriter &operator=(const UndoPayloadWriter &) = delete;
+
+        // Queues write, which must create path from payload. bytes is the
+        // in-memory size of payload; while more than maxQueuedBytes are
+        // queued this blocks until the worker catches up.
+        void enqueue(std::filesystem::path path,
+                     std::shared_ptr<const Payload> payload,
+                     std::uint64_t bytes, WriteFn write);
+        // As above, taking over payload's data.
+        void enqueue(std::filesystem::path path, Payload &&payload,
+                     std::uint64_t bytes, WriteFn write);
+
+        // The payload of path if its file is not complete yet.
+        [[nodiscard]] std::shared_ptr<const Payload>
+        find(const std::filesystem::path &path) const;
+
+        // Forgets the payload of path. A write of path that is in progress
+        // is finished and its file deleted before this returns. Returns the
+        // in-memory size of the payload, or 0 if path was not queued.
+        std::uint64_t cancel(const std::filesystem::path &path);
+
+        void cancelAllIn(const std::filesystem::path &directory);
+
+        void waitUntilWritten(const std::filesystem::path &directory) const;
+        void waitUntilIdle() const;
+
+        // In-memory sizes of the payloads in directory whose files are not
+        // complete yet.
+        [[nodiscard]] std::map<std::filesystem::path, std::uint64_t>
+        queuedIn(const std::filesystem::path &directory) const;
+
+    private:
+        struct Entry
+        {
+            std::filesystem::path path;
+            std::shared_ptr<const Payload> payload;
+            std::uint64_t bytes = 0;
+            WriteFn write;
+            bool canceled = false;
+            bool failed = false;
+        };
+
+        const std::uint64_t maxQueuedBytes;
+        mutable std::mutex mutex;
+        std::condition_variable workAvailable;
+        mutable std::condition_variable progress;
+        std::deque<std::shared_ptr<Entry>> queue;
+        std::map<std::filesystem::path, std::shared_ptr<Entry>> entries;
+        std::shared_ptr<Entry> inFlight;
+        std::uint64_t queuedBytes = 0;
+        bool stopRequested = false;
+        std::thread worker;
+
+        [[nodiscard]] bool hasPendingWriteIn(
+            const std::filesystem::path &directory) const;
+        void run();
+    };
+
+    // The writer shared by every undo store in the process.
+    [[nodiscard]] UndoPayloadWriter &undoPayloadWriter();
+
+    // Blocks until every queued undo payload is on disk. Called on shutdown.
+    void drainUndoPayloadWrites();
+} // namespace cupuacu::undo
@@ -1,91 +1,108 @@
 #include "UndoStore.hpp"
 
+#include "UndoPayloadIndex.hpp"
+#include "UndoPayloadWriter.hpp"
 #include "../Logger.hpp"
 #include "../file/FileIo.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <variant>
+#include <vector>
 
 namespace cupuacu::undo
 {
     namespace
     {
         constexpr char kSegmentMagic[] = "CUPUACU_UNDO_SEGMENT";
-        constexpr std::uint32_t kSegmentVersion = 3;
+        // Version 4 stores dirty state as frame ranges instead of one byte
+        // per sample and only writes provenance ranges that have a source.
+        // Version 5 is version 4 with each channel's samples stored as an
+        // encodeSamples() block; it is only written by lossless stores.
+        constexpr std::uint32_t kRawSegmentVersion = 4;
+        constexpr std::uint32_t kEncodedSegmentVersion = 5;
         constexpr char kSampleMatrixMagic[] = "CUPUACU_UNDO_SAMPLE_MATRIX";
-        constexpr std::uint32_t kSampleMatrixVersion = 1;
         constexpr char kSampleCubeMagic[] = "CUPUACU_UNDO_SAMPLE_CUBE";
-        constexpr std::uint32_t kSampleCubeVersion = 1;
+        // Every payload file name ends in an extension starting with this.
+        constexpr char kPayloadExtensionPrefix[] = ".cupuacu-undo-";
+        // Sample matrices and cubes likewise use version 2 for encoded
+        // channels.
+        constexpr std::uint32_t kRawSampleArrayVersion = 1;
+        constexpr std::uint32_t kEncodedSampleArrayVersion = 2;
+
+        // Payloads are little-endian. Sample data moves through the stream in
+        // blocks of this many values rather than one byte or value at a time.
+        constexpr std::size_t kBulkValuesPerBlock = 65536;
+
+        template <typename Word> void storeLittleEndian(Word value, char *bytes)
+        {
+            for (std::size_t i = 0; i < sizeof(Word); ++i)
+            {
+                bytes[i] = static_cast<char>(value & 0xffu);
+                value = static_cast<Word>(value >> 8);
+            }
+        }
 
-        struct SerializedProvenanceRange
+        template <typename Word> Word loadLittleEndian(const unsigned char *bytes)
         {
-            std::int64_t startFrame = 0;
-            std::int64_t endFrameExclusive = 0;
-            std::uint64_t sourceId = 0;
-            std::int64_t sourceStartFrame = -1;
-        };
+            Word value = 0;
+            for (std::size_t i = sizeof(Word); i-- > 0;)
+            {
+                value = static_cast<Word>((value << 8) | bytes[i]);
+            }
+            return value;
+        }
 
         void writeU32(std::ostream &output, const std::uint32_t value)
         {
-            const char bytes[] = {
-                static_cast<char>(value & 0xffu),
-                static_cast<char>((value >> 8) & 0xffu),
-                static_cast<char>((value >> 16) & 0xffu),
-                static_cast<char>((value >> 24) & 0xffu),
-            };
+            char bytes[sizeof(value)]{};
+            storeLittleEndian(value, bytes);
+            output.write(bytes, sizeof(bytes));
+        }
+
+        void writeU64(std::ostream &output, const std::uint64_t value)
+        {
+            char bytes[sizeof(value)]{};
+            storeLittleEndian(value, bytes);
             output.write(bytes, sizeof(bytes));
         }
 
         void writeI64(std::ostream &output, const std::int64_t value)
         {
-            const auto unsignedValue = static_cast<std::uint64_t>(value);
-            for (int shift = 0; shift < 64; shift += 8)
-            {
-                output.put(static_cast<char>((unsignedValue >> shift) & 0xffu));
-            }
+            writeU64(output, static_cast<std::uint64_t>(value));
         }
 
-        void writeU64(std::ostream &output, const std::uint64_t value)
+        void readExactly(std::istream &input, char *destination,
+                         const std::size_t byteCount)
         {
-            for (int shift = 0; shift < 64; shift += 8)
+            input.read(destination, static_cast<std::streamsize>(byteCount));
+            if (!input ||
+                static_cast<std::size_t>(input.gcount()) != byteCount)
             {
-                output.put(static_cast<char>((value >> shift) & 0xffu));
+                throw std::runtime_error("Truncated undo segment");
             }
         }
 
         std::uint32_t readU32(std::istream &input)
         {
-            unsigned char bytes[4]{};
-            input.read(reinterpret_cast<char *>(bytes), sizeof(bytes));
-            if (!input)
-            {
-                throw std::runtime_error("Truncated undo segment");
-            }
-            return static_cast<std::uint32_t>(bytes[0]) |
-                   (static_cast<std::uint32_t>(bytes[1]) << 8) |
-                   (static_cast<std::uint32_t>(bytes[2]) << 16) |
-                   (static_cast<std::uint32_t>(bytes[3]) << 24);
+            unsigned char bytes[sizeof(std::uint32_t)]{};
+            readExactly(input, reinterpret_cast<char *>(bytes), sizeof(bytes));
+            return loadLittleEndian<std::uint32_t>(bytes);
         }
 
         std::uint64_t readU64(std::istream &input)
         {
-            std::uint64_t value = 0;
-            for (int shift = 0; shift < 64; shift += 8)
-            {
-                const int byte = input.get();
-                if (byte == std::char_traits<char>::eof())
-                {
-                    throw std::runtime_error("Truncated undo segment");
-                }
-                value |= static_cast<std::uint64_t>(
-                             static_cast<unsigned char>(byte))
-                         << shift;
-            }
-            return value;
+            unsigned char bytes[sizeof(std::uint64_t)]{};
+            readExactly(input, reinterpret_cast<char *>(bytes), sizeof(bytes));
+            return loadLittleEndian<std::uint64_t>(bytes);
         }
 
         std::int64_t readI64(std::istream &input)
@@ -93,14 +110,6 @@ namespace cupuacu::undo
             return static_cast<std::int64_t>(readU64(input));
         }
 
-        void writeFloat(std::ostream &output, const float value)
-        {
-            std::uint32_t bits = 0;
-            static_assert(sizeof(bits) == sizeof(value));
-            std::memcpy(&bits, &value, sizeof(bits));
-            writeU32(output, bits);
-        }
-
         float readFloat(std::istream &input)
         {
             const std::uint32_t bits = readU32(input);
@@ -110,97 +119,132 @@ namespace cupuacu::undo
             return value;
         }
 
-        void writeByte(std::ostream &output, const std::uint8_t value)
+        void writeFloats(std::ostream &output, const float *samples,
+                         const std::size_t count)
         {
-            output.put(static_cast<char>(value));
+            static_assert(sizeof(float) == sizeof(std::uint32_t));
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                output.write(reinterpret_cast<const char *>(samples),
+                             static_cast<std::streamsize>(count * sizeof(float)));
+                return;
+            }
+
+            std::vector<char> bytes(
+                std::min(count, kBulkValuesPerBlock) * sizeof(float));
+            for (std::size_t first = 0; first < count;
+                 first += kBulkValuesPerBlock)
+            {
+                const auto blockCount =
+                    std::min(kBulkValuesPerBlock, count - first);
+                for (std::size_t i = 0; i < blockCount; ++i)
+                {
+                    std::uint32_t bits = 0;
+                    std::memcpy(&bits, samples + first + i, sizeof(bits));
+                    storeLittleEndian(bits, bytes.data() + i * sizeof(bits));
+                }
+                output.write(bytes.data(),
+                             static_cast<std::streamsize>(blockCount *
+                                                          sizeof(float)));
+            }
         }
 
-        std::uint8_t readByte(std::istream &input)
+        void readFloats(std::istream &input, float *samples,
+                        const std::size_t count)
         {
-            const int byte = input.get();
-            if (byte == std::char_traits<char>::eof())
+            for (std::size_t first = 0; first < count;
+                 first += kBulkValuesPerBlock)
             {
-                throw std::runtime_error("Truncated undo segment");
+                const auto blockCount =
+                    std::min(kBulkValuesPerBlock, count - first);
+                readExactly(input, reinterpret_cast<char *>(samples + first),
+                            blockCount * sizeof(float));
+                if constexpr (std::endian::native != std::endian::little)
+                {
+                    for (std::size_t i = 0; i < blockCount; ++i)
+                    {
+                        unsigned char bytes[sizeof(float)]{};
+                        std::memcpy(bytes, samples + first + i, sizeof(bytes));
+                        const auto bits = loadLittleEndian<std::uint32_t>(bytes);
+                        std::memcpy(samples + first + i, &bits, sizeof(bits));
+                    }
+                }
             }
-            return static_cast<std::uint8_t>(byte);
         }
 
-        cupuacu::SampleFormat sampleFormatFromInt(const std::uint32_t value)
+        // Writes the samples, whose count the reader already knows, either
+        // raw or as a length-prefixed encodeSamples() block.
+        void writeChannelSamples(std::ostream &output, const float *samples,
+                                 const std::size_t count,
+                                 const PayloadCodec codec)
         {
-            switch (static_cast<cupuacu::SampleFormat>(value))
+            if (codec == PayloadCodec::Raw)
             {
-                case cupuacu::SampleFormat::PCM_S8:
-                case cupuacu::SampleFormat::PCM_S16:
-                case cupuacu::SampleFormat::PCM_S24:
-                case cupuacu::SampleFormat::PCM_S32:
-                case cupuacu::SampleFormat::FLOAT32:
-                case cupuacu::SampleFormat::FLOAT64:
-                case cupuacu::SampleFormat::Unknown:
-                    return static_cast<cupuacu::SampleFormat>(value);
+                writeFloats(output, samples, count);
+                return;
             }
-            return cupuacu::SampleFormat::Unknown;
+
+            const auto encoded = encodeSamples(samples, count);
+            writeU64(output, encoded.size());
+            output.write(reinterpret_cast<const char *>(encoded.data()),
+                         static_cast<std::streamsize>(encoded.size()));
         }
 
-        bool continuesRange(
-            const SerializedProvenanceRange &range,
-            const cupuacu::audio::SampleProvenance &provenance,
-            const std::int64_t frame)
+        void readChannelSamples(std::istream &input, float *samples,
+                                const std::size_t count, const bool encoded)
         {
-            if (frame != range.endFrameExclusive ||
-                provenance.sourceId != range.sourceId)
+            if (!encoded)
             {
-                return false;
+                readFloats(input, samples, count);
+                return;
             }
 
-            if (range.sourceId == 0)
+            const auto byteCount = readU64(input);
+            // The raw fallback is the largest encoding there is.
+            if (byteCount > 2 + static_cast<std::uint64_t>(count) * sizeof(float))
             {
-                return provenance.frameIndex == -1;
+                throw std::runtime_error("Invalid undo payload size");
             }
+            std::vector<std::uint8_t> bytes(static_cast<std::size_t>(byteCount));
+            readExactly(input, reinterpret_cast<char *>(bytes.data()),
+                        bytes.size());
+            decodeSamples(bytes.data(), bytes.size(), samples, count);
+        }
 
-            return provenance.frameIndex ==
-                   range.sourceStartFrame + (frame - range.startFrame);
+        void writeSampleVector(std::ostream &output,
+                               const std::vector<float> &samples,
+                               const PayloadCodec codec)
+        {
+            writeU64(output, samples.size());
+            writeChannelSamples(output, samples.data(), samples.size(), codec);
         }
 
-        std::vector<SerializedProvenanceRange> compressProvenanceRanges(
-            const std::vector<cupuacu::audio::SampleProvenance> &provenance)
+        void readSampleVector(std::istream &input, std::vector<float> &samples,
+                              const bool encoded)
         {
-            std::vector<SerializedProvenanceRange> ranges;
-            if (provenance.empty())
-            {
-                return ranges;
-            }
+            samples.resize(readU64(input));
+            readChannelSamples(input, samples.data(), samples.size(), encoded);
+        }
 
-            SerializedProvenanceRange active{
-                .startFrame = 0,
-                .endFrameExclusive = 1,
-                .sourceId = provenance[0].sourceId,
-                .sourceStartFrame = provenance[0].frameIndex,
-            };
-            for (std::int64_t frame = 1;
-                 frame < static_cast<std::int64_t>(provenance.size()); ++frame)
+        cupuacu::SampleFormat sampleFormatFromInt(const std::uint32_t value)
+        {
+            switch (static_cast<cupuacu::SampleFormat>(value))
             {
-                const auto &sampleProvenance =
-                    provenance[static_cast<std::size_t>(frame)];
-                if (continuesRange(active, sampleProvenance, frame))
-                {
-                    active.endFrameExclusive = frame + 1;
-                    continue;
-                }
-
-                ranges.push_back(active);
-                active = {
-                    .startFrame = frame,
-                    .endFrameExclusive = frame + 1,
-                    .sourceId = sampleProvenance.sourceId,
-                    .sourceStartFrame = sampleProvenance.frameIndex,
-                };
+                case cupuacu::SampleFormat::PCM_S8:
+                case cupuacu::SampleFormat::PCM_S16:
+                case cupuacu::SampleFormat::PCM_S24:
+                case cupuacu::SampleFormat::PCM_S32:
+                case cupuacu::SampleFormat::FLOAT32:
+                case cupuacu::SampleFormat::FLOAT64:
+                case cupuacu::SampleFormat::Unknown:
+                    return static_cast<cupuacu::SampleFormat>(value);
             }
-            ranges.push_back(active);
-            return ranges;
+            return cupuacu::SampleFormat::Unknown;
         }
 
         void writeSegmentFile(const std::filesystem::path &path,
-                              const cupuacu::Document::AudioSegment &segment)
+                              const cupuacu::Document::AudioSegment &segment,
+                              const PayloadCodec codec)
         {
             std::ofstream output(path, std::ios::binary);
             if (!output.is_open())
@@ -209,7 +253,9 @@ namespace cupuacu::undo
             }
 
             output.write(kSegmentMagic, sizeof(kSegmentMagic));
-            writeU32(output, kSegmentVersion);
+            writeU32(output, codec == PayloadCodec::Raw
+                                 ? kRawSegmentVersion
+                                 : kEncodedSegmentVersion);
             writeU32(output, static_cast<std::uint32_t>(segment.format));
             writeU32(output, static_cast<std::uint32_t>(segment.sampleRate));
             writeI64(output, segment.channelCount);
@@ -219,26 +265,25 @@ namespace cupuacu::undo
             {
                 const auto &channelSamples =
                     segment.samples[static_cast<std::size_t>(channel)];
-                const auto *channelDirty =
+                const auto dirtyRanges =
                     channel < static_cast<std::int64_t>(segment.dirty.size())
-                        ? &segment.dirty[static_cast<std::size_t>(channel)]
-                        : nullptr;
-                const auto &channelProvenance =
-                    segment.provenance[static_cast<std::size_t>(channel)];
-                const auto ranges = compressProvenanceRanges(channelProvenance);
-                for (std::int64_t frame = 0; frame < segment.frameCount; ++frame)
-                {
-                    writeFloat(output,
-                               channelSamples[static_cast<std::size_t>(frame)]);
-                }
-                for (std::int64_t frame = 0; frame < segment.frameCount; ++frame)
+                        ? segment.dirty[static_cast<std::size_t>(channel)]
+                              .rangesWithin(0, segment.frameCount)
+                        : std::vector<cupuacu::audio::FrameRange>{};
+                const auto ranges =
+                    channel < static_cast<std::int64_t>(segment.provenance.size())
+                        ? cupuacu::audio::provenanceRangesWithin(
+                              segment.provenance[static_cast<std::size_t>(channel)],
+                              0, segment.frameCount)
+                        : std::vector<cupuacu::audio::ProvenanceRange>{};
+                writeChannelSamples(output, channelSamples.data(),
+                                    static_cast<std::size_t>(segment.frameCount),
+                                    codec);
+                writeI64(output, static_cast<std::int64_t>(dirtyRanges.size()));
+                for (const auto &range : dirtyRanges)
                 {
-                    writeByte(output,
-                              channelDirty != nullptr &&
-                                      frame < static_cast<std::int64_t>(
-                                                  channelDirty->size())
-                                  ? (*channelDirty)[static_cast<std::size_t>(frame)]
-                                  : 0u);
+                    writeI64(output, range.startFrame);
+                    writeI64(output, range.endFrameExclusive);
                 }
                 writeI64(output, static_cast<std::int64_t>(ranges.size()));
                 for (const auto &range : ranges)
@@ -266,7 +311,7 @@ namespace cupuacu::undo
                 throw std::runtime_error("Invalid undo segment");
             }
             const auto version = readU32(input);
-            if (version != 1 && version != 2 && version != kSegmentVersion)
+            if (version < 1 || version > kEncodedSegmentVersion)
             {
                 throw std::runtime_error("Unsupported undo segment version");
             }
@@ -297,35 +342,65 @@ namespace cupuacu::undo
                 auto &channelProvenance =
                     segment.provenance[static_cast<std::size_t>(channel)];
                 channelSamples.resize(static_cast<std::size_t>(segment.frameCount));
-                channelDirty.assign(static_cast<std::size_t>(segment.frameCount), 0u);
-                channelProvenance.resize(
-                    static_cast<std::size_t>(segment.frameCount));
                 if (version == 1)
                 {
                     for (std::int64_t frame = 0; frame < segment.frameCount; ++frame)
                     {
                         channelSamples[static_cast<std::size_t>(frame)] =
                             readFloat(input);
-                        channelProvenance[static_cast<std::size_t>(frame)] = {
-                            .sourceId = readU64(input),
-                            .frameIndex = readI64(input),
-                        };
+                        const auto sourceId = readU64(input);
+                        const auto frameIndex = readI64(input);
+                        cupuacu::audio::appendProvenance(
+                            channelProvenance, frame,
+                            {.sourceId = sourceId, .frameIndex = frameIndex});
                     }
                     continue;
                 }
 
-                for (std::int64_t frame = 0; frame < segment.frameCount; ++frame)
+                readChannelSamples(input, channelSamples.data(),
+                                   channelSamples.size(),
+                                   version >= kEncodedSegmentVersion);
+                if (version == 3)
                 {
-                    channelSamples[static_cast<std::size_t>(frame)] =
-                        readFloat(input);
+                    std::vector<char> dirtyBytes(std::min(
+                        static_cast<std::size_t>(segment.frameCount),
+                        kBulkValuesPerBlock));
+                    for (std::int64_t first = 0; first < segment.frameCount;
+                         first += static_cast<std::int64_t>(kBulkValuesPerBlock))
+                    {
+                        const auto blockCount = std::min<std::int64_t>(
+                            static_cast<std::int64_t>(kBulkValuesPerBlock),
+                            segment.frameCount - first);
+                        readExactly(input, dirtyBytes.data(),
+                                    static_cast<std::size_t>(blockCount));
+                        for (std::int64_t i = 0; i < blockCount; ++i)
+                        {
+                            if (dirtyBytes[static_cast<std::size_t>(i)] != 0)
+                            {
+                                channelDirty.add(first + i, first + i + 1);
+                            }
+                        }
+                    }
                 }
-                if (version >= 3)
+                else if (version >= 4)
                 {
-                    for (std::int64_t frame = 0; frame < segment.frameCount;
-                         ++frame)
+                    const auto dirtyRangeCount = readI64(input);
+                    if (dirtyRangeCount < 0)
                     {
-                        channelDirty[static_cast<std::size_t>(frame)] =
-                            readByte(input);
+                        throw std::runtime_error("Invalid undo segment dirty state");
+                    }
+                    for (std::int64_t rangeIndex = 0; rangeIndex < dirtyRangeCount;
+                         ++rangeIndex)
+                    {
+                        const auto startFrame = readI64(input);
+                        const auto endFrameExclusive = readI64(input);
+                        if (startFrame < 0 || endFrameExclusive < startFrame ||
+                            endFrameExclusive > segment.frameCount)
+                        {
+                            throw std::runtime_error(
+                                "Invalid undo segment dirty range");
+                        }
+                        channelDirty.add(startFrame, endFrameExclusive);
                     }
                 }
 
@@ -346,17 +421,17 @@ namespace cupuacu::undo
                         throw std::runtime_error(
                             "Invalid undo segment provenance range");
                     }
-                    for (std::int64_t frame = startFrame;
-                         frame < endFrameExclusive; ++frame)
+                    // Earlier versions also wrote ranges without a source.
+                    if (sourceId == 0 || sourceStartFrame < 0 ||
+                        startFrame == endFrameExclusive)
                     {
-                        channelProvenance[static_cast<std::size_t>(frame)] = {
-                            .sourceId = sourceId,
-                            .frameIndex =
-                                sourceId == 0
-                                    ? -1
-                                    : sourceStartFrame + (frame - startFrame),
-                        };
+                        continue;
                     }
+                    channelProvenance.push_back(
+                        {.startFrame = startFrame,
+                         .endFrameExclusive = endFrameExclusive,
+                         .sourceId = sourceId,
+                         .sourceStartFrame = sourceStartFrame});
                 }
             }
 
@@ -365,7 +440,8 @@ namespace cupuacu::undo
 
         void writeSampleMatrixFile(
             const std::filesystem::path &path,
-            const std::vector<std::vector<float>> &samples)
+            const std::vector<std::vector<float>> &samples,
+            const PayloadCodec codec)
         {
             std::ofstream output(path, std::ios::binary);
             if (!output.is_open())
@@ -374,15 +450,13 @@ namespace cupuacu::undo
             }
 
             output.write(kSampleMatrixMagic, sizeof(kSampleMatrixMagic));
-            writeU32(output, kSampleMatrixVersion);
+            writeU32(output, codec == PayloadCodec::Raw
+                                 ? kRawSampleArrayVersion
+                                 : kEncodedSampleArrayVersion);
             writeU64(output, samples.size());
             for (const auto &channel : samples)
             {
-                writeU64(output, channel.size());
-                for (const float sample : channel)
-                {
-                    writeFloat(output, sample);
-                }
+                writeSampleVector(output, channel, codec);
             }
 
             if (!output.good())
@@ -400,7 +474,9 @@ namespace cupuacu::undo
             {
                 throw std::runtime_error("Invalid undo sample matrix");
             }
-            if (readU32(input) != kSampleMatrixVersion)
+            const auto version = readU32(input);
+            if (version != kRawSampleArrayVersion &&
+                version != kEncodedSampleArrayVersion)
             {
                 throw std::runtime_error(
                     "Unsupported undo sample matrix version");
@@ -409,18 +485,16 @@ namespace cupuacu::undo
             std::vector<std::vector<float>> samples(readU64(input));
             for (auto &channel : samples)
             {
-                channel.resize(readU64(input));
-                for (auto &sample : channel)
-                {
-                    sample = readFloat(input);
-                }
+                readSampleVector(input, channel,
+                                 version == kEncodedSampleArrayVersion);
             }
             return samples;
         }
 
         void writeSampleCubeFile(
             const std::filesystem::path &path,
-            const std::vector<std::vector<std::vector<float>>> &samples)
+            const std::vector<std::vector<std::vector<float>>> &samples,
+            const PayloadCodec codec)
         {
             std::ofstream output(path, std::ios::binary);
             if (!output.is_open())
@@ -429,18 +503,16 @@ namespace cupuacu::undo
             }
 
             output.write(kSampleCubeMagic, sizeof(kSampleCubeMagic));
-            writeU32(output, kSampleCubeVersion);
+            writeU32(output, codec == PayloadCodec::Raw
+                                 ? kRawSampleArrayVersion
+                                 : kEncodedSampleArrayVersion);
             writeU64(output, samples.size());
             for (const auto &matrix : samples)
             {
                 writeU64(output, matrix.size());
                 for (const auto &channel : matrix)
                 {
-                    writeU64(output, channel.size());
-                    for (const float sample : channel)
-                    {
-                        writeFloat(output, sample);
-                    }
+                    writeSampleVector(output, channel, codec);
                 }
             }
 
@@ -460,7 +532,9 @@ namespace cupuacu::undo
             {
                 throw std::runtime_error("Invalid undo sample cube");
             }
-            if (readU32(input) != kSampleCubeVersion)
+            const auto version = readU32(input);
+            if (version != kRawSampleArrayVersion &&
+                version != kEncodedSampleArrayVersion)
             {
                 throw std::runtime_error("Unsupported undo sample cube version");
             }
@@ -471,17 +545,260 @@ namespace cupuacu::undo
                 matrix.resize(readU64(input));
                 for (auto &channel : matrix)
                 {
-                    channel.resize(readU64(input));
-                    for (auto &sample : channel)
-                    {
-                        sample = readFloat(input);
-                    }
+                    readSampleVector(input, channel,
+                                     version == kEncodedSampleArrayVersion);
                 }
             }
             return samples;
         }
+
+        std::uint64_t sampleBytes(const std::vector<std::vector<float>> &samples)
+        {
+            std::uint64_t bytes = 0;
+            for (const auto &channel : samples)
+            {
+                bytes += channel.size() * sizeof(float);
+            }
+            return bytes;
+        }
+
+        std::uint64_t
+        sampleBytes(const std::vector<std::vector<std::vector<float>>> &samples)
+        {
+            std::uint64_t bytes = 0;
+            for (const auto &matrix : samples)
+            {
+                bytes += sampleBytes(matrix);
+            }
+            return bytes;
+        }
+
+        // Compares float bits, so that for example -0.0f and 0.0f differ.
+        bool sameSamples(const std::vector<float> &a,
+                         const std::vector<float> &b)
+        {
+            return a.size() == b.size() &&
+                   (a.empty() || std::memcmp(a.data(), b.data(),
+                                             a.size() * sizeof(float)) == 0);
+        }
+
+        bool samePayload(const std::vector<std::vector<float>> &a,
+                         const std::vector<std::vector<float>> &b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                              sameSamples);
+        }
+
+        bool samePayload(const std::vector<std::vector<std::vector<float>>> &a,
+                         const std::vector<std::vector<std::vector<float>>> &b)
+        {
+            return std::equal(
+                a.begin(), a.end(), b.begin(), b.end(),
+                [](const auto &matrixA, const auto &matrixB)
+                { return samePayload(matrixA, matrixB); });
+        }
+
+        bool samePayload(const cupuacu::Document::AudioSegment &a,
+                         const cupuacu::Document::AudioSegment &b)
+        {
+            return a.format == b.format && a.sampleRate == b.sampleRate &&
+                   a.channelCount == b.channelCount &&
+                   a.frameCount == b.frameCount &&
+                   samePayload(a.samples, b.samples) &&
+                   std::equal(a.dirty.begin(), a.dirty.end(), b.dirty.begin(),
+                              b.dirty.end(),
+                              [](const auto &dirtyA, const auto &dirtyB)
+                              {
+                                  return dirtyA.getRanges() ==
+                                         dirtyB.getRanges();
+                              }) &&
+                   a.provenance == b.provenance;
+        }
+
+        cupuacu::Document::AudioSegment
+        readPayloadFile(std::istream &input,
+                        const cupuacu::Document::AudioSegment &)
+        {
+            return readSegmentFile(input);
+        }
+
+        std::vector<std::vector<float>>
+        readPayloadFile(std::istream &input,
+                        const std::vector<std::vector<float>> &)
+        {
+            return readSampleMatrixFile(input);
+        }
+
+        std::vector<std::vector<std::vector<float>>>
+        readPayloadFile(std::istream &input,
+                        const std::vector<std::vector<std::vector<float>>> &)
+        {
+            return readSampleCubeFile(input);
+        }
+
+        // Whether the payload file at path reads back as data. A file that
+        // cannot be read holds nothing.
+        template <typename T>
+        bool payloadFileHolds(const std::filesystem::path &path, const T &data)
+        {
+            std::ifstream input(path, std::ios::binary);
+            if (!input.is_open())
+            {
+                return false;
+            }
+            try
+            {
+                return samePayload(readPayloadFile(input, data), data);
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+        }
+
+        // Writes data to path unless a file with the same content exists,
+        // in which case path becomes a hard link to it. A file whose key
+        // matches is read back and compared first.
+        template <typename T, typename WriteFile>
+        void writeDeduplicatedPayload(const std::filesystem::path &path,
+                                      const T &data, const PayloadCodec codec,
+                                      WriteFile writeFile)
+        {
+            const auto key = payloadContentKey(data, codec);
+            if (undoPayloadIndex().linkExisting(
+                    key, path,
+                    [&](const std::filesystem::path &candidate)
+                    { return payloadFileHolds(candidate, data); }))
+            {
+                return;
+            }
+
+            cupuacu::file::writeFileAtomically(
+                path,
+                [&](const std::filesystem::path &temporaryPath)
+                {
+                    writeFile(temporaryPath, data, codec);
+                });
+            std::error_code ec;
+            const auto bytes = std::filesystem::file_size(path, ec);
+            undoPayloadIndex().add(key, path,
+                                   ec ? 0 : static_cast<std::uint64_t>(bytes));
+        }
+
+        void writePayload(const std::filesystem::path &path,
+                          const UndoPayloadWriter::Payload &payload,
+                          const PayloadCodec codec)
+        {
+            if (const auto *segment =
+                    std::get_if<cupuacu::Document::AudioSegment>(&payload))
+            {
+                writeDeduplicatedPayload(path, *segment, codec,
+                                         writeSegmentFile);
+            }
+            else if (const auto *matrix =
+                         std::get_if<std::vector<std::vector<float>>>(&payload))
+            {
+                writeDeduplicatedPayload(path, *matrix, codec,
+                                         writeSampleMatrixFile);
+            }
+            else
+            {
+                writeDeduplicatedPayload(
+                    path,
+                    std::get<std::vector<std::vector<std::vector<float>>>>(
+                        payload),
+                    codec, writeSampleCubeFile);
+            }
+        }
+
+        void enqueuePayloadWrite(const std::filesystem::path &path,
+                                 UndoPayloadWriter::Payload &&payload,
+                                 const std::uint64_t bytes,
+                                 const PayloadCodec codec)
+        {
+            undoPayloadWriter().enqueue(
+                path, std::move(payload), bytes,
+                [codec](const std::filesystem::path &destination,
+                        const UndoPayloadWriter::Payload &queued)
+                {
+                    writePayload(destination, queued, codec);
+                });
+        }
+
+        std::uint64_t
+        sampleBytes(const cupuacu::Document::AudioSegment &segment)
+        {
+            return sampleBytes(segment.samples);
+        }
+
+        // Queues data for the writer thread in WriteBehind mode, moving it
+        // into the queue when it is an rvalue, and otherwise writes it now.
+        template <typename T, typename WriteFile>
+        void storePayload(const std::filesystem::path &path, T &&data,
+                          const PayloadWriteMode mode, const PayloadCodec codec,
+                          WriteFile writeFile)
+        {
+            if (mode == PayloadWriteMode::WriteBehind)
+            {
+                const auto bytes = sampleBytes(data);
+                enqueuePayloadWrite(
+                    path,
+                    UndoPayloadWriter::Payload{
+                        std::in_place_type<std::remove_cvref_t<T>>,
+                        std::forward<T>(data)},
+                    bytes, codec);
+                return;
+            }
+
+            writeDeduplicatedPayload(path, data, codec, writeFile);
+        }
+
+        // The share of a payload file's size attributed to one of its hard
+        // links, so that content shared between payloads is counted once.
+        std::uint64_t attributedFileBytes(const std::filesystem::path &path,
+                                          std::error_code &ec)
+        {
+            const auto size = std::filesystem::file_size(path, ec);
+            if (ec)
+            {
+                return 0;
+            }
+            const auto links = std::filesystem::hard_link_count(path, ec);
+            if (ec || links == 0)
+            {
+                ec.clear();
+                return static_cast<std::uint64_t>(size);
+            }
+            return static_cast<std::uint64_t>(size / links);
+        }
+
+        template <typename T>
+        std::optional<T> findQueuedPayload(const std::filesystem::path &path)
+        {
+            const auto queued = undoPayloadWriter().find(path);
+            if (!queued)
+            {
+                return std::nullopt;
+            }
+            if (const auto *payload = std::get_if<T>(queued.get()))
+            {
+                return *payload;
+            }
+            throw std::runtime_error(
+                "Queued undo payload has an unexpected type");
+        }
     } // namespace
 
+    void UndoStore::setPayloadCodec(const PayloadCodec payloadCodecToUse)
+    {
+        payloadCodec = payloadCodecToUse;
+    }
+
+    PayloadCodec UndoStore::getPayloadCodec() const
+    {
+        return payloadCodec;
+    }
+
     void UndoStore::attach(std::filesystem::path rootPathToUse)
     {
         rootPath = std::move(rootPathToUse);
@@ -499,6 +816,27 @@ namespace cupuacu::undo
             throw std::runtime_error("Failed to create undo store directory: " +
                                      ec.message());
         }
+        // Payloads left by an earlier session are counted from here on; the
+        // ones written from now on are counted as they are written.
+        for (const auto &entry :
+             std::filesystem::directory_iterator(rootPath, ec))
+        {
+            if (ec)
+            {
+                break;
+            }
+            if (entry.is_regular_file(ec) &&
+                entry.path().extension().string().starts_with(
+                    kPayloadExtensionPrefix))
+            {
+                const auto bytes = attributedFileBytes(entry.path(), ec);
+                if (!ec)
+                {
+                    undoPayloadIndex().addUnindexed(entry.path(), bytes);
+                }
+            }
+            ec.clear();
+        }
         cupuacu::logging::info("Attached undo store at " + rootPath.string());
     }
 
@@ -521,6 +859,9 @@ namespace cupuacu::undo
 
         const auto previousRoot = rootPath;
         const auto previousStats = stats();
+        undoPayloadWriter().cancelAllIn(rootPath);
+        undoPayloadWriter().waitUntilWritten(rootPath);
+        undoPayloadIndex().forgetAllIn(rootPath);
         std::error_code ec;
         std::filesystem::remove_all(rootPath, ec);
         rootPath.clear();
@@ -556,12 +897,22 @@ namespace cupuacu::undo
             throw std::runtime_error("Undo store is not attached");
         }
 
-        cupuacu::file::writeFileAtomically(
-            path,
-            [&](const std::filesystem::path &temporaryPath)
-            {
-                writeSegmentFile(temporaryPath, segment);
-            });
+        storePayload(path, segment, writeMode, payloadCodec, writeSegmentFile);
+        return {.path = path};
+    }
+
+    auto UndoStore::writeSegment(cupuacu::Document::AudioSegment &&segment,
+                                 const std::string &prefix) const
+        -> SegmentHandle
+    {
+        const auto path = allocatePath(prefix, ".cupuacu-undo-segment");
+        if (path.empty())
+        {
+            throw std::runtime_error("Undo store is not attached");
+        }
+
+        storePayload(path, std::move(segment),
+                     writeMode, payloadCodec, writeSegmentFile);
         return {.path = path};
     }
 
@@ -572,6 +923,11 @@ namespace cupuacu::undo
         {
             throw std::runtime_error("Undo segment handle is empty");
         }
+        if (auto queued = findQueuedPayload<cupuacu::Document::AudioSegment>(
+                handle.path))
+        {
+            return std::move(*queued);
+        }
 
         std::ifstream input(handle.path, std::ios::binary);
         if (!input.is_open())
@@ -591,12 +947,23 @@ namespace cupuacu::undo
             throw std::runtime_error("Undo store is not attached");
         }
 
-        cupuacu::file::writeFileAtomically(
-            path,
-            [&](const std::filesystem::path &temporaryPath)
-            {
-                writeSampleMatrixFile(temporaryPath, samples);
-            });
+        storePayload(path, samples,
+                     writeMode, payloadCodec, writeSampleMatrixFile);
+        return {.path = path};
+    }
+
+    auto UndoStore::writeSampleMatrix(
+        std::vector<std::vector<float>> &&samples,
+        const std::string &prefix) const -> SampleMatrixHandle
+    {
+        const auto path = allocatePath(prefix, ".cupuacu-undo-sample-matrix");
+        if (path.empty())
+        {
+            throw std::runtime_error("Undo store is not attached");
+        }
+
+        storePayload(path, std::move(samples),
+                     writeMode, payloadCodec, writeSampleMatrixFile);
         return {.path = path};
     }
 
@@ -607,6 +974,11 @@ namespace cupuacu::undo
         {
             throw std::runtime_error("Undo sample matrix handle is empty");
         }
+        if (auto queued =
+                findQueuedPayload<std::vector<std::vector<float>>>(handle.path))
+        {
+            return std::move(*queued);
+        }
 
         std::ifstream input(handle.path, std::ios::binary);
         if (!input.is_open())
@@ -626,12 +998,23 @@ namespace cupuacu::undo
             throw std::runtime_error("Undo store is not attached");
         }
 
-        cupuacu::file::writeFileAtomically(
-            path,
-            [&](const std::filesystem::path &temporaryPath)
-            {
-                writeSampleCubeFile(temporaryPath, samples);
-            });
+        storePayload(path, samples,
+                     writeMode, payloadCodec, writeSampleCubeFile);
+        return {.path = path};
+    }
+
+    auto UndoStore::writeSampleCube(
+        std::vector<std::vector<std::vector<float>>> &&samples,
+        const std::string &prefix) const -> SampleCubeHandle
+    {
+        const auto path = allocatePath(prefix, ".cupuacu-undo-sample-cube");
+        if (path.empty())
+        {
+            throw std::runtime_error("Undo store is not attached");
+        }
+
+        storePayload(path, std::move(samples),
+                     writeMode, payloadCodec, writeSampleCubeFile);
         return {.path = path};
     }
 
@@ -642,6 +1025,11 @@ namespace cupuacu::undo
         {
             throw std::runtime_error("Undo sample cube handle is empty");
         }
+        if (auto queued = findQueuedPayload<
+                std::vector<std::vector<std::vector<float>>>>(handle.path))
+        {
+            return std::move(*queued);
+        }
 
         std::ifstream input(handle.path, std::ios::binary);
         if (!input.is_open())
@@ -651,42 +1039,58 @@ namespace cupuacu::undo
         return readSampleCubeFile(input);
     }
 
-    auto UndoStore::stats() const -> Stats
+    std::uint64_t UndoStore::remove(const PayloadHandle &handle) const
     {
-        Stats result{};
-        if (rootPath.empty())
+        if (handle.empty() || rootPath.empty() ||
+            handle.path.parent_path() != rootPath)
         {
-            return result;
+            return 0;
         }
 
+        // A write that was in progress has indexed its file by the time
+        // cancel() returns, so it is forgotten in either case.
+        if (const auto queuedBytes = undoPayloadWriter().cancel(handle.path);
+            queuedBytes > 0)
+        {
+            undoPayloadIndex().forget(handle.path);
+            return queuedBytes;
+        }
+
+        const auto bytes = undoPayloadIndex().forget(handle.path);
         std::error_code ec;
-        if (!std::filesystem::exists(rootPath, ec) || ec)
+        if (!std::filesystem::remove(handle.path, ec) || ec)
         {
-            return result;
+            return 0;
         }
+        return bytes;
+    }
 
-        for (const auto &entry : std::filesystem::directory_iterator(rootPath, ec))
+    auto UndoStore::stats() const -> Stats
+    {
+        if (rootPath.empty())
         {
-            if (ec)
-            {
-                break;
-            }
-            if (!entry.is_regular_file())
-            {
-                continue;
-            }
+            return {};
+        }
 
+        // A payload whose file is completed while this runs may be in both,
+        // so the queued ones are left out of the index's count.
+        const auto queued = undoPayloadWriter().queuedIn(rootPath);
+        const auto written = undoPayloadIndex().usageIn(rootPath, queued);
+        Stats result{.fileCount = written.fileCount,
+                     .totalBytes = written.totalBytes};
+        for (const auto &[path, bytes] : queued)
+        {
             ++result.fileCount;
-            const auto size = entry.file_size(ec);
-            if (!ec)
-            {
-                result.totalBytes += static_cast<std::uint64_t>(size);
-            }
-            else
-            {
-                ec.clear();
-            }
+            result.totalBytes += bytes;
         }
         return result;
     }
+
+    void UndoStore::flush() const
+    {
+        if (!rootPath.empty())
+        {
+            undoPayloadWriter().waitUntilWritten(rootPath);
+        }
+    }
 } // namespace cupuacu::undo
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Document.hpp"
+#include "UndoPayloadCodec.hpp"
 
 #include <filesystem>
 #include <string>
@@ -8,6 +9,15 @@
 
 namespace cupuacu::undo
 {
+    enum class PayloadWriteMode
+    {
+        // write* returns once the payload file is complete.
+        Immediate,
+        // write* queues the payload on undoPayloadWriter() and returns;
+        // reads are served from the queued copy until its file is complete.
+        WriteBehind
+    };
+
     class UndoStore
     {
     public:
@@ -31,6 +41,19 @@ namespace cupuacu::undo
         using SampleMatrixHandle = PayloadHandle;
         using SampleCubeHandle = PayloadHandle;
 
+        UndoStore() = default;
+        explicit UndoStore(
+            PayloadCodec payloadCodecToUse,
+            PayloadWriteMode writeModeToUse = PayloadWriteMode::Immediate)
+            : payloadCodec(payloadCodecToUse), writeMode(writeModeToUse)
+        {
+        }
+
+        // Applies to payloads written from now on; payloads written with
+        // either codec can always be read back.
+        void setPayloadCodec(PayloadCodec payloadCodecToUse);
+        [[nodiscard]] PayloadCodec getPayloadCodec() const;
+
         void attach(std::filesystem::path rootPathToUse);
         [[nodiscard]] bool isAttached() const;
         [[nodiscard]] const std::filesystem::path &root() const;
@@ -40,9 +63,14 @@ namespace cupuacu::undo
         allocatePath(const std::string &prefix,
                      const std::string &extension = ".bin") const;
 
+        // The overloads taking an rvalue move the payload into the write
+        // queue in WriteBehind mode; the others copy it there.
         [[nodiscard]] SegmentHandle
         writeSegment(const cupuacu::Document::AudioSegment &segment,
                      const std::string &prefix = "segment") const;
+        [[nodiscard]] SegmentHandle
+        writeSegment(cupuacu::Document::AudioSegment &&segment,
+                     const std::string &prefix = "segment") const;
 
         [[nodiscard]] cupuacu::Document::AudioSegment
         readSegment(const SegmentHandle &handle) const;
@@ -51,6 +79,9 @@ namespace cupuacu::undo
         writeSampleMatrix(
             const std::vector<std::vector<float>> &samples,
             const std::string &prefix = "sample-matrix") const;
+        [[nodiscard]] SampleMatrixHandle
+        writeSampleMatrix(std::vector<std::vector<float>> &&samples,
+                          const std::string &prefix = "sample-matrix") const;
 
         [[nodiscard]] std::vector<std::vector<float>>
         readSampleMatrix(const SampleMatrixHandle &handle) const;
@@ -59,13 +90,32 @@ namespace cupuacu::undo
         writeSampleCube(
             const std::vector<std::vector<std::vector<float>>> &samples,
             const std::string &prefix = "sample-cube") const;
+        [[nodiscard]] SampleCubeHandle
+        writeSampleCube(
+            std::vector<std::vector<std::vector<float>>> &&samples,
+            const std::string &prefix = "sample-cube") const;
 
         [[nodiscard]] std::vector<std::vector<std::vector<float>>>
         readSampleCube(const SampleCubeHandle &handle) const;
 
+        // Deletes the payload file of handle if it lives in this store and
+        // returns the bytes stats() counted for it, or 0 if nothing was
+        // deleted. Payloads with identical content share one file through
+        // hard links, which is only freed with its last link.
+        std::uint64_t remove(const PayloadHandle &handle) const;
+
+        // Includes payloads that are still queued for writing. A file
+        // shared by n payloads counts 1/n of its size for each of them.
+        // Kept up to date as payloads are written, linked and removed, so
+        // this does not touch the disk.
         [[nodiscard]] Stats stats() const;
 
+        // Blocks until every payload written to this store is on disk.
+        void flush() const;
+
     private:
         std::filesystem::path rootPath;
+        PayloadCodec payloadCodec = PayloadCodec::Raw;
+        PayloadWriteMode writeMode = PayloadWriteMode::Immediate;
     };
 } // namespace cupuacu::undo
@@ -8,6 +8,12 @@
 
 namespace cupuacu::waveform
 {
+    namespace
+    {
+        constexpr int64_t kBuildChunkBlocks = 4096;
+        constexpr std::size_t kMaxChunksAheadOfPublication = 64;
+    } // namespace
+
     DocumentWaveformCaches::~DocumentWaveformCaches()
     {
         stopBuild();
@@ -32,9 +38,9 @@ namespace cupuacu::waveform
         return *this;
     }
 
-    DocumentWaveformCaches::BuildJob::BuildJob(const Document &documentToRead,
-                                               BuildRequest requestToUse)
-        : document(documentToRead),
+    DocumentWaveformCaches::BuildJob::BuildJob(
+        Document::ReadLease snapshotToRead, BuildRequest requestToUse)
+        : snapshot(std::move(snapshotToRead)),
           request(std::move(requestToUse))
     {
     }
@@ -102,168 +108,259 @@ namespace cupuacu::waveform
 
     void DocumentWaveformCaches::BuildJob::cancel()
     {
-        cancelRequested.store(true, std::memory_order_release);
+        {
+            // Taken so that a waiter cannot miss the flag between checking
+            // it and going to sleep.
+            std::lock_guard lock(mutex);
+            cancelRequested.store(true, std::memory_order_release);
+        }
         outputCv.notify_all();
+        chunkCv.notify_all();
     }
 
     void DocumentWaveformCaches::BuildJob::run()
     {
-        constexpr int64_t kBuildChunkBlocks = 4096;
-        constexpr std::size_t kMaxQueuedOutputs = 32;
-        if (!request.channels.empty())
+        int64_t totalBlocks = 0;
+        std::vector<std::pair<int64_t, int64_t>> dirtyBlocks;
+        dirtyBlocks.reserve(request.channels.size());
+        for (const auto &channel : request.channels)
         {
-            struct ChannelBuildRuntime
-            {
-                int64_t channelIndex = 0;
-                gui::WaveformCache::BuildState state;
-                int64_t nextBlock = 0;
-                int64_t dirtyToBlock = -1;
-            };
+            const auto &state = channel.buildState;
+            totalBlocks += channel.totalDirtyBlocks;
+            const int64_t level0Size =
+                state.levels.empty()
+                    ? 0
+                    : static_cast<int64_t>(state.levels[0].size());
+            dirtyBlocks.emplace_back(
+                std::max<int64_t>(0, state.dirtyFromBlock),
+                std::min<int64_t>(state.dirtyToBlock, level0Size - 1));
+        }
 
-            int64_t totalBlocks = 0;
-            std::vector<ChannelBuildRuntime> channels;
-            channels.reserve(request.channels.size());
-            for (const auto &channel : request.channels)
+        // Chunks go round-robin over the channels so that all of them fill
+        // in at the same pace.
+        for (int64_t chunkStart = 0;; chunkStart += kBuildChunkBlocks)
+        {
+            bool anyChunk = false;
+            for (std::size_t channel = 0; channel < dirtyBlocks.size();
+                 ++channel)
             {
-                totalBlocks += channel.totalDirtyBlocks;
-                channels.push_back(ChannelBuildRuntime{
-                    .channelIndex = channel.channelIndex,
-                    .state = channel.buildState,
-                    .nextBlock = channel.buildState.dirtyFromBlock,
-                    .dirtyToBlock = channel.buildState.dirtyToBlock,
+                const auto [firstBlock, lastBlock] = dirtyBlocks[channel];
+                if (lastBlock - firstBlock < chunkStart)
+                {
+                    continue;
+                }
+                anyChunk = true;
+                const int64_t fromBlock = firstBlock + chunkStart;
+                chunks.push_back(Level0Chunk{
+                    .channel = channel,
+                    .fromBlock = fromBlock,
+                    .toBlock = std::min<int64_t>(
+                        lastBlock, fromBlock + kBuildChunkBlocks - 1),
                 });
             }
+            if (!anyChunk)
+            {
+                break;
+            }
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            progress = {.completedBlocks = 0, .totalBlocks = totalBlocks};
+        }
+
+        const std::size_t workerCount = std::clamp<std::size_t>(
+            std::thread::hardware_concurrency(), 1,
+            std::max<std::size_t>(1, chunks.size()));
+        level0Workers.reserve(workerCount);
+        for (std::size_t i = 0; i < workerCount; ++i)
+        {
+            level0Workers.emplace_back([this] { computeLevel0Chunks(); });
+        }
+
+        // Workers return once every chunk is claimed or the job is
+        // cancelled, which is also when publishChunks() returns.
+        publishChunks();
+        for (auto &level0Worker : level0Workers)
+        {
+            level0Worker.join();
+        }
+    }
+
+    void DocumentWaveformCaches::BuildJob::computeLevel0Chunks()
+    {
+        std::vector<float> samples;
+
+        while (true)
+        {
+            std::size_t chunkIndex = 0;
+            {
+                std::unique_lock lock(mutex);
+                // Workers stay a bounded number of chunks ahead of
+                // publication, so the peaks they hold do not pile up.
+                chunkCv.wait(
+                    lock,
+                    [this]
+                    {
+                        return cancelRequested.load(
+                                   std::memory_order_acquire) ||
+                               nextUnclaimedChunk >= chunks.size() ||
+                               nextUnclaimedChunk <
+                                   nextUnpublishedChunk +
+                                       kMaxChunksAheadOfPublication;
+                    });
+                if (cancelRequested.load(std::memory_order_acquire) ||
+                    nextUnclaimedChunk >= chunks.size())
+                {
+                    return;
+                }
+                chunkIndex = nextUnclaimedChunk++;
+            }
+
+            const auto &chunk = chunks[chunkIndex];
+            const auto &channel = request.channels[chunk.channel];
+            const auto blockCount =
+                static_cast<std::size_t>(chunk.toBlock - chunk.fromBlock + 1);
+            std::vector<gui::Peak> peaks(blockCount);
+            std::vector<gui::BlockEnergy> energies(blockCount);
+            gui::WaveformCache::computeLevel0Peaks(
+                channel.buildState.layout, chunk.fromBlock, chunk.toBlock,
+                [&](const int64_t frameStart, const int64_t frameCount)
+                {
+                    samples.resize(static_cast<std::size_t>(frameCount));
+                    const int64_t read =
+                        snapshot.readFrames(channel.channelIndex, frameStart,
+                                            samples.data(), frameCount);
+                    std::fill(samples.begin() + read, samples.end(), 0.0f);
+                    return samples.data();
+                },
+                peaks.data(), energies.data());
 
             {
                 std::lock_guard lock(mutex);
-                progress = {.completedBlocks = 0, .totalBlocks = totalBlocks};
+                chunks[chunkIndex].peaks = std::move(peaks);
+                chunks[chunkIndex].energies = std::move(energies);
+                chunks[chunkIndex].computed = true;
             }
+            chunkCv.notify_all();
+        }
+    }
+
+    void DocumentWaveformCaches::BuildJob::publishChunks()
+    {
+        constexpr std::size_t kMaxQueuedOutputs = 32;
+
+        std::vector<gui::WaveformCache::BuildState> states;
+        states.reserve(request.channels.size());
+        for (const auto &channel : request.channels)
+        {
+            states.push_back(channel.buildState);
+        }
 
-            bool workRemaining = true;
-            while (workRemaining)
+        for (std::size_t chunkIndex = 0; chunkIndex < chunks.size();
+             ++chunkIndex)
+        {
+            std::vector<gui::Peak> peaks;
+            std::vector<gui::BlockEnergy> energies;
             {
+                std::unique_lock lock(mutex);
+                chunkCv.wait(lock,
+                             [&]
+                             {
+                                 return cancelRequested.load(
+                                            std::memory_order_acquire) ||
+                                        chunks[chunkIndex].computed;
+                             });
                 if (cancelRequested.load(std::memory_order_acquire))
                 {
                     return;
                 }
-                workRemaining = false;
-                for (auto &channel : channels)
-                {
-                    if (cancelRequested.load(std::memory_order_acquire))
-                    {
-                        return;
-                    }
-                    if (channel.dirtyToBlock < channel.nextBlock)
-                    {
-                        continue;
-                    }
-                    workRemaining = true;
-
-                    const int64_t builtFromBlock = channel.nextBlock;
-                    const int64_t builtToBlock = std::min<int64_t>(
-                        channel.dirtyToBlock,
-                        builtFromBlock + kBuildChunkBlocks - 1);
-                    const int64_t sampleStart =
-                        builtFromBlock *
-                        static_cast<int64_t>(gui::WaveformCache::BASE_BLOCK_SIZE);
-                    const int64_t sampleEndExclusive = std::min<int64_t>(
-                        channel.state.numSamples,
-                        (builtToBlock + 1) * static_cast<int64_t>(
-                                                 gui::WaveformCache::BASE_BLOCK_SIZE));
-
-                    std::vector<float> samples;
-                    samples.reserve(static_cast<std::size_t>(std::max<int64_t>(
-                        0, sampleEndExclusive - sampleStart)));
-                    {
-                        auto lease = document.acquireReadLease();
-                        for (int64_t sample = sampleStart;
-                             sample < sampleEndExclusive; ++sample)
-                        {
-                            if ((sample & 4095) == 0 &&
-                                cancelRequested.load(std::memory_order_acquire))
-                            {
-                                return;
-                            }
-                            samples.push_back(
-                                lease.getSample(channel.channelIndex, sample));
-                        }
-                    }
+                peaks = std::move(chunks[chunkIndex].peaks);
+                energies = std::move(chunks[chunkIndex].energies);
+            }
 
-                    gui::WaveformCache::rebuildDirtyBlockRangeFromSlice(
-                        channel.state.levels, channel.state.numSamples,
-                        builtFromBlock, builtToBlock, sampleStart,
-                        samples.data(), static_cast<int64_t>(samples.size()));
-
-                    BuildOutput chunkOutput{
-                        .waveformDataVersion = request.waveformDataVersion,
-                        .completedBlocks = 0,
-                        .totalBlocks = totalBlocks,
-                        .completed = false,
-                        .channelChunks = {BuildOutput::ChannelChunk{
-                            .channelIndex = channel.channelIndex,
-                            .builtFromBlock = builtFromBlock,
-                            .builtToBlock = builtToBlock,
-                            .levelUpdates = {},
-                        }},
-                    };
-
-                    int64_t levelFrom = builtFromBlock;
-                    int64_t levelTo = builtToBlock;
-                    for (int level = 0;
-                         level < static_cast<int>(channel.state.levels.size()) &&
-                         levelTo >= levelFrom;
-                         ++level)
-                    {
-                        auto &levelData =
-                            channel.state.levels[static_cast<std::size_t>(level)];
-                        const int64_t clampedFrom = std::clamp<int64_t>(
-                            levelFrom, 0,
-                            static_cast<int64_t>(levelData.size()));
-                        const int64_t clampedTo = std::clamp<int64_t>(
-                            levelTo, -1,
-                            static_cast<int64_t>(levelData.size()) - 1);
-                        if (clampedTo >= clampedFrom)
-                        {
-                            auto &levelUpdates =
-                                chunkOutput.channelChunks[0].levelUpdates;
-                            levelUpdates.push_back(
-                                gui::WaveformCache::LevelSpanUpdate{
-                                    .level = level,
-                                    .fromIndex = clampedFrom,
-                                    .peaks = std::vector<gui::Peak>(
-                                        levelData.begin() + clampedFrom,
-                                        levelData.begin() + clampedTo + 1),
-                                });
-                        }
-                        levelFrom /= 2;
-                        levelTo /= 2;
-                    }
+            const auto &chunk = chunks[chunkIndex];
+            auto &state = states[chunk.channel];
+            const int64_t builtFromBlock = chunk.fromBlock;
+            const int64_t builtToBlock = chunk.toBlock;
+            std::copy(peaks.begin(), peaks.end(),
+                      state.levels[0].begin() + builtFromBlock);
+            std::copy(energies.begin(), energies.end(),
+                      state.energyLevels[0].begin() + builtFromBlock);
+            gui::WaveformCache::foldDirtyLevels(state.levels, builtFromBlock,
+                                                builtToBlock);
+            gui::WaveformCache::foldDirtyLevels(state.energyLevels,
+                                                builtFromBlock, builtToBlock);
+
+            BuildOutput chunkOutput{
+                .waveformDataVersion = request.waveformDataVersion,
+                .completedBlocks = 0,
+                .totalBlocks = progress.totalBlocks,
+                .completed = false,
+                .channelChunks = {BuildOutput::ChannelChunk{
+                    .channelIndex = request.channels[chunk.channel].channelIndex,
+                    .builtFromBlock = builtFromBlock,
+                    .builtToBlock = builtToBlock,
+                    .levelUpdates = {},
+                }},
+            };
 
-                    {
-                        std::unique_lock lock(mutex);
-                        outputCv.wait(
-                            lock,
-                            [this]
-                            {
-                                return cancelRequested.load(
-                                           std::memory_order_acquire) ||
-                                       outputs.size() < kMaxQueuedOutputs;
-                            });
-                        if (cancelRequested.load(std::memory_order_acquire))
-                        {
-                            return;
-                        }
-                        progress = {.completedBlocks =
-                                        progress.completedBlocks +
-                                        (builtToBlock - builtFromBlock + 1),
-                                    .totalBlocks = totalBlocks};
-                        chunkOutput.completedBlocks = progress.completedBlocks;
-                        outputs.push_back(std::move(chunkOutput));
-                    }
+            int64_t levelFrom = builtFromBlock;
+            int64_t levelTo = builtToBlock;
+            for (int level = 0;
+                 level < static_cast<int>(state.levels.size()) &&
+                 levelTo >= levelFrom;
+                 ++level)
+            {
+                const auto &levelData =
+                    state.levels[static_cast<std::size_t>(level)];
+                const auto &energyData =
+                    state.energyLevels[static_cast<std::size_t>(level)];
+                const int64_t clampedFrom = std::clamp<int64_t>(
+                    levelFrom, 0, static_cast<int64_t>(levelData.size()));
+                const int64_t clampedTo = std::clamp<int64_t>(
+                    levelTo, -1, static_cast<int64_t>(levelData.size()) - 1);
+                if (clampedTo >= clampedFrom)
+                {
+                    auto &levelUpdates =
+                        chunkOutput.channelChunks[0].levelUpdates;
+                    levelUpdates.push_back(gui::WaveformCache::LevelSpanUpdate{
+                        .level = level,
+                        .fromIndex = clampedFrom,
+                        .peaks = std::vector<gui::Peak>(
+                            levelData.begin() + clampedFrom,
+                            levelData.begin() + clampedTo + 1),
+                        .energies = std::vector<gui::BlockEnergy>(
+                            energyData.begin() + clampedFrom,
+                            energyData.begin() + clampedTo + 1),
+                    });
+                }
+                levelFrom /= 2;
+                levelTo /= 2;
+            }
 
-                    channel.nextBlock = builtToBlock + 1;
+            {
+                std::unique_lock lock(mutex);
+                outputCv.wait(lock,
+                              [this]
+                              {
+                                  return cancelRequested.load(
+                                             std::memory_order_acquire) ||
+                                         outputs.size() < kMaxQueuedOutputs;
+                              });
+                if (cancelRequested.load(std::memory_order_acquire))
+                {
+                    return;
                 }
+                progress = {.completedBlocks =
+                                progress.completedBlocks +
+                                (builtToBlock - builtFromBlock + 1),
+                            .totalBlocks = progress.totalBlocks};
+                chunkOutput.completedBlocks = progress.completedBlocks;
+                outputs.push_back(std::move(chunkOutput));
+                nextUnpublishedChunk = chunkIndex + 1;
             }
+            chunkCv.notify_all();
         }
 
         std::unique_lock lock(mutex);
@@ -307,6 +404,11 @@ namespace cupuacu::waveform
                       gui::WaveformCache{});
     }
 
+    int64_t DocumentWaveformCaches::getCacheCount() const
+    {
+        return static_cast<int64_t>(caches.size());
+    }
+
     gui::WaveformCache &DocumentWaveformCaches::getCache(const int channel)
     {
         return caches[static_cast<std::size_t>(channel)];
@@ -336,6 +438,36 @@ namespace cupuacu::waveform
         }
     }
 
+    bool DocumentWaveformCaches::applyEdits(
+        const int64_t channelCount, const int64_t frameCountBefore,
+        const std::vector<FrameEdit> &edits)
+    {
+        if (channelCount <= 0 ||
+            static_cast<int64_t>(caches.size()) != channelCount)
+        {
+            return false;
+        }
+        for (const auto &cache : caches)
+        {
+            if (!cache.isLaidOutFor(frameCountBefore))
+            {
+                return false;
+            }
+        }
+
+        stopBuild();
+        for (const auto &edit : edits)
+        {
+            for (auto &cache : caches)
+            {
+                cache.applyErase(edit.frameIndex,
+                                 edit.frameIndex + edit.erasedFrames);
+                cache.applyInsert(edit.frameIndex, edit.insertedFrames);
+            }
+        }
+        return true;
+    }
+
     void DocumentWaveformCaches::invalidateSamples(const int64_t startSample,
                                                    const int64_t endSample)
     {
@@ -353,15 +485,8 @@ namespace cupuacu::waveform
             return false;
         }
 
-        const auto expectedLevel0Size =
-            frameCount <= 0
-                ? 0
-                : (frameCount + gui::WaveformCache::BASE_BLOCK_SIZE - 1) /
-                      gui::WaveformCache::BASE_BLOCK_SIZE;
-        const auto &cache = caches[static_cast<std::size_t>(channel)];
-        return cache.levelsCount() > 0 &&
-               static_cast<int64_t>(cache.getLevelByIndex(0).size()) ==
-                   expectedLevel0Size;
+        return caches[static_cast<std::size_t>(channel)].isLaidOutFor(
+            frameCount);
     }
 
     bool DocumentWaveformCaches::needsBuild(const int64_t frameCount,
@@ -392,16 +517,17 @@ namespace cupuacu::waveform
             return 0;
         }
 
+        // Caches not laid out for the document are built from scratch.
+        const int64_t fullBlockCount =
+            (frameCount + gui::WaveformCache::BASE_BLOCK_SIZE - 1) /
+            gui::WaveformCache::BASE_BLOCK_SIZE;
         int64_t total = 0;
         for (int64_t channel = 0; channel < channelCount; ++channel)
         {
-            auto buildState =
-                caches[static_cast<std::size_t>(channel)].snapshotBuildState();
-            if (!level0SizeMatches(channel, frameCount))
-            {
-                buildState = gui::WaveformCache::makeFullBuildState(frameCount);
-            }
-            total += gui::WaveformCache::dirtyBlockCount(buildState);
+            total += level0SizeMatches(channel, frameCount)
+                         ? caches[static_cast<std::size_t>(channel)]
+                               .dirtyBlockCount()
+                         : fullBlockCount;
         }
 
         return total;
@@ -458,6 +584,15 @@ namespace cupuacu::waveform
             return;
         }
 
+        // The request describes the caches at waveformDataVersion, so the
+        // snapshot has to hold the samples of that version.
+        auto snapshot = document.acquireReadLease();
+        if (snapshot.getWaveformDataVersion() != waveformDataVersion ||
+            snapshot.getFrameCount() != frameCount)
+        {
+            return;
+        }
+
         auto request =
             makeBuildRequest(frameCount, channelCount, waveformDataVersion);
         if (!request.has_value())
@@ -469,7 +604,8 @@ namespace cupuacu::waveform
             .completedBlocks = 0,
             .totalBlocks = totalDirtyBlocks(frameCount, channelCount),
         };
-        buildJob = std::make_unique<BuildJob>(document, std::move(*request));
+        buildJob = std::make_unique<BuildJob>(std::move(snapshot),
+                                              std::move(*request));
         buildJob->start();
     }
 
@@ -487,8 +623,8 @@ namespace cupuacu::waveform
         if (buildJob &&
             buildJob->waveformDataVersion() != waveformDataVersion)
         {
-            // Mutation jobs read directly from the live document, so any
-            // version change invalidates the in-flight build request.
+            // The job reads the snapshot it pinned, so after any version
+            // change its peaks describe samples that are gone.
             stopBuild();
         }
 
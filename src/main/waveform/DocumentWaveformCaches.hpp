@@ -24,6 +24,15 @@ namespace cupuacu::waveform
             int64_t totalBlocks = 0;
         };
 
+        // Frames [frameIndex, frameIndex + erasedFrames) were replaced by
+        // insertedFrames new ones.
+        struct FrameEdit
+        {
+            int64_t frameIndex = 0;
+            int64_t erasedFrames = 0;
+            int64_t insertedFrames = 0;
+        };
+
         DocumentWaveformCaches() = default;
         ~DocumentWaveformCaches();
 
@@ -38,11 +47,20 @@ namespace cupuacu::waveform
         void syncToChannelCount(int64_t channelCount);
         void resetToChannelCount(int64_t channelCount);
 
+        [[nodiscard]] int64_t getCacheCount() const;
         gui::WaveformCache &getCache(int channel);
         const gui::WaveformCache &getCache(int channel) const;
 
         void applyInsert(int64_t frameIndex, int64_t numFrames);
         void applyErase(int64_t frameIndex, int64_t numFrames);
+        // Moves the peaks along with edits, made in order, that took a
+        // document of frameCountBefore frames to its current length, so that
+        // only the peaks around them are built again. Returns false, leaving
+        // the caches as they were, if they were not laid out for that
+        // document.
+        [[nodiscard]] bool applyEdits(int64_t channelCount,
+                                      int64_t frameCountBefore,
+                                      const std::vector<FrameEdit> &edits);
         void invalidateSamples(int64_t startSample, int64_t endSample);
 
         void update(const Document &document, uint64_t waveformDataVersion);
@@ -83,10 +101,15 @@ namespace cupuacu::waveform
             std::vector<ChannelChunk> channelChunks;
         };
 
+        // Level-0 peaks are computed by a pool of workers, a chunk of one
+        // channel at a time. The job's own thread merges the chunks into the
+        // upper levels and publishes them in order, so that the waveform
+        // still fills in from left to right.
         class BuildJob
         {
         public:
-            BuildJob(const Document &documentToRead, BuildRequest requestToUse);
+            BuildJob(Document::ReadLease snapshotToRead,
+                     BuildRequest requestToUse);
             ~BuildJob();
 
             BuildJob(const BuildJob &) = delete;
@@ -102,17 +125,36 @@ namespace cupuacu::waveform
             void cancel();
 
         private:
-            Document document;
+            struct Level0Chunk
+            {
+                std::size_t channel = 0;
+                int64_t fromBlock = 0;
+                int64_t toBlock = -1;
+                std::vector<gui::Peak> peaks;
+                std::vector<gui::BlockEnergy> energies;
+                bool computed = false;
+            };
+
+            // Pinned when the job starts. Edits made while it runs detach
+            // from it instead of copying the samples it reads.
+            Document::ReadLease snapshot;
             BuildRequest request;
             mutable std::mutex mutex;
             std::condition_variable outputCv;
+            std::condition_variable chunkCv;
             bool completed = false;
             BuildProgress progress;
             std::deque<BuildOutput> outputs;
+            std::vector<Level0Chunk> chunks;
+            std::size_t nextUnclaimedChunk = 0;
+            std::size_t nextUnpublishedChunk = 0;
             std::thread worker;
+            std::vector<std::thread> level0Workers;
             std::atomic_bool cancelRequested{false};
 
             void run();
+            void publishChunks();
+            void computeLevel0Chunks();
         };
 
         std::vector<gui::WaveformCache> caches = std::vector<gui::WaveformCache>(2);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace cupuacu::waveform
+{
+    // What a persistent waveform cache file is looked up by.
+    enum class PersistentCacheKeyMode
+    {
+        // The source file's path, size and modification time.
+        SourceFile,
+        // A hash of evenly spaced windows of the decoded samples, so copies,
+        // renames and metadata-only rewrites of a file find the same cache.
+        SampledContent
+    };
+
+    struct PersistentCacheSettings
+    {
+        static constexpr uint64_t DEFAULT_MAX_DIRECTORY_BYTES =
+            uint64_t{2} * 1024 * 1024 * 1024;
+
+        PersistentCacheKeyMode keyMode = PersistentCacheKeyMode::SourceFile;
+        // Least recently used cache files are removed once the cache
+        // directory grows past this. 0 means no limit.
+        uint64_t maxDirectoryBytes = DEFAULT_MAX_DIRECTORY_BYTES;
+
+        bool operator==(const PersistentCacheSettings &) const = default;
+    };
+} // namespace cupuacu::waveform
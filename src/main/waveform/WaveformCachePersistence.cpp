@@ -3,19 +3,34 @@
 #include "../DocumentSession.hpp"
 #include "../file/FileIo.hpp"
 
+#include "../file/MappedFile.hpp"
+
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <chrono>
 #include <cstring>
 #include <fstream>
 #include <limits>
+#include <span>
 #include <system_error>
+#include <vector>
 
 namespace cupuacu::waveform
 {
     namespace
     {
         constexpr char kMagic[] = "CUPUACU_WAVEFORM_CACHE";
-        constexpr uint32_t kStorageVersion = 1;
+        constexpr char kCacheExtension[] = ".cupuacu-waveform-cache";
+        constexpr uint32_t kStorageVersion = 4;
+        constexpr std::size_t kPeakAlignment = 64;
+        constexpr std::size_t kLevelTableEntrySize =
+            2 * sizeof(uint64_t) + sizeof(int64_t);
+        static_assert(sizeof(gui::Peak) == 2 * sizeof(float));
+        static_assert(sizeof(gui::BlockEnergy) ==
+                      sizeof(float) + sizeof(uint32_t));
+        constexpr int64_t kSampledContentWindowCount = 64;
+        constexpr int64_t kSampledContentWindowFrames = 4096;
         constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
         constexpr uint64_t kFnvPrime = 1099511628211ull;
 
@@ -155,15 +170,6 @@ namespace cupuacu::waveform
             return static_cast<int64_t>(readU64(input));
         }
 
-        float readFloat(std::istream &input)
-        {
-            const uint32_t bits = readU32(input);
-            float value = 0.0f;
-            static_assert(sizeof(bits) == sizeof(value));
-            std::memcpy(&value, &bits, sizeof(value));
-            return value;
-        }
-
         std::string readString(std::istream &input)
         {
             const uint32_t size = readU32(input);
@@ -182,6 +188,7 @@ namespace cupuacu::waveform
             writeString(output, key.sourcePath);
             writeU64(output, key.sourceFileSize);
             writeI64(output, key.sourceLastWriteTimeNs);
+            writeU64(output, key.sampledContentHash);
             writeU32(output, static_cast<uint32_t>(key.sampleFormat));
             writeU32(output, static_cast<uint32_t>(key.sampleRate));
             writeI64(output, key.channelCount);
@@ -194,6 +201,7 @@ namespace cupuacu::waveform
                 .sourcePath = readString(input),
                 .sourceFileSize = readU64(input),
                 .sourceLastWriteTimeNs = readI64(input),
+                .sampledContentHash = readU64(input),
                 .sampleFormat = static_cast<SampleFormat>(readU32(input)),
                 .sampleRate = static_cast<int>(readU32(input)),
                 .channelCount = readI64(input),
@@ -201,23 +209,29 @@ namespace cupuacu::waveform
             };
         }
 
-        bool cacheStateIsComplete(const gui::WaveformCache::BuildState &state,
-                                  const int64_t frameCount)
+        // Where a level's peaks, and the energies beside them, sit in the
+        // cache file.
+        struct LevelTableEntry
         {
-            if (state.numSamples != frameCount || state.dirtyToBlock >= state.dirtyFromBlock)
-            {
-                return false;
-            }
-            if (frameCount <= 0)
-            {
-                return false;
-            }
-            const int64_t expectedLevel0Size =
-                (frameCount + gui::WaveformCache::BASE_BLOCK_SIZE - 1) /
-                gui::WaveformCache::BASE_BLOCK_SIZE;
-            return !state.levels.empty() &&
-                   static_cast<int64_t>(state.levels.front().size()) ==
-                       expectedLevel0Size;
+            uint64_t offset = 0;
+            int64_t peakCount = 0;
+            uint64_t energyOffset = 0;
+        };
+
+        std::size_t alignPeakOffset(const std::size_t offset)
+        {
+            return (offset + kPeakAlignment - 1) / kPeakAlignment *
+                   kPeakAlignment;
+        }
+
+        bool cacheIsComplete(const gui::WaveformCache &cache,
+                             const int64_t frameCount)
+        {
+            // Edits leave gaps in the layout, and only plain layouts are
+            // worth keeping for the file as it is on disk.
+            return frameCount > 0 && cache.isLaidOutFor(frameCount) &&
+                   !cache.hasDirtyBlocks() &&
+                   cache.getFrameLayout().isIdentity();
         }
 
         bool sessionHasCompletePersistentCache(
@@ -234,9 +248,9 @@ namespace cupuacu::waveform
             for (int64_t channel = 0; channel < session.document.getChannelCount();
                  ++channel)
             {
-                const auto state = session.getWaveformCache(
-                    static_cast<int>(channel)).snapshotBuildState();
-                if (!cacheStateIsComplete(state, frameCount))
+                if (!cacheIsComplete(
+                        session.getWaveformCache(static_cast<int>(channel)),
+                        frameCount))
                 {
                     return false;
                 }
@@ -245,6 +259,56 @@ namespace cupuacu::waveform
             return true;
         }
 
+        void writePeaks(std::ostream &output,
+                        const std::span<const gui::Peak> peaks)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                output.write(reinterpret_cast<const char *>(peaks.data()),
+                             static_cast<std::streamsize>(peaks.size_bytes()));
+            }
+            else
+            {
+                for (const auto &peak : peaks)
+                {
+                    writeFloat(output, peak.min);
+                    writeFloat(output, peak.max);
+                }
+            }
+        }
+
+        void writeEnergies(std::ostream &output,
+                           const std::span<const gui::BlockEnergy> energies)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                output.write(
+                    reinterpret_cast<const char *>(energies.data()),
+                    static_cast<std::streamsize>(energies.size_bytes()));
+            }
+            else
+            {
+                for (const auto &energy : energies)
+                {
+                    writeFloat(output, energy.sumOfSquares);
+                    writeU32(output, energy.clipCount);
+                }
+            }
+        }
+
+        void writePadding(std::ostream &output)
+        {
+            const auto position = static_cast<std::size_t>(output.tellp());
+            const std::array<char, kPeakAlignment> zeros{};
+            output.write(zeros.data(),
+                         static_cast<std::streamsize>(
+                             alignPeakOffset(position) - position));
+        }
+
+        // The header, key and level tables come first. Each level's peaks
+        // follow as little-endian float pairs, and then its energies as a
+        // little-endian float and uint32_t each, all starting at multiples
+        // of kPeakAlignment so that a mapped file can be read in place.
         void writeCacheFile(const std::filesystem::path &path,
                             const cupuacu::DocumentSession &session,
                             const PersistentCacheKey &key)
@@ -255,28 +319,53 @@ namespace cupuacu::waveform
                 throw std::runtime_error("Failed to open waveform cache");
             }
 
+            const auto channelCount = session.document.getChannelCount();
             output.write(kMagic, sizeof(kMagic));
             writeU32(output, kStorageVersion);
             writePersistentCacheKey(output, key);
-            writeI64(output, session.document.getChannelCount());
+            writeI64(output, channelCount);
 
-            for (int64_t channel = 0; channel < session.document.getChannelCount();
-                 ++channel)
+            std::size_t tablesSize = 0;
+            for (int64_t channel = 0; channel < channelCount; ++channel)
+            {
+                const auto &cache =
+                    session.getWaveformCache(static_cast<int>(channel));
+                tablesSize += sizeof(uint32_t) +
+                              static_cast<std::size_t>(cache.levelsCount()) *
+                                  kLevelTableEntrySize;
+            }
+
+            auto offset = alignPeakOffset(
+                static_cast<std::size_t>(output.tellp()) + tablesSize);
+            for (int64_t channel = 0; channel < channelCount; ++channel)
             {
-                const auto state = session.getWaveformCache(
-                    static_cast<int>(channel)).snapshotBuildState();
-                writeI64(output, state.numSamples);
-                writeI64(output, state.dirtyFromBlock);
-                writeI64(output, state.dirtyToBlock);
-                writeU32(output, static_cast<uint32_t>(state.levels.size()));
-                for (const auto &level : state.levels)
+                const auto &cache =
+                    session.getWaveformCache(static_cast<int>(channel));
+                writeU32(output, static_cast<uint32_t>(cache.levelsCount()));
+                for (int level = 0; level < cache.levelsCount(); ++level)
                 {
-                    writeI64(output, static_cast<int64_t>(level.size()));
-                    for (const auto &peak : level)
-                    {
-                        writeFloat(output, peak.min);
-                        writeFloat(output, peak.max);
-                    }
+                    const auto peaks = cache.getLevelByIndex(level);
+                    const auto energies = cache.getEnergyLevelByIndex(level);
+                    const auto energyOffset =
+                        alignPeakOffset(offset + peaks.size_bytes());
+                    writeU64(output, offset);
+                    writeI64(output, static_cast<int64_t>(peaks.size()));
+                    writeU64(output, energyOffset);
+                    offset =
+                        alignPeakOffset(energyOffset + energies.size_bytes());
+                }
+            }
+
+            for (int64_t channel = 0; channel < channelCount; ++channel)
+            {
+                const auto &cache =
+                    session.getWaveformCache(static_cast<int>(channel));
+                for (int level = 0; level < cache.levelsCount(); ++level)
+                {
+                    writePadding(output);
+                    writePeaks(output, cache.getLevelByIndex(level));
+                    writePadding(output);
+                    writeEnergies(output, cache.getEnergyLevelByIndex(level));
                 }
             }
 
@@ -286,45 +375,94 @@ namespace cupuacu::waveform
             }
         }
 
-        std::vector<gui::WaveformCache::BuildResult>
-        readCacheResults(std::istream &input, const int64_t channelCount)
+        std::vector<std::vector<LevelTableEntry>>
+        readLevelTables(std::istream &input, const int64_t channelCount,
+                        const int64_t frameCount, const std::size_t fileSize)
         {
-            if (channelCount < 0)
-            {
-                throw std::runtime_error("Invalid waveform cache channel count");
-            }
+            const auto expectedSizes =
+                gui::WaveformCache::levelSizesFor(frameCount);
 
-            std::vector<gui::WaveformCache::BuildResult> results;
-            results.reserve(static_cast<std::size_t>(channelCount));
+            std::vector<std::vector<LevelTableEntry>> tables;
+            tables.reserve(static_cast<std::size_t>(channelCount));
             for (int64_t channel = 0; channel < channelCount; ++channel)
             {
-                gui::WaveformCache::BuildResult result;
-                result.numSamples = readI64(input);
-                result.dirtyFromBlock = readI64(input);
-                result.dirtyToBlock = readI64(input);
                 const auto levelCount = readU32(input);
-                result.levels.resize(levelCount);
-                for (uint32_t levelIndex = 0; levelIndex < levelCount; ++levelIndex)
+                if (levelCount != expectedSizes.size())
+                {
+                    throw std::runtime_error(
+                        "Invalid waveform cache level count");
+                }
+
+                auto &table = tables.emplace_back(levelCount);
+                for (uint32_t level = 0; level < levelCount; ++level)
                 {
-                    const auto peakCount = readI64(input);
-                    if (peakCount < 0)
+                    auto &entry = table[level];
+                    entry.offset = readU64(input);
+                    entry.peakCount = readI64(input);
+                    entry.energyOffset = readU64(input);
+                    const auto fits = [&](const uint64_t offset,
+                                          const std::size_t nodeSize)
                     {
-                        throw std::runtime_error("Invalid waveform cache level size");
-                    }
-                    auto &level = result.levels[static_cast<std::size_t>(levelIndex)];
-                    level.resize(static_cast<std::size_t>(peakCount));
-                    for (int64_t peakIndex = 0; peakIndex < peakCount; ++peakIndex)
+                        return offset % kPeakAlignment == 0 &&
+                               offset <= fileSize &&
+                               static_cast<uint64_t>(entry.peakCount) *
+                                       nodeSize <=
+                                   fileSize - offset;
+                    };
+                    if (entry.peakCount != expectedSizes[level] ||
+                        !fits(entry.offset, sizeof(gui::Peak)) ||
+                        !fits(entry.energyOffset, sizeof(gui::BlockEnergy)))
                     {
-                        level[static_cast<std::size_t>(peakIndex)] = {
-                            .min = readFloat(input),
-                            .max = readFloat(input),
-                        };
+                        throw std::runtime_error(
+                            "Invalid waveform cache level table");
                     }
                 }
-                results.push_back(std::move(result));
             }
 
-            return results;
+            return tables;
+        }
+
+        uint32_t decodeU32(const std::byte *&bytes)
+        {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                value |= static_cast<uint32_t>(*bytes++) << shift;
+            }
+            return value;
+        }
+
+        float decodeFloat(const std::byte *&bytes)
+        {
+            const uint32_t bits = decodeU32(bytes);
+            float value = 0.0f;
+            std::memcpy(&value, &bits, sizeof(bits));
+            return value;
+        }
+
+        std::vector<gui::Peak> decodePeaks(const std::byte *bytes,
+                                      const int64_t peakCount)
+        {
+            std::vector<gui::Peak> peaks(static_cast<std::size_t>(peakCount));
+            for (auto &peak : peaks)
+            {
+                peak.min = decodeFloat(bytes);
+                peak.max = decodeFloat(bytes);
+            }
+            return peaks;
+        }
+
+        std::vector<gui::BlockEnergy> decodeEnergies(const std::byte *bytes,
+                                                     const int64_t count)
+        {
+            std::vector<gui::BlockEnergy> energies(
+                static_cast<std::size_t>(count));
+            for (auto &energy : energies)
+            {
+                energy.sumOfSquares = decodeFloat(bytes);
+                energy.clipCount = decodeU32(bytes);
+            }
+            return energies;
         }
     } // namespace
 
@@ -335,11 +473,12 @@ namespace cupuacu::waveform
         hashString(hash, sourcePath);
         hashValue(hash, sourceFileSize);
         hashValue(hash, sourceLastWriteTimeNs);
+        hashValue(hash, sampledContentHash);
         hashValue(hash, sampleFormat);
         hashValue(hash, sampleRate);
         hashValue(hash, channelCount);
         hashValue(hash, frameCount);
-        return hex64(hash) + ".cupuacu-waveform-cache";
+        return hex64(hash) + kCacheExtension;
     }
 
     std::filesystem::path
@@ -350,7 +489,8 @@ namespace cupuacu::waveform
 
     std::optional<PersistentCacheKey>
     makePersistentCacheKey(const std::string &sourceFilePath,
-                           const Document &document)
+                           const Document &document,
+                           const PersistentCacheKeyMode keyMode)
     {
         if (sourceFilePath.empty() || document.getChannelCount() <= 0 ||
             document.getFrameCount() <= 0)
@@ -365,6 +505,17 @@ namespace cupuacu::waveform
             return std::nullopt;
         }
 
+        if (keyMode == PersistentCacheKeyMode::SampledContent)
+        {
+            return PersistentCacheKey{
+                .sampledContentHash = computeSampledContentHash(document),
+                .sampleFormat = document.getSampleFormat(),
+                .sampleRate = document.getSampleRate(),
+                .channelCount = document.getChannelCount(),
+                .frameCount = document.getFrameCount(),
+            };
+        }
+
         const auto normalizedPath = normalizeExistingPath(sourcePath);
         if (!normalizedPath.has_value())
         {
@@ -399,52 +550,181 @@ namespace cupuacu::waveform
         };
     }
 
+    uint64_t computeSampledContentHash(const Document &document)
+    {
+        const auto lease = document.acquireReadLease();
+        const int64_t channelCount = lease.getChannelCount();
+        const int64_t frameCount = lease.getFrameCount();
+
+        uint64_t hash = kFnvOffsetBasis;
+        hashValue(hash, channelCount);
+        hashValue(hash, frameCount);
+
+        if (channelCount <= 0 || frameCount <= 0)
+        {
+            return hash;
+        }
+
+        // Short documents are hashed whole. Longer ones are hashed in
+        // windows spread evenly from their first frame to their last.
+        const bool hashWholeDocument =
+            frameCount <= kSampledContentWindowCount *
+                              kSampledContentWindowFrames;
+        const int64_t windowCount =
+            hashWholeDocument ? (frameCount + kSampledContentWindowFrames - 1) /
+                                    kSampledContentWindowFrames
+                              : kSampledContentWindowCount;
+        std::vector<float> window(
+            static_cast<std::size_t>(kSampledContentWindowFrames));
+
+        for (int64_t windowIndex = 0; windowIndex < windowCount; ++windowIndex)
+        {
+            const int64_t startFrame =
+                hashWholeDocument
+                    ? windowIndex * kSampledContentWindowFrames
+                    : (frameCount - kSampledContentWindowFrames) *
+                          windowIndex / (kSampledContentWindowCount - 1);
+            const int64_t windowFrames = std::min(
+                kSampledContentWindowFrames, frameCount - startFrame);
+            for (int64_t channel = 0; channel < channelCount; ++channel)
+            {
+                const int64_t framesRead = lease.readFrames(
+                    channel, startFrame, window.data(), windowFrames);
+                hashBytes(hash, window.data(),
+                          static_cast<std::size_t>(
+                              std::max<int64_t>(0, framesRead)) *
+                              sizeof(float));
+            }
+        }
+
+        return hash;
+    }
+
+    uint64_t evictPersistentWaveformCaches(
+        const std::filesystem::path &cacheRoot,
+        const uint64_t maxDirectoryBytes,
+        const std::filesystem::path &keptPath)
+    {
+        struct CacheFile
+        {
+            std::filesystem::path path;
+            uint64_t size = 0;
+            std::filesystem::file_time_type lastUsed;
+        };
+
+        std::error_code ec;
+        std::vector<CacheFile> cacheFiles;
+        uint64_t totalSize = 0;
+        for (std::filesystem::directory_iterator it(cacheRoot, ec), end;
+             !ec && it != end; it.increment(ec))
+        {
+            std::error_code entryEc;
+            if (!it->is_regular_file(entryEc) ||
+                it->path().extension() != kCacheExtension)
+            {
+                continue;
+            }
+
+            CacheFile cacheFile{.path = it->path()};
+            cacheFile.size = it->file_size(entryEc);
+            if (entryEc)
+            {
+                continue;
+            }
+            cacheFile.lastUsed = it->last_write_time(entryEc);
+            if (entryEc)
+            {
+                continue;
+            }
+            totalSize += cacheFile.size;
+            cacheFiles.push_back(std::move(cacheFile));
+        }
+
+        std::sort(cacheFiles.begin(), cacheFiles.end(),
+                  [](const CacheFile &a, const CacheFile &b)
+                  { return a.lastUsed < b.lastUsed; });
+
+        uint64_t removedSize = 0;
+        for (const auto &cacheFile : cacheFiles)
+        {
+            if (totalSize - removedSize <= maxDirectoryBytes)
+            {
+                break;
+            }
+            if (!keptPath.empty() && cacheFile.path == keptPath)
+            {
+                continue;
+            }
+
+            std::error_code removeEc;
+            if (std::filesystem::remove(cacheFile.path, removeEc))
+            {
+                removedSize += cacheFile.size;
+            }
+        }
+
+        return removedSize;
+    }
+
     bool savePersistentWaveformCache(
         const cupuacu::DocumentSession &session,
-        const std::filesystem::path &cacheRoot)
+        const std::filesystem::path &cacheRoot,
+        const PersistentCacheSettings &settings)
     {
-        const auto key = session.getPersistentWaveformCacheKey();
+        const auto key =
+            session.getPersistentWaveformCacheKey(settings.keyMode);
         if (!key.has_value() || !sessionHasCompletePersistentCache(session))
         {
             return false;
         }
 
+        const auto cachePath = cacheRoot / key->cacheBasename();
         try
         {
             cupuacu::file::writeFileAtomically(
-                cacheRoot / key->cacheBasename(),
+                cachePath,
                 [&](const std::filesystem::path &temporaryPath)
                 {
                     writeCacheFile(temporaryPath, session, *key);
                 });
-            return true;
         }
         catch (...)
         {
             return false;
         }
+
+        if (settings.maxDirectoryBytes > 0)
+        {
+            (void)evictPersistentWaveformCaches(
+                cacheRoot, settings.maxDirectoryBytes, cachePath);
+        }
+        return true;
     }
 
     bool savePersistentWaveformCache(const cupuacu::DocumentSession &session,
-                                     const Paths &paths)
+                                     const Paths &paths,
+                                     const PersistentCacheSettings &settings)
     {
-        return savePersistentWaveformCache(session, paths.waveformCachePath());
+        return savePersistentWaveformCache(session, paths.waveformCachePath(),
+                                           settings);
     }
 
     bool loadPersistentWaveformCache(
         cupuacu::DocumentSession &session,
-        const std::filesystem::path &cacheRoot)
+        const std::filesystem::path &cacheRoot,
+        const PersistentCacheSettings &settings)
     {
-        const auto key = session.getPersistentWaveformCacheKey();
+        const auto key =
+            session.getPersistentWaveformCacheKey(settings.keyMode);
         if (!key.has_value())
         {
             return false;
         }
 
+        const auto cachePath = cacheRoot / key->cacheBasename();
         try
         {
-            std::ifstream input(cacheRoot / key->cacheBasename(),
-                                std::ios::binary);
+            std::ifstream input(cachePath, std::ios::binary);
             if (!input.is_open())
             {
                 return false;
@@ -472,32 +752,76 @@ namespace cupuacu::waveform
                 return false;
             }
 
-            auto results = readCacheResults(input, channelCount);
-            if (!input)
-            {
-                return false;
-            }
+            // The peaks are used where they are in the mapped file. Levels
+            // the view never zooms into are never paged in.
+            const auto mappedFile = cupuacu::file::MappedFile::open(cachePath);
+            const auto bytes = mappedFile->bytes();
+            const auto frameCount = session.document.getFrameCount();
+            const auto tables =
+                readLevelTables(input, channelCount, frameCount, bytes.size());
 
             session.stopWaveformCacheBuild();
             session.waveformCaches.resetToChannelCount(channelCount);
             for (int64_t channel = 0; channel < channelCount; ++channel)
             {
-                session.getWaveformCache(static_cast<int>(channel))
-                    .applyBuildResult(std::move(
-                        results[static_cast<std::size_t>(channel)]));
+                auto &cache =
+                    session.getWaveformCache(static_cast<int>(channel));
+                const auto &table = tables[static_cast<std::size_t>(channel)];
+                if constexpr (std::endian::native == std::endian::little)
+                {
+                    gui::WaveformCache::MappedLevels mapped{.storage =
+                                                                mappedFile};
+                    for (const auto &entry : table)
+                    {
+                        mapped.levels.emplace_back(
+                            reinterpret_cast<const gui::Peak *>(bytes.data() +
+                                                           entry.offset),
+                            static_cast<std::size_t>(entry.peakCount));
+                        mapped.energyLevels.emplace_back(
+                            reinterpret_cast<const gui::BlockEnergy *>(
+                                bytes.data() + entry.energyOffset),
+                            static_cast<std::size_t>(entry.peakCount));
+                    }
+                    cache.applyMappedLevels(frameCount, std::move(mapped));
+                }
+                else
+                {
+                    gui::WaveformCache::BuildResult result{.numSamples =
+                                                               frameCount};
+                    for (const auto &entry : table)
+                    {
+                        result.levels.push_back(decodePeaks(
+                            bytes.data() + entry.offset, entry.peakCount));
+                        result.energyLevels.push_back(decodeEnergies(
+                            bytes.data() + entry.energyOffset,
+                            entry.peakCount));
+                    }
+                    cache.applyBuildResult(std::move(result));
+                }
             }
 
-            return sessionHasCompletePersistentCache(session);
+            if (!sessionHasCompletePersistentCache(session))
+            {
+                return false;
+            }
         }
         catch (...)
         {
             return false;
         }
+
+        // The modification time doubles as the last use for eviction.
+        std::error_code ec;
+        std::filesystem::last_write_time(
+            cachePath, std::filesystem::file_time_type::clock::now(), ec);
+        return true;
     }
 
     bool loadPersistentWaveformCache(cupuacu::DocumentSession &session,
-                                     const Paths &paths)
+                                     const Paths &paths,
+                                     const PersistentCacheSettings &settings)
     {
-        return loadPersistentWaveformCache(session, paths.waveformCachePath());
+        return loadPersistentWaveformCache(session, paths.waveformCachePath(),
+                                           settings);
     }
 } // namespace cupuacu::waveform
@@ -3,6 +3,7 @@
 #include "../Document.hpp"
 #include "../Paths.hpp"
 #include "../gui/WaveformCache.hpp"
+#include "PersistentCacheSettings.hpp"
 
 #include <cstdint>
 #include <filesystem>
@@ -18,11 +19,14 @@ namespace cupuacu::waveform
 {
     struct PersistentCacheKey
     {
-        static constexpr uint32_t FORMAT_VERSION = 1;
+        static constexpr uint32_t FORMAT_VERSION = 2;
 
+        // Only set for PersistentCacheKeyMode::SourceFile.
         std::string sourcePath;
         uint64_t sourceFileSize = 0;
         int64_t sourceLastWriteTimeNs = 0;
+        // Only set for PersistentCacheKeyMode::SampledContent.
+        uint64_t sampledContentHash = 0;
         SampleFormat sampleFormat = SampleFormat::Unknown;
         int sampleRate = 0;
         int64_t channelCount = 0;
@@ -35,20 +39,39 @@ namespace cupuacu::waveform
     };
 
     [[nodiscard]] std::optional<PersistentCacheKey>
-    makePersistentCacheKey(const std::string &sourceFilePath,
-                           const Document &document);
+    makePersistentCacheKey(
+        const std::string &sourceFilePath, const Document &document,
+        PersistentCacheKeyMode keyMode = PersistentCacheKeyMode::SourceFile);
 
+    // Hashes the document's shape and evenly spaced windows of samples from
+    // every channel, including its first and last frames. Short documents
+    // are hashed whole.
+    [[nodiscard]] uint64_t computeSampledContentHash(const Document &document);
+
+    // Saving also removes the least recently saved or loaded cache files
+    // until the directory fits settings.maxDirectoryBytes.
     [[nodiscard]] bool savePersistentWaveformCache(
-        const cupuacu::DocumentSession &session, const Paths &paths);
+        const cupuacu::DocumentSession &session, const Paths &paths,
+        const PersistentCacheSettings &settings = {});
 
     [[nodiscard]] bool savePersistentWaveformCache(
         const cupuacu::DocumentSession &session,
-        const std::filesystem::path &cacheRoot);
+        const std::filesystem::path &cacheRoot,
+        const PersistentCacheSettings &settings = {});
 
     [[nodiscard]] bool loadPersistentWaveformCache(
-        cupuacu::DocumentSession &session, const Paths &paths);
+        cupuacu::DocumentSession &session, const Paths &paths,
+        const PersistentCacheSettings &settings = {});
 
     [[nodiscard]] bool loadPersistentWaveformCache(
         cupuacu::DocumentSession &session,
-        const std::filesystem::path &cacheRoot);
+        const std::filesystem::path &cacheRoot,
+        const PersistentCacheSettings &settings = {});
+
+    // Removes the least recently used cache files in cacheRoot, other than
+    // keptPath, until the ones left take up at most maxDirectoryBytes.
+    // Returns how many bytes were removed.
+    uint64_t evictPersistentWaveformCaches(
+        const std::filesystem::path &cacheRoot, uint64_t maxDirectoryBytes,
+        const std::filesystem::path &keptPath = {});
 } // namespace cupuacu::waveform
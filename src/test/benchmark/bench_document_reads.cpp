@@ -0,0 +1,98 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "Document.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// One hour of 44.1 kHz stereo float audio is about 1.3 GB. Run with a small
+// sample count, e.g. `cupuacu-benchmarks "[document]" --benchmark-samples 5`.
+
+namespace
+{
+    constexpr int64_t kSampleRate = 44100;
+    constexpr int64_t kChannelCount = 2;
+    constexpr int64_t kFrameCount = kSampleRate * 60 * 60;
+    constexpr int64_t kChunkFrames = 65536;
+
+    void fillDocument(cupuacu::Document &document)
+    {
+        document.initialize(cupuacu::SampleFormat::FLOAT32,
+                            static_cast<int>(kSampleRate),
+                            kChannelCount, kFrameCount);
+        std::vector<float> chunk(static_cast<std::size_t>(kChunkFrames));
+        for (int64_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            for (int64_t start = 0; start < kFrameCount; start += kChunkFrames)
+            {
+                const auto frames = std::min(kChunkFrames, kFrameCount - start);
+                for (int64_t i = 0; i < frames; ++i)
+                {
+                    chunk[static_cast<std::size_t>(i)] =
+                        static_cast<float>((start + i) % 2000) / 1000.0f - 1.0f;
+                }
+                document.writeChannelFloatBlock(channel, start, chunk.data(),
+                                                frames, false);
+            }
+        }
+    }
+} // namespace
+
+TEST_CASE("Document reads of a one hour stereo file", "[document][!benchmark]")
+{
+    cupuacu::Document document;
+    fillDocument(document);
+
+    BENCHMARK("per-sample getSample on a read lease")
+    {
+        const auto lease = document.acquireReadLease();
+        double sum = 0.0;
+        for (int64_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            for (int64_t frame = 0; frame < kFrameCount; ++frame)
+            {
+                sum += lease.getSample(channel, frame);
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("bulk readFrames into a chunk buffer")
+    {
+        const auto lease = document.acquireReadLease();
+        std::vector<float> chunk(static_cast<std::size_t>(kChunkFrames));
+        double sum = 0.0;
+        for (int64_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            for (int64_t start = 0; start < kFrameCount; start += kChunkFrames)
+            {
+                const auto frames = lease.readFrames(channel, start, chunk.data(),
+                                                     kChunkFrames);
+                for (int64_t i = 0; i < frames; ++i)
+                {
+                    sum += chunk[static_cast<std::size_t>(i)];
+                }
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("zero-copy forEachSpan")
+    {
+        const auto lease = document.acquireReadLease();
+        double sum = 0.0;
+        for (int64_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            lease.forEachSpan(channel, 0, kFrameCount,
+                              [&](const std::span<const float> span, int64_t)
+                              {
+                                  for (const float sample : span)
+                                  {
+                                      sum += sample;
+                                  }
+                              });
+        }
+        return sum;
+    };
+}
@@ -0,0 +1,126 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "undo/UndoPayloadCodec.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Encodes and decodes one minute of 44.1 kHz mono audio of three kinds and
+// prints the compression ratio and MB/s of each, followed by Catch2's
+// timings. Run e.g. `cupuacu-benchmarks "[undo]"`.
+
+namespace
+{
+    constexpr std::size_t kFrameCount = 44100 * 60;
+
+    // Music-like material loaded from a 16-bit file: every sample is an
+    // exact PCM code.
+    std::vector<float> makePcm16Channel()
+    {
+        std::mt19937 random(1);
+        std::normal_distribution<double> noise(0.0, 200.0);
+        std::vector<float> samples(kFrameCount);
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            const double t = static_cast<double>(i) / 44100.0;
+            const auto code = std::lround(
+                9000.0 * std::sin(2.0 * 3.14159265358979 * 220.0 * t) +
+                4000.0 * std::sin(2.0 * 3.14159265358979 * 331.0 * t) +
+                noise(random));
+            samples[i] = static_cast<float>(code) / 32768.0f;
+        }
+        return samples;
+    }
+
+    // The same material after a float effect such as a gain change.
+    std::vector<float> makeProcessedChannel()
+    {
+        auto samples = makePcm16Channel();
+        for (auto &sample : samples)
+        {
+            sample *= 0.8317f;
+        }
+        return samples;
+    }
+
+    // A selection that has been silenced.
+    std::vector<float> makeSilentChannel()
+    {
+        return std::vector<float>(kFrameCount, 0.0f);
+    }
+
+    void report(const std::string &label, const std::vector<float> &samples)
+    {
+        const double rawBytes =
+            static_cast<double>(samples.size() * sizeof(float));
+
+        const auto encodeStart = std::chrono::steady_clock::now();
+        const auto encoded =
+            cupuacu::undo::encodeSamples(samples.data(), samples.size());
+        const std::chrono::duration<double> encodeTime =
+            std::chrono::steady_clock::now() - encodeStart;
+
+        std::vector<float> decoded(samples.size());
+        const auto decodeStart = std::chrono::steady_clock::now();
+        cupuacu::undo::decodeSamples(encoded.data(), encoded.size(),
+                                     decoded.data(), decoded.size());
+        const std::chrono::duration<double> decodeTime =
+            std::chrono::steady_clock::now() - decodeStart;
+
+        const double megabytes = rawBytes / (1024.0 * 1024.0);
+        std::cout << label << ": ratio "
+                  << rawBytes / static_cast<double>(encoded.size())
+                  << ", encode " << megabytes / encodeTime.count()
+                  << " MB/s, decode " << megabytes / decodeTime.count()
+                  << " MB/s\n";
+        REQUIRE(decoded == samples);
+    }
+} // namespace
+
+TEST_CASE("Undo payload codec ratio and throughput", "[undo][!benchmark]")
+{
+    const auto pcm16 = makePcm16Channel();
+    const auto processed = makeProcessedChannel();
+    const auto silent = makeSilentChannel();
+
+    report("16-bit PCM codes", pcm16);
+    report("processed float", processed);
+    report("silence", silent);
+
+    BENCHMARK("encode 16-bit PCM codes")
+    {
+        return cupuacu::undo::encodeSamples(pcm16.data(), pcm16.size());
+    };
+
+    BENCHMARK("encode processed float")
+    {
+        return cupuacu::undo::encodeSamples(processed.data(), processed.size());
+    };
+
+    const auto encodedPcm16 =
+        cupuacu::undo::encodeSamples(pcm16.data(), pcm16.size());
+    const auto encodedProcessed =
+        cupuacu::undo::encodeSamples(processed.data(), processed.size());
+    std::vector<float> decoded(kFrameCount);
+
+    BENCHMARK("decode 16-bit PCM codes")
+    {
+        cupuacu::undo::decodeSamples(encodedPcm16.data(), encodedPcm16.size(),
+                                     decoded.data(), decoded.size());
+        return decoded[0];
+    };
+
+    BENCHMARK("decode processed float")
+    {
+        cupuacu::undo::decodeSamples(encodedProcessed.data(),
+                                     encodedProcessed.size(), decoded.data(),
+                                     decoded.size());
+        return decoded[0];
+    };
+}
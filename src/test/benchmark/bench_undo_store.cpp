@@ -0,0 +1,124 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "undo/UndoStore.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Each payload holds one minute of 44.1 kHz stereo float audio (about
+// 21 MB). Besides Catch2's timings, one timed round trip per payload kind is
+// printed as MB/s. Run e.g. `cupuacu-benchmarks "[undo]"`.
+
+namespace
+{
+    constexpr std::size_t kFrameCount = 44100 * 60;
+    constexpr std::size_t kChannelCount = 2;
+
+    std::vector<std::vector<float>> makeChannels()
+    {
+        std::vector<std::vector<float>> channels(kChannelCount);
+        for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+        {
+            channels[channel].resize(kFrameCount);
+            for (std::size_t frame = 0; frame < kFrameCount; ++frame)
+            {
+                channels[channel][frame] =
+                    static_cast<float>((frame + channel * 7) % 2000) / 1000.0f -
+                    1.0f;
+            }
+        }
+        return channels;
+    }
+
+    void reportThroughput(const std::string &label, const double bytes,
+                          const std::function<void()> &operation)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        operation();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << label << ": "
+                  << bytes / (1024.0 * 1024.0) / elapsed.count() << " MB/s\n";
+    }
+} // namespace
+
+TEST_CASE("Undo store payload throughput", "[undo][!benchmark]")
+{
+    const auto root = std::filesystem::temp_directory_path() /
+                      "cupuacu-undo-store-benchmark";
+    cupuacu::undo::UndoStore store;
+    store.attach(root);
+
+    const auto channels = makeChannels();
+    const double payloadBytes =
+        static_cast<double>(kFrameCount * kChannelCount * sizeof(float));
+
+    cupuacu::Document::AudioSegment segment{};
+    segment.format = cupuacu::SampleFormat::PCM_S16;
+    segment.sampleRate = 44100;
+    segment.channelCount = static_cast<int64_t>(kChannelCount);
+    segment.frameCount = static_cast<int64_t>(kFrameCount);
+    segment.samples = channels;
+    segment.dirty.resize(kChannelCount);
+    segment.provenance.assign(
+        kChannelCount, {{.startFrame = 0,
+                         .endFrameExclusive = static_cast<int64_t>(kFrameCount),
+                         .sourceId = 1,
+                         .sourceStartFrame = 0}});
+
+    const std::vector<std::vector<std::vector<float>>> cube{channels};
+
+    cupuacu::undo::UndoStore::SegmentHandle segmentHandle;
+    cupuacu::undo::UndoStore::SampleMatrixHandle matrixHandle;
+    cupuacu::undo::UndoStore::SampleCubeHandle cubeHandle;
+    reportThroughput("segment write", payloadBytes,
+                     [&] { segmentHandle = store.writeSegment(segment); });
+    reportThroughput("segment read", payloadBytes,
+                     [&] { (void)store.readSegment(segmentHandle); });
+    reportThroughput("sample matrix write", payloadBytes,
+                     [&] { matrixHandle = store.writeSampleMatrix(channels); });
+    reportThroughput("sample matrix read", payloadBytes,
+                     [&] { (void)store.readSampleMatrix(matrixHandle); });
+    reportThroughput("sample cube write", payloadBytes,
+                     [&] { cubeHandle = store.writeSampleCube(cube); });
+    reportThroughput("sample cube read", payloadBytes,
+                     [&] { (void)store.readSampleCube(cubeHandle); });
+
+    BENCHMARK("write segment")
+    {
+        return store.writeSegment(segment);
+    };
+
+    BENCHMARK("read segment")
+    {
+        return store.readSegment(segmentHandle).frameCount;
+    };
+
+    BENCHMARK("write sample matrix")
+    {
+        return store.writeSampleMatrix(channels);
+    };
+
+    BENCHMARK("read sample matrix")
+    {
+        return store.readSampleMatrix(matrixHandle).size();
+    };
+
+    BENCHMARK("write sample cube")
+    {
+        return store.writeSampleCube(cube);
+    };
+
+    BENCHMARK("read sample cube")
+    {
+        return store.readSampleCube(cubeHandle).size();
+    };
+
+    store.clear();
+}
@@ -0,0 +1,145 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "gui/WaveformCache.hpp"
+#include "gui/WaveformPeakKernels.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Reduces ten minutes of 44.1 kHz mono audio to level-0 peaks and folds them
+// into the coarser levels with each kernel set the CPU supports, printing
+// samples/s next to the scalar kernels', followed by Catch2's timings. Run
+// e.g. `cupuacu-benchmarks "[waveform]"`.
+
+namespace
+{
+    using cupuacu::gui::Peak;
+    using cupuacu::gui::PeakKernelSet;
+    using cupuacu::gui::WaveformCache;
+
+    constexpr int64_t kFrameCount = 44100 * 60 * 10;
+    constexpr int kRepetitions = 10;
+
+    std::vector<float> makeChannel()
+    {
+        std::mt19937 random(1);
+        std::normal_distribution<float> noise(0.0f, 0.05f);
+        std::vector<float> samples(static_cast<std::size_t>(kFrameCount));
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            const double t = static_cast<double>(i) / 44100.0;
+            samples[i] = static_cast<float>(
+                             0.5 * std::sin(2.0 * 3.14159265358979 * 220.0 * t)) +
+                         noise(random);
+        }
+        return samples;
+    }
+
+    int64_t blockCount()
+    {
+        return (kFrameCount + WaveformCache::BASE_BLOCK_SIZE - 1) /
+               WaveformCache::BASE_BLOCK_SIZE;
+    }
+
+    // Level 0 and the folds above it, as WaveformCache builds them.
+    void buildPyramid(const PeakKernelSet kernelSet, const float *samples,
+                      std::vector<std::vector<Peak>> &levels)
+    {
+        cupuacu::gui::computeBlockPeaks(kernelSet, samples, kFrameCount,
+                                        WaveformCache::BASE_BLOCK_SIZE,
+                                        levels[0].data());
+        for (std::size_t level = 1; level < levels.size(); ++level)
+        {
+            cupuacu::gui::foldPeaks(
+                kernelSet, levels[level - 1].data(),
+                static_cast<int64_t>(levels[level - 1].size()),
+                levels[level].data());
+        }
+    }
+
+    std::vector<std::vector<Peak>> makeLevels()
+    {
+        std::vector<std::vector<Peak>> levels;
+        int64_t size = blockCount();
+        while (static_cast<int>(levels.size()) <
+               WaveformCache::MAX_LEVEL_COUNT)
+        {
+            levels.emplace_back(static_cast<std::size_t>(size));
+            if (size <= 1)
+            {
+                break;
+            }
+            size = (size + 1) / 2;
+        }
+        return levels;
+    }
+
+    double samplesPerSecond(const PeakKernelSet kernelSet,
+                            const std::vector<float> &samples,
+                            std::vector<std::vector<Peak>> &levels)
+    {
+        buildPyramid(kernelSet, samples.data(), levels);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepetitions; ++i)
+        {
+            buildPyramid(kernelSet, samples.data(), levels);
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return static_cast<double>(kFrameCount) * kRepetitions /
+               elapsed.count();
+    }
+} // namespace
+
+TEST_CASE("Waveform peak kernel throughput", "[waveform][!benchmark]")
+{
+    const auto samples = makeChannel();
+    auto scalarLevels = makeLevels();
+    const double scalarRate =
+        samplesPerSecond(PeakKernelSet::Scalar, samples, scalarLevels);
+    std::cout << "scalar: " << scalarRate / 1.0e6 << " Msamples/s\n";
+
+    for (const auto kernelSet :
+         {PeakKernelSet::Sse2, PeakKernelSet::Avx2, PeakKernelSet::Neon})
+    {
+        if (!cupuacu::gui::isPeakKernelSetSupported(kernelSet))
+        {
+            continue;
+        }
+
+        auto levels = makeLevels();
+        const double rate = samplesPerSecond(kernelSet, samples, levels);
+        std::cout << cupuacu::gui::peakKernelSetName(kernelSet) << ": "
+                  << rate / 1.0e6 << " Msamples/s, " << rate / scalarRate
+                  << "x scalar\n";
+        for (std::size_t level = 0; level < levels.size(); ++level)
+        {
+            REQUIRE(levels[level].size() == scalarLevels[level].size());
+            for (std::size_t i = 0; i < levels[level].size(); ++i)
+            {
+                REQUIRE(levels[level][i].min == scalarLevels[level][i].min);
+                REQUIRE(levels[level][i].max == scalarLevels[level][i].max);
+            }
+        }
+    }
+
+    auto levels = makeLevels();
+
+    BENCHMARK("scalar peak pyramid")
+    {
+        buildPyramid(PeakKernelSet::Scalar, samples.data(), levels);
+        return levels.back().front().max;
+    };
+
+    BENCHMARK("active peak pyramid")
+    {
+        buildPyramid(cupuacu::gui::activePeakKernelSet(), samples.data(),
+                     levels);
+        return levels.back().front().max;
+    };
+}
@@ -0,0 +1,128 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "gui/WaveformPeakKernels.hpp"
+#include "gui/WaveformSmoothReconstruction.hpp"
+#include "gui/WaveformSmoothRenderPlanning.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Works out the smooth mode values of a 3840 pixel wide view at 10 pixels per
+// frame with the natural spline smooth mode used to draw and with the
+// windowed-sinc reconstruction that replaced it, per kernel set the CPU
+// supports, printing frames/s, followed by Catch2's timings. Run e.g.
+// `cupuacu-benchmarks "[waveform]"`.
+
+namespace
+{
+    using cupuacu::gui::PeakKernelSet;
+
+    constexpr int kWidth = 3840;
+    constexpr double kSamplesPerPixel = 0.1;
+    constexpr int64_t kFrameCount = 44100;
+    constexpr int64_t kSampleOffset = 20000;
+    constexpr int kRepetitions = 200;
+
+    std::vector<float> makeChannel()
+    {
+        std::vector<float> samples(static_cast<std::size_t>(kFrameCount));
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            const double t = static_cast<double>(i) / 44100.0;
+            samples[i] = static_cast<float>(
+                0.5 * std::sin(2.0 * 3.14159265358979 * 3000.0 * t));
+        }
+        return samples;
+    }
+
+    float splineFrame(const std::vector<float> &samples)
+    {
+        const auto input = cupuacu::gui::planWaveformSmoothRenderInput(
+            kWidth, kSamplesPerPixel, kSampleOffset, 0.5 / kSamplesPerPixel,
+            kFrameCount,
+            [&](const int64_t sampleIndex)
+            { return samples[static_cast<std::size_t>(sampleIndex)]; });
+        return cupuacu::gui::evaluateWaveformSmoothSpline(input).back();
+    }
+
+    float reconstructedFrame(cupuacu::gui::WaveformSmoothReconstructor &
+                                 reconstructor,
+                             const std::vector<float> &samples)
+    {
+        return reconstructor
+            .reconstruct(kWidth, kSamplesPerPixel, kSampleOffset, kFrameCount,
+                         [&](const int64_t startFrame, float *destination,
+                             const int64_t frameCount)
+                         {
+                             std::copy_n(samples.begin() + startFrame,
+                                         frameCount, destination);
+                             return frameCount;
+                         })
+            .back();
+    }
+
+    template <typename Frame> double framesPerSecond(Frame &&frame)
+    {
+        volatile float sink = frame();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRepetitions; ++i)
+        {
+            sink = frame();
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        (void)sink;
+        return kRepetitions / elapsed.count();
+    }
+} // namespace
+
+TEST_CASE("Waveform smooth reconstruction throughput",
+          "[waveform][!benchmark]")
+{
+    const auto samples = makeChannel();
+    const double splineRate =
+        framesPerSecond([&] { return splineFrame(samples); });
+    std::cout << "natural spline: " << splineRate << " frames/s\n";
+
+    const auto window = cupuacu::gui::planWaveformSmoothSampleWindow(
+        kWidth, kSamplesPerPixel, kSampleOffset, kFrameCount);
+    REQUIRE(window.pixelCount == kWidth + 1);
+    std::vector<float> values(static_cast<std::size_t>(window.pixelCount));
+    for (const auto kernelSet : {PeakKernelSet::Scalar, PeakKernelSet::Sse2,
+                                 PeakKernelSet::Avx2, PeakKernelSet::Neon})
+    {
+        if (!cupuacu::gui::isPeakKernelSetSupported(kernelSet))
+        {
+            continue;
+        }
+
+        const double rate = framesPerSecond(
+            [&]
+            {
+                cupuacu::gui::reconstructSmoothWaveform(
+                    kernelSet, samples.data() + window.firstFrame, window,
+                    kSamplesPerPixel, kSampleOffset, values.data());
+                return values.back();
+            });
+        std::cout << cupuacu::gui::peakKernelSetName(kernelSet)
+                  << " windowed sinc: " << rate << " frames/s, "
+                  << rate / splineRate << "x spline\n";
+    }
+
+    cupuacu::gui::WaveformSmoothReconstructor reconstructor;
+
+    BENCHMARK("natural spline frame")
+    {
+        return splineFrame(samples);
+    };
+
+    BENCHMARK("windowed sinc frame")
+    {
+        return reconstructedFrame(reconstructor, samples);
+    };
+}
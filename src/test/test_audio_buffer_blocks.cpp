@@ -0,0 +1,543 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "Document.hpp"
+#include "audio/AudioBuffer.hpp"
+#include "audio/ChannelBlocks.hpp"
+#include "audio/FrameRangeSet.hpp"
+#include "audio/SampleScratchFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+    using cupuacu::audio::ChannelBlocks;
+
+    void fillWithFrameNumbers(ChannelBlocks &channel)
+    {
+        channel.forEachMutableSpan(
+            0, channel.size(),
+            [](const std::span<float> span, const int64_t firstFrame)
+            {
+                for (std::size_t i = 0; i < span.size(); ++i)
+                {
+                    span[i] = static_cast<float>(firstFrame +
+                                                 static_cast<int64_t>(i));
+                }
+            });
+    }
+
+    void requireMatches(const ChannelBlocks &channel,
+                        const std::vector<float> &expected)
+    {
+        REQUIRE(channel.size() == static_cast<int64_t>(expected.size()));
+
+        std::vector<float> actual(expected.size());
+        channel.read(0, actual.data(), channel.size());
+        REQUIRE(actual == expected);
+
+        auto reader = channel.reader();
+        for (std::size_t i = 0; i < expected.size(); i += 997)
+        {
+            REQUIRE(reader[static_cast<int64_t>(i)] == expected[i]);
+            REQUIRE(channel.get(static_cast<int64_t>(i)) == expected[i]);
+        }
+    }
+} // namespace
+
+TEST_CASE("Channel blocks splice inserts and removals like a flat vector",
+          "[audio]")
+{
+    constexpr int64_t kInitialFrames = ChannelBlocks::kBlockFrames * 5 + 123;
+
+    ChannelBlocks channel;
+    channel.resize(kInitialFrames);
+    fillWithFrameNumbers(channel);
+
+    std::vector<float> expected(static_cast<std::size_t>(kInitialFrames));
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        expected[i] = static_cast<float>(i);
+    }
+    requireMatches(channel, expected);
+
+    std::mt19937 random(1234);
+    for (int edit = 0; edit < 40; ++edit)
+    {
+        const auto frameCount = static_cast<int64_t>(expected.size());
+        std::uniform_int_distribution<int64_t> positionDistribution(0,
+                                                                    frameCount);
+        std::uniform_int_distribution<int64_t> lengthDistribution(
+            1, ChannelBlocks::kBlockFrames * 2);
+        const auto position = positionDistribution(random);
+        const auto length = lengthDistribution(random);
+
+        if (edit % 2 == 0)
+        {
+            channel.insertZeros(position, length);
+            expected.insert(expected.begin() + position,
+                            static_cast<std::size_t>(length), 0.0f);
+        }
+        else
+        {
+            const auto removable = std::min(length, frameCount - position);
+            channel.erase(position, removable);
+            expected.erase(expected.begin() + position,
+                           expected.begin() + position + removable);
+        }
+        requireMatches(channel, expected);
+        REQUIRE(channel.blockCount() <=
+                static_cast<std::size_t>(
+                    2 * (channel.size() + ChannelBlocks::kBlockFrames - 1) /
+                        ChannelBlocks::kBlockFrames +
+                    1));
+    }
+}
+
+TEST_CASE("Channel blocks stay coalesced across erase and insert cycles",
+          "[audio]")
+{
+    constexpr int64_t kInitialFrames = ChannelBlocks::kBlockFrames * 4;
+
+    ChannelBlocks channel;
+    channel.resize(kInitialFrames);
+    fillWithFrameNumbers(channel);
+
+    const auto requireCoalesced = [&]
+    {
+        for (std::size_t i = 0; i < channel.blockCount(); ++i)
+        {
+            REQUIRE(channel.blockSize(i) > 0);
+            REQUIRE(channel.blockSize(i) <= ChannelBlocks::kBlockFrames);
+            if (i > 0)
+            {
+                REQUIRE(channel.blockSize(i - 1) + channel.blockSize(i) >
+                        ChannelBlocks::kBlockFrames);
+            }
+        }
+    };
+
+    std::mt19937 random(99);
+    for (int cycle = 0; cycle < 200; ++cycle)
+    {
+        const auto frameCount = channel.size();
+        std::uniform_int_distribution<int64_t> positionDistribution(
+            0, frameCount - 1);
+        std::uniform_int_distribution<int64_t> lengthDistribution(1, 4096);
+        const auto position = positionDistribution(random);
+        const auto length =
+            std::min(lengthDistribution(random), frameCount - position);
+
+        channel.erase(position, length);
+        requireCoalesced();
+        channel.insertZeros(positionDistribution(random) % channel.size(),
+                            length);
+        requireCoalesced();
+        REQUIRE(channel.size() == kInitialFrames);
+    }
+    REQUIRE(channel.blockCount() <= 8);
+}
+
+TEST_CASE("Channel blocks keep appends densely packed", "[audio]")
+{
+    ChannelBlocks channel;
+    for (int chunk = 0; chunk < 1000; ++chunk)
+    {
+        channel.insertZeros(channel.size(), 512);
+    }
+
+    REQUIRE(channel.size() == 512000);
+    REQUIRE(channel.blockCount() ==
+            static_cast<std::size_t>((512000 + ChannelBlocks::kBlockFrames - 1) /
+                                     ChannelBlocks::kBlockFrames));
+}
+
+TEST_CASE("Channel block readers return silence outside the channel", "[audio]")
+{
+    cupuacu::audio::AudioBuffer buffer;
+    buffer.resize(1, 10);
+    buffer.setSample(0, 9, 0.5f);
+
+    auto reader = buffer.getChannelReader(0);
+    REQUIRE(reader[9] == 0.5f);
+    REQUIRE(reader[10] == 0.0f);
+    REQUIRE(reader[-1] == 0.0f);
+
+    auto missingChannel = buffer.getChannelReader(3);
+    REQUIRE(missingChannel[0] == 0.0f);
+}
+
+TEST_CASE("Audio buffer removal across blocks keeps surrounding samples",
+          "[audio]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 3;
+
+    cupuacu::audio::AudioBuffer buffer;
+    buffer.resize(2, kFrames);
+    for (int64_t frame = 0; frame < kFrames; ++frame)
+    {
+        buffer.setSample(0, frame, static_cast<float>(frame));
+        buffer.setSample(1, frame, -static_cast<float>(frame));
+    }
+
+    const int64_t removeStart = ChannelBlocks::kBlockFrames - 10;
+    const int64_t removeCount = ChannelBlocks::kBlockFrames + 20;
+    int64_t lastCompleted = 0;
+    int64_t lastTotal = 0;
+    buffer.removeFrames(removeStart, removeCount,
+                        [&](const int64_t completed, const int64_t total)
+                        {
+                            REQUIRE(completed >= lastCompleted);
+                            lastCompleted = completed;
+                            lastTotal = total;
+                        });
+
+    REQUIRE(lastCompleted == lastTotal);
+    REQUIRE(buffer.getFrameCount() == kFrames - removeCount);
+    REQUIRE(buffer.getSample(0, removeStart - 1) ==
+            static_cast<float>(removeStart - 1));
+    REQUIRE(buffer.getSample(0, removeStart) ==
+            static_cast<float>(removeStart + removeCount));
+    REQUIRE(buffer.getSample(1, removeStart) ==
+            -static_cast<float>(removeStart + removeCount));
+}
+
+TEST_CASE("Channel block copies duplicate only the blocks they write",
+          "[audio]")
+{
+    ChannelBlocks original;
+    original.resize(ChannelBlocks::kBlockFrames * 4);
+    fillWithFrameNumbers(original);
+
+    ChannelBlocks copy = original;
+    copy.set(ChannelBlocks::kBlockFrames + 5, -1.0f);
+
+    std::vector<const float *> originalBlocks;
+    std::vector<const float *> copyBlocks;
+    original.forEachSpan(0, original.size(),
+                         [&](const std::span<const float> span, int64_t)
+                         { originalBlocks.push_back(span.data()); });
+    copy.forEachSpan(0, copy.size(),
+                     [&](const std::span<const float> span, int64_t)
+                     { copyBlocks.push_back(span.data()); });
+
+    REQUIRE(originalBlocks.size() == 4);
+    REQUIRE(copyBlocks.size() == 4);
+    REQUIRE(copyBlocks[0] == originalBlocks[0]);
+    REQUIRE(copyBlocks[1] != originalBlocks[1]);
+    REQUIRE(copyBlocks[2] == originalBlocks[2]);
+    REQUIRE(copyBlocks[3] == originalBlocks[3]);
+
+    REQUIRE(original.get(ChannelBlocks::kBlockFrames + 5) ==
+            static_cast<float>(ChannelBlocks::kBlockFrames + 5));
+    REQUIRE(copy.get(ChannelBlocks::kBlockFrames + 5) == -1.0f);
+
+    copy.erase(10, 20);
+    REQUIRE(original.size() == ChannelBlocks::kBlockFrames * 4);
+    REQUIRE(original.get(10) == 10.0f);
+    REQUIRE(copy.get(10) == 30.0f);
+}
+
+TEST_CASE("Channel blocks read paged out samples from the scratch file",
+          "[audio]")
+{
+    const auto scratch = cupuacu::audio::SampleScratchFile::create(
+        std::filesystem::temp_directory_path() / "cupuacu-tests");
+
+    ChannelBlocks channel;
+    channel.resize(ChannelBlocks::kBlockFrames * 3 + 17);
+    fillWithFrameNumbers(channel);
+    REQUIRE(channel.residentBytes() > 0);
+
+    std::vector<float> expected(static_cast<std::size_t>(channel.size()));
+    channel.read(0, expected.data(), channel.size());
+
+    channel.pageOut(*scratch, INT64_MAX);
+    REQUIRE(channel.residentBytes() == 0);
+    REQUIRE(scratch->getUsedSlotCount() == 4);
+    requireMatches(channel, expected);
+
+    channel.erase(100, ChannelBlocks::kBlockFrames);
+    expected.erase(expected.begin() + 100,
+                   expected.begin() + 100 + ChannelBlocks::kBlockFrames);
+    channel.set(5, -2.0f);
+    expected[5] = -2.0f;
+    requireMatches(channel, expected);
+
+    channel.resize(0);
+    REQUIRE(scratch->getUsedSlotCount() == 0);
+}
+
+TEST_CASE("Documents keep written samples within their resident budget",
+          "[document]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 16;
+    constexpr int64_t kBudgetBytes =
+        ChannelBlocks::kBlockFrames * static_cast<int64_t>(sizeof(float)) * 4;
+
+    cupuacu::Document document;
+    document.setResidentSampleBudget(
+        cupuacu::audio::SampleScratchFile::create(
+            std::filesystem::temp_directory_path() / "cupuacu-tests"),
+        kBudgetBytes);
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 1, kFrames);
+    REQUIRE(document.getResidentSampleBytes() == 0);
+
+    std::vector<float> chunk(static_cast<std::size_t>(ChannelBlocks::kBlockFrames));
+    for (int64_t start = 0; start < kFrames; start += ChannelBlocks::kBlockFrames)
+    {
+        for (std::size_t i = 0; i < chunk.size(); ++i)
+        {
+            chunk[i] = static_cast<float>(start + static_cast<int64_t>(i));
+        }
+        document.writeChannelFloatBlock(0, start, chunk.data(),
+                                        ChannelBlocks::kBlockFrames, false);
+        REQUIRE(document.getResidentSampleBytes() <= kBudgetBytes);
+    }
+
+    for (int64_t frame = 0; frame < kFrames; frame += 4099)
+    {
+        REQUIRE(document.getSample(0, frame) == static_cast<float>(frame));
+    }
+}
+
+TEST_CASE("Documents keep sample edits, inserts and copies within their "
+          "resident budget",
+          "[document]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 16;
+    constexpr int64_t kBudgetBytes =
+        ChannelBlocks::kBlockFrames * static_cast<int64_t>(sizeof(float)) * 4;
+
+    cupuacu::Document document;
+    document.setResidentSampleBudget(
+        cupuacu::audio::SampleScratchFile::create(
+            std::filesystem::temp_directory_path() / "cupuacu-tests"),
+        kBudgetBytes);
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 1, kFrames);
+
+    // One sample per block brings every block into RAM.
+    for (int64_t frame = 7; frame < kFrames;
+         frame += ChannelBlocks::kBlockFrames)
+    {
+        document.setSample(0, frame, static_cast<float>(frame), false);
+        REQUIRE(document.getResidentSampleBytes() <= kBudgetBytes);
+    }
+
+    // Splitting blocks to insert slices them.
+    for (int i = 0; i < 16; ++i)
+    {
+        document.insertFrames(ChannelBlocks::kBlockFrames * i + 1000, 3000);
+        REQUIRE(document.getResidentSampleBytes() <= kBudgetBytes);
+    }
+
+    // Blocks shared with a copy are duplicated as they are written.
+    const cupuacu::Document copy(document);
+    for (int64_t frame = 11; frame < document.getFrameCount();
+         frame += ChannelBlocks::kBlockFrames / 2)
+    {
+        document.setSample(0, frame, 0.25f, false);
+        REQUIRE(document.getResidentSampleBytes() <= kBudgetBytes);
+    }
+
+    REQUIRE(document.getSample(0, 7) == 7.0f);
+    REQUIRE(copy.getSample(0, 11) == 0.0f);
+    REQUIRE(document.getSample(0, 11) == 0.25f);
+}
+
+TEST_CASE("Documents count only unshared resident blocks as their own",
+          "[document]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 4;
+
+    cupuacu::Document document;
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 1, kFrames);
+    const std::vector<float> samples(static_cast<std::size_t>(kFrames), 0.5f);
+    document.writeChannelFloatBlock(0, 0, samples.data(), kFrames, false);
+    const auto residentBytes = document.getResidentSampleBytes();
+    REQUIRE(residentBytes > 0);
+    REQUIRE(document.getUnsharedResidentSampleBytes() == residentBytes);
+
+    cupuacu::Document revision(document);
+    REQUIRE(revision.getUnsharedResidentSampleBytes() == 0);
+
+    document.setSample(0, 5, 0.25f, false);
+    REQUIRE(revision.getUnsharedResidentSampleBytes() > 0);
+    REQUIRE(revision.getUnsharedResidentSampleBytes() < residentBytes / 2);
+    REQUIRE(revision.getUnsharedResidentSampleBytes() ==
+            document.getUnsharedResidentSampleBytes());
+}
+
+TEST_CASE("Compact PCM blocks read back as float until they are edited",
+          "[document]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 2 + 300;
+    constexpr int64_t kChannels = 2;
+
+    for (const int bitDepth : {16, 24})
+    {
+        const int32_t fullScale = 1 << (bitDepth - 1);
+        std::vector<int32_t> interleaved(
+            static_cast<std::size_t>(kFrames * kChannels));
+        for (int64_t frame = 0; frame < kFrames; ++frame)
+        {
+            const auto value =
+                static_cast<int32_t>((frame * 7919) % (2 * fullScale)) -
+                fullScale;
+            interleaved[static_cast<std::size_t>(frame * kChannels)] = value;
+            interleaved[static_cast<std::size_t>(frame * kChannels + 1)] =
+                -1 - value;
+        }
+        const auto expectedSample = [&](const int64_t channel,
+                                         const int64_t frame)
+        {
+            return static_cast<float>(
+                       interleaved[static_cast<std::size_t>(frame * kChannels +
+                                                            channel)]) /
+                   static_cast<float>(fullScale);
+        };
+
+        cupuacu::Document document;
+        document.initialize(bitDepth == 16 ? cupuacu::SampleFormat::PCM_S16
+                                           : cupuacu::SampleFormat::PCM_S24,
+                            44100, kChannels, kFrames);
+        document.writeInterleavedPcmBlock(0, interleaved.data(), kFrames,
+                                          kChannels, bitDepth);
+
+        const auto compactBytes = document.getResidentSampleBytes();
+        REQUIRE(compactBytes >= kFrames * kChannels * bitDepth / 8);
+        REQUIRE(compactBytes <
+                kFrames * kChannels * static_cast<int64_t>(sizeof(float)));
+
+        auto reader = document.getAudioBuffer()->getChannelReader(1);
+        for (int64_t frame = 0; frame < kFrames; ++frame)
+        {
+            REQUIRE(reader[frame] == expectedSample(1, frame));
+        }
+        for (int64_t frame = kFrames - 1; frame >= 0; frame -= 331)
+        {
+            REQUIRE(document.getSample(0, frame) == expectedSample(0, frame));
+        }
+
+        document.setSample(0, 10, 0.5f);
+        REQUIRE(document.getSample(0, 10) == 0.5f);
+        REQUIRE(document.getSample(0, 11) == expectedSample(0, 11));
+        REQUIRE(document.getResidentSampleBytes() > compactBytes);
+
+        document.removeFrames(ChannelBlocks::kBlockFrames - 5, 10);
+        REQUIRE(document.getSample(1, ChannelBlocks::kBlockFrames - 5) ==
+                expectedSample(1, ChannelBlocks::kBlockFrames + 5));
+    }
+}
+
+TEST_CASE("Document read leases copy and visit ranges across blocks",
+          "[document]")
+{
+    constexpr int64_t kFrames = ChannelBlocks::kBlockFrames * 3 + 17;
+
+    cupuacu::Document document;
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 2, kFrames);
+    std::vector<float> source(static_cast<std::size_t>(kFrames));
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        source[i] = static_cast<float>(i);
+    }
+    document.writeChannelFloatBlock(1, 0, source.data(), kFrames, false);
+
+    const auto lease = document.acquireReadLease();
+    const int64_t start = ChannelBlocks::kBlockFrames - 3;
+    std::vector<float> copied(static_cast<std::size_t>(
+                                  ChannelBlocks::kBlockFrames * 2),
+                              -1.0f);
+    REQUIRE(lease.readFrames(1, start, copied.data(),
+                             static_cast<int64_t>(copied.size())) ==
+            static_cast<int64_t>(copied.size()));
+    for (std::size_t i = 0; i < copied.size(); ++i)
+    {
+        REQUIRE(copied[i] == static_cast<float>(start + static_cast<int64_t>(i)));
+    }
+
+    std::vector<float> tail(64, -1.0f);
+    REQUIRE(lease.readFrames(1, kFrames - 10, tail.data(), 64) == 10);
+    REQUIRE(tail[9] == static_cast<float>(kFrames - 1));
+    REQUIRE(tail[10] == -1.0f);
+    REQUIRE(lease.readFrames(2, 0, tail.data(), 64) == 0);
+
+    int64_t visitedFrames = 0;
+    int64_t expectedFirstFrame = start;
+    lease.forEachSpan(1, start, kFrames,
+                      [&](const std::span<const float> span,
+                          const int64_t firstFrame)
+                      {
+                          REQUIRE(firstFrame == expectedFirstFrame);
+                          REQUIRE(span.front() == static_cast<float>(firstFrame));
+                          expectedFirstFrame += static_cast<int64_t>(span.size());
+                          visitedFrames += static_cast<int64_t>(span.size());
+                      });
+    REQUIRE(visitedFrames == kFrames - start);
+}
+
+TEST_CASE("Frame range sets merge, split and shift like a per-frame mask",
+          "[audio]")
+{
+    using cupuacu::audio::FrameRangeSet;
+
+    constexpr int64_t kFrames = 400;
+    std::mt19937 random(11);
+    FrameRangeSet set;
+    std::vector<bool> mask(static_cast<std::size_t>(kFrames), false);
+
+    const auto requireMatches = [&]
+    {
+        int64_t previousEnd = -1;
+        for (const auto &range : set.getRanges())
+        {
+            REQUIRE(range.startFrame > previousEnd);
+            REQUIRE(range.startFrame < range.endFrameExclusive);
+            previousEnd = range.endFrameExclusive;
+        }
+        for (int64_t frame = 0; frame < static_cast<int64_t>(mask.size());
+             ++frame)
+        {
+            REQUIRE(set.contains(frame) ==
+                    mask[static_cast<std::size_t>(frame)]);
+        }
+    };
+
+    for (int step = 0; step < 300; ++step)
+    {
+        const auto size = static_cast<int64_t>(mask.size());
+        const auto start = static_cast<int64_t>(random() % (size + 1));
+        const auto count = static_cast<int64_t>(random() % 40);
+        switch (random() % 3)
+        {
+        case 0:
+        {
+            const auto end = std::min(size, start + count);
+            set.add(start, end);
+            for (int64_t frame = start; frame < end; ++frame)
+            {
+                mask[static_cast<std::size_t>(frame)] = true;
+            }
+            break;
+        }
+        case 1:
+            set.insertGap(start, count);
+            mask.insert(mask.begin() + start, static_cast<std::size_t>(count),
+                        false);
+            break;
+        default:
+        {
+            const auto removed = std::min(count, size - start);
+            set.removeSpan(start, removed);
+            mask.erase(mask.begin() + start, mask.begin() + start + removed);
+            break;
+        }
+        }
+        requireMatches();
+    }
+}
@@ -10,6 +10,28 @@
 #include "effects/DynamicsEffect.hpp"
 #include "effects/RemoveSilenceEffect.hpp"
 #include "effects/ReverseEffect.hpp"
+#include "undo/UndoHistoryBudget.hpp"
+
+#include <filesystem>
+
+namespace
+{
+    std::size_t countSampleMatrixPayloads(const cupuacu::State &state)
+    {
+        const auto &undoStore = state.getActiveDocumentSession().undoStore;
+        undoStore.flush();
+        std::size_t count = 0;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(undoStore.root()))
+        {
+            if (entry.path().extension() == ".cupuacu-undo-sample-matrix")
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+} // namespace
 
 TEST_CASE("Reverse effect runs in the background and commits undoably",
           "[effects]")
@@ -99,6 +121,41 @@ TEST_CASE("Amplify/Fade runs in the background and commits undoably",
     REQUIRE(document.getSample(0, 3) == Catch::Approx(1.0f));
 }
 
+TEST_CASE("Amplify/Fade undo stores only the old samples and replays the effect",
+          "[effects]")
+{
+    cupuacu::test::StateWithTestPaths state{};
+    auto &document = state.getActiveDocumentSession().document;
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 1, 4);
+    for (int64_t frame = 0; frame < 4; ++frame)
+    {
+        document.setSample(0, frame, 1.0f, false);
+    }
+
+    cupuacu::effects::performAmplifyFade(
+        &state, cupuacu::effects::AmplifyFadeSettings{100.0, 200.0, 0, false});
+    cupuacu::test::drainPendingEffectWork(&state);
+
+    REQUIRE(state.canUndo());
+    REQUIRE(countSampleMatrixPayloads(state) == 1);
+    REQUIRE(state.getActiveUndoables().back()->canPersistForRestart());
+
+    state.undoHistoryBudget.maxPendingBytes = 1;
+    cupuacu::undo::enforceUndoHistoryBudget(&state);
+    REQUIRE(state.getActiveUndoables().back()->pendingPayloadBytes() == 0);
+
+    state.undo();
+    REQUIRE(document.getSample(0, 0) == Catch::Approx(1.0f));
+    REQUIRE(document.getSample(0, 3) == Catch::Approx(1.0f));
+
+    state.redo();
+    REQUIRE(document.getSample(0, 0) == Catch::Approx(1.0f));
+    REQUIRE(document.getSample(0, 1) == Catch::Approx(1.3333333f));
+    REQUIRE(document.getSample(0, 2) == Catch::Approx(1.6666666f));
+    REQUIRE(document.getSample(0, 3) == Catch::Approx(2.0f));
+    REQUIRE(countSampleMatrixPayloads(state) == 1);
+}
+
 TEST_CASE("Dynamics runs in the background and commits undoably", "[effects]")
 {
     cupuacu::test::StateWithTestPaths state{};
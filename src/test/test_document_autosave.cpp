@@ -14,12 +14,16 @@
 #include "actions/Undoable.hpp"
 #include "persistence/DocumentAutosave.hpp"
 #include "persistence/SessionStatePersistence.hpp"
+#include "undo/UndoHistoryBudget.hpp"
 #include "undo/UndoManifestPersistence.hpp"
+#include "undo/UndoPayloadWriter.hpp"
+#include "undo/UndoStore.hpp"
 
 #include <nlohmann/json.hpp>
 
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <chrono>
 #include <thread>
 #include <memory>
@@ -58,6 +62,7 @@ namespace
         REQUIRE(actual.numSamples == expected.numSamples);
         REQUIRE(actual.dirtyFromBlock == expected.dirtyFromBlock);
         REQUIRE(actual.dirtyToBlock == expected.dirtyToBlock);
+        REQUIRE(actual.layout == expected.layout);
         REQUIRE(actual.levels.size() == expected.levels.size());
         for (std::size_t levelIndex = 0; levelIndex < expected.levels.size();
              ++levelIndex)
@@ -122,6 +127,51 @@ namespace
         float previousValue = 0.0f;
     };
 
+    class PendingSamplesUndoable : public SetSampleUndoable
+    {
+    public:
+        PendingSamplesUndoable(cupuacu::State *stateToUse,
+                               const int64_t frameToUse,
+                               const std::size_t pendingSampleCount)
+            : SetSampleUndoable(stateToUse, frameToUse, 0.25f),
+              pendingSamples(std::vector<std::vector<float>>{
+                  std::vector<float>(pendingSampleCount, 0.5f)})
+        {
+        }
+
+        [[nodiscard]] std::vector<cupuacu::undo::UndoStore::PayloadHandle>
+        payloadHandles() const override
+        {
+            return {samplesHandle};
+        }
+
+        [[nodiscard]] std::uint64_t pendingPayloadBytes() const override
+        {
+            return pendingSamples ? pendingSamples->front().size() * sizeof(float)
+                                  : 0;
+        }
+
+        void spillPendingPayloads(cupuacu::DocumentSession &session) override
+        {
+            if (pendingSamples)
+            {
+                samplesHandle = session.undoStore.writeSampleMatrix(
+                    *pendingSamples, "pending-samples");
+                pendingSamples.reset();
+            }
+        }
+
+        [[nodiscard]] const cupuacu::undo::UndoStore::PayloadHandle &
+        getSamplesHandle() const
+        {
+            return samplesHandle;
+        }
+
+    private:
+        std::optional<std::vector<std::vector<float>>> pendingSamples;
+        cupuacu::undo::UndoStore::PayloadHandle samplesHandle;
+    };
+
     void drainPendingAutosave(cupuacu::State &state)
     {
         const auto deadline =
@@ -597,24 +647,326 @@ TEST_CASE("Undo segments store contiguous provenance compactly",
         state.getActiveDocumentSession().undoStore.readSegment(handle);
     REQUIRE(restored.frameCount == segment.frameCount);
     REQUIRE(restored.channelCount == segment.channelCount);
-    for (std::size_t channel = 0; channel < restored.provenance.size(); ++channel)
+    REQUIRE(segment.provenance.size() == 1);
+    REQUIRE(segment.provenance[0].size() <= 1);
+    REQUIRE(restored.provenance == segment.provenance);
+    for (int64_t channel = 0; channel < restored.channelCount; ++channel)
     {
-        REQUIRE(restored.provenance[channel].size() ==
-                segment.provenance[channel].size());
-        for (std::size_t frame = 0; frame < restored.provenance[channel].size();
-             ++frame)
+        for (int64_t frame = 0; frame < restored.frameCount; ++frame)
         {
-            REQUIRE(restored.provenance[channel][frame].sourceId ==
-                    segment.provenance[channel][frame].sourceId);
-            REQUIRE(restored.provenance[channel][frame].frameIndex ==
-                    segment.provenance[channel][frame].frameIndex);
+            REQUIRE(restored.getProvenance(channel, frame).sourceId ==
+                    segment.getProvenance(channel, frame).sourceId);
+            REQUIRE(restored.getProvenance(channel, frame).frameIndex ==
+                    segment.getProvenance(channel, frame).frameIndex);
+            REQUIRE(restored.isDirty(channel, frame) ==
+                    segment.isDirty(channel, frame));
         }
     }
 
+    state.getActiveDocumentSession().undoStore.flush();
     const auto size = std::filesystem::file_size(handle.path);
     REQUIRE(size < 6000);
 }
 
+TEST_CASE("Undo store round-trips raw and encoded payloads",
+          "[autosave]")
+{
+    cupuacu::undo::UndoStore store;
+    store.attach(cupuacu::test::makeUniqueTestRoot("undo-store-bulk") / "undo");
+
+    std::vector<std::vector<float>> matrix(2);
+    matrix[0].resize(150001);
+    for (std::size_t i = 0; i < matrix[0].size(); ++i)
+    {
+        matrix[0][i] = static_cast<float>(i % 977) / 977.0f - 0.5f;
+    }
+    matrix[1] = {1.0f, -0.0f, 0.25f};
+
+    const auto matrixHandle = store.writeSampleMatrix(matrix);
+    REQUIRE(store.readSampleMatrix(matrixHandle) == matrix);
+
+    // Samples stay little-endian IEEE floats on disk: 1.0f follows the
+    // 27-byte magic, version, channel count and both channel lengths.
+    std::ifstream raw(matrixHandle.path, std::ios::binary);
+    const auto secondChannelOffset = 27 + 4 + 8 + 8 + 150001 * 4 + 8;
+    raw.seekg(secondChannelOffset);
+    unsigned char bytes[4]{};
+    raw.read(reinterpret_cast<char *>(bytes), sizeof(bytes));
+    REQUIRE(bytes[0] == 0x00);
+    REQUIRE(bytes[1] == 0x00);
+    REQUIRE(bytes[2] == 0x80);
+    REQUIRE(bytes[3] == 0x3f);
+
+    const std::vector<std::vector<std::vector<float>>> cube{matrix, {}, {{}}};
+    REQUIRE(store.readSampleCube(store.writeSampleCube(cube)) == cube);
+
+    cupuacu::Document::AudioSegment segment{};
+    segment.format = cupuacu::SampleFormat::PCM_S16;
+    segment.sampleRate = 44100;
+    segment.channelCount = 1;
+    segment.frameCount = static_cast<int64_t>(matrix[0].size());
+    segment.samples = {matrix[0]};
+    segment.dirty.resize(1);
+    segment.dirty[0].add(70000, 70010);
+    segment.provenance = {{{.startFrame = 0,
+                            .endFrameExclusive = 70000,
+                            .sourceId = 7,
+                            .sourceStartFrame = 100}}};
+
+    const auto restored = store.readSegment(store.writeSegment(segment));
+    REQUIRE(restored.samples == segment.samples);
+    REQUIRE(restored.dirty[0].getRanges() == segment.dirty[0].getRanges());
+    REQUIRE(restored.provenance == segment.provenance);
+
+    store.setPayloadCodec(cupuacu::undo::PayloadCodec::Lossless);
+    const auto encodedMatrixHandle = store.writeSampleMatrix(matrix);
+    REQUIRE(store.readSampleMatrix(encodedMatrixHandle) == matrix);
+    REQUIRE(std::filesystem::file_size(encodedMatrixHandle.path) <
+            std::filesystem::file_size(matrixHandle.path));
+    REQUIRE(store.readSampleCube(store.writeSampleCube(cube)) == cube);
+    const auto encodedSegment = store.readSegment(store.writeSegment(segment));
+    REQUIRE(encodedSegment.samples == segment.samples);
+    REQUIRE(encodedSegment.dirty[0].getRanges() ==
+            segment.dirty[0].getRanges());
+    REQUIRE(encodedSegment.provenance == segment.provenance);
+    REQUIRE(store.readSampleMatrix(matrixHandle) == matrix);
+
+    std::filesystem::resize_file(matrixHandle.path,
+                                 std::filesystem::file_size(matrixHandle.path) -
+                                     2);
+    REQUIRE_THROWS_AS(store.readSampleMatrix(matrixHandle), std::runtime_error);
+    std::filesystem::resize_file(
+        encodedMatrixHandle.path,
+        std::filesystem::file_size(encodedMatrixHandle.path) - 2);
+    REQUIRE_THROWS_AS(store.readSampleMatrix(encodedMatrixHandle),
+                      std::runtime_error);
+}
+
+TEST_CASE("Write-behind undo store serves payloads until they are on disk",
+          "[autosave]")
+{
+    cupuacu::undo::UndoStore store{cupuacu::undo::PayloadCodec::Lossless,
+                                   cupuacu::undo::PayloadWriteMode::WriteBehind};
+    store.attach(cupuacu::test::makeUniqueTestRoot("undo-store-write-behind") /
+                 "undo");
+
+    std::vector<std::vector<float>> matrix(2, std::vector<float>(4096));
+    for (std::size_t i = 0; i < matrix[0].size(); ++i)
+    {
+        matrix[0][i] = static_cast<float>(i % 311) / 311.0f;
+        matrix[1][i] = -matrix[0][i];
+    }
+
+    const auto kept = store.writeSampleMatrix(matrix, "kept");
+    const auto removed = store.writeSampleMatrix(matrix, "removed");
+    REQUIRE(store.readSampleMatrix(kept) == matrix);
+    REQUIRE(store.stats().fileCount == 2);
+
+    REQUIRE(store.remove(removed) > 0);
+    store.flush();
+    REQUIRE(std::filesystem::exists(kept.path));
+    REQUIRE_FALSE(std::filesystem::exists(removed.path));
+    REQUIRE(store.readSampleMatrix(kept) == matrix);
+
+    const auto stats = store.stats();
+    REQUIRE(stats.fileCount == 1);
+    REQUIRE(stats.totalBytes == std::filesystem::file_size(kept.path));
+
+    const std::vector<std::vector<std::vector<float>>> cube{matrix, {}};
+    const auto cubeHandle = store.writeSampleCube(cube);
+    REQUIRE(store.readSampleCube(cubeHandle) == cube);
+    REQUIRE_THROWS_AS(store.readSampleMatrix(cubeHandle), std::runtime_error);
+    cupuacu::undo::drainUndoPayloadWrites();
+    REQUIRE(store.readSampleCube(cubeHandle) == cube);
+}
+
+TEST_CASE("Write-behind undo store takes over payloads passed as rvalues",
+          "[autosave]")
+{
+    cupuacu::undo::UndoStore store{cupuacu::undo::PayloadCodec::Lossless,
+                                   cupuacu::undo::PayloadWriteMode::WriteBehind};
+    store.attach(cupuacu::test::makeUniqueTestRoot("undo-store-moved") /
+                 "undo");
+
+    const std::vector<std::vector<float>> expected(
+        2, std::vector<float>(2048, 0.25f));
+    auto matrix = expected;
+    const auto matrixHandle = store.writeSampleMatrix(std::move(matrix));
+    REQUIRE(matrix.empty());
+    REQUIRE(store.readSampleMatrix(matrixHandle) == expected);
+
+    std::vector<std::vector<std::vector<float>>> cube{expected, expected};
+    const auto cubeHandle = store.writeSampleCube(std::move(cube));
+    REQUIRE(cube.empty());
+
+    cupuacu::Document::AudioSegment segment{};
+    segment.format = cupuacu::SampleFormat::FLOAT32;
+    segment.sampleRate = 44100;
+    segment.channelCount = 2;
+    segment.frameCount = 2048;
+    segment.samples = expected;
+    const auto segmentHandle = store.writeSegment(std::move(segment));
+    REQUIRE(segment.samples.empty());
+
+    cupuacu::undo::drainUndoPayloadWrites();
+    REQUIRE(store.readSampleMatrix(matrixHandle) == expected);
+    REQUIRE(store.readSampleCube(cubeHandle) ==
+            std::vector<std::vector<std::vector<float>>>{expected, expected});
+    REQUIRE(store.readSegment(segmentHandle).samples == expected);
+}
+
+TEST_CASE("Undo stores write identical payloads once", "[autosave]")
+{
+    const auto root = cupuacu::test::makeUniqueTestRoot("undo-store-dedup");
+    cupuacu::undo::UndoStore store{cupuacu::undo::PayloadCodec::Lossless};
+    store.attach(root / "first");
+    cupuacu::undo::UndoStore otherStore{
+        cupuacu::undo::PayloadCodec::Lossless,
+        cupuacu::undo::PayloadWriteMode::WriteBehind};
+    otherStore.attach(root / "second");
+
+    std::vector<std::vector<float>> matrix(1, std::vector<float>(2048));
+    for (std::size_t i = 0; i < matrix[0].size(); ++i)
+    {
+        matrix[0][i] = static_cast<float>(i % 97) / 97.0f;
+    }
+
+    const auto first = store.writeSampleMatrix(matrix, "first");
+    const auto second = store.writeSampleMatrix(matrix, "second");
+    const auto shared = otherStore.writeSampleMatrix(matrix, "shared");
+    otherStore.flush();
+    REQUIRE(first.path != second.path);
+    REQUIRE(std::filesystem::hard_link_count(first.path) == 3);
+    REQUIRE(store.stats().fileCount == 2);
+    REQUIRE(store.stats().totalBytes + otherStore.stats().totalBytes ==
+            std::filesystem::file_size(first.path));
+
+    auto changed = matrix;
+    changed[0][1000] = 0.5f;
+    const auto distinct = store.writeSampleMatrix(changed, "distinct");
+    REQUIRE(std::filesystem::hard_link_count(distinct.path) == 1);
+    cupuacu::undo::UndoStore rawStore;
+    rawStore.attach(root / "raw");
+    const auto raw = rawStore.writeSampleMatrix(matrix, "raw");
+    REQUIRE(std::filesystem::hard_link_count(raw.path) == 1);
+
+    REQUIRE(store.remove(first) > 0);
+    REQUIRE_FALSE(std::filesystem::exists(first.path));
+    REQUIRE(store.readSampleMatrix(second) == matrix);
+    REQUIRE(otherStore.readSampleMatrix(shared) == matrix);
+    REQUIRE(std::filesystem::hard_link_count(second.path) == 2);
+
+    store.clear();
+    REQUIRE(otherStore.readSampleMatrix(shared) == matrix);
+    REQUIRE(std::filesystem::hard_link_count(shared.path) == 1);
+}
+
+TEST_CASE("Undo stores link only to files that still hold the payload",
+          "[autosave]")
+{
+    cupuacu::undo::UndoStore store{cupuacu::undo::PayloadCodec::Raw};
+    store.attach(cupuacu::test::makeUniqueTestRoot("undo-store-verify") /
+                 "undo");
+
+    const std::vector<std::vector<float>> matrix(
+        1, std::vector<float>(1024, 0.5f));
+    const auto original = store.writeSampleMatrix(matrix, "original");
+
+    // Same size, different bytes: the content key no longer describes it.
+    const auto size = std::filesystem::file_size(original.path);
+    {
+        std::fstream file(original.path,
+                          std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(size) - 1);
+        file.put('\x7f');
+    }
+    REQUIRE(std::filesystem::file_size(original.path) == size);
+
+    const auto rewritten = store.writeSampleMatrix(matrix, "rewritten");
+    REQUIRE(std::filesystem::hard_link_count(rewritten.path) == 1);
+    REQUIRE(store.readSampleMatrix(rewritten) == matrix);
+
+    std::filesystem::resize_file(rewritten.path, size / 2);
+    const auto again = store.writeSampleMatrix(matrix, "again");
+    REQUIRE(std::filesystem::hard_link_count(again.path) == 1);
+    REQUIRE(store.readSampleMatrix(again) == matrix);
+}
+
+TEST_CASE("Undo store stats follow writes, links and removals without a scan",
+          "[autosave]")
+{
+    const auto root = cupuacu::test::makeUniqueTestRoot("undo-store-usage");
+    cupuacu::undo::UndoStore store{cupuacu::undo::PayloadCodec::Raw};
+    store.attach(root / "first");
+    cupuacu::undo::UndoStore otherStore{cupuacu::undo::PayloadCodec::Raw};
+    otherStore.attach(root / "second");
+
+    // What listing the store's files gives, each file's size split between
+    // its links. Shares are rounded to whole bytes, one per file at most.
+    const auto scannedBytes = [](const cupuacu::undo::UndoStore &scanned)
+    {
+        double bytes = 0.0;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(scanned.root()))
+        {
+            bytes += static_cast<double>(
+                         std::filesystem::file_size(entry.path())) /
+                     static_cast<double>(
+                         std::filesystem::hard_link_count(entry.path()));
+        }
+        return Catch::Approx(bytes).margin(12.0);
+    };
+
+    std::vector<cupuacu::undo::UndoStore::PayloadHandle> handles;
+    for (int i = 0; i < 12; ++i)
+    {
+        // Every third payload repeats the one before it.
+        const auto content = i - (i % 3 == 2 ? 1 : 0);
+        const std::vector<std::vector<float>> matrix(
+            1, std::vector<float>(100 + static_cast<std::size_t>(content),
+                                  static_cast<float>(content)));
+        auto &target = i % 2 == 0 ? store : otherStore;
+        handles.push_back(target.writeSampleMatrix(matrix, "usage"));
+        REQUIRE(static_cast<double>(store.stats().totalBytes) ==
+                scannedBytes(store));
+        REQUIRE(static_cast<double>(otherStore.stats().totalBytes) ==
+                scannedBytes(otherStore));
+    }
+
+    for (std::size_t i = 0; i < handles.size(); i += 2)
+    {
+        auto &target = i % 4 == 0 ? store : otherStore;
+        const auto before = target.stats().totalBytes;
+        const auto freed = target.remove(handles[i]);
+        REQUIRE(static_cast<double>(target.stats().totalBytes) ==
+                Catch::Approx(static_cast<double>(before - freed))
+                    .margin(1.0));
+        REQUIRE(static_cast<double>(store.stats().totalBytes) ==
+                scannedBytes(store));
+        REQUIRE(static_cast<double>(otherStore.stats().totalBytes) ==
+                scannedBytes(otherStore));
+    }
+    REQUIRE(store.stats().fileCount ==
+            static_cast<std::uint64_t>(std::distance(
+                std::filesystem::directory_iterator(store.root()),
+                std::filesystem::directory_iterator{})));
+
+    const auto restoredRoot = root / "restored";
+    std::filesystem::create_directories(restoredRoot);
+    std::filesystem::copy_file(handles[1].path,
+                               restoredRoot / "earlier.cupuacu-undo-segment");
+    {
+        std::ofstream manifest(restoredRoot / "manifest.json");
+        manifest << "{}";
+    }
+    cupuacu::undo::UndoStore restoredStore;
+    restoredStore.attach(restoredRoot);
+    const auto restoredStats = restoredStore.stats();
+    REQUIRE(restoredStats.fileCount == 1);
+    REQUIRE(restoredStats.totalBytes ==
+            std::filesystem::file_size(handles[1].path));
+}
+
 TEST_CASE("Restart undo persistence byte policy rejects oversized stores",
           "[autosave]")
 {
@@ -626,6 +978,94 @@ TEST_CASE("Restart undo persistence byte policy rejects oversized stores",
         {.fileCount = 2, .totalBytes = 129}, 128));
 }
 
+TEST_CASE("Undo history budget drops the oldest steps and their payloads",
+          "[autosave]")
+{
+    cupuacu::test::StateWithTestPaths state{
+        cupuacu::test::makeUniqueTestRoot("document-autosave")};
+    initializeMonoDocument(state, std::vector<float>(1000, 0.25f));
+    auto &session = state.getActiveDocumentSession();
+    const auto cutFirstFrames = [&]
+    {
+        session.selection.setValue1(0.0);
+        session.selection.setValue2(100.0);
+        cupuacu::actions::audio::performCut(&state);
+    };
+
+    cutFirstFrames();
+    state.undo();
+    REQUIRE(state.getActiveRedoables().size() == 1);
+    const auto redoHandles =
+        state.getActiveRedoables().back()->payloadHandles();
+    REQUIRE(redoHandles.size() == 1);
+    session.undoStore.flush();
+    REQUIRE(std::filesystem::exists(redoHandles[0].path));
+
+    cutFirstFrames();
+    REQUIRE_FALSE(std::filesystem::exists(redoHandles[0].path));
+
+    cutFirstFrames();
+    cutFirstFrames();
+    REQUIRE(state.getActiveUndoables().size() == 3);
+    session.undoStore.flush();
+    std::vector<std::filesystem::path> olderPayloads;
+    for (std::size_t index = 0; index + 1 < 3; ++index)
+    {
+        for (const auto &handle :
+             state.getActiveUndoables()[index]->payloadHandles())
+        {
+            REQUIRE(std::filesystem::exists(handle.path));
+            olderPayloads.push_back(handle.path);
+        }
+    }
+
+    state.undoHistoryBudget.maxSessionBytes = 1;
+    cutFirstFrames();
+
+    REQUIRE(state.getActiveUndoables().size() == 1);
+    for (const auto &path : olderPayloads)
+    {
+        REQUIRE_FALSE(std::filesystem::exists(path));
+    }
+    REQUIRE(session.document.getFrameCount() == 600);
+    state.undo();
+    REQUIRE(session.document.getFrameCount() == 700);
+    REQUIRE_FALSE(state.canUndo());
+}
+
+TEST_CASE("Undo history budget spills pending samples before dropping steps",
+          "[autosave]")
+{
+    cupuacu::test::StateWithTestPaths state{
+        cupuacu::test::makeUniqueTestRoot("document-autosave")};
+    initializeMonoDocument(state, {0.0f, 0.0f, 0.0f});
+    cupuacu::actions::detail::ensureUndoStoreForTab(&state,
+                                                    state.activeTabIndex);
+    state.undoHistoryBudget.maxPendingBytes = 1000 * sizeof(float);
+
+    auto first = std::make_shared<PendingSamplesUndoable>(&state, 0, 800);
+    state.addUndoable(first);
+    REQUIRE(first->pendingPayloadBytes() == 800 * sizeof(float));
+    REQUIRE(first->getSamplesHandle().empty());
+
+    auto second = std::make_shared<PendingSamplesUndoable>(&state, 1, 800);
+    state.addUndoable(second);
+
+    REQUIRE(first->pendingPayloadBytes() == 0);
+    state.getActiveDocumentSession().undoStore.flush();
+    REQUIRE(std::filesystem::exists(first->getSamplesHandle().path));
+    REQUIRE(second->pendingPayloadBytes() == 800 * sizeof(float));
+    REQUIRE(state.getActiveUndoables().size() == 2);
+
+    const auto usage = cupuacu::undo::measureUndoHistory(*state.getActiveTab());
+    REQUIRE(usage.undoStepCount == 2);
+    REQUIRE(usage.pendingBytes == 800 * sizeof(float));
+    REQUIRE(usage.storedBytes > 0);
+    REQUIRE(cupuacu::undo::describeUndoHistoryUsage(
+                usage, state.undoHistoryBudget)
+                .find("2 undo step(s)") == 0);
+}
+
 TEST_CASE("Startup restore preserves persistent cut undo history", "[autosave]")
 {
     const auto root = cupuacu::test::makeUniqueTestRoot("document-autosave");
@@ -844,6 +1284,63 @@ TEST_CASE("Startup restore preserves multi-step persistent cut undo history",
             std::vector<float>({0.0f, 1.0f, 2.0f, 3.0f}));
 }
 
+TEST_CASE("Undo drops restart history entries that can no longer be restored",
+          "[autosave]")
+{
+    const auto root = cupuacu::test::makeUniqueTestRoot("document-autosave");
+    {
+        cupuacu::test::StateWithTestPaths state{root};
+        initializeMonoDocument(state, {0.0f, 1.0f, 2.0f, 3.0f, 4.0f});
+        auto &session = state.getActiveDocumentSession();
+        for (int i = 0; i < 3; ++i)
+        {
+            session.selection.setValue1(1.0);
+            session.selection.setValue2(2.0);
+            cupuacu::actions::audio::performCut(&state);
+        }
+
+        drainPendingAutosave(state);
+        cupuacu::actions::persistSessionState(&state);
+    }
+
+    cupuacu::test::StateWithTestPaths restored{root};
+    std::vector<std::string> reportedTitles;
+    restored.errorReporter =
+        [&](const std::string &title, const std::string &)
+    { reportedTitles.push_back(title); };
+    const auto persisted = cupuacu::persistence::SessionStatePersistence::load(
+        restored.paths->sessionStatePath());
+    cupuacu::actions::restoreStartupDocument(&restored, {}, persisted);
+    REQUIRE(restored.getActiveUndoables().size() == 3);
+
+    // Only the newest entry is restored up front; the handles of the
+    // others are read from the restart history.
+    const auto oldestHandles =
+        restored.getActiveUndoables()[0]->payloadHandles();
+    const auto middleHandles =
+        restored.getActiveUndoables()[1]->payloadHandles();
+    REQUIRE(oldestHandles.size() == 1);
+    REQUIRE(middleHandles.size() == 1);
+    REQUIRE(std::filesystem::exists(oldestHandles.front().path));
+
+    restored.undo();
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 3.0f, 4.0f}));
+
+    std::filesystem::remove(middleHandles.front().path);
+    restored.undo();
+    REQUIRE(reportedTitles == std::vector<std::string>{"Undo unavailable"});
+    REQUIRE_FALSE(restored.canUndo());
+    REQUIRE_FALSE(std::filesystem::exists(oldestHandles.front().path));
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 3.0f, 4.0f}));
+
+    REQUIRE(restored.canRedo());
+    restored.redo();
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 4.0f}));
+}
+
 TEST_CASE("Startup restore preserves persistent redo history",
           "[autosave]")
 {
@@ -880,6 +1377,133 @@ TEST_CASE("Startup restore preserves persistent redo history",
     REQUIRE_FALSE(restored.canRedo());
 }
 
+TEST_CASE("Undo manifest appends history changes to its journal",
+          "[autosave]")
+{
+    const auto root = cupuacu::test::makeUniqueTestRoot("document-autosave");
+    {
+        cupuacu::test::StateWithTestPaths state{root};
+        initializeMonoDocument(state, {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f});
+        auto &session = state.getActiveDocumentSession();
+        const auto cutSecondFrame = [&]
+        {
+            session.selection.setValue1(1.0);
+            session.selection.setValue2(2.0);
+            cupuacu::actions::audio::performCut(&state);
+        };
+
+        cutSecondFrame();
+        cutSecondFrame();
+        drainPendingAutosave(state);
+        cupuacu::actions::persistSessionState(&state);
+
+        const auto manifestPath =
+            cupuacu::undo::manifestPathForStore(session.undoStore.root());
+        const auto readManifest = [&]
+        {
+            std::ifstream input(manifestPath);
+            return std::string(std::istreambuf_iterator<char>(input), {});
+        };
+        const auto compactedManifest = readManifest();
+
+        cutSecondFrame();
+        state.undo();
+        drainPendingAutosave(state);
+        cupuacu::actions::persistSessionState(&state);
+
+        REQUIRE(readManifest() == compactedManifest);
+        std::ifstream journal(
+            std::filesystem::path(manifestPath).replace_extension(".journal"));
+        std::size_t journalLineCount = 0;
+        for (std::string line; std::getline(journal, line);)
+        {
+            ++journalLineCount;
+        }
+        REQUIRE(journalLineCount > 1);
+    }
+
+    cupuacu::test::StateWithTestPaths restored{root};
+    const auto persisted = cupuacu::persistence::SessionStatePersistence::load(
+        restored.paths->sessionStatePath());
+    cupuacu::actions::restoreStartupDocument(&restored, {}, persisted);
+
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 3.0f, 4.0f, 5.0f}));
+    REQUIRE(restored.getActiveUndoables().size() == 2);
+    REQUIRE(restored.getActiveRedoables().size() == 1);
+
+    restored.redo();
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 4.0f, 5.0f}));
+    restored.undo();
+    restored.undo();
+    restored.undo();
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f}));
+    REQUIRE_FALSE(restored.canUndo());
+}
+
+TEST_CASE("Undo manifest keeps journaling after a save was cut short",
+          "[autosave]")
+{
+    const auto root = cupuacu::test::makeUniqueTestRoot("document-autosave");
+    const auto cutSecondFrame = [](cupuacu::State &state)
+    {
+        auto &session = state.getActiveDocumentSession();
+        session.selection.setValue1(1.0);
+        session.selection.setValue2(2.0);
+        cupuacu::actions::audio::performCut(&state);
+        drainPendingAutosave(state);
+        cupuacu::actions::persistSessionState(&state);
+    };
+    const auto restore = [&](cupuacu::test::StateWithTestPaths &state)
+    {
+        const auto persisted =
+            cupuacu::persistence::SessionStatePersistence::load(
+                state.paths->sessionStatePath());
+        cupuacu::actions::restoreStartupDocument(&state, {}, persisted);
+    };
+
+    {
+        cupuacu::test::StateWithTestPaths state{root};
+        initializeMonoDocument(state, {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f});
+        cutSecondFrame(state);
+        cutSecondFrame(state);
+        cutSecondFrame(state);
+
+        // A crash while appending leaves a line without its newline.
+        const auto journalPath =
+            std::filesystem::path(cupuacu::undo::manifestPathForStore(
+                                      state.getActiveDocumentSession()
+                                          .undoStore.root()))
+                .replace_extension(".journal");
+        REQUIRE(std::filesystem::exists(journalPath));
+        std::ofstream(journalPath, std::ios::app) << "{\"records\":[{\"st";
+    }
+
+    {
+        cupuacu::test::StateWithTestPaths restored{root};
+        restore(restored);
+        REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+                std::vector<float>({0.0f, 4.0f, 5.0f}));
+        REQUIRE(restored.getActiveUndoables().size() == 3);
+        cutSecondFrame(restored);
+    }
+
+    cupuacu::test::StateWithTestPaths restored{root};
+    restore(restored);
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 5.0f}));
+    REQUIRE(restored.getActiveUndoables().size() == 4);
+    for (int step = 0; step < 4; ++step)
+    {
+        restored.undo();
+    }
+    REQUIRE(readMonoSamples(restored.getActiveDocumentSession().document) ==
+            std::vector<float>({0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f}));
+    REQUIRE_FALSE(restored.canUndo());
+}
+
 TEST_CASE("Startup restore prunes stale undo stores and keeps active ones",
           "[autosave]")
 {
@@ -915,6 +1539,36 @@ TEST_CASE("Startup restore prunes stale undo stores and keeps active ones",
     REQUIRE(restored.canUndo());
 }
 
+TEST_CASE("Undo manifests of fresh sessions never share a generation",
+          "[autosave]")
+{
+    // A journal is applied to the manifest with its generation, so one
+    // left behind by a crash must not match a later session's manifest.
+    const auto persistedGeneration = []
+    {
+        cupuacu::test::StateWithTestPaths state{
+            cupuacu::test::makeUniqueTestRoot("document-autosave")};
+        initializeMonoDocument(state, {0.0f, 1.0f, 2.0f});
+        auto &session = state.getActiveDocumentSession();
+        session.selection.setValue1(1.0);
+        session.selection.setValue2(2.0);
+        cupuacu::actions::audio::performCut(&state);
+        drainPendingAutosave(state);
+        cupuacu::actions::persistSessionState(&state);
+
+        std::ifstream input(
+            cupuacu::undo::manifestPathForStore(session.undoStore.root()));
+        return nlohmann::json::parse(input).at("generation")
+            .get<std::uint64_t>();
+    };
+
+    const auto first = persistedGeneration();
+    const auto second = persistedGeneration();
+    REQUIRE(first != 0);
+    REQUIRE(second != 0);
+    REQUIRE(first != second);
+}
+
 TEST_CASE("Undo manifest restore fails cleanly for unsupported entry kinds",
           "[autosave]")
 {
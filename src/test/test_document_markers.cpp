@@ -76,28 +76,132 @@ TEST_CASE("Appending frames preserves metadata without rescanning old frames",
     REQUIRE_FALSE(lease.isDirty(0, 100000));
 }
 
-TEST_CASE("Document read lease blocks concurrent mutation",
-          "[document][threading]")
+TEST_CASE("Document dirty ranges follow insert and remove frame edits",
+          "[document]")
 {
+    using cupuacu::audio::FrameRange;
+
     cupuacu::Document document;
-    document.initialize(cupuacu::SampleFormat::PCM_S16, 44100, 1, 4);
-    document.setSample(0, 0, 0.0f);
+    document.initialize(cupuacu::SampleFormat::PCM_S16, 44100, 2, 1000);
+    for (int64_t frame = 100; frame < 200; ++frame)
+    {
+        document.setSample(0, frame, 0.25f, true);
+    }
+    document.setSample(0, 500, 0.5f, true);
+    document.setSample(1, 10, 0.5f, true);
+
+    {
+        auto lease = document.acquireReadLease();
+        REQUIRE(lease.getDirtyRanges(0, 0, 1000) ==
+                std::vector<FrameRange>{{100, 200}, {500, 501}});
+        REQUIRE(lease.getDirtyRanges(0, 150, 600) ==
+                std::vector<FrameRange>{{150, 200}, {500, 501}});
+        REQUIRE(lease.getDirtyRanges(1, 0, 1000) ==
+                std::vector<FrameRange>{{10, 11}});
+    }
 
-    std::future<void> mutation;
+    document.insertFrames(150, 50);
     {
-        const auto lease = document.acquireReadLease();
-        mutation = std::async(std::launch::async,
-                              [&document]
-                              {
-                                  document.setSample(0, 0, 0.5f);
-                              });
-
-        REQUIRE(mutation.wait_for(std::chrono::milliseconds(20)) ==
-                std::future_status::timeout);
+        auto lease = document.acquireReadLease();
+        REQUIRE(lease.getDirtyRanges(0, 0, 1050) ==
+                std::vector<FrameRange>{{100, 150}, {200, 250}, {550, 551}});
+        REQUIRE_FALSE(lease.isDirty(0, 175));
+        REQUIRE(lease.isDirty(1, 10));
     }
 
+    document.removeFrames(140, 70);
+    {
+        auto lease = document.acquireReadLease();
+        REQUIRE(lease.getDirtyRanges(0, 0, 980) ==
+                std::vector<FrameRange>{{100, 180}, {480, 481}});
+    }
+
+    document.writeChannelFloatBlock(1, 20, std::vector<float>(5, 0.1f).data(),
+                                    5, true);
+    {
+        auto lease = document.acquireReadLease();
+        REQUIRE(lease.getDirtyRanges(1, 0, 980) ==
+                std::vector<FrameRange>{{10, 11}, {20, 25}});
+    }
+
+    document.getAudioBuffer()->markAllClean();
+    auto lease = document.acquireReadLease();
+    REQUIRE(lease.getDirtyRanges(0, 0, 980).empty());
+    REQUIRE(lease.getDirtyRanges(1, 0, 980).empty());
+}
+
+TEST_CASE("Document segments carry dirty state and provenance as ranges",
+          "[document]")
+{
+    using cupuacu::audio::FrameRange;
+
+    cupuacu::Document document;
+    document.initialize(cupuacu::SampleFormat::PCM_S16, 44100, 1, 100000);
+    document.markCurrentStateAsSavedSource();
+    for (int64_t frame = 1000; frame < 1010; ++frame)
+    {
+        document.setSample(0, frame, 0.5f, true);
+    }
+    document.setSampleProvenance(0, 1005, {});
+
+    const auto segment = document.captureSegment(900, 50000);
+    REQUIRE(segment.frameCount == 50000);
+    REQUIRE(segment.dirty[0].getRanges() == std::vector<FrameRange>{{100, 110}});
+    REQUIRE(segment.provenance[0].size() == 2);
+    REQUIRE(segment.getProvenance(0, 0).frameIndex == 900);
+    REQUIRE_FALSE(segment.getProvenance(0, 105).isValid());
+    REQUIRE(segment.getProvenance(0, 49999).frameIndex == 50899);
+    REQUIRE(segment.samples[0][100] == document.getSample(0, 1000));
+
+    document.writeSegment(60000, segment);
+    auto lease = document.acquireReadLease();
+    REQUIRE(lease.getDirtyRanges(0, 50000, 100000) ==
+            std::vector<FrameRange>{{60100, 60110}});
+    REQUIRE(lease.getSampleProvenance(0, 60000).frameIndex == 900);
+    REQUIRE_FALSE(lease.getSampleProvenance(0, 60105).isValid());
+    REQUIRE(lease.getSampleProvenance(0, 60106).frameIndex == 1006);
+    REQUIRE(lease.getSampleProvenance(0, 59999).frameIndex == 59999);
+    REQUIRE(lease.getSample(0, 60100) == lease.getSample(0, 1000));
+}
+
+TEST_CASE("Document read lease pins a snapshot without blocking mutation",
+          "[document][threading]")
+{
+    cupuacu::Document document;
+    document.initialize(cupuacu::SampleFormat::PCM_S16, 44100, 1, 4);
+    document.setSample(0, 0, 0.0f);
+    const uint64_t markerId = document.addMarker(2, "Pinned");
+
+    const auto lease = document.acquireReadLease();
+    const auto pinnedVersion = lease.getWaveformDataVersion();
+    REQUIRE(pinnedVersion == document.getWaveformDataVersion());
+
+    auto mutation = std::async(std::launch::async,
+                               [&document, markerId]
+                               {
+                                   document.setSample(0, 0, 0.5f);
+                                   document.insertFrames(0, 2);
+                                   document.setMarkerLabel(markerId, "Moved");
+                               });
+    REQUIRE(mutation.wait_for(std::chrono::seconds(5)) ==
+            std::future_status::ready);
     mutation.get();
-    REQUIRE(document.getSample(0, 0) == 0.5f);
+
+    REQUIRE(document.getSample(0, 2) == 0.5f);
+    REQUIRE(document.getFrameCount() == 6);
+    REQUIRE(document.getWaveformDataVersion() > pinnedVersion);
+
+    REQUIRE(lease.getWaveformDataVersion() == pinnedVersion);
+    REQUIRE(lease.getSample(0, 0) == 0.0f);
+    REQUIRE(lease.getFrameCount() == 4);
+    REQUIRE(lease.getMarkers().size() == 1);
+    REQUIRE(lease.getMarkers()[0].frame == 2);
+    REQUIRE(lease.getMarkers()[0].label == "Pinned");
+
+    const auto nextLease = document.acquireReadLease();
+    REQUIRE(nextLease.getWaveformDataVersion() ==
+            document.getWaveformDataVersion());
+    REQUIRE(nextLease.getSample(0, 2) == 0.5f);
 }
 
 TEST_CASE("Document marker edits preserve identity", "[document][markers]")
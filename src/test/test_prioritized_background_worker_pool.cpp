@@ -0,0 +1,174 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "concurrency/PrioritizedBackgroundWorkerPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Pool = cupuacu::concurrency::PrioritizedBackgroundWorkerPool<int, int>;
+
+    template <typename Predicate>
+    bool waitUntil(Predicate &&predicate,
+                   const std::chrono::milliseconds timeout =
+                       std::chrono::milliseconds(500))
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            if (predicate())
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return predicate();
+    }
+} // namespace
+
+TEST_CASE("PrioritizedBackgroundWorkerPool runs the most urgent request first",
+          "[concurrency]")
+{
+    std::atomic<bool> gateOpen{false};
+    std::atomic<bool> gateEntered{false};
+    std::vector<int> processedRequests;
+    std::mutex processedMutex;
+
+    Pool pool(
+        [&](const int &request, const std::uint64_t,
+            const Pool::CancelCheck &, const Pool::PublishFn &publish)
+        {
+            if (request == 0)
+            {
+                gateEntered = true;
+                while (!gateOpen)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            {
+                std::lock_guard lock(processedMutex);
+                processedRequests.push_back(request);
+            }
+            publish(request);
+        },
+        1);
+    REQUIRE(pool.getThreadCount() == 1);
+
+    auto gate = pool.connect();
+    auto far = pool.connect();
+    auto nearLater = pool.connect();
+    auto nearEarlier = pool.connect();
+
+    (void)gate.submit(0, 0);
+    REQUIRE(waitUntil([&] { return gateEntered.load(); }));
+
+    (void)far.submit(3, 2);
+    (void)nearEarlier.submit(1, 1);
+    (void)nearLater.submit(2, 1);
+    gateOpen = true;
+
+    REQUIRE(waitUntil(
+        [&]
+        {
+            std::lock_guard lock(processedMutex);
+            return processedRequests.size() == 4;
+        }));
+    std::lock_guard lock(processedMutex);
+    REQUIRE(processedRequests == std::vector<int>{0, 1, 2, 3});
+}
+
+TEST_CASE("PrioritizedBackgroundWorkerPool cancels a client's superseded work",
+          "[concurrency]")
+{
+    std::atomic<int> canceledRequestsSeen{0};
+    Pool pool(
+        [&](const int &request, const std::uint64_t,
+            const Pool::CancelCheck &isCanceled, const Pool::PublishFn &publish)
+        {
+            for (int chunk = 0; chunk < request; ++chunk)
+            {
+                if (isCanceled())
+                {
+                    ++canceledRequestsSeen;
+                    return;
+                }
+                publish(chunk);
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        },
+        2);
+
+    auto client = pool.connect();
+    auto other = pool.connect();
+    REQUIRE(client.isConnected());
+
+    const auto generation1 = client.submit(100, 0);
+    REQUIRE(waitUntil([&] { return !client.takePublished().empty(); }));
+    const auto otherGeneration = other.submit(3, 0);
+    const auto generation2 = client.submit(3, 0);
+    REQUIRE(generation2 == generation1 + 1);
+    REQUIRE(client.latestGeneration() == generation2);
+
+    std::vector<Pool::PublishedResult> published;
+    std::vector<Pool::PublishedResult> otherPublished;
+    REQUIRE(waitUntil(
+        [&]
+        {
+            auto drained = client.takePublished();
+            published.insert(published.end(),
+                             std::make_move_iterator(drained.begin()),
+                             std::make_move_iterator(drained.end()));
+            auto otherDrained = other.takePublished();
+            otherPublished.insert(otherPublished.end(),
+                                  std::make_move_iterator(otherDrained.begin()),
+                                  std::make_move_iterator(otherDrained.end()));
+            return published.size() == 3 && otherPublished.size() == 3;
+        }));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(client.takePublished().empty());
+    REQUIRE(canceledRequestsSeen.load() == 1);
+    for (const auto &result : published)
+    {
+        REQUIRE(result.generation == generation2);
+    }
+    for (const auto &result : otherPublished)
+    {
+        REQUIRE(result.generation == otherGeneration);
+    }
+}
+
+TEST_CASE("PrioritizedBackgroundWorkerPool drops the work of closed clients",
+          "[concurrency]")
+{
+    std::atomic<bool> running{false};
+    std::atomic<bool> canceled{false};
+    Pool pool(
+        [&](const int &, const std::uint64_t,
+            const Pool::CancelCheck &isCanceled, const Pool::PublishFn &publish)
+        {
+            running = true;
+            while (!isCanceled())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            canceled = true;
+            publish(1);
+        },
+        1);
+
+    auto client = pool.connect();
+    (void)client.submit(1, 0);
+    REQUIRE(waitUntil([&] { return running.load(); }));
+
+    client.close();
+    REQUIRE_FALSE(client.isConnected());
+    REQUIRE(client.submit(2, 0) == 0);
+    REQUIRE(waitUntil([&] { return canceled.load(); }));
+    REQUIRE(client.takePublished().empty());
+}
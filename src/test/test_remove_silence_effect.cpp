@@ -214,3 +214,99 @@ TEST_CASE("Remove silence compacts only the selected stereo channel", "[effects]
     REQUIRE(doc.getSample(1, 1) == Approx(11.0f));
     REQUIRE(doc.getSample(1, 7) == Approx(17.0f));
 }
+
+TEST_CASE("Remove silence finds the same runs through waveform caches",
+          "[effects]")
+{
+    cupuacu::Document doc{};
+    doc.initialize(cupuacu::SampleFormat::FLOAT32, 48000, 2, 400000);
+    for (int64_t frame = 0; frame < doc.getFrameCount(); ++frame)
+    {
+        // Loud stretches, quiet noise and exact silence at unaligned
+        // boundaries.
+        const int64_t section = frame / 9973;
+        const float noise = static_cast<float>((frame * 7919) % 101) / 100.0f;
+        const float value = section % 3 == 0   ? 0.5f * noise - 0.25f
+                            : section % 3 == 1 ? 0.004f * noise
+                                               : 0.0f;
+        doc.setSample(0, frame, value, false);
+        doc.setSample(1, frame, section % 5 == 1 ? 0.3f : value, false);
+    }
+
+    cupuacu::waveform::DocumentWaveformCaches caches;
+    caches.resetToChannelCount(doc.getChannelCount());
+    caches.rebuildSynchronously(doc);
+
+    cupuacu::effects::RemoveSilenceSettings settings{};
+    settings.minimumSilenceLengthMs = 20.0;
+    const auto requireSameRuns = [&](const std::vector<int64_t> &channels,
+                                     const int64_t startFrame,
+                                     const int64_t frameCount,
+                                     const double threshold)
+    {
+        const auto scanned = cupuacu::effects::planSilenceRemoval(
+            doc, channels, startFrame, frameCount, threshold,
+            cupuacu::effects::RemoveSilenceMode::AllSilencesInSection,
+            settings);
+        const auto cached = cupuacu::effects::planSilenceRemoval(
+            doc, channels, startFrame, frameCount, threshold,
+            cupuacu::effects::RemoveSilenceMode::AllSilencesInSection,
+            settings, &caches);
+        REQUIRE(cached.size() == scanned.size());
+        for (std::size_t i = 0; i < scanned.size(); ++i)
+        {
+            REQUIRE(cached[i].startFrame == scanned[i].startFrame);
+            REQUIRE(cached[i].frameCount == scanned[i].frameCount);
+        }
+
+        REQUIRE(cupuacu::effects::computeAutoSilenceThresholdAbsolute(
+                    doc, channels, startFrame, frameCount, &caches) ==
+                cupuacu::effects::computeAutoSilenceThresholdAbsolute(
+                    doc, channels, startFrame, frameCount));
+        return scanned.size();
+    };
+
+    REQUIRE(requireSameRuns({0}, 0, doc.getFrameCount(), 0.0) > 0);
+    REQUIRE(requireSameRuns({0, 1}, 0, doc.getFrameCount(), 0.005) > 0);
+    requireSameRuns({1}, 1234, 300000, 0.005);
+    requireSameRuns({0, 1}, 70001, 129, 0.3);
+
+    // Frames changed since the caches were built are read as they are.
+    for (int64_t frame = 3000; frame < 12000; ++frame)
+    {
+        doc.setSample(0, frame, 0.0f, false);
+    }
+    caches.invalidateSamples(3000, 11999);
+    REQUIRE(requireSameRuns({0}, 0, doc.getFrameCount(), 0.0) > 0);
+}
+
+TEST_CASE("Remove silence keeps audio that waveform caches wrongly show as silent",
+          "[effects]")
+{
+    // Caches that were built for other audio of the same length, as a
+    // persistent cache matched by a sample of its content can be.
+    cupuacu::Document silent{};
+    silent.initialize(cupuacu::SampleFormat::FLOAT32, 48000, 1, 200000);
+    cupuacu::waveform::DocumentWaveformCaches caches;
+    caches.resetToChannelCount(silent.getChannelCount());
+    caches.rebuildSynchronously(silent);
+
+    cupuacu::Document doc{};
+    doc.initialize(cupuacu::SampleFormat::FLOAT32, 48000, 1, 200000);
+    for (int64_t frame = 50000; frame < 150000; ++frame)
+    {
+        doc.setSample(0, frame, frame % 2 == 0 ? 0.5f : -0.5f, false);
+    }
+
+    cupuacu::effects::RemoveSilenceSettings settings{};
+    settings.minimumSilenceLengthMs = 20.0;
+    const auto runs = cupuacu::effects::planSilenceRemoval(
+        doc, {0}, 0, doc.getFrameCount(), 0.0,
+        cupuacu::effects::RemoveSilenceMode::AllSilencesInSection, settings,
+        &caches);
+    REQUIRE(runs.size() == 2);
+    REQUIRE(runs[0].startFrame == 0);
+    REQUIRE(runs[0].frameCount == 50000);
+    REQUIRE(runs[1].startFrame == 150000);
+    REQUIRE(runs[1].frameCount == 50000);
+}
@@ -0,0 +1,80 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "TestPaths.hpp"
+#include "persistence/UndoHistoryPropertiesPersistence.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("Undo history properties persistence round-trip", "[persistence]")
+{
+    const auto testConfigRoot = cupuacu::test::makeUniqueTestRoot(
+        "undo-history-properties-round-trip");
+    cupuacu::test::StateWithTestPaths state{testConfigRoot};
+    const auto propertiesPath = state.paths->undoHistoryPropertiesPath();
+
+    const cupuacu::undo::UndoHistoryBudget budget{
+        .maxPendingBytes = 1234,
+        .maxSessionBytes = 0,
+        .maxTotalBytes = 123456789};
+
+    REQUIRE(cupuacu::persistence::UndoHistoryPropertiesPersistence::save(
+        propertiesPath, budget));
+
+    nlohmann::json persistedJson;
+    {
+        std::ifstream in(propertiesPath, std::ios::binary);
+        REQUIRE(in.good());
+        in >> persistedJson;
+    }
+
+    REQUIRE(persistedJson.at("version").get<int>() == 1);
+    REQUIRE(persistedJson.at("maxPendingBytes").get<uint64_t>() == 1234);
+    REQUIRE(persistedJson.at("maxSessionBytes").get<uint64_t>() == 0);
+    REQUIRE(persistedJson.at("maxTotalBytes").get<uint64_t>() == 123456789);
+
+    const auto loaded =
+        cupuacu::persistence::UndoHistoryPropertiesPersistence::load(
+            propertiesPath);
+    REQUIRE(loaded.has_value());
+    REQUIRE(*loaded == budget);
+}
+
+TEST_CASE("Undo history properties persistence rejects missing malformed and invalid values",
+          "[persistence]")
+{
+    REQUIRE_FALSE(cupuacu::persistence::UndoHistoryPropertiesPersistence::load(
+                      "")
+                      .has_value());
+    REQUIRE_FALSE(cupuacu::persistence::UndoHistoryPropertiesPersistence::save(
+        "", {}));
+
+    const auto testConfigRoot = cupuacu::test::makeUniqueTestRoot(
+        "undo-history-properties-invalid");
+    const auto propertiesPath =
+        testConfigRoot / "config-home" / "undo_history_properties.json";
+    std::filesystem::create_directories(propertiesPath.parent_path());
+
+    const auto requireRejected = [&](const char *contents)
+    {
+        {
+            std::ofstream out(propertiesPath,
+                              std::ios::binary | std::ios::trunc);
+            REQUIRE(out.good());
+            out << contents;
+        }
+        REQUIRE_FALSE(
+            cupuacu::persistence::UndoHistoryPropertiesPersistence::load(
+                propertiesPath)
+                .has_value());
+    };
+
+    requireRejected("{ invalid");
+    requireRejected(
+        R"({"version":1,"maxPendingBytes":1,"maxSessionBytes":-1,"maxTotalBytes":1})");
+    requireRejected(
+        R"({"version":2,"maxPendingBytes":1,"maxSessionBytes":1,"maxTotalBytes":1})");
+    requireRejected(R"({"version":1,"maxPendingBytes":1,"maxTotalBytes":1})");
+}
@@ -0,0 +1,117 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "undo/UndoPayloadCodec.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    std::vector<float> roundTrip(const std::vector<float> &samples,
+                                 std::size_t *encodedSize = nullptr)
+    {
+        const auto encoded =
+            cupuacu::undo::encodeSamples(samples.data(), samples.size());
+        if (encodedSize)
+        {
+            *encodedSize = encoded.size();
+        }
+        std::vector<float> decoded(samples.size(), 123.0f);
+        cupuacu::undo::decodeSamples(encoded.data(), encoded.size(),
+                                     decoded.data(), decoded.size());
+        return decoded;
+    }
+
+    bool bitIdentical(const std::vector<float> &a, const std::vector<float> &b)
+    {
+        return a.size() == b.size() &&
+               (a.empty() ||
+                std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+    }
+} // namespace
+
+TEST_CASE("Undo payload codec stores PCM code channels as small integers",
+          "[undo]")
+{
+    std::vector<float> samples(10000);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        const auto code = static_cast<int>(
+            std::lround(12000.0 * std::sin(static_cast<double>(i) * 0.01)));
+        samples[i] = static_cast<float>(code) / 32768.0f;
+    }
+
+    std::size_t encodedSize = 0;
+    REQUIRE(bitIdentical(roundTrip(samples, &encodedSize), samples));
+    REQUIRE(encodedSize < samples.size() * sizeof(float) / 4);
+}
+
+TEST_CASE("Undo payload codec round-trips arbitrary float bits exactly",
+          "[undo]")
+{
+    std::mt19937 random(1234);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+
+    std::vector<float> smooth(5000);
+    for (std::size_t i = 0; i < smooth.size(); ++i)
+    {
+        smooth[i] = 0.7f * std::sin(static_cast<float>(i) * 0.003f) +
+                    noise(random) * 0.01f;
+    }
+    std::size_t encodedSize = 0;
+    REQUIRE(bitIdentical(roundTrip(smooth, &encodedSize), smooth));
+    REQUIRE(encodedSize < smooth.size() * sizeof(float));
+
+    std::vector<float> special{0.0f,
+                               -0.0f,
+                               1.0f,
+                               -1.0f,
+                               std::numeric_limits<float>::infinity(),
+                               -std::numeric_limits<float>::infinity(),
+                               std::numeric_limits<float>::quiet_NaN(),
+                               std::numeric_limits<float>::denorm_min(),
+                               -std::numeric_limits<float>::max(),
+                               0.5f / 32768.0f};
+    REQUIRE(bitIdentical(roundTrip(special), special));
+
+    std::vector<float> white(3000);
+    std::uniform_int_distribution<std::uint32_t> bits;
+    for (auto &sample : white)
+    {
+        const auto value = bits(random);
+        std::memcpy(&sample, &value, sizeof(sample));
+    }
+    REQUIRE(bitIdentical(roundTrip(white, &encodedSize), white));
+    REQUIRE(encodedSize <= white.size() * sizeof(float) + 1);
+
+    REQUIRE(roundTrip({}).empty());
+    REQUIRE(bitIdentical(roundTrip(std::vector<float>(70000, 0.0f), &encodedSize),
+                         std::vector<float>(70000, 0.0f)));
+    REQUIRE(encodedSize < 70000 / 4);
+}
+
+TEST_CASE("Undo payload codec rejects truncated input", "[undo]")
+{
+    std::vector<float> samples(2000);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<float>(i % 300) / 32768.0f;
+    }
+    auto encoded = cupuacu::undo::encodeSamples(samples.data(), samples.size());
+    encoded.resize(encoded.size() / 2);
+
+    std::vector<float> decoded(samples.size());
+    REQUIRE_THROWS_AS(cupuacu::undo::decodeSamples(encoded.data(),
+                                                   encoded.size(),
+                                                   decoded.data(),
+                                                   decoded.size()),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(
+        cupuacu::undo::decodeSamples(nullptr, 0, decoded.data(), decoded.size()),
+        std::runtime_error);
+}
@@ -32,6 +32,7 @@
 #include <fstream>
 #include <optional>
 #include <random>
+#include <set>
 #include <string>
 #include <system_error>
 #include <thread>
@@ -1323,6 +1324,62 @@ TEST_CASE("Overwrite patches only one stereo channel sample in place", "[file]")
     REQUIRE(differingOffsets.size() == sizeof(std::int16_t));
 }
 
+TEST_CASE("Overwrite patches a long dirty range of one stereo channel in place",
+          "[file]")
+{
+    ScopedDirCleanup cleanup(
+        makeUniqueTempDir("cupuacu-test-wav-stereo-range-patch"));
+    const auto wavPath = cleanup.path() / "stereo_range.wav";
+
+    constexpr std::size_t kFrames = 40000;
+    constexpr std::size_t kDirtyStart = 10000;
+    constexpr std::size_t kDirtyEnd = 30000;
+    std::vector<int16_t> interleaved(kFrames * 2);
+    for (std::size_t i = 0; i < interleaved.size(); ++i)
+    {
+        interleaved[i] = static_cast<int16_t>(static_cast<int>(i % 2000) - 1000);
+    }
+    writePcm16WavFile(wavPath, 44100, 2, interleaved);
+    const auto originalBytes = readBytes(wavPath);
+
+    cupuacu::test::StateWithTestPaths state{};
+    state.getActiveDocumentSession().currentFile = wavPath.string();
+    cupuacu::file::loadSampleData(&state);
+    const std::vector<float> written(kDirtyEnd - kDirtyStart, 0.25f);
+    state.getActiveDocumentSession().document.writeChannelFloatBlock(
+        0, kDirtyStart, written.data(),
+        static_cast<int64_t>(written.size()), true);
+
+    REQUIRE(cupuacu::actions::overwritePreserving(&state));
+
+    const auto parsed = cupuacu::file::wav::WavParser::parseFile(wavPath);
+    const auto *dataChunk = parsed.findChunk("data");
+    REQUIRE(dataChunk != nullptr);
+    const auto differingOffsets =
+        findDifferingByteOffsets(originalBytes, readBytes(wavPath));
+    REQUIRE_FALSE(differingOffsets.empty());
+    std::set<std::size_t> patchedFrames;
+    for (const auto offset : differingOffsets)
+    {
+        REQUIRE(offset >= dataChunk->payloadOffset);
+        const auto sample =
+            (offset - dataChunk->payloadOffset) / sizeof(std::int16_t);
+        REQUIRE(sample % 2 == 0);
+        REQUIRE(sample / 2 >= kDirtyStart);
+        REQUIRE(sample / 2 < kDirtyEnd);
+        patchedFrames.insert(sample / 2);
+    }
+    REQUIRE(patchedFrames.size() == kDirtyEnd - kDirtyStart);
+
+    int sampleRate = 0;
+    int channels = 0;
+    const auto frames = readFramesAsFloat(wavPath, sampleRate, channels);
+    REQUIRE(frames[kDirtyStart * 2] ==
+            Catch::Approx(0.25f).margin(1.0f / 32767.0f));
+    REQUIRE(frames[(kDirtyEnd - 1) * 2] ==
+            Catch::Approx(0.25f).margin(1.0f / 32767.0f));
+}
+
 TEST_CASE("Overwrite after trim preserves surviving PCM16 sample bytes",
           "[file]")
 {
@@ -227,3 +227,247 @@ TEST_CASE("Synchronous file open persists and reuses the initial waveform cache"
         REQUIRE_FALSE(cacheState.levels.empty());
     }
 }
+
+TEST_CASE("Sampled content waveform cache keys survive copies and renames",
+          "[waveform][persistence]")
+{
+    const auto root =
+        cupuacu::test::makeUniqueTestRoot("waveform-cache-persistence");
+    cupuacu::test::StateWithTestPaths state{root};
+    const cupuacu::waveform::PersistentCacheSettings settings{
+        .keyMode = cupuacu::waveform::PersistentCacheKeyMode::SampledContent};
+
+    const auto sourcePath = root / "source.wav";
+    const auto renamedPath = root / "renamed.wav";
+    std::filesystem::create_directories(sourcePath.parent_path());
+    {
+        std::ofstream output(sourcePath, std::ios::binary);
+        REQUIRE(output.is_open());
+        output << "waveform";
+    }
+
+    std::vector<float> samples(400000);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<float>(static_cast<int64_t>(i % 251) - 125) /
+                     125.0f;
+    }
+
+    auto &session = state.getActiveDocumentSession();
+    initializeMonoDocument(session, samples);
+    session.setCurrentFile(sourcePath.string());
+    session.rebuildWaveformCacheSynchronously();
+
+    const auto key = session.getPersistentWaveformCacheKey(settings.keyMode);
+    REQUIRE(key.has_value());
+    REQUIRE(key->sourcePath.empty());
+    REQUIRE(key->sampledContentHash != 0);
+    REQUIRE(cupuacu::waveform::savePersistentWaveformCache(
+        session, *state.paths, settings));
+
+    std::filesystem::rename(sourcePath, renamedPath);
+    {
+        std::ofstream output(renamedPath, std::ios::binary | std::ios::app);
+        REQUIRE(output.is_open());
+        output << "retagged";
+    }
+
+    cupuacu::DocumentSession restored;
+    initializeMonoDocument(restored, samples);
+    restored.setCurrentFile(renamedPath.string());
+    REQUIRE_FALSE(cupuacu::waveform::loadPersistentWaveformCache(
+        restored, *state.paths));
+    REQUIRE(cupuacu::waveform::loadPersistentWaveformCache(
+        restored, *state.paths, settings));
+    requireBuildStatesEqual(restored.getWaveformCache(0).snapshotBuildState(),
+                            session.getWaveformCache(0).snapshotBuildState());
+
+    auto changedSamples = samples;
+    changedSamples.back() = 1.0f;
+    cupuacu::DocumentSession changed;
+    initializeMonoDocument(changed, changedSamples);
+    changed.setCurrentFile(renamedPath.string());
+    const auto changedKey =
+        changed.getPersistentWaveformCacheKey(settings.keyMode);
+    REQUIRE(changedKey.has_value());
+    REQUIRE(changedKey->cacheBasename() != key->cacheBasename());
+    REQUIRE_FALSE(cupuacu::waveform::loadPersistentWaveformCache(
+        changed, *state.paths, settings));
+}
+
+TEST_CASE("Waveform cache persistence evicts least recently used cache files",
+          "[waveform][persistence]")
+{
+    const auto root =
+        cupuacu::test::makeUniqueTestRoot("waveform-cache-persistence");
+    const auto cacheRoot = root / "waveform-cache";
+    std::filesystem::create_directories(cacheRoot);
+
+    const auto now = std::filesystem::file_time_type::clock::now();
+    const auto writeFile = [&](const std::string &name, const std::size_t size,
+                               const int ageInMinutes)
+    {
+        const auto path = cacheRoot / name;
+        {
+            std::ofstream output(path, std::ios::binary);
+            REQUIRE(output.is_open());
+            output << std::string(size, 'x');
+        }
+        std::filesystem::last_write_time(
+            path, now - std::chrono::minutes(ageInMinutes));
+        return path;
+    };
+
+    const auto oldest = writeFile("a.cupuacu-waveform-cache", 100, 30);
+    const auto older = writeFile("b.cupuacu-waveform-cache", 100, 20);
+    const auto kept = writeFile("c.cupuacu-waveform-cache", 100, 40);
+    const auto newest = writeFile("d.cupuacu-waveform-cache", 100, 10);
+    const auto unrelated = writeFile("notes.txt", 1000, 50);
+
+    REQUIRE(cupuacu::waveform::evictPersistentWaveformCaches(cacheRoot, 250,
+                                                             kept) == 200);
+    REQUIRE_FALSE(std::filesystem::exists(oldest));
+    REQUIRE_FALSE(std::filesystem::exists(older));
+    REQUIRE(std::filesystem::exists(kept));
+    REQUIRE(std::filesystem::exists(newest));
+    REQUIRE(std::filesystem::exists(unrelated));
+
+    REQUIRE(cupuacu::waveform::evictPersistentWaveformCaches(cacheRoot, 250,
+                                                             kept) == 0);
+}
+
+TEST_CASE("Saving a waveform cache keeps the cache directory within budget",
+          "[waveform][persistence]")
+{
+    const auto root =
+        cupuacu::test::makeUniqueTestRoot("waveform-cache-persistence");
+    cupuacu::test::StateWithTestPaths state{root};
+    const auto cacheRoot = state.paths->waveformCachePath();
+
+    const auto writeSource = [&](const std::string &name)
+    {
+        const auto path = root / name;
+        std::ofstream output(path, std::ios::binary);
+        REQUIRE(output.is_open());
+        output << name;
+        return path;
+    };
+
+    cupuacu::DocumentSession first;
+    initializeMonoDocument(first, std::vector<float>(4096, 0.5f));
+    first.setCurrentFile(writeSource("first.wav").string());
+    first.rebuildWaveformCacheSynchronously();
+    REQUIRE(cupuacu::waveform::savePersistentWaveformCache(first,
+                                                           *state.paths));
+    const auto firstCachePath = first.getPersistentWaveformCachePath(
+        *state.paths);
+    REQUIRE(std::filesystem::exists(firstCachePath));
+    std::filesystem::last_write_time(
+        firstCachePath,
+        std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+
+    const cupuacu::waveform::PersistentCacheSettings settings{
+        .maxDirectoryBytes = std::filesystem::file_size(firstCachePath)};
+
+    cupuacu::DocumentSession second;
+    initializeMonoDocument(second, std::vector<float>(4096, -0.5f));
+    second.setCurrentFile(writeSource("second.wav").string());
+    second.rebuildWaveformCacheSynchronously();
+    REQUIRE(cupuacu::waveform::savePersistentWaveformCache(
+        second, *state.paths, settings));
+
+    REQUIRE_FALSE(std::filesystem::exists(firstCachePath));
+    REQUIRE(std::filesystem::exists(
+        second.getPersistentWaveformCachePath(*state.paths)));
+    REQUIRE_FALSE(cupuacu::waveform::loadPersistentWaveformCache(
+        first, *state.paths, settings));
+    REQUIRE(cupuacu::waveform::loadPersistentWaveformCache(
+        second, *state.paths, settings));
+}
+
+TEST_CASE("Loaded waveform caches are read in place until they are edited",
+          "[waveform][persistence]")
+{
+    const auto root =
+        cupuacu::test::makeUniqueTestRoot("waveform-cache-persistence");
+    cupuacu::test::StateWithTestPaths state{root};
+
+    const auto sourcePath = root / "source.wav";
+    std::filesystem::create_directories(sourcePath.parent_path());
+    {
+        std::ofstream output(sourcePath, std::ios::binary);
+        REQUIRE(output.is_open());
+        output << "waveform";
+    }
+
+    std::vector<float> samples(100000);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] =
+            static_cast<float>(static_cast<int64_t>(i * 7 % 251) - 125) /
+            125.0f;
+    }
+
+    auto &session = state.getActiveDocumentSession();
+    initializeMonoDocument(session, samples);
+    session.setCurrentFile(sourcePath.string());
+    session.rebuildWaveformCacheSynchronously();
+    REQUIRE(cupuacu::waveform::savePersistentWaveformCache(session,
+                                                           *state.paths));
+
+    cupuacu::DocumentSession restored;
+    initializeMonoDocument(restored, samples);
+    restored.setCurrentFile(sourcePath.string());
+    REQUIRE(cupuacu::waveform::loadPersistentWaveformCache(restored,
+                                                           *state.paths));
+    REQUIRE(restored.getWaveformCache(0).hasMappedLevels());
+    requireBuildStatesEqual(restored.getWaveformCache(0).snapshotBuildState(),
+                            session.getWaveformCache(0).snapshotBuildState());
+
+    const int64_t editedFrame = 54321;
+    restored.document.setSample(0, editedFrame, 1.0f, false);
+    restored.invalidateWaveformSamples(editedFrame, editedFrame);
+    restored.rebuildWaveformCacheSynchronously();
+    REQUIRE_FALSE(restored.getWaveformCache(0).hasMappedLevels());
+
+    samples[static_cast<std::size_t>(editedFrame)] = 1.0f;
+    cupuacu::DocumentSession expected;
+    initializeMonoDocument(expected, samples);
+    expected.rebuildWaveformCacheSynchronously();
+    requireBuildStatesEqual(restored.getWaveformCache(0).snapshotBuildState(),
+                            expected.getWaveformCache(0).snapshotBuildState());
+}
+
+TEST_CASE("Waveform cache persistence rejects truncated cache files",
+          "[waveform][persistence]")
+{
+    const auto root =
+        cupuacu::test::makeUniqueTestRoot("waveform-cache-persistence");
+    cupuacu::test::StateWithTestPaths state{root};
+
+    const auto sourcePath = root / "source.wav";
+    std::filesystem::create_directories(sourcePath.parent_path());
+    {
+        std::ofstream output(sourcePath, std::ios::binary);
+        REQUIRE(output.is_open());
+        output << "waveform";
+    }
+
+    const std::vector<float> samples(4096, 0.25f);
+    auto &session = state.getActiveDocumentSession();
+    initializeMonoDocument(session, samples);
+    session.setCurrentFile(sourcePath.string());
+    session.rebuildWaveformCacheSynchronously();
+    REQUIRE(cupuacu::waveform::savePersistentWaveformCache(session,
+                                                           *state.paths));
+
+    const auto cachePath = session.getPersistentWaveformCachePath(*state.paths);
+    std::filesystem::resize_file(cachePath,
+                                 std::filesystem::file_size(cachePath) - 1);
+
+    cupuacu::DocumentSession restored;
+    initializeMonoDocument(restored, samples);
+    restored.setCurrentFile(sourcePath.string());
+    REQUIRE_FALSE(cupuacu::waveform::loadPersistentWaveformCache(
+        restored, *state.paths));
+}
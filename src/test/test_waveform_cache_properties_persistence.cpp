@@ -0,0 +1,82 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "TestPaths.hpp"
+#include "persistence/WaveformCachePropertiesPersistence.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("Waveform cache properties persistence round-trip", "[persistence]")
+{
+    const auto testConfigRoot = cupuacu::test::makeUniqueTestRoot(
+        "waveform-cache-properties-round-trip");
+    cupuacu::test::StateWithTestPaths state{testConfigRoot};
+    const auto propertiesPath = state.paths->waveformCachePropertiesPath();
+
+    const cupuacu::waveform::PersistentCacheSettings settings{
+        .keyMode = cupuacu::waveform::PersistentCacheKeyMode::SampledContent,
+        .maxDirectoryBytes = 123456789};
+
+    REQUIRE(cupuacu::persistence::WaveformCachePropertiesPersistence::save(
+        propertiesPath, settings));
+
+    nlohmann::json persistedJson;
+    {
+        std::ifstream in(propertiesPath, std::ios::binary);
+        REQUIRE(in.good());
+        in >> persistedJson;
+    }
+
+    REQUIRE(persistedJson.at("version").get<int>() == 1);
+    REQUIRE(persistedJson.at("keyMode").get<std::string>() ==
+            "sampled_content");
+    REQUIRE(persistedJson.at("maxDirectoryBytes").get<uint64_t>() ==
+            123456789);
+
+    const auto loaded =
+        cupuacu::persistence::WaveformCachePropertiesPersistence::load(
+            propertiesPath);
+    REQUIRE(loaded.has_value());
+    REQUIRE(*loaded == settings);
+}
+
+TEST_CASE("Waveform cache properties persistence rejects missing malformed and invalid values",
+          "[persistence]")
+{
+    REQUIRE_FALSE(cupuacu::persistence::WaveformCachePropertiesPersistence::load(
+                      "")
+                      .has_value());
+    REQUIRE_FALSE(cupuacu::persistence::WaveformCachePropertiesPersistence::save(
+        "", {}));
+
+    const auto testConfigRoot = cupuacu::test::makeUniqueTestRoot(
+        "waveform-cache-properties-invalid");
+    const auto propertiesPath =
+        testConfigRoot / "config-home" / "waveform_cache.json";
+    std::filesystem::create_directories(propertiesPath.parent_path());
+
+    const auto requireRejected = [&](const char *contents)
+    {
+        {
+            std::ofstream out(propertiesPath,
+                              std::ios::binary | std::ios::trunc);
+            REQUIRE(out.good());
+            out << contents;
+        }
+        REQUIRE_FALSE(
+            cupuacu::persistence::WaveformCachePropertiesPersistence::load(
+                propertiesPath)
+                .has_value());
+    };
+
+    requireRejected("{ invalid");
+    requireRejected(
+        R"({"version":1,"keyMode":"mystery","maxDirectoryBytes":1024})");
+    requireRejected(
+        R"({"version":1,"keyMode":"source_file","maxDirectoryBytes":-1})");
+    requireRejected(
+        R"({"version":2,"keyMode":"source_file","maxDirectoryBytes":1024})");
+    requireRejected(R"({"version":1,"keyMode":"source_file"})");
+}
@@ -5,18 +5,24 @@
 #include "TestPaths.hpp"
 #include "TestResourceUtil.hpp"
 #include "actions/audio/EditCommands.hpp"
+#include "audio/FrameRangeVersions.hpp"
 #include "file/file_loading.hpp"
 #include "gui/DevicePropertiesWindow.hpp"
 #include "gui/LabeledField.hpp"
 #include "gui/Waveform.hpp"
 #include "gui/WaveformBlockRenderPlanning.hpp"
+#include "gui/WaveformCache.hpp"
 #include "gui/WaveformOverviewPlanning.hpp"
 #include "gui/ScrollBar.hpp"
+#include "gui/WaveformSmoothReconstruction.hpp"
 #include "gui/WaveformSmoothRenderPlanning.hpp"
+#include "gui/WaveformTilePool.hpp"
+#include "waveform/DocumentWaveformCaches.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <map>
+#include <random>
 #include <filesystem>
 #include <chrono>
 #include <system_error>
@@ -119,6 +125,291 @@ TEST_CASE("Waveform overview planning maps frame spans to fill rects",
     REQUIRE(rect->h == 24);
 }
 
+TEST_CASE("Waveform peak kernels match the scalar kernels", "[gui]")
+{
+    using cupuacu::gui::Peak;
+    using cupuacu::gui::PeakKernelSet;
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> samples(1000);
+    for (auto &sample : samples)
+    {
+        sample = distribution(random);
+    }
+
+    for (const auto kernelSet :
+         {PeakKernelSet::Sse2, PeakKernelSet::Avx2, PeakKernelSet::Neon})
+    {
+        if (!cupuacu::gui::isPeakKernelSetSupported(kernelSet))
+        {
+            continue;
+        }
+
+        for (const int64_t sampleCount : {1, 7, 8, 17, 128, 129, 1000})
+        {
+            for (const int64_t blockSize : {1, 5, 16, 128})
+            {
+                const int64_t blocks = (sampleCount + blockSize - 1) / blockSize;
+                std::vector<Peak> expected(static_cast<std::size_t>(blocks));
+                std::vector<Peak> actual(expected.size());
+                cupuacu::gui::computeBlockPeaks(PeakKernelSet::Scalar,
+                                                samples.data(), sampleCount,
+                                                blockSize, expected.data());
+                cupuacu::gui::computeBlockPeaks(kernelSet, samples.data(),
+                                                sampleCount, blockSize,
+                                                actual.data());
+                for (std::size_t i = 0; i < expected.size(); ++i)
+                {
+                    REQUIRE(actual[i].min == expected[i].min);
+                    REQUIRE(actual[i].max == expected[i].max);
+                }
+
+                std::vector<Peak> expectedFolded((expected.size() + 1) / 2);
+                std::vector<Peak> actualFolded(expectedFolded.size());
+                cupuacu::gui::foldPeaks(PeakKernelSet::Scalar, expected.data(),
+                                        blocks, expectedFolded.data());
+                cupuacu::gui::foldPeaks(kernelSet, expected.data(), blocks,
+                                        actualFolded.data());
+                for (std::size_t i = 0; i < expectedFolded.size(); ++i)
+                {
+                    REQUIRE(actualFolded[i].min == expectedFolded[i].min);
+                    REQUIRE(actualFolded[i].max == expectedFolded[i].max);
+                }
+            }
+        }
+    }
+
+    // A partial rebuild from a slice refolds the levels above it.
+    cupuacu::gui::WaveformCache cache;
+    cache.init(static_cast<int64_t>(samples.size()));
+    auto state = cache.snapshotBuildState();
+    auto result = cupuacu::gui::WaveformCache::buildFromState(
+        state, static_cast<const float *>(samples.data()));
+    samples[300] = 2.0f;
+    cupuacu::gui::WaveformCache::rebuildDirtyBlockRangeFromSlice(
+        result.levels, result.energyLevels,
+        static_cast<int64_t>(samples.size()), 2, 2, 256,
+        samples.data() + 256, 128);
+    REQUIRE(result.levels[0][2].max == 2.0f);
+    REQUIRE(result.levels.back().front().max == 2.0f);
+}
+
+TEST_CASE("Waveform cache inserts and erases rebuild only the peaks around "
+          "them",
+          "[gui]")
+{
+    using cupuacu::gui::Peak;
+    using cupuacu::gui::WaveformCache;
+
+    std::mt19937 rng(19);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> samples(1 << 20);
+    for (auto &sample : samples)
+    {
+        sample = distribution(rng);
+    }
+
+    WaveformCache cache;
+    cache.rebuildAll(samples.data(), static_cast<int64_t>(samples.size()));
+    const auto totalBlocks =
+        static_cast<int64_t>(cache.getLevelByIndex(0).size());
+
+    // Every level-0 peak must be that of the frames the layout puts in its
+    // block, and every level above the fold of the one below.
+    const auto requireCacheMatchesSamples = [&]
+    {
+        REQUIRE_FALSE(cache.hasDirtyBlocks());
+        REQUIRE(cache.isLaidOutFor(static_cast<int64_t>(samples.size())));
+        const auto state = cache.snapshotBuildState();
+        std::vector<Peak> expected(state.levels[0].size(),
+                                   WaveformCache::EMPTY_PEAK);
+        for (int64_t frame = 0; frame < static_cast<int64_t>(samples.size());
+             ++frame)
+        {
+            auto &peak = expected[static_cast<std::size_t>(
+                state.layout.gridPositionOf(frame) /
+                WaveformCache::BASE_BLOCK_SIZE)];
+            peak.min = std::min(peak.min, samples[frame]);
+            peak.max = std::max(peak.max, samples[frame]);
+        }
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            REQUIRE(state.levels[0][i].min == expected[i].min);
+            REQUIRE(state.levels[0][i].max == expected[i].max);
+        }
+        for (std::size_t level = 1; level < state.levels.size(); ++level)
+        {
+            const auto &below = state.levels[level - 1];
+            std::vector<Peak> folded((below.size() + 1) / 2);
+            cupuacu::gui::foldPeaks(below.data(),
+                                    static_cast<int64_t>(below.size()),
+                                    folded.data());
+            REQUIRE(state.levels[level].size() == folded.size());
+            for (std::size_t i = 0; i < folded.size(); ++i)
+            {
+                REQUIRE(state.levels[level][i].min == folded[i].min);
+                REQUIRE(state.levels[level][i].max == folded[i].max);
+            }
+        }
+        REQUIRE(state.levels.back().size() == 1);
+    };
+
+    const auto dirtyBlocks = [&]
+    {
+        return WaveformCache::dirtyBlockCount(cache.snapshotBuildState());
+    };
+
+    // An unaligned insert near the start only dirties the blocks of the
+    // grid it opened up, not the frames moved after it.
+    std::vector<float> inserted(1000, 1.5f);
+    samples.insert(samples.begin() + 333, inserted.begin(), inserted.end());
+    cache.applyInsert(333, 1000);
+    REQUIRE(dirtyBlocks() <=
+            WaveformCache::SHIFT_ALIGNMENT / WaveformCache::BASE_BLOCK_SIZE + 1);
+    cache.rebuildDirty(samples.data());
+    requireCacheMatchesSamples();
+
+    samples.erase(samples.begin() + 5000, samples.begin() + 70001);
+    cache.applyErase(5000, 70001);
+    REQUIRE(dirtyBlocks() <=
+            2 * WaveformCache::SHIFT_ALIGNMENT / WaveformCache::BASE_BLOCK_SIZE);
+    cache.rebuildDirty(samples.data());
+    requireCacheMatchesSamples();
+
+    // Frames inserted where others were erased go into the gap left there.
+    samples.insert(samples.begin() + 5000, 77, -1.25f);
+    cache.applyInsert(5000, 77);
+    REQUIRE(dirtyBlocks() <= 2);
+    cache.rebuildDirty(samples.data());
+    requireCacheMatchesSamples();
+
+    // Appending and erasing the end only touch the last blocks.
+    samples.insert(samples.end(), 300, 0.75f);
+    cache.applyInsert(static_cast<int64_t>(samples.size()) - 300, 300);
+    cache.rebuildDirty(samples.data());
+    requireCacheMatchesSamples();
+    samples.resize(samples.size() - 4000);
+    cache.applyErase(static_cast<int64_t>(samples.size()),
+                     static_cast<int64_t>(samples.size()) + 4000);
+    REQUIRE(dirtyBlocks() == 1);
+    cache.rebuildDirty(samples.data());
+    requireCacheMatchesSamples();
+
+    REQUIRE(cache.builtSamplePrefixEnd() ==
+            static_cast<int64_t>(samples.size()));
+    REQUIRE(static_cast<int64_t>(cache.getLevelByIndex(0).size()) <
+            totalBlocks + 2 * WaveformCache::SHIFT_ALIGNMENT /
+                              WaveformCache::BASE_BLOCK_SIZE);
+}
+
+TEST_CASE("Waveform cache range statistics match the frames they cover",
+          "[gui]")
+{
+    using cupuacu::gui::WaveformCache;
+
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> distribution(-0.9f, 0.9f);
+    std::vector<float> samples(300001);
+    for (auto &sample : samples)
+    {
+        sample = distribution(rng);
+    }
+    for (std::size_t i = 0; i < samples.size(); i += 977)
+    {
+        samples[i] = i % 2 == 0 ? 1.0f : -1.0f;
+    }
+
+    WaveformCache cache;
+    cache.rebuildAll(samples.data(), static_cast<int64_t>(samples.size()));
+
+    int64_t framesRead = 0;
+    const auto readFrames = [&](const int64_t frameStart, const int64_t count)
+    {
+        framesRead += count;
+        return static_cast<const float *>(samples.data() + frameStart);
+    };
+
+    const auto requireStatisticsMatchSamples =
+        [&](const int64_t frameStart, const int64_t frameEnd)
+    {
+        double sumOfSquares = 0.0;
+        int64_t clipCount = 0;
+        float minSample = WaveformCache::EMPTY_PEAK.min;
+        float maxSample = WaveformCache::EMPTY_PEAK.max;
+        for (int64_t frame = frameStart; frame < frameEnd; ++frame)
+        {
+            const float sample = samples[static_cast<std::size_t>(frame)];
+            sumOfSquares += static_cast<double>(sample) * sample;
+            clipCount +=
+                std::fabs(sample) >= cupuacu::gui::CLIPPED_SAMPLE_LEVEL ? 1
+                                                                        : 0;
+            minSample = std::min(minSample, sample);
+            maxSample = std::max(maxSample, sample);
+        }
+
+        const auto statistics =
+            cache.getRangeStatistics(frameStart, frameEnd, readFrames);
+        REQUIRE(statistics.frameCount == frameEnd - frameStart);
+        REQUIRE(statistics.clipCount == clipCount);
+        REQUIRE(statistics.peak.min == minSample);
+        REQUIRE(statistics.peak.max == maxSample);
+        REQUIRE(statistics.sumOfSquares ==
+                Catch::Approx(sumOfSquares).epsilon(1.0e-4).margin(1.0e-6));
+    };
+
+    const auto requireRandomRangesMatch = [&]
+    {
+        const auto frameCount = static_cast<int64_t>(samples.size());
+        requireStatisticsMatchSamples(0, frameCount);
+        requireStatisticsMatchSamples(5, 6);
+        requireStatisticsMatchSamples(128, 256);
+        std::uniform_int_distribution<int64_t> frames(0, frameCount);
+        for (int i = 0; i < 64; ++i)
+        {
+            auto a = frames(rng);
+            auto b = frames(rng);
+            requireStatisticsMatchSamples(std::min(a, b), std::max(a, b));
+        }
+    };
+
+    requireRandomRangesMatch();
+
+    // Long ranges take their built blocks from the levels.
+    framesRead = 0;
+    (void)cache.getRangeStatistics(
+        1, static_cast<int64_t>(samples.size()) - 1, readFrames);
+    REQUIRE(framesRead < 2 * WaveformCache::BASE_BLOCK_SIZE);
+
+    const auto topLevel = cache.levelsCount() - 1;
+    REQUIRE(cache.getEnergyLevelByIndex(topLevel).size() == 1);
+    REQUIRE(cache.getEnergyLevelByIndex(topLevel)[0].clipCount ==
+            cache.getRangeStatistics(0, static_cast<int64_t>(samples.size()),
+                                     readFrames)
+                .clipCount);
+
+    // Dirty blocks are read from the frames until they are built again,
+    // and the energies move along with edits as the peaks do.
+    samples.insert(samples.begin() + 4321, 5000, 1.0f);
+    cache.applyInsert(4321, 5000);
+    REQUIRE(cache.hasDirtyBlocks());
+    requireRandomRangesMatch();
+    cache.rebuildDirty(samples.data());
+    requireRandomRangesMatch();
+
+    samples.erase(samples.begin() + 10000, samples.begin() + 150000);
+    cache.applyErase(10000, 150000);
+    requireRandomRangesMatch();
+    cache.rebuildDirty(samples.data());
+    REQUIRE_FALSE(cache.getFrameLayout().isIdentity());
+    requireRandomRangesMatch();
+
+    const auto statistics = cache.getRangeStatistics(4321, 9321, readFrames);
+    REQUIRE(statistics.clipCount == 5000);
+    REQUIRE(statistics.magnitude() == 1.0f);
+    REQUIRE(statistics.rms() == Catch::Approx(1.0));
+}
+
 TEST_CASE("Waveform smooth spline evaluation and segment quads handle edge cases",
           "[gui]")
 {
@@ -153,6 +444,87 @@ TEST_CASE("Waveform smooth spline evaluation and segment quads handle edge cases
     REQUIRE(vertical->vertices[2].y == Catch::Approx(9.0f));
 }
 
+TEST_CASE("Waveform smooth reconstruction passes through the frames it draws",
+          "[gui]")
+{
+    using cupuacu::gui::PeakKernelSet;
+
+    std::vector<float> samples(1000);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<float>(std::sin(0.3 * static_cast<double>(i)));
+    }
+    int readCount = 0;
+    const auto readFrames = [&](const int64_t startFrame, float *destination,
+                                const int64_t frameCount)
+    {
+        ++readCount;
+        REQUIRE(startFrame >= 0);
+        const auto count = std::min<int64_t>(
+            frameCount, static_cast<int64_t>(samples.size()) - startFrame);
+        std::copy_n(samples.begin() + startFrame, count, destination);
+        return count;
+    };
+
+    cupuacu::gui::WaveformSmoothReconstructor reconstructor;
+    REQUIRE(reconstructor.reconstruct(200, 0.25, 1000, 1000, readFrames)
+                .empty());
+    REQUIRE(readCount == 0);
+
+    // Pixel x is at frame x / 4 + 9.5, so pixels 2 and 6 are on frames 10
+    // and 11.
+    const auto values = reconstructor.reconstruct(200, 0.25, 10, 1000,
+                                                  readFrames);
+    REQUIRE(values.size() == 201);
+    REQUIRE(values[2] == Catch::Approx(samples[10]).margin(1.0e-6));
+    REQUIRE(values[6] == Catch::Approx(samples[11]).margin(1.0e-6));
+    REQUIRE(values[4] > std::min(samples[10], samples[11]));
+    REQUIRE(values[4] < std::max(samples[10], samples[11]));
+
+    const auto again = reconstructor.reconstruct(200, 0.25, 10, 1000,
+                                                 readFrames);
+    REQUIRE(again.data() == values.data());
+
+    // Cut short where the document ends, holding the frames at either end.
+    const auto atStart = reconstructor.reconstruct(
+        200, 0.25, 0, 20, [&](const int64_t startFrame, float *destination,
+                              const int64_t frameCount)
+        {
+            REQUIRE(startFrame + frameCount <= 20);
+            std::fill_n(destination, frameCount, 0.5f);
+            return frameCount;
+        });
+    REQUIRE(atStart.size() == 81);
+    for (const float value : atStart)
+    {
+        REQUIRE(value == Catch::Approx(0.5f).margin(1.0e-6));
+    }
+
+    const auto window =
+        cupuacu::gui::planWaveformSmoothSampleWindow(300, 0.37, 100, 1000);
+    std::vector<float> expected(static_cast<std::size_t>(window.pixelCount));
+    cupuacu::gui::reconstructSmoothWaveform(
+        PeakKernelSet::Scalar, samples.data() + window.firstFrame, window,
+        0.37, 100, expected.data());
+    for (const auto kernelSet :
+         {PeakKernelSet::Sse2, PeakKernelSet::Avx2, PeakKernelSet::Neon})
+    {
+        if (!cupuacu::gui::isPeakKernelSetSupported(kernelSet))
+        {
+            continue;
+        }
+
+        std::vector<float> actual(expected.size());
+        cupuacu::gui::reconstructSmoothWaveform(
+            kernelSet, samples.data() + window.firstFrame, window, 0.37, 100,
+            actual.data());
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            REQUIRE(actual[i] == Catch::Approx(expected[i]).margin(1.0e-5));
+        }
+    }
+}
+
 TEST_CASE("LabeledField marks itself dirty only when the displayed value changes",
           "[gui]")
 {
@@ -217,6 +589,62 @@ TEST_CASE("DocumentSession publishes waveform cache results from background work
     REQUIRE(built);
 }
 
+TEST_CASE("Background waveform builds match synchronous builds across channels",
+          "[gui][waveform]")
+{
+    cupuacu::Document document;
+    constexpr int64_t frameCount = (1 << 21) + 77;
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 2, frameCount);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    for (int64_t channel = 0; channel < 2; ++channel)
+    {
+        for (int64_t frame = 0; frame < frameCount; ++frame)
+        {
+            document.setSample(channel, frame, distribution(random), false);
+        }
+    }
+
+    cupuacu::waveform::DocumentWaveformCaches background;
+    background.resetToChannelCount(2);
+    background.invalidateSamples(0, frameCount - 1);
+    const auto version = document.getWaveformDataVersion();
+    background.update(document, version);
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (background.getBuildProgress(document, version).has_value() &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+        (void)background.pumpWork(document, version);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE_FALSE(background.getBuildProgress(document, version).has_value());
+
+    cupuacu::waveform::DocumentWaveformCaches synchronous;
+    synchronous.resetToChannelCount(2);
+    synchronous.rebuildSynchronously(document);
+
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        const auto &built = background.getCache(channel);
+        const auto &expected = synchronous.getCache(channel);
+        REQUIRE_FALSE(built.hasDirtyBlocks());
+        REQUIRE(built.levelsCount() == expected.levelsCount());
+        for (int level = 0; level < built.levelsCount(); ++level)
+        {
+            const auto &builtPeaks = built.getLevelByIndex(level);
+            const auto &expectedPeaks = expected.getLevelByIndex(level);
+            REQUIRE(builtPeaks.size() == expectedPeaks.size());
+            for (std::size_t i = 0; i < builtPeaks.size(); ++i)
+            {
+                REQUIRE(builtPeaks[i].min == expectedPeaks[i].min);
+                REQUIRE(builtPeaks[i].max == expectedPeaks[i].max);
+            }
+        }
+    }
+}
+
 TEST_CASE("Waveform overview planning keeps drawing the clean prefix after frame erasure while cache rebuild is pending",
           "[gui][waveform]")
 {
@@ -412,6 +840,203 @@ TEST_CASE("Background block render input avoids raw sample snapshots for zoomed-
     REQUIRE(zoomedIn.samplesPerPeak == 0);
 }
 
+TEST_CASE("FrameRangeVersions only changes ranges that overlap a change",
+          "[gui][waveform]")
+{
+    using cupuacu::audio::FrameRangeVersions;
+    FrameRangeVersions versions;
+    const auto before = versions.versionOf(0, 1000);
+    const auto beforeHead = versions.versionOf(0, 100);
+    const auto beforeTail = versions.versionOf(200, 1000);
+
+    versions.markChanged(100, 200);
+    REQUIRE(versions.versionOf(0, 100) == beforeHead);
+    REQUIRE(versions.versionOf(200, 1000) == beforeTail);
+    REQUIRE(versions.versionOf(150, 151) > before);
+    REQUIRE(versions.versionOf(0, 101) == versions.versionOf(150, 151));
+
+    const auto changed = versions.versionOf(100, 200);
+    versions.markChanged(500, FrameRangeVersions::END);
+    REQUIRE(versions.versionOf(100, 200) == changed);
+    REQUIRE(versions.versionOf(200, 500) == beforeTail);
+    REQUIRE(versions.versionOf(499, 501) > changed);
+    REQUIRE(versions.versionOf(1000000, 1000001) ==
+            versions.versionOf(499, 501));
+
+    for (int64_t i = 0; i < 2000; ++i)
+    {
+        versions.markChanged(1000 + i * 10, 1000 + i * 10 + 5);
+    }
+    REQUIRE(versions.getRunCount() <= FrameRangeVersions::MAX_RUN_COUNT);
+    REQUIRE(versions.versionOf(0, 100) == beforeHead);
+}
+
+TEST_CASE("FrameRangeVersions joins contiguous changes into one run",
+          "[gui][waveform]")
+{
+    using cupuacu::audio::FrameRangeVersions;
+    FrameRangeVersions versions;
+    const auto untouched = versions.versionOf(0, 1000);
+
+    for (int64_t frame = 1000; frame < 3000; ++frame)
+    {
+        versions.markChanged(frame, frame + 1);
+    }
+    REQUIRE(versions.getRunCount() == 3);
+    REQUIRE(versions.versionOf(0, 1000) == untouched);
+    REQUIRE(versions.versionOf(3000, 4000) == untouched);
+    REQUIRE(versions.versionOf(1000, 1001) > untouched);
+    REQUIRE(versions.versionOf(2999, 3000) == versions.versionOf(1000, 1001));
+
+    // Backwards and inside the run joins it too.
+    for (int64_t frame = 999; frame >= 900; --frame)
+    {
+        versions.markChanged(frame, frame + 1);
+    }
+    versions.markChanged(1500, 1600);
+    REQUIRE(versions.getRunCount() == 3);
+    REQUIRE(versions.versionOf(0, 900) == untouched);
+    REQUIRE(versions.versionOf(900, 901) > versions.versionOf(0, 900));
+
+    // A change that does not touch the last one starts a run of its own.
+    const auto joined = versions.versionOf(900, 3000);
+    versions.markChanged(5000, 5001);
+    REQUIRE(versions.getRunCount() == 5);
+    REQUIRE(versions.versionOf(900, 3000) == joined);
+
+    FrameRangeVersions streamed;
+    constexpr int64_t blockFrames = 512;
+    constexpr int64_t joinedRuns = 4;
+    for (int64_t frame = 0;
+         frame < FrameRangeVersions::MAX_JOINED_RUN_LENGTH * joinedRuns;
+         frame += blockFrames)
+    {
+        streamed.markChanged(frame, frame + blockFrames);
+    }
+    REQUIRE(streamed.getRunCount() == joinedRuns + 1);
+}
+
+TEST_CASE("Document frame range versions follow edits and moved frames",
+          "[gui][waveform]")
+{
+    cupuacu::Document document;
+    document.initialize(cupuacu::SampleFormat::FLOAT32, 44100, 2, 10000);
+
+    const auto head = document.getFrameRangeVersion(0, 0, 1000);
+    const auto tail = document.getFrameRangeVersion(0, 5000, 6000);
+    const auto otherChannel = document.getFrameRangeVersion(1, 0, 10000);
+    const auto otherChannelHead = document.getFrameRangeVersion(1, 0, 1000);
+
+    document.setSample(0, 5500, 0.5f);
+    REQUIRE(document.getFrameRangeVersion(0, 0, 1000) == head);
+    REQUIRE(document.getFrameRangeVersion(0, 5000, 6000) != tail);
+    REQUIRE(document.getFrameRangeVersion(1, 0, 10000) == otherChannel);
+
+    const auto edited = document.getFrameRangeVersion(0, 5000, 6000);
+    document.insertFrames(2000, 100);
+    REQUIRE(document.getFrameRangeVersion(0, 0, 1000) == head);
+    REQUIRE(document.getFrameRangeVersion(0, 5000, 6000) != edited);
+    REQUIRE(document.getFrameRangeVersion(1, 0, 1000) == otherChannelHead);
+    REQUIRE(document.getFrameRangeVersion(1, 0, 10000) != otherChannel);
+
+    REQUIRE(document.getFrameRangeVersion(2, 0, 1000) == 0);
+}
+
+TEST_CASE("Waveform tiles cover the view from frame 0 at a fixed width",
+          "[gui][waveform]")
+{
+    using cupuacu::gui::WAVEFORM_TILE_WIDTH;
+    const auto atStart = cupuacu::gui::planWaveformTileSpan(0, 4.0, 600);
+    REQUIRE(atStart.firstTileIndex == 0);
+    REQUIRE(atStart.firstTileX == 0);
+    REQUIRE(atStart.tileCount == 3);
+
+    // 300 pixels into the channel: tile 1 starts 44 pixels left of the view.
+    const auto scrolled = cupuacu::gui::planWaveformTileSpan(1200, 4.0, 600);
+    REQUIRE(scrolled.firstTileIndex == 1);
+    REQUIRE(scrolled.firstTileX == -44);
+    REQUIRE(scrolled.tileCount == 3);
+    REQUIRE(scrolled.firstTileX + scrolled.tileCount * WAVEFORM_TILE_WIDTH >=
+            600);
+
+    REQUIRE(cupuacu::gui::waveformTileSampleOffset(1, 4.0) == 1024);
+    const auto frames = cupuacu::gui::waveformTileFrameRange(1, 4.0);
+    REQUIRE(frames.startFrame == 1016);
+    REQUIRE(frames.endFrameExclusive == 1024 + (WAVEFORM_TILE_WIDTH + 2) * 4);
+}
+
+TEST_CASE("Waveform tile pool evicts the least recently used tiles",
+          "[gui][waveform]")
+{
+    std::vector<int> destroyed;
+    cupuacu::gui::WaveformTilePool<int> pool(
+        [&](const int texture) { destroyed.push_back(texture); }, 300);
+    const auto keyFor = [](const int64_t tileIndex)
+    {
+        return cupuacu::gui::WaveformTileKey{.samplesPerPixel = 4.0,
+                                             .verticalZoom = 1.0,
+                                             .height = 100,
+                                             .pixelScale = 1,
+                                             .uiScale = 1.0f,
+                                             .tileIndex = tileIndex,
+                                             .dataVersion = 1};
+    };
+
+    pool.insert(keyFor(0), 10, 100);
+    pool.insert(keyFor(1), 11, 100);
+    pool.insert(keyFor(2), 12, 100);
+    REQUIRE(pool.find(keyFor(0)) != nullptr);
+
+    pool.insert(keyFor(3), 13, 100);
+    REQUIRE(destroyed == std::vector<int>{11});
+    REQUIRE_FALSE(pool.contains(keyFor(1)));
+    REQUIRE(pool.contains(keyFor(0)));
+    REQUIRE(pool.getUsedBytes() == 300);
+
+    auto changedKey = keyFor(2);
+    changedKey.dataVersion = 2;
+    REQUIRE(pool.find(changedKey) == nullptr);
+
+    pool.insert(keyFor(3), 23, 100);
+    REQUIRE(destroyed == std::vector<int>{11, 13});
+    REQUIRE(*pool.find(keyFor(3)) == 23);
+
+    pool.clear();
+    REQUIRE(pool.size() == 0);
+    REQUIRE(destroyed.size() == 5);
+}
+
+TEST_CASE("Pinned waveform cache levels outlive later cache edits",
+          "[gui][waveform]")
+{
+    using cupuacu::gui::Peak;
+    using cupuacu::gui::WaveformCache;
+
+    std::vector<float> samples(1 << 16);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<float>(i % 200) / 100.0f - 1.0f;
+    }
+
+    WaveformCache cache;
+    cache.rebuildAll(samples.data(), static_cast<int64_t>(samples.size()));
+    const auto pinned = cache.pinLevel(0);
+    REQUIRE(pinned.peaks.data() == cache.getLevelByIndex(0).data());
+    const std::vector<Peak> before(pinned.peaks.begin(), pinned.peaks.end());
+
+    cache.applyErase(0, static_cast<int64_t>(samples.size()) / 2);
+    REQUIRE(cache.getLevelByIndex(0).size() < before.size());
+    cache.clear();
+
+    REQUIRE(pinned.peaks.size() == before.size());
+    for (std::size_t i = 0; i < before.size(); ++i)
+    {
+        REQUIRE(pinned.peaks[i].min == before[i].min);
+        REQUIRE(pinned.peaks[i].max == before[i].max);
+    }
+    REQUIRE(WaveformCache{}.pinLevel(0).peaks.empty());
+}
+
 TEST_CASE("ScrollBar vertical drag updates value and non-left clicks are ignored",
           "[gui]")
 {